@@ -0,0 +1,93 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+// Replaces the global operator new and delete so that every allocation on a
+// thread with a metrics slot counts towards uno_allocations_total. It costs one
+// thread-local load per allocation. The definitions live here rather than in a
+// source file so that only the programs that export metrics (server and
+// simulate) pay for it: include it from exactly one file, the program's main.
+// Define UNO_NO_ALLOCATION_COUNT for sanitizer builds, which bring their own
+// allocator; the metric is then left out of the export rather than reading 0.
+
+#ifndef UNO_NO_ALLOCATION_COUNT
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include "Metrics.h"
+
+// Every form of operator new comes through here, so each pairs with the
+// matching delete below whichever form the standard library picks
+static void* countedAllocate(size_t size, size_t alignment)
+{
+    Metrics::count(Counter::Allocations);
+    if (size == 0)
+        size = 1;
+    for (;;)
+    {
+        void* memory = nullptr;
+        if (alignment <= alignof(std::max_align_t))
+            memory = malloc(size);
+        else if (posix_memalign(&memory, alignment, size) != 0)
+            memory = nullptr;
+        if (memory)
+            return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+static void* countedAllocateNothrow(size_t size, size_t alignment) noexcept
+{
+    try
+    {
+        return countedAllocate(size, alignment);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size) { return countedAllocate(size, 0); }
+void* operator new[](size_t size) { return countedAllocate(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocateNothrow(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocateNothrow(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, size_t(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateNothrow(size, size_t(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateNothrow(size, size_t(alignment));
+}
+
+// malloc and posix_memalign memory alike goes back through free. GCC sees
+// these inlined next to a new expression and takes free for a mismatch.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { free(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static const bool allocationsCounted = (Metrics::countAllocations(), true);
+#endif
+
+#endif // ALLOCATION_COUNTER_H
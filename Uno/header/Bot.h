@@ -0,0 +1,43 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "Move.h"
+
+class UnoGame;
+
+// Computer player that picks moves for whoever's turn it is
+class Bot {
+public:
+    // Picks one of the legal moves for the current player.
+    // DropTwo plays come back with the cards to drop filled in.
+    virtual Move chooseMove(const UnoGame& game, const std::vector<Move>& legal) = 0;
+    virtual std::string getName() const = 0;
+    virtual ~Bot();
+};
+
+// Picks uniformly among legal moves
+class RandomBot : public Bot {
+private:
+    std::mt19937 rng;
+
+public:
+    explicit RandomBot(unsigned int seed);
+    Move chooseMove(const UnoGame& game, const std::vector<Move>& legal) override;
+    std::string getName() const override;
+};
+
+// Calls UNO when it can, plays its most punishing card, keeps wild cards for last
+// and names the color it holds most of
+class GreedyBot : public Bot {
+public:
+    Move chooseMove(const UnoGame& game, const std::vector<Move>& legal) override;
+    std::string getName() const override;
+};
+
+// Creates a bot by name ("random" or "greedy"); the caller owns it
+Bot* createBot(const std::string& name, unsigned int seed);
+
+#endif // BOT_H
@@ -0,0 +1,140 @@
+#ifndef BYTE_BUFFER_H
+#define BYTE_BUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Exceptions.h"
+
+// Appends little-endian integers and varints to a growable byte buffer.
+// Shared by the file formats and the network protocol.
+class ByteWriter {
+private:
+    std::vector<uint8_t>& out;
+
+public:
+    explicit ByteWriter(std::vector<uint8_t>& buffer) : out(buffer) {}
+
+    void putU8(uint8_t value) { out.push_back(value); }
+
+    void putU16(uint16_t value) {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+
+    void putU32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    void putU64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    // 7 bits per byte, high bit set while more bytes follow
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+
+    // Signed varint; small negative numbers stay small
+    void putSigned(int64_t value) {
+        putVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void putBytes(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    void putString(const std::string& text) {
+        putVarint(text.size());
+        putBytes(text.data(), text.size());
+    }
+
+    size_t size() const { return out.size(); }
+};
+
+// Reads what ByteWriter wrote. Running past the end throws, so truncated
+// or corrupt input never reads out of bounds.
+class ByteReader {
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+
+    void require(size_t count) {
+        if (length - position < count) {
+            throw Uno::InvalidInputException("Encoded data is truncated");
+        }
+    }
+
+public:
+    ByteReader(const uint8_t* bytes, size_t size) : data(bytes), length(size), position(0) {}
+    explicit ByteReader(const std::vector<uint8_t>& buffer) : ByteReader(buffer.data(), buffer.size()) {}
+
+    uint8_t getU8() {
+        require(1);
+        return data[position++];
+    }
+
+    uint16_t getU16() {
+        require(2);
+        uint16_t value = data[position] | (data[position + 1] << 8);
+        position += 2;
+        return value;
+    }
+
+    uint32_t getU32() {
+        require(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(data[position + i]) << (8 * i);
+        position += 4;
+        return value;
+    }
+
+    uint64_t getU64() {
+        require(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(data[position + i]) << (8 * i);
+        position += 8;
+        return value;
+    }
+
+    uint64_t getVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = getU8();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw Uno::InvalidInputException("Varint is too long");
+    }
+
+    int64_t getSigned() {
+        uint64_t raw = getVarint();
+        return static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    }
+
+    const uint8_t* getBytes(size_t count) {
+        require(count);
+        const uint8_t* bytes = data + position;
+        position += count;
+        return bytes;
+    }
+
+    std::string getString() {
+        size_t size = getVarint();
+        const uint8_t* bytes = getBytes(size);
+        return std::string(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    size_t remaining() const { return length - position; }
+    size_t offset() const { return position; }
+    bool atEnd() const { return position == length; }
+};
+
+#endif // BYTE_BUFFER_H
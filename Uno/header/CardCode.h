@@ -0,0 +1,41 @@
+#ifndef CARD_CODE_H
+#define CARD_CODE_H
+
+#include <cstdint>
+#include "CardColour.h"
+
+class Card;
+
+// Card types, in the order used by card codes
+enum class CardKind {
+    Number,
+    Skip,
+    Reverse,
+    DrawTwo,
+    DrawSix,
+    DropTwo,
+    Wild,
+    DrawFour
+};
+
+// A card packed into 16 bits for files and network messages:
+// bits 0-3 number, bits 4-6 color, bits 7-9 kind.
+// Wild cards carry their chosen color (NONE until one is picked).
+using CardCode = uint16_t;
+
+const CardCode NO_CARD = 0xFFFF; // Stands for "no card" in encoded data
+
+CardCode encodeCard(const Card* card);
+
+// Creates a new card from its code; the caller owns the returned card
+Card* decodeCard(CardCode code);
+
+inline CardKind cardCodeKind(CardCode code) { return static_cast<CardKind>((code >> 7) & 0x7); }
+inline CardColor cardCodeColor(CardCode code) { return static_cast<CardColor>((code >> 4) & 0x7); }
+inline int cardCodeNumber(CardCode code) { return code & 0xF; }
+
+inline CardCode makeCardCode(CardKind kind, CardColor color, int number = 0) {
+    return static_cast<CardCode>((static_cast<int>(kind) << 7) | (static_cast<int>(color) << 4) | (number & 0xF));
+}
+
+#endif // CARD_CODE_H
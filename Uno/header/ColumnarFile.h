@@ -0,0 +1,81 @@
+#ifndef COLUMNAR_FILE_H
+#define COLUMNAR_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Column chunk encodings; the writer keeps whichever is smaller
+enum class ColumnEncoding : uint8_t {
+    BitPacked = 0, // Offset from the chunk minimum, packed at a fixed bit width
+    RunLength = 1  // (value, run length) pairs
+};
+
+// Where one column of one row group lives in the file
+struct ColumnChunk {
+    uint64_t offset;
+    uint64_t size;
+    ColumnEncoding encoding;
+};
+
+// Streams integer rows to disk in a column-oriented layout.
+// Rows are buffered one row group at a time; each full group is encoded
+// column by column and written out, so memory use does not grow with the run.
+//
+// File layout: magic, column chunks, footer (column names and chunk index),
+// footer offset, magic.
+class ColumnarWriter {
+private:
+    std::ofstream out;
+    std::string path;
+    std::vector<std::string> columnNames;
+    std::vector<std::vector<int64_t>> columns; // Current row group, one buffer per column
+    int rowGroupSize;
+    uint64_t offset;
+    uint64_t totalRows;
+    bool closed;
+
+    std::vector<uint32_t> groupRows;  // Rows in each written group
+    std::vector<ColumnChunk> chunks;  // groups x columns, group-major
+    std::vector<uint8_t> packed;      // Scratch buffers reused for every chunk
+    std::vector<uint8_t> runs;
+
+    void flushRowGroup();
+    void write(const std::vector<uint8_t>& bytes);
+
+public:
+    ColumnarWriter(const std::string& filePath, const std::vector<std::string>& names, int rowsPerGroup = 16384);
+    ~ColumnarWriter();
+
+    // Appends one row; values holds one entry per column in declaration order
+    void appendRow(const int64_t* values);
+
+    // Writes the last partial group and the footer
+    void close();
+
+    uint64_t rowsWritten() const;
+    uint64_t bytesWritten() const;
+};
+
+// Reads columns back without touching the chunks of columns that were not asked for
+class ColumnarReader {
+private:
+    std::ifstream in;
+    std::vector<std::string> columnNames;
+    std::vector<uint32_t> groupRows;
+    std::vector<ColumnChunk> chunks;
+    uint64_t totalRows;
+
+public:
+    explicit ColumnarReader(const std::string& filePath);
+
+    const std::vector<std::string>& columns() const;
+    uint64_t rowCount() const;
+    int columnIndex(const std::string& name) const;
+
+    // Appends every value of one column to out
+    void readColumn(const std::string& name, std::vector<int64_t>& out);
+};
+
+#endif // COLUMNAR_FILE_H
@@ -0,0 +1,76 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ByteWriter;
+class ByteReader;
+
+// Shared-dictionary compression for protocol frames, negotiated per connection
+// with UseCompression (see Protocol.h).
+//
+// Each frame is packed on its own, as [varint packed size][sequences], so a
+// receiver can unpack every frame as soon as it arrives. A sequence is a token
+// byte (literal count in the high nibble, match length - MIN_MATCH in the low
+// one, 15 meaning a varint with the rest follows), the literals, then the match
+// distance as a varint, left out when the frame ends with the literals.
+//
+// Matches reach back COMPRESSION_WINDOW bytes into the frames the connection
+// packed before, on a history both ends keep in step and start from the same
+// built-in dictionary of typical frames. Frames on one connection repeat the
+// table id, names, cards and change layout of the ones before, which is what
+// makes frames of a few dozen bytes worth packing.
+
+const uint8_t COMPRESSION_DICTIONARY = 1;  // Version of the built-in dictionary
+const size_t COMPRESSION_WINDOW = 2048;    // History kept by each end, in bytes
+
+// The history one end keeps: the last COMPRESSION_WINDOW bytes it packed or unpacked
+class CompressionHistory {
+protected:
+    uint8_t ring[COMPRESSION_WINDOW];
+    uint32_t position;  // Bytes seen since the start, dictionary included; wraps harmlessly
+
+    CompressionHistory();
+    void append(const uint8_t* bytes, size_t size);
+    uint8_t at(uint32_t offset) const { return ring[offset & (COMPRESSION_WINDOW - 1)]; }
+
+public:
+    // Writes the history, for a connection handed to another process
+    void saveState(ByteWriter& writer) const;
+    // Reads a history written by saveState; throws InvalidInputException if it is malformed
+    void loadState(ByteReader& reader);
+};
+
+// The sending end. pack costs a few hundred nanoseconds for a typical frame.
+class FramePacker : public CompressionHistory {
+private:
+    static const int HASH_BITS = 10;
+    uint32_t head[1 << HASH_BITS];          // Latest position + 1 of each 3-byte hash, 0 for none
+    uint16_t chain[COMPRESSION_WINDOW];     // Distance to the previous position with the same hash
+    uint32_t hashed;                        // Positions below this are in head and chain
+
+    void insertHashes(uint32_t end, const uint8_t* frame, uint32_t frameStart);
+
+public:
+    FramePacker();
+
+    // Appends one whole frame to out, packed
+    void pack(const uint8_t* frame, size_t size, std::vector<uint8_t>& out);
+    // Packs every frame in frames, which must hold whole frames only
+    void packFrames(const uint8_t* frames, size_t size, std::vector<uint8_t>& out);
+
+    void loadState(ByteReader& reader);
+};
+
+// The receiving end
+class FrameUnpacker : public CompressionHistory {
+public:
+    // Unpacks the packed frame data starts with into frame, replacing what it held.
+    // Returns the bytes taken from data, or 0 if the packed frame is not all there
+    // yet. Throws InvalidInputException for data no FramePacker could have written.
+    size_t unpack(const uint8_t* data, size_t size, std::vector<uint8_t>& frame);
+};
+
+#endif // COMPRESSION_H
@@ -3,26 +3,84 @@
 
 #include <stack>
 #include <vector>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
 #include "Card.h"
+#include "CardCode.h"
+
+struct StateDelta;
+struct DeltaOp;
+class ByteWriter;
+class ByteReader;
+
+// Shuffle source that counts its draws, so its position can be saved in a
+// snapshot and restored by reseeding and skipping ahead
+struct CountingRng {
+    using result_type = std::mt19937::result_type;
+
+    std::mt19937 engine;
+    unsigned int seedValue = 0;
+    uint64_t draws = 0;
+
+    static constexpr result_type min() { return std::mt19937::min(); }
+    static constexpr result_type max() { return std::mt19937::max(); }
+
+    result_type operator()() {
+        draws++;
+        return engine();
+    }
+
+    void seed(unsigned int value, uint64_t skip = 0) {
+        engine.seed(value);
+        engine.discard(skip);
+        seedValue = value;
+        draws = skip;
+    }
+};
 
 class Deck {
 private:
     std::stack<Card*> drawPile;       // Stack for drawing cards
     std::stack<Card*> discardPile;    // Stack for discarded cards
+    StateDelta* recorder;             // Receives pile changes while a move is recorded
+    CountingRng rng;                  // Shuffle source; seeded so simulated games can be replayed
+    // Cards of earlier games by code (wild ones without their chosen color),
+    // handed out again by makeCard so a game reusing the deck allocates none
+    std::unordered_map<CardCode, std::vector<Card*>> spareCards;
 
     // Helper function to create and add the cards to the deck
     void addStandardUNODeck();
+    void loadPile(ByteReader& in, std::stack<Card*>& pile);
 
 public:
     Deck();
     ~Deck();
 
+    Deck(const Deck&) = delete;
+    Deck& operator=(const Deck&) = delete;
+
+    // Puts every card in both piles aside for reuse, leaving the deck empty
+    void clear();
+
+    // The card for code, reusing a spare one when there is one; nullptr for NO_CARD
+    Card* makeCard(CardCode code);
+
+    // Takes back a card that left the game (a hand's, the top card) for makeCard to reuse
+    void recycle(Card* card);
+
     // Initialize the deck with 108 standard UNO cards
     void initializeDeck();
 
     // Shuffle the draw pile
     void shuffleDeck();
 
+    // Reseed the shuffle so the same seed always deals the same game
+    void seed(unsigned int value);
+
+    // Random number in [0, bound) taken from the deck's shuffle source
+    int randomInt(int bound);
+
     // Draw a card from the deck (i.e., pop from drawPile)
     Card* drawCard();
 
@@ -40,6 +98,17 @@ public:
     
     // Get the top card of the discard pile
     Card* getTopDiscard() const;
+
+    // Writes both piles and the shuffle position; loadState replaces the current piles
+    void saveState(ByteWriter& out) const;
+    void loadState(ByteReader& in);
+
+    // Sets where pile changes are recorded (nullptr stops recording)
+    void setRecorder(StateDelta* delta);
+
+    // Undoes or redoes a recorded pile change
+    void revertOp(const DeltaOp& op, const StateDelta& delta);
+    void replayOp(const DeltaOp& op, const StateDelta& delta);
 };
 
 #endif // DECK_H
\ No newline at end of file
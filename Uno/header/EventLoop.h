@@ -0,0 +1,339 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "Compression.h"
+#include "IoBackend.h"
+#include "Matchmaker.h"
+#include "Move.h"
+#include "MpscQueue.h"
+#include "Protocol.h"
+#include "TableSlab.h"
+#include "TimingWheel.h"
+
+class Server;
+class ByteReader;
+class ByteWriter;
+class MoveJournal;
+struct RecoveredGame;
+
+const int MAX_SEND_VECTORS = 64; // Output segments handed to one sendmsg
+
+// Serialized frames shared by many connections' output, freed with the last one
+typedef std::shared_ptr<const std::vector<uint8_t>> SharedBytes;
+
+// One client socket and its buffered input and output
+struct Connection {
+    int fd = -1;
+    uint64_t sessionId = 0;
+    std::string name;
+    std::vector<uint8_t> input;   // Received bytes; frames are parsed from inputStart
+    size_t inputStart = 0;
+    std::vector<uint8_t> output;  // Newest bytes not yet handed to the socket, from outputStart
+    size_t outputStart = 0;
+    std::deque<SharedBytes> queued; // Older output, sent before output; the first from queuedStart
+    size_t queuedStart = 0;
+    uint64_t tableId = 0;         // 0 when not at a table; set as soon as a join is sent
+    int seat = NO_SEAT;           // NO_SEAT until the table's shard confirms the join
+    bool spectating = false;      // Watching tableId rather than sitting at it
+    uint64_t movedTableId = 0;    // The table that left the node under the seat; its moves are bounced
+    uint64_t matchTicket = 0;     // The matchmaking search under way, 0 when none
+    int matchSeats = 0;           // Its terms, so a hot restart can search again
+    int matchRating = 0;
+    bool peer = false;            // The cluster router's control link (after PeerHello)
+    std::unique_ptr<FramePacker> packer;     // Set once the client asked for UseCompression
+    std::unique_ptr<FrameUnpacker> unpacker;
+    bool flushPending = false;    // Listed for the flush before the loop next polls
+
+    // Backend bookkeeping
+    bool waitingToWrite = false;  // epoll: EPOLLOUT is armed
+    bool sendInFlight = false;    // io_uring: a sendmsg is submitted
+    msghdr sendHeader;            // io_uring: the sendmsg in flight, over sendVectors
+    iovec sendVectors[MAX_SEND_VECTORS];
+    bool receiving = false;       // io_uring: the multishot recv is armed
+    int pendingOps = 0;           // io_uring: submitted requests not yet completed
+
+    // Appends whole frames to output, packed once compression is on
+    void sendFrames(const uint8_t* frames, size_t size);
+    void sendFrames(const std::vector<uint8_t>& frames) { sendFrames(frames.data(), frames.size()); }
+    // Queues a frame that other connections may share, behind everything queued before it.
+    // A packed connection packs its own copy instead, as its history differs from the others'
+    void queueShared(const SharedBytes& frame);
+    // Moves output into the queue, so its bytes stay put while the kernel reads them
+    void sealOutput();
+    bool hasOutput() const;
+    // Points vectors at the unsent bytes, oldest first, and returns how many it filled
+    int gatherOutput(iovec* vectors, int maxVectors) const;
+    // Drops sent bytes from the front
+    void consumeOutput(size_t sent);
+    void clearOutput();
+};
+
+// Work one loop hands to another through its inbound queue
+enum class LoopCommand : uint8_t {
+    JoinTable,  // To the table's shard: seat the session
+    PlayMove,   // To the table's shard
+    LeaveTable, // To the table's shard: free the session's seat
+    Detach,     // To the table's shard: the session's connection dropped; a game on holds the seat
+    CreateMatch, // To any shard: open a table for the matched players and deal
+    Watch,      // To the table's shard: a spectator on fromLoop
+    Unwatch,    // To the table's shard: that spectator went away
+    ClaimSeat,  // To the table's shard: seat a player of a table that moved here (seat, ticket holds the token)
+    AdoptTable, // To the table's shard: a table from another node; bytes hold its state
+    Rebalance,  // To every loop: move out the tables this node no longer owns, via the control link
+    Drain,      // To the table's shard: answered with Drained once the session's earlier commands are handled
+    Seated,     // To the session's loop: the join went through (seat) or not (NO_SEAT)
+    Watching,   // To the session's loop: the spectator is registered; bytes hold the first view
+    Matched,    // To the session's loop: the search ticket got seat at tableId (0: none, bytes say why)
+    Deliver,    // To the session's loop: frames to send
+    Moved,      // To the session's loop (every spectator there for session 0): the table left this node
+                // from seat, or (NO_SEAT) the seat was taken back; bytes hold the notice
+    Drained,    // To the session's loop: the moved table's shard is done with it; bytes hold the notice
+    Unplayed,   // To the session's loop: a move found its table gone (move)
+    Broadcast   // To a spectator's loop: shared frames for every spectator of the table there
+};
+
+struct LoopMessage {
+    LoopCommand command = LoopCommand::Deliver;
+    int fromLoop = -1;        // Loop the session lives on
+    uint64_t sessionId = 0;
+    uint64_t tableId = 0;
+    int seat = NO_SEAT;
+    std::string name;         // JoinTable
+    Move move;                // PlayMove
+    std::chrono::steady_clock::time_point readAt; // PlayMove: when the session's loop read it
+    std::vector<uint8_t> bytes; // Frames for the session (Seated, Watching, Deliver)
+    SharedBytes shared;       // Broadcast
+    std::vector<MatchTicket> match; // CreateMatch
+    uint64_t ticket = 0;      // Matched; the seat's token for ClaimSeat
+    uint64_t version = 0;     // ClaimSeat: the last table version the player applied; AdoptTable: the hop
+};
+
+// A single-threaded event loop that owns a set of connections and a shard of
+// the tables. The server runs one per core. Each loop has its own SO_REUSEPORT
+// listener, so the kernel spreads new connections across loops, and its own
+// IoBackend (epoll or io_uring) doing the socket calls.
+//
+// A table lives on loop (id % loop count) and only that loop's thread touches
+// it, so the game needs no lock. A connection stays on the loop that accepted
+// it: its table commands are posted to the shard's MpscQueue, and the frames
+// the shard produces for it come back through the connection's own loop queue.
+// Neither side ever waits for the other.
+//
+// Spectators are kept by their own loop, per table. The shard only counts them
+// per loop and posts each update once to every loop that has any, as a shared
+// buffer that all of that loop's spectators queue without copying.
+//
+// The shard's tables sit in fixed-size slots of a TableSlab, up to the
+// configured number per loop; a full loop turns new tables away as an
+// overloaded one does.
+//
+// In a cluster, tables whose ids the hash ring gives to another node are
+// written out with ServerTable::saveState and handed to the router, which
+// passes them on; their players get tokens to claim their seats there.
+//
+// Every running table has a turn timer in the loop's timing wheel, restarted
+// whenever the table changes; the poll timeout is set to wake the loop for the
+// next one due. A player whose connection drops mid-game keeps the seat for the
+// resume grace period, on a second timer: ClaimSeat with the seat's token takes
+// it back from a new connection, with only the deltas missed since then.
+//
+// Output is not sent as it is produced. A move answers every seat and spectator
+// of the table, and one poll's batch can hold several moves at the same
+// connection's tables, so the loop lists each connection it gave output to and
+// flushes the list once, just before it polls again: a single sendmsg per
+// connection carries everything the iteration queued for it.
+//
+// The loop watches its own load. Its lag is how long it has gone without
+// waiting for work: a loop that finds events ready each time it polls is
+// falling behind, and whatever arrives waits for everything before it. Past
+// the configured lag or inbox depth it counts as overloaded, and new work is
+// turned away so the games it already hosts keep their pace (see Server.h).
+//
+// With a journal directory configured, the loop logs the games its tables are
+// running to its own MoveJournal: each table's whole state as its game starts
+// (and when a seat gets a new token), then every move it accepts. Appending
+// only fills a buffer; the journal's flusher syncs each batch with one
+// fdatasync, so the loop never waits for the disk and a crash loses at most
+// the moves of the batch in flight. Once enough has been logged, the loop
+// compacts the journal at a turn boundary to one snapshot per running game.
+// After a crash the server loads those games back before it serves (see
+// Server.h), with their seats empty until the players claim them.
+//
+// For a hot restart the loop can be stopped, quiesced and drained from another
+// thread, and its tables and connections written out for the next process,
+// whose loop of the same index reads them back before it starts.
+class EventLoop : private IoHandler {
+private:
+    Server& server;
+    int index;
+    int listenFd;
+    std::unique_ptr<IoBackend> io;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    std::unordered_map<uint64_t, Connection*> connections;  // By session id
+    TableSlab tables;                                       // This loop's shard
+    std::unordered_map<uint64_t, std::vector<Connection*>> spectators; // This loop's spectators, by table
+    uint64_t nextTableSerial;
+    std::mt19937 seeds;              // Seeds for new games
+
+    MpscQueue<LoopMessage> inbox;
+    std::atomic<bool> wakePending;   // A wake-up for the inbox is already on its way
+
+    // Turn timeouts for this loop's tables, in ticks of TIMER_TICK_MS since clockStart
+    TimingWheel turnTimers;
+    std::chrono::steady_clock::time_point clockStart;
+    uint64_t turnTicks;              // 0 when turns never time out
+    uint64_t graceTicks;             // 0 when dropped players lose their seats at once
+    std::random_device entropy;      // Seat tokens, which must not follow from the deals
+    std::vector<uint8_t> unpacked;   // The frame processInput last unpacked
+    std::vector<Connection*> unflushed; // Given output since the loop last flushed
+
+    std::unique_ptr<MoveJournal> journal; // The running games, nullptr when not journaling
+    uint64_t journalRecords;         // Appended since the journal was last compacted
+    std::vector<uint8_t> journalState; // Scratch for the table state being logged
+
+    std::atomic<bool> full;          // The shard has no room for another table
+
+    // Load, measured over windows of LOAD_WINDOW_MS
+    std::atomic<bool> overloaded;
+    bool working;                    // An event of the current poll was handled
+    std::chrono::steady_clock::time_point workSince;   // When the first one was
+    std::chrono::steady_clock::time_point behindSince; // When the loop last had to wait for work
+    std::chrono::steady_clock::time_point windowEnd;
+    int64_t worstLagUs;              // In the current window
+    size_t deepestInbox;             // Most messages one runQueued found in the current window
+    int calmWindows;                 // Windows in a row under half of both limits
+
+    void run();
+    void noteWork();                 // Called as each event is handled
+    void measureLoad(std::chrono::steady_clock::time_point polledAt);
+    uint64_t currentTick() const;
+    int timerWait() const;           // Poll timeout that wakes the loop for the next timer
+    void expireTimers();
+    void processInput(Connection* connection);
+    void handleFrame(Connection* connection, ByteReader& frame);
+    void closeConnection(Connection* connection);
+    void scheduleFlush(Connection* connection); // Sends the connection's output before the next poll
+    void flushOutput();
+
+    void onAccept(int fd) override;
+    void onInput(Connection* connection) override;
+    void onHangup(Connection* connection) override;
+    void onWake() override;
+
+    void execute(LoopMessage& message);  // Runs one message, queued or from this loop itself
+    void sendToLoop(int loop, LoopMessage& message);
+
+    // Session side: runs on the connection's loop
+    void routeToTable(Connection* connection, LoopCommand command, const Move& move = Move());
+    void handleSeated(LoopMessage& message);
+    void handleDeliver(LoopMessage& message);
+    void handleWatching(LoopMessage& message);
+    void handleBroadcast(LoopMessage& message);
+    void stopWatching(Connection* connection);
+    void handleMatched(LoopMessage& message);
+    void handleMoved(LoopMessage& message);
+    void handleDrained(LoopMessage& message);
+    void handleUnplayed(LoopMessage& message);
+    void bounceMove(Connection* connection, const Move& move);
+    bool refuseIfBusy(Connection* connection);
+    bool refuseUnlessPeer(Connection* connection);
+    bool refuseIfOverloaded(Connection* connection);
+    bool refuseIfFull(Connection* connection);
+    void reportTables();             // After tables come or go
+
+    // Table side: runs on the table's shard
+    uint64_t newTableId();
+    void createTable(Connection* connection, int seats, int rating);
+    void createMatch(const LoopMessage& message);
+    void refuseMatch(const LoopMessage& message);
+    void joinTable(const LoopMessage& message);
+    void playMove(const LoopMessage& message);
+    void leaveTable(const LoopMessage& message);
+    bool vacateSeat(TableEntry& entry, int seat);
+    void detachSeat(const LoopMessage& message);
+    void appendResumable(std::vector<uint8_t>& frames, TableEntry& entry, int seat);
+    void watchTable(const LoopMessage& message);
+    void unwatchTable(const LoopMessage& message);
+    void claimSeat(const LoopMessage& message);
+    void adoptTable(const LoopMessage& message);
+    void rebalance(const LoopMessage& message);
+    void broadcast(uint64_t tableId, TableEntry& entry, const std::vector<uint8_t>& frames);
+    void sendSpectatorBacklog(uint64_t tableId, TableEntry& entry);
+    void updateLobby(TableEntry& entry);
+    void sendTo(uint64_t tableId, const SeatRef& seat, std::vector<uint8_t>& frames);
+    void sendState(TableEntry& entry);
+    void sendGameOver(TableEntry& entry);
+    void armTurnTimer(TableEntry& entry);
+    void timeOutTurn(uint64_t tableId);
+    void armGraceTimer(TableEntry& entry);
+    void endGrace(uint64_t tableId);
+    void saveJournaled(const TableEntry& entry, std::vector<uint8_t>& out) const;
+    void journalTable(TableEntry& entry);     // Logs a running game's whole state
+    void journalMove(TableEntry& entry, const Move& move, int seat); // After seat's move went through
+    void journalEnd(uint64_t tableId);        // The game is over or left this loop
+    uint64_t rewriteJournal();
+    void compactJournal();
+    void dropJournal();                       // After a write failed
+
+    void sendText(Connection* connection, ServerMessage type, const std::string& text);
+
+public:
+    EventLoop(Server& owner, int loopIndex, int listenSocket, IoBackendKind backend);
+    ~EventLoop() override;
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void start();
+    void stop();  // Asks the loop to exit; join() waits for it
+    void join();
+
+    // Hot restart, while the loop is stopped
+    void quiesce();        // Withdraws what the kernel holds for the loop's sockets
+    void resume();         // Undoes quiesce() when the handoff falls through
+    bool runQueued();      // Runs what is in the inbox; false if it was empty
+    // Writes the tables and connections, appending each socket to fds and
+    // recording its index there
+    void exportState(ByteWriter& writer, std::vector<int>& fds) const;
+    // Adopts what exportState wrote, taking the sockets from fds; before start()
+    void importState(ByteReader& reader, const std::vector<int>& fds);
+    int getListenFd() const;
+
+    // Crash recovery, before start(): adds a game the journal of some loop
+    // held, which the table's id gives to this one; one already here is left
+    // alone. Throws, keeping nothing, if it cannot be restored.
+    void recoverTable(uint64_t tableId, const RecoveredGame& recovered);
+    // Starts journaling to this loop's file in the journal directory, first
+    // rewriting it as the games now running; while the loop is stopped
+    void openJournal();
+    // The journal file of the loop with that index
+    static std::string journalPath(const std::string& directory, int loopIndex);
+
+    // Queues work for this loop (thread-safe, lock-free)
+    void post(LoopMessage message);
+
+    int getIndex() const;
+    // True while the loop sheds load: its lag or inbox depth went past the
+    // configured limit and has not stayed under half of both since (thread-safe)
+    bool isOverloaded() const;
+    // True while the shard holds as many tables as it may (thread-safe)
+    bool isFull() const;
+    // Neither overloaded nor full, so a good place for a new table (thread-safe)
+    bool canHostTables() const;
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,24 @@
+#ifndef FEATURE_EXPORT_H
+#define FEATURE_EXPORT_H
+
+#include <string>
+#include "Simulator.h"
+#include "ColumnarFile.h"
+
+// Streams one row per simulated turn into a columnar file.
+// Columns: game, turn, seat, hand_0..hand_3, top_card, top_color, move_type,
+// move_card, move_color, called_uno, legal_moves, reversed.
+class TurnFeatureWriter : public TurnObserver {
+private:
+    ColumnarWriter writer;
+
+public:
+    explicit TurnFeatureWriter(const std::string& path);
+    void onTurn(const TurnRecord& record) override;
+    void close();
+
+    uint64_t rowsWritten() const;
+    uint64_t bytesWritten() const;
+};
+
+#endif // FEATURE_EXPORT_H
@@ -0,0 +1,125 @@
+#ifndef GAME_CLIENT_H
+#define GAME_CLIENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Move.h"
+#include "MpscQueue.h"
+#include "Protocol.h"
+
+class ByteReader;
+
+enum class ClientStatus {
+    Connecting,
+    Connected,
+    Reconnecting,  // The connection dropped mid-game; the seat is being claimed back
+    Disconnected
+};
+
+// Everything a client knows about its table; GameUI renders this in network mode
+struct RemoteTable {
+    ClientStatus status = ClientStatus::Connecting;
+    std::string disconnectReason;
+    uint64_t sessionId = 0;
+    uint64_t tableId = 0;
+    int seat = NO_SEAT;                // Stays NO_SEAT for a spectator
+    bool hasView = false;
+    TableView view;                    // Latest state sent by the server, with the own moves it has not answered yet
+    int pendingMoves = 0;              // How many of those moves view shows ahead of the server
+    bool gameOver = false;
+    int winnerSeat = -1;               // -1 when the game was abandoned
+    std::vector<std::string> notices;  // Rejections and errors not yet shown, oldest first
+    TableListPage lobby;               // The last page of open tables listTables asked for
+    uint64_t version = 0;              // Changes whenever anything above does
+};
+
+// Client side of the game server protocol. A background thread owns the
+// socket: it connects, sends the commands queued by the caller and applies
+// server messages to a RemoteTable as they arrive. None of the public calls
+// wait for the network, so a render loop can use them every frame.
+//
+// Moves are shown at once: sendMove checks them against the view by the
+// engine's rules and applies what the player can foresee of them
+// (predictMove). Each answer from the server replaces the confirmed view and
+// the moves still unanswered are applied to it again, so a move the server saw
+// differently is corrected with the next update.
+//
+// Frames are packed both ways (Compression.h), which the client asks for
+// first thing on every connection.
+//
+// If the connection drops during a game, the thread reconnects a few times
+// and claims the seat back with the token the server gave it, sending the
+// version of its view so that only the missed deltas come back.
+class GameClient {
+private:
+    std::string host;
+    int port;
+    std::string playerName;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    MpscQueue<std::vector<uint8_t>> outbox;  // Frames queued by the caller
+    int wakeFds[2];                          // Pipe that interrupts the network thread's poll (POSIX)
+
+    std::mutex stateMutex;
+    RemoteTable state;                       // Guarded by stateMutex
+    uint64_t resumeToken;                    // From the last Resumable, 0 for none; guarded by stateMutex
+    // Prediction state, guarded by stateMutex as well
+    TableView confirmedView;                 // As the server last sent it; state.view adds pendingMoves
+    std::vector<Move> pendingMoves;          // Sent and shown but not answered yet, oldest first
+    bool confirmedPlayed;                    // The seat played a card this turn, in confirmedView
+    bool predictedPlayed;                    // The same in state.view
+
+    void run();
+    // Moves bytes until the connection fails, returning why, or until disconnect(), returning ""
+    std::string exchange(intptr_t socket, std::vector<uint8_t> greeting);
+    // Reconnects and claims the seat back if a game is under way; NO_SOCKET (as intptr_t) otherwise
+    intptr_t resume(const std::string& reason, std::vector<uint8_t>& greeting);
+    void handleFrame(ByteReader& frame);
+    // The oldest pending move was answered: applied by the server, or refused
+    void settleMove(bool applied);
+    // Rebuilds state.view from confirmedView and the pending moves that still apply
+    void reconcile();
+    void fail(const std::string& reason);
+    void queue(std::vector<uint8_t>& frame);
+    void wake();
+
+public:
+    GameClient();
+    ~GameClient();
+
+    GameClient(const GameClient&) = delete;
+    GameClient& operator=(const GameClient&) = delete;
+
+    // Starts connecting in the background and introduces the player once connected
+    void connect(const std::string& serverHost, int serverPort, const std::string& name);
+    // Closes the connection and stops the network thread
+    void disconnect();
+
+    // Commands are sent in order as soon as the connection is up
+    // The rating is shown with the table in the lobby
+    void createTable(int seats, int rating = 0);
+    void joinTable(uint64_t tableId);
+    // Watches a table without a seat; the view then has no hand
+    void spectate(uint64_t tableId);
+    // Asks the server to seat the player at a new table of that size with similarly rated players
+    void findMatch(int seats, int rating);
+    void cancelMatch();
+    // Asks for a page of the tables still filling up with that many seats (0 for any)
+    // and a rating near this one; it arrives in RemoteTable::lobby
+    void listTables(int seats, int rating, uint64_t page);
+    // Shows the move in the view at once and sends it. Throws the engine's exception
+    // instead, sending nothing, for a move the server would refuse.
+    void sendMove(const Move& move);
+    void leaveTable();
+
+    // Copies the latest state into table if it changed since table.version, and moves
+    // new notices over. Returns false without waiting if the network thread holds the state.
+    bool sync(RemoteTable& table);
+};
+
+#endif // GAME_CLIENT_H
@@ -1,12 +1,15 @@
 #ifndef GAME_UI_H
 #define GAME_UI_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "raylib.h"
 #include "UnoGame.h"
 #include "Player.h"
 #include "ColorSelector.h"
+#include "MoveJournal.h"
+#include "GameClient.h"
 
 // Button structure
 struct Button {
@@ -26,13 +29,31 @@ private:
     bool showContinueButton;    // Whether to show the continue/end turn button
     char statusMessage[128];    // Message to display to the player
     Button fullscreenToggleButton; // Button to toggle fullscreen mode
-    Card* cardNeedingColorChoice;  // Card that needs a color to be chosen (Wild cards)
+    int pendingPlayIndex;          // Hand index of a Wild/DropTwo card waiting for a color or drop choice
     ColorSelector colorSelector;   // UI for selecting colors for Wild cards
     
     bool selectingCardsToDrop; // Indicates if the player is selecting cards to drop
     std::vector<int> selectedCardIndices; // Stores indices of selected cards
 
-    static bool effectsApplied; // NEW: tracks if pending effects have been applied
+    int movesThisTurn;     // Moves the current player can still undo
+    int redoableThisTurn;  // Undone moves of the current player that can be redone
+
+    MoveJournal* journal;  // Crash journal for the current game (nullptr when not journaling)
+    uint64_t journalGameId;
+    int turnsSinceCompact; // Completed turns logged since the journal was last compacted
+
+    // Network mode: the server's state stands in for the local UnoGame
+    RemoteTable remote;
+    std::vector<std::unique_ptr<Card>> remoteHand; // remote.view's cards, decoded for drawing
+    std::unique_ptr<Card> remoteTopCard;
+
+    void ApplyMove(UnoGame& game, const Move& move);
+    Move TakeDropMove();
+    void FinishDropSelection(UnoGame& game);
+
+    void SyncRemote(GameClient& client);
+    bool SendRemoteMove(GameClient& client, const Move& move);
+    void HandleRemoteCardClick(GameClient& client, int index);
 
 public:
     GameUI();
@@ -43,16 +64,32 @@ public:
     bool IsExiting() const;
     
     void DrawPlayerHand(Player* player, std::vector<Rectangle>& cardRects);
+    void DrawHandCards(const std::vector<Card*>& cards, std::vector<Rectangle>& cardRects);
     void DrawTopCard(Card* topCard);
     void DrawPlayerInfo(Player* player);
     void DrawGameButtons(Button& unoButton, Button& drawButton, Button& quitButton);
     void DrawEndGameScreen(UnoGame& game);
     void DrawPlayerTransitionScreen(const std::string& nextPlayerName);
+    void DrawRemoteSeats();
+    void DrawRemoteMessage(const char* title, const char* detail);
+    void DrawRemoteEndScreen();
     
-    void RequestColorChoice(Card* card);
+    void RequestColorChoice(int handIndex);
     void UpdateFullscreenButton();
+
+    // Undo/redo is limited to the current turn so earlier players' hands stay hidden
+    void UndoLastMove(UnoGame& game);
+    void RedoLastMove(UnoGame& game);
+
+    // Logs every move of the game to journal so it can be recovered after a crash
+    void SetJournal(MoveJournal* moveJournal, uint64_t gameId);
+    // Picks up a game restored from the journal, possibly in the middle of a turn
+    void ResumeGame(UnoGame& game);
     
     bool HandleGameScreen(UnoGame& game);
+    // Plays on a game server instead: renders the state client receives and sends moves
+    // through it. There is no hand-over screen since every player has their own machine.
+    bool HandleGameScreen(GameClient& client);
 };
 
 
@@ -0,0 +1,93 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hot restart: a running server hands its tables, sessions and sockets to a new
+// process started with --take-over, which carries on where the old one stopped.
+//
+// The state travels in a shared-memory segment (a sealed memfd) that the new
+// process maps and reads in place. The segment and every socket descriptor
+// cross a Unix SOCK_SEQPACKET socket as SCM_RIGHTS. The exchange:
+//
+//   new -> old  HANDOFF_REQUEST
+//   old -> new  segment size and descriptor count, with the memfd attached,
+//               then the descriptors, HANDOFF_FDS_PER_MESSAGE at a time
+//   new -> old  HANDOFF_ADOPTED once the state is loaded, before it serves anything
+//   old -> new  HANDOFF_COMMIT; from here on the old process leaves the sockets alone
+//
+// Until the commit either side can back out: the old process carries on
+// serving and the new one exits.
+const char HANDOFF_REQUEST = 'H';
+const char HANDOFF_ADOPTED = 'A';
+const char HANDOFF_COMMIT = 'C';
+const int HANDOFF_FDS_PER_MESSAGE = 250;  // The kernel takes at most 253 per message
+const int HANDOFF_TIMEOUT_MS = 10000;     // Longest wait for the other side at any step
+
+// Sends one step of the exchange; false if the channel failed
+bool sendHandoffStep(int channel, char step);
+// Waits up to HANDOFF_TIMEOUT_MS for step; false on anything else
+bool receiveHandoffStep(int channel, char step);
+
+// Old side: copies state into a new memfd segment and sends it and fds down the
+// channel. Throws ResourceException if anything fails.
+void sendHandoff(int channel, const std::vector<uint8_t>& state, const std::vector<int>& fds);
+
+// New side: what the old server sent, received on construction
+class ReceivedHandoff {
+private:
+    int channel;
+    const uint8_t* data;  // The mapped segment
+    size_t size;
+    std::vector<int> fds;
+
+public:
+    // Connects to the old server's handoff socket and receives its state;
+    // throws ResourceException if the exchange fails
+    explicit ReceivedHandoff(const std::string& path);
+    // Unmaps the segment. The descriptors belong to the caller.
+    ~ReceivedHandoff();
+
+    ReceivedHandoff(const ReceivedHandoff&) = delete;
+    ReceivedHandoff& operator=(const ReceivedHandoff&) = delete;
+
+    const uint8_t* getData() const { return data; }
+    size_t getSize() const { return size; }
+    const std::vector<int>& getFds() const { return fds; }
+
+    // Reports the state adopted and waits for the old server to let go; throws
+    // ResourceException if it backed out, in which case the caller must not serve
+    void confirm();
+};
+
+// Waits on a Unix socket for a successor asking for the state and runs
+// handOff(channel) on its own thread for each one. handOff returns true once
+// the state has moved, which ends the thread. POSIX only, like the server.
+class HandoffListener {
+private:
+    std::string path;
+    int listenFd;
+    int wakeFd;               // eventfd that ends the thread's poll
+    std::function<bool(int)> handOff;
+    std::thread thread;
+
+    void run();
+
+public:
+    // Binds the socket; throws ResourceException if it cannot
+    HandoffListener(const std::string& socketPath, std::function<bool(int)> onRequest);
+    ~HandoffListener();
+
+    HandoffListener(const HandoffListener&) = delete;
+    HandoffListener& operator=(const HandoffListener&) = delete;
+
+    void start();
+    void stop();
+};
+
+#endif // HANDOFF_H
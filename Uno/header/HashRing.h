@@ -0,0 +1,38 @@
+#ifndef HASH_RING_H
+#define HASH_RING_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Consistent hashing of 64-bit keys (table ids) onto named nodes. Every node
+// owns POINTS_PER_NODE pseudo-random points on a 64-bit circle, and a key
+// belongs to the node of the first point at or after the key's hash. Adding or
+// removing a node only moves the keys on the arcs it gains or loses, about
+// 1/N of them, and the many points per node keep the shares even.
+//
+// Points depend only on the names, so every process given the same list
+// agrees on every owner.
+class HashRing {
+public:
+    static const int POINTS_PER_NODE = 128;
+
+private:
+    std::vector<std::string> nodes;
+    std::vector<std::pair<uint64_t, int>> points;  // Hash and node index, sorted by hash
+
+public:
+    HashRing() = default;
+    explicit HashRing(const std::vector<std::string>& nodeNames);
+
+    // Index into getNodes() of the node owning key; -1 for an empty ring
+    int owner(uint64_t key) const;
+    const std::vector<std::string>& getNodes() const;
+    bool empty() const;
+
+    // Spreads keys such as consecutive table ids over the whole circle
+    static uint64_t hashKey(uint64_t key);
+};
+
+#endif // HASH_RING_H
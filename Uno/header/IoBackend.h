@@ -0,0 +1,87 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <string>
+#include <vector>
+
+struct Connection;
+
+// Kernel interface an event loop uses for its sockets
+enum class IoBackendKind {
+    Epoll,   // Readiness events, then non-blocking recv/send calls
+    IoUring  // Completion ring: multishot accept/recv, one syscall per loop iteration
+};
+
+// Parses "epoll" or "uring"; throws InvalidInputException for anything else
+IoBackendKind parseIoBackendKind(const std::string& name);
+std::string ioBackendName(IoBackendKind kind);
+
+// Receives what the backend sees. The event loop implements it; every call is
+// made on the loop's own thread, from inside IoBackend::poll.
+class IoHandler {
+public:
+    virtual void onAccept(int fd) = 0;                   // New socket from the listener
+    virtual void onInput(Connection* connection) = 0;    // Bytes were appended to connection->input
+    virtual void onHangup(Connection* connection) = 0;   // The peer closed or the socket failed
+    virtual void onWake() = 0;                           // Someone called wake()
+    virtual ~IoHandler();
+};
+
+// Socket I/O for one event loop. Connections are owned by the loop; the
+// backend only keeps them alive while the kernel may still refer to them.
+class IoBackend {
+public:
+    // Starts receiving on a connection and sends any output it already has
+    virtual void attach(Connection* connection) = 0;
+    // Sends connection->output from outputStart
+    virtual void flush(Connection* connection) = 0;
+    // Closes the socket and deletes the connection once nothing refers to it
+    virtual void release(Connection* connection) = 0;
+    // Waits up to timeoutMs (-1: as long as it takes) for the next batch of events
+    // and dispatches it; false on a fatal error
+    virtual bool poll(int timeoutMs) = 0;
+    // Makes poll() return soon (thread-safe)
+    virtual void wake() = 0;
+    // Withdraws every request the kernel holds for the loop's sockets, dispatching
+    // what already arrived, so the sockets can be handed to another process.
+    // Output stays queued in the connections. Only called while the loop is stopped.
+    virtual void quiesce() = 0;
+    // Undoes quiesce() when the handoff falls through
+    virtual void resume(const std::vector<Connection*>& connections) = 0;
+    virtual ~IoBackend();
+};
+
+// Level-triggered epoll with non-blocking sockets
+class EpollBackend : public IoBackend {
+private:
+    IoHandler& handler;
+    int listenFd;
+    int epollFd;
+    int wakeFd;                         // eventfd behind wake()
+    std::vector<Connection*> closed;    // Freed after the current batch
+
+    void acceptConnections();
+    void readFrom(Connection* connection);
+    void watch(Connection* connection, int operation);
+
+public:
+    EpollBackend(IoHandler& eventHandler, int listenSocket);
+    ~EpollBackend() override;
+
+    EpollBackend(const EpollBackend&) = delete;
+    EpollBackend& operator=(const EpollBackend&) = delete;
+
+    void attach(Connection* connection) override;
+    void flush(Connection* connection) override;
+    void release(Connection* connection) override;
+    bool poll(int timeoutMs) override;
+    void wake() override;
+    void quiesce() override;
+    void resume(const std::vector<Connection*>& connections) override;
+};
+
+// Creates the backend for one loop listening on listenSocket; the caller owns it.
+// Throws ResourceException when the kernel does not support the kind asked for.
+IoBackend* createIoBackend(IoBackendKind kind, IoHandler& handler, int listenSocket);
+
+#endif // IO_BACKEND_H
@@ -0,0 +1,84 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LoadConfig {
+    std::string host = "127.0.0.1";
+    int port = 7777;
+    int clients = 1000;
+    int threads = 0;        // Client threads; 0 means one per core
+    int seats = 2;          // Table size each client asks the matchmaker for
+    int seconds = 10;
+    int thinkMs = 0;        // Pause before each move, as a human player would take
+    std::string strategy = "random";  // "random" or "first" (always the first playable card)
+    int dropPercent = 0;    // Chance that a client drops its connection instead of moving, then resumes
+    bool compress = false;  // Ask for compression on every connection
+};
+
+// Round-trip times in microseconds, bucketed to about 3% so that millions of
+// samples take a few kilobytes and percentiles stay cheap
+class LatencyHistogram {
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maximum;
+
+    static int bucketOf(uint64_t micros);
+    static uint64_t bucketTop(int bucket);  // Largest value that falls in the bucket
+
+public:
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+    void merge(const LatencyHistogram& other);
+
+    // Smallest bucket value that at least fraction of the samples do not exceed
+    uint64_t percentile(double fraction) const;
+    uint64_t count() const;
+    uint64_t max() const;
+};
+
+// What one run measured
+struct LoadReport {
+    LatencyHistogram latency;    // From sending a move to the update or rejection that answers it
+    uint64_t movesSent = 0;
+    uint64_t movesRejected = 0;
+    uint64_t updates = 0;        // Table states and deltas received
+    uint64_t staleDeltas = 0;    // Deltas that did not follow the client's view
+    uint64_t gamesFinished = 0;
+    uint64_t serverErrors = 0;   // Error messages from the server
+    uint64_t disconnects = 0;    // Connections the server closed during the run
+    uint64_t connectFailures = 0;
+    uint64_t resumes = 0;        // Seats claimed back after a deliberate drop
+    uint64_t resumeSnapshots = 0; // Of those, followed by a full view rather than deltas (periodic ones included)
+    uint64_t bytesSent = 0;      // On the wire, packed when compressing
+    uint64_t bytesReceived = 0;
+    uint64_t searchesRefused = 0; // Turned away with Busy by an overloaded server, and tried again later
+    double seconds = 0;
+
+    void merge(const LoadReport& other);
+};
+
+// Plays many simulated clients against a running server: each connects, asks
+// the matchmaker for a table and plays game after game with its strategy,
+// working only from the views the server sends. The clients are spread over
+// a few threads, each running its share from one epoll loop, so thousands fit
+// on one machine next to the server they measure.
+class LoadGenerator {
+private:
+    LoadConfig config;
+
+    void runThread(int thread, int firstClient, int clientCount, LoadReport& report);
+
+public:
+    explicit LoadGenerator(const LoadConfig& loadConfig);
+
+    // Runs for config.seconds and returns the merged results; throws
+    // InvalidInputException for a bad configuration
+    LoadReport run();
+};
+
+#endif // LOAD_GENERATOR_H
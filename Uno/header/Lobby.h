@@ -0,0 +1,98 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Matchmaker.h"
+#include "MpscQueue.h"
+#include "Protocol.h"
+
+const int LOBBY_PAGE_SIZE = 32;  // Tables per TableList page
+const int LOBBY_BUCKETS = MAX_RATING / RATING_BUCKET + 1;
+
+// The tables players can still join, server-wide, as clients browse them with
+// ListTables. The lobby is a view the shards keep current: each reports the
+// changes to its waiting tables as they happen (created, a seat taken or
+// freed, started, closed or moved out). A request never looks at the live
+// tables.
+//
+// Tables are listed by seat count (and once more under "any size") and rating
+// bucket, like the matchmaker groups its players, oldest first. The lobby has
+// a thread of its own, like the matchmaker: loops post their changes to a
+// lock-free queue, and the thread applies them a batch at a time. Each listing
+// is a vector sorted by id, so a page starts at a known index. After a batch
+// the thread writes the TableList frames of every listing it changed, from
+// the first page a change fell on, and publishes the listing's pages with an
+// atomic shared_ptr swap. A request loads that pointer and hands out the
+// page's shared buffer, which a connection queues without copying, so no
+// loop ever waits for another to browse or report.
+//
+// list(), unlist() and page() may be called from any thread.
+class Lobby {
+private:
+    typedef std::shared_ptr<const std::vector<uint8_t>> Page;
+    typedef std::shared_ptr<const std::vector<Page>> Pages;
+
+    static const size_t UNCHANGED = SIZE_MAX;
+
+    struct Change {
+        bool unlist = false;
+        LobbyTable table;            // Only the id for unlist
+    };
+    struct Listing {
+        std::vector<LobbyTable> tables; // By id, which is also by age on each shard
+        size_t changedFrom = UNCHANGED; // First position changed since the pages were written
+        Pages pages;                 // Swapped whole with std::atomic_store; page() loads it
+    };
+
+    std::thread thread;
+    std::atomic<bool> stopping;
+    int wakeFd;
+    MpscQueue<Change> inbox;
+    std::atomic<bool> wakePending;
+    std::atomic<size_t> listed;
+
+    // Owned by the lobby thread, except that page() reads each listing's pages
+    std::unordered_map<uint64_t, LobbyTable> tables;
+    Listing listings[MAX_SEATS + 1][LOBBY_BUCKETS];  // [0]: any size
+
+    static int bucketOf(int rating);
+    static Page writePage(int seats, int bucket, uint64_t page, uint64_t pageCount,
+                          const LobbyTable* rows, size_t count);
+    void post(const Change& change);
+    void wake();
+    void run();
+    void drain();
+    void add(const LobbyTable& table);
+    void remove(const LobbyTable& table);
+    void publish(int seats, int bucket, Listing& listing);
+
+public:
+    Lobby();
+    ~Lobby();
+
+    Lobby(const Lobby&) = delete;
+    Lobby& operator=(const Lobby&) = delete;
+
+    void start();
+    void stop();
+
+    // Lists the table, or updates it if it is listed already
+    void list(const LobbyTable& table);
+    // Takes the table off the list; nothing happens if it is not on it
+    void unlist(uint64_t tableId);
+
+    // The TableList frame for a page of the tables with that seat count (0 for
+    // any) and a rating in the same bucket as rating. Pages past the last one
+    // come back empty. Changes show once the lobby thread has caught up with them.
+    Page page(int seats, int rating, uint64_t page) const;
+
+    size_t size() const;
+};
+
+#endif // LOBBY_H
@@ -0,0 +1,28 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of a whole file, memory-mapped where the platform allows it
+// so large inputs can be parsed in place without copying
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+    std::vector<char> fallback; // Used instead of a mapping on platforms without mmap
+
+public:
+    explicit MappedFile(const std::string& filePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view text() const { return std::string_view(data, length); }
+    size_t size() const { return length; }
+};
+
+#endif // MAPPED_FILE_H
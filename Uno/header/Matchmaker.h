@@ -0,0 +1,100 @@
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MpscQueue.h"
+#include "Simulator.h"
+
+class Server;
+
+const int RATING_BUCKET = 100;    // Players whose ratings share a bucket match straight away
+const int MAX_RATING = 4000;
+const int WIDEN_AFTER_MS = 2000;  // Each time a player waits this long, one more bucket either side will do
+
+// A player waiting for a table
+struct MatchTicket {
+    uint64_t ticket = 0;     // Unique per request, so a late match can be told from a newer search
+    uint64_t sessionId = 0;
+    int loop = -1;           // Loop the session lives on
+    std::string name;
+    int seats = 2;           // 2, 3 or 4, as offered by PLAYER_SETUP
+    int rating = 0;
+    std::chrono::steady_clock::time_point since;
+};
+
+// Server-side matchmaking on its own thread. Loops hand it tickets through a
+// lock-free queue; it groups tickets wanting the same table size by rating
+// bucket, widening the accepted range the longer the oldest player waits.
+// Each formed table is handed to a shard owner, which seats the players and
+// starts the game. Tickets are kept in two ordered sets per table size (by
+// rating and by age), so inserting, cancelling and matching are O(log n).
+class Matchmaker {
+private:
+    struct ByRating {
+        bool operator()(const MatchTicket* a, const MatchTicket* b) const {
+            return a->rating != b->rating ? a->rating < b->rating : a->ticket < b->ticket;
+        }
+    };
+    struct ByAge {
+        bool operator()(const MatchTicket* a, const MatchTicket* b) const {
+            return a->since != b->since ? a->since < b->since : a->ticket < b->ticket;
+        }
+    };
+    struct Queue {
+        std::set<MatchTicket*, ByRating> byRating;
+        std::set<MatchTicket*, ByAge> byAge;
+    };
+    struct Request {
+        bool cancel = false;     // Cancels ticket.sessionId's search
+        MatchTicket ticket;
+    };
+
+    Server& server;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    int wakeFd;
+    MpscQueue<Request> inbox;
+    std::atomic<bool> wakePending;
+    std::atomic<uint64_t> nextTicket;
+    std::atomic<uint64_t> matchesFormed;
+
+    // Owned by the matchmaker thread
+    Queue queues[MAX_SEATS + 1];                          // By table size
+    std::unordered_map<uint64_t, MatchTicket*> bySession;
+    int nextLoop;
+
+    void run();
+    void drain();
+    void add(MatchTicket* ticket);
+    void remove(MatchTicket* ticket);
+    bool tryMatch(MatchTicket* anchor, int buckets);
+    void widen();
+    void formTable(std::vector<MatchTicket*>& players);
+    void wake();
+
+public:
+    explicit Matchmaker(Server& owner);
+    ~Matchmaker();
+
+    Matchmaker(const Matchmaker&) = delete;
+    Matchmaker& operator=(const Matchmaker&) = delete;
+
+    void start();
+    void stop();
+
+    // Queues a search (thread-safe) and returns its ticket number. A session has at most one search.
+    uint64_t enqueue(uint64_t sessionId, int loop, const std::string& name, int seats, int rating);
+    // Drops the session's search if it is still waiting (thread-safe)
+    void cancel(uint64_t sessionId);
+
+    uint64_t getMatchesFormed() const;
+};
+
+#endif // MATCHMAKER_H
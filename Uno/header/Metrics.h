@@ -0,0 +1,111 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Monotonic counts; Prometheus derives rates such as moves per second from them
+enum class Counter {
+    Moves,            // Moves the engine applied
+    MovesRejected,    // Moves the server refused
+    GamesFinished,
+    Reshuffles,       // Discard piles shuffled back into the draw pile
+    Allocations,      // Calls to operator new, in programs that include AllocationCounter.h
+    MessagesPosted,   // Work queued for an event loop
+    MessagesHandled,  // Queued work an event loop ran
+    Connections,      // Connections accepted
+    Shed,             // New tables and searches refused while overloaded or full
+    DelayedUpdates,   // Spectator updates held back while overloaded
+    SocketWrites,     // Send calls made for connection output
+    JournalFailures,  // Event loops that stopped journaling their games after a write failed
+    COUNT
+};
+
+// Levels a thread reports for its own share; the scrape adds the shares up
+enum class Gauge {
+    ActiveTables,
+    OpenConnections,
+    MatchmakingWaiting,
+    OverloadedLoops,  // 1 for each event loop shedding load
+    TableMemory,      // Bytes of table slots held, in use or free (see TableSlab.h)
+    COUNT
+};
+
+const int COUNTER_COUNT = static_cast<int>(Counter::COUNT);
+const int GAUGE_COUNT = static_cast<int>(Gauge::COUNT);
+const int LATENCY_BUCKETS = 14; // Upper bounds in LATENCY_BOUNDS_US, plus one for the rest
+
+// One thread's metrics, alone on its cache lines. Only the owning thread
+// writes it, with plain loads and stores rather than read-modify-write, so
+// recording costs about as much as bumping a local variable; the atomics only
+// keep a concurrent scrape well defined.
+struct alignas(64) MetricSlot {
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<int64_t> gauges[GAUGE_COUNT];
+    std::atomic<uint64_t> latencyBuckets[LATENCY_BUCKETS + 1];
+    std::atomic<uint64_t> latencySumUs;
+
+    MetricSlot();
+};
+
+// The calling thread's slot, nullptr until it calls Metrics::attachThread.
+// Threads without one record nothing.
+extern thread_local MetricSlot* threadMetrics;
+
+// Process-wide metrics registry. Slots are never freed, so counts from
+// threads that have finished still show up.
+class Metrics {
+public:
+    // Gives the calling thread a slot of its own (once; later calls keep it)
+    static void attachThread();
+
+    static void count(Counter counter, uint64_t amount = 1) {
+        MetricSlot* slot = threadMetrics;
+        if (!slot) return;
+        std::atomic<uint64_t>& value = slot->counters[static_cast<int>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void setGauge(Gauge gauge, int64_t value) {
+        MetricSlot* slot = threadMetrics;
+        if (slot) slot->gauges[static_cast<int>(gauge)].store(value, std::memory_order_relaxed);
+    }
+
+    // Called once by AllocationCounter.h; without it Counter::Allocations is left out of render()
+    static void countAllocations();
+
+    // Records one move's latency in microseconds
+    static void observeMoveLatency(uint64_t micros);
+
+    // Sums every slot into the Prometheus text exposition format
+    static std::string render();
+};
+
+// Serves Metrics::render() over HTTP on its own thread, so scrapes never run on
+// an event loop. Listens on "HOST:PORT", or on a Unix socket given as "unix:PATH".
+// POSIX only, like the server.
+class MetricsEndpoint {
+private:
+    std::string address;
+    int listenFd;
+    int wakeFd;               // eventfd that ends the thread's poll
+    std::thread thread;
+
+    void run();
+    void serve(int client);
+
+public:
+    // Binds the socket; throws ResourceException if it cannot
+    explicit MetricsEndpoint(const std::string& listenAddress);
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    void start();
+    void stop();
+};
+
+#endif // METRICS_H
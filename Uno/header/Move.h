@@ -0,0 +1,53 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include "CardColour.h"
+
+class ByteWriter;
+class ByteReader;
+
+// Kinds of action a player can take during their turn
+enum class MoveType {
+    Play,    // Play the card at handIndex onto the discard pile
+    Draw,    // Draw a single card from the deck
+    CallUno, // Declare UNO while holding two cards
+    EndTurn  // Finish the turn and pass play to the next player
+};
+
+// A single player action, applied to the game through UnoGame::makeMove
+struct Move {
+    MoveType type = MoveType::Draw;
+    int handIndex = -1;                // Index of the card to play (Play only)
+    CardColor color = CardColor::NONE; // Color chosen for Wild and DrawFour cards
+    int dropCount = 0;                 // Number of cards dropped by a DropTwo card
+    int dropIndices[2] = {-1, -1};     // Cards dropped by DropTwo, indexed after the played card leaves the hand
+
+    static Move play(int index, CardColor chosenColor = CardColor::NONE) {
+        Move move;
+        move.type = MoveType::Play;
+        move.handIndex = index;
+        move.color = chosenColor;
+        return move;
+    }
+
+    static Move draw() { return Move(); }
+
+    static Move callUno() {
+        Move move;
+        move.type = MoveType::CallUno;
+        return move;
+    }
+
+    static Move endTurn() {
+        Move move;
+        move.type = MoveType::EndTurn;
+        return move;
+    }
+};
+
+// Compact binary form of a move, used by the move journal and replay files.
+// readMove throws InvalidInputException on fields no move can have.
+void writeMove(ByteWriter& out, const Move& move);
+Move readMove(ByteReader& in);
+
+#endif // MOVE_H
@@ -0,0 +1,121 @@
+#ifndef MOVE_JOURNAL_H
+#define MOVE_JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Move.h"
+
+class UnoGame;
+
+// Kinds of journal record
+enum class JournalRecordType : uint8_t {
+    Snapshot = 1, // Full table state; replaces everything logged earlier for the game
+    Move = 2,     // A move accepted by UnoGame::makeMove
+    Undo = 3,
+    Redo = 4,
+    GameEnd = 5   // The game finished or was abandoned and needs no recovery
+};
+
+// One logged action replayed on top of a snapshot
+struct JournalOp {
+    JournalRecordType type;
+    Move move; // Only set for Move records
+};
+
+// What recovery found for one unfinished game
+struct RecoveredGame {
+    std::vector<uint8_t> snapshot;
+    std::vector<JournalOp> ops;
+};
+
+// Write-ahead log of committed moves, so a crashed game can be rebuilt from
+// the last snapshot plus the moves logged after it. The raylib game (main.cpp,
+// GameUI.cpp) journals its session; the server gives each event loop a journal
+// of the games its tables are running (see EventLoop.h), whose snapshots are
+// table states the loop restores itself.
+//
+// Appending only encodes the record into an in-memory buffer and returns its
+// log sequence number (LSN). A background thread writes everything appended
+// so far and syncs it with a single fdatasync (group commit), so the cost of
+// a sync is shared by every move that arrived while the previous one ran.
+// Callers that must not acknowledge a move before it is on disk call
+// waitDurable with the returned LSN; the render loop just keeps going.
+//
+// File layout: magic, then records of [u32 payload size][u32 CRC-32][payload],
+// payload = type, game id (varint), snapshot bytes or encoded move.
+// Recovery stops at the first torn or corrupt record.
+//
+// Compacting writes the new journal beside the old one and renames it over it,
+// so a crash part way through leaves one or the other whole.
+class MoveJournal {
+private:
+    std::string path;
+    int fd;
+
+    std::mutex fileMutex;             // Held while the file is written or swapped by compact
+    std::mutex mutex;                 // Guards everything below
+    std::condition_variable hasWork;
+    std::condition_variable flushed;
+    std::vector<uint8_t> pending;     // Records appended since the last flush
+    std::vector<uint8_t> writing;     // Records being written by the flusher
+    std::vector<uint8_t> nextImage;   // A compacted journal for the flusher to swap in before pending
+    uint64_t appendedLsn;
+    uint64_t durable;
+    int commitWindowMicros;
+    bool stopping;
+    std::string failure;              // Set if a write or sync failed; later calls throw it
+    std::thread flusher;
+
+    void flushLoop();
+    uint64_t append(JournalRecordType type, uint64_t gameId, const uint8_t* data, size_t size);
+    void beginRecord(JournalRecordType type, uint64_t gameId, size_t& start);
+    uint64_t endRecord(size_t start);
+    void openFile();
+    std::string replaceFile(const std::vector<uint8_t>& image); // With fileMutex held; returns the error
+
+public:
+    // Opens (or creates) the journal and drops any torn tail left by a crash.
+    // commitWindowMicros lets the flusher wait briefly to gather a larger batch.
+    explicit MoveJournal(const std::string& filePath, int commitWindowMicros = 0);
+    ~MoveJournal();
+
+    MoveJournal(const MoveJournal&) = delete;
+    MoveJournal& operator=(const MoveJournal&) = delete;
+
+    // Each returns the LSN of the appended record
+    uint64_t logSnapshot(uint64_t gameId, const UnoGame& game);
+    // A snapshot in the caller's own format; restoreGame cannot load it
+    uint64_t logSnapshot(uint64_t gameId, const std::vector<uint8_t>& state);
+    uint64_t logMove(uint64_t gameId, const Move& move);
+    uint64_t logUndo(uint64_t gameId);
+    uint64_t logRedo(uint64_t gameId);
+    uint64_t logGameEnd(uint64_t gameId);
+
+    // Blocks until every record up to lsn is synced to disk
+    void waitDurable(uint64_t lsn);
+    uint64_t durableLsn();
+
+    // Rewrites the journal as one snapshot per live game, discarding the
+    // history behind them. Call at a point where the games will not be undone
+    // past their current state (e.g. a turn boundary).
+    void compact(const std::vector<std::pair<uint64_t, const UnoGame*>>& liveGames);
+    // The same with snapshots in the caller's own format, but the flusher
+    // writes and swaps in the new journal, so the caller does not wait for
+    // the disk. The states must cover every record appended before the call.
+    // Returns an LSN that is durable once the new journal is in place.
+    uint64_t compactLater(const std::vector<std::pair<uint64_t, std::vector<uint8_t>>>& liveStates);
+
+    // Reads a journal and returns the unfinished games by id
+    static std::map<uint64_t, RecoveredGame> recover(const std::string& filePath);
+
+    // Loads the snapshot into an empty game and replays the logged ops
+    static void restoreGame(const RecoveredGame& recovered, UnoGame& game);
+};
+
+#endif // MOVE_JOURNAL_H
@@ -0,0 +1,55 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free queue with many producers and one consumer (Vyukov's
+// intrusive list). push() may be called from any thread and never waits on
+// another thread; pop() belongs to the single owning thread. Items pushed by
+// one producer come out in the order they went in.
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next;
+        T value;
+        Node() : next(nullptr) {}
+    };
+
+    std::atomic<Node*> head;  // Most recently pushed node
+    Node* tail;               // Consumed node whose successor is popped next
+
+public:
+    MpscQueue() : head(new Node()), tail(head.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Takes the oldest item. Returns false when the queue is empty, or while a
+    // producer is halfway through a push; that producer's wake-up follows.
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,99 @@
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Move.h"
+#include "Replay.h"
+#include "Simulator.h"
+
+// Plain-text game notation, small enough to paste into a bug report:
+//
+//   # comments run to the end of the line
+//   game 42 3                  seed, then number of players (starts a game)
+//   name 0 Alice               optional seat names
+//   3 / d / u 5g+4 / 2^0,4 /   moves, any number of lines
+//   result 1                   optional winning seat, or "none"
+//
+// Move tokens:
+//   7        play hand card 7
+//   7g       play a Wild or DrawFour card choosing r, b, g or y
+//   7^0,4    play a DropTwo card and drop cards 0 and 4 (counted after card 7 leaves the hand)
+//   d        draw a card
+//   u        call UNO
+//   /        end the turn
+// A play may end in +N: it dealt N penalty cards (Draw Two, Draw Four,
+// Draw Six or a missed UNO call). Replaying checks the count.
+struct NotationMove {
+    Move move;
+    int penalty = -1; // Penalty cards the move dealt, -1 if not annotated
+};
+
+struct NotationGame {
+    unsigned int seed = 0;
+    int players = 0;
+    std::string_view names[MAX_SEATS]; // Empty when the notation gives no name
+    std::vector<NotationMove> moves;
+    int winnerSeat = -2;               // -1 for "result none", -2 when no result was given
+    int line = 0;                      // Line of the game header, for error messages
+};
+
+// Streams games out of notation text without copying it: names point into
+// the text and the moves vector is reused, so the text (e.g. a MappedFile)
+// must outlive the parsed games. Throws InvalidInputException with the line number.
+class NotationParser {
+private:
+    std::string_view text;
+    size_t position;
+    int lineNumber;
+    bool pendingGame; // A "game" line was read but its game not yet returned
+
+    bool nextToken(std::string_view& token, bool& lineStart);
+    void fail(const std::string& message) const;
+    void parseMove(std::string_view token, NotationMove& out) const;
+
+public:
+    // firstLine numbers error messages when input is a slice of a larger file
+    explicit NotationParser(std::string_view input, int firstLine = 1);
+
+    // Fills game with the next game in the text; false once the text is used up
+    bool next(NotationGame& game);
+};
+
+// Parses a whole number that fills the entire view; no allocation, no locale
+bool parseInteger(std::string_view text, int& output);
+
+// Appends a game in notation form
+void formatNotation(const NotationGame& game, std::string& out);
+
+// Converts a replay to notation, playing it to fill in the penalty counts
+void replayToNotation(const Replay& replay, NotationGame& out);
+
+// Writes every simulated game to a text file in notation form, with penalty counts
+class NotationWriter : public TurnObserver {
+private:
+    std::ofstream out;
+    std::string path;
+    NotationGame game;
+    std::string text;
+    int cardsBefore;
+    uint64_t games;
+
+public:
+    explicit NotationWriter(const std::string& filePath);
+
+    void onGameStart(const UnoGame& table, unsigned int seed) override;
+    void onTurn(const TurnRecord& record) override;
+    void onMove(const UnoGame& table, const Move& move) override;
+    void onGameEnd(const GameResult& result) override;
+
+    void close();
+    uint64_t gamesWritten() const;
+};
+
+// Plays a notated game on a fresh engine, checking moves, penalties and the result
+ReplayCheck verifyNotation(const NotationGame& game);
+
+#endif // NOTATION_H
@@ -8,12 +8,17 @@
 class Card;
 class Deck;
 class UnoGame;
+struct StateDelta;
+struct DeltaOp;
+class ByteWriter;
+class ByteReader;
 
 class Player {
 private:
     std::string name;
     std::vector<Card*> hand;
     bool hasCalledUNO;
+    StateDelta* recorder; // Receives hand and UNO changes while a move is recorded
 
 public:
     // Constructor that sets the player's name
@@ -52,6 +57,21 @@ public:
     // Gets the player's name
     std::string getName() const;
     void drawHand(int startX, int startY) const;
+
+    // Sets where hand and UNO changes are recorded (nullptr stops recording)
+    void setRecorder(StateDelta* delta);
+
+    // Undoes or redoes a recorded hand or UNO change
+    void revertOp(const DeltaOp& op);
+    void replayOp(const DeltaOp& op);
+    
+    // Writes the name, UNO flag and hand; loadState builds a player from that
+    // record, taking the hand's cards from deck
+    void saveState(ByteWriter& out) const;
+    static Player* loadState(ByteReader& in, Deck& deck);
+
+    // Gives every card in hand back to the deck for reuse, leaving the hand empty
+    void returnHand(Deck& deck);
     
     // Destructor to clean up cards in hand
     ~Player();
@@ -0,0 +1,173 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CardCode.h"
+#include "Simulator.h"
+
+class ByteWriter;
+class ByteReader;
+
+// Binary protocol spoken between the game server and its clients over TCP.
+// Every message is a frame: [u32 body size][u8 message type][payload],
+// little-endian, with payload fields encoded by ByteWriter.
+
+const uint32_t MAX_FRAME_SIZE = 64 * 1024; // Larger frames close the connection
+const int NO_SEAT = 0xFF;                   // Seat number meaning "not seated"
+
+// Messages sent by clients
+enum class ClientMessage : uint8_t {
+    Hello = 1,       // name (string)
+    CreateTable = 2, // seats (u8, 2-4), then optionally the creator's rating (varint) for the lobby;
+                     // the creator takes seat 0
+    JoinTable = 3,   // table id (varint)
+    PlayMove = 4,    // move (writeMove)
+    LeaveTable = 5,  // no payload
+    Ping = 6,        // token (u64), echoed back in Pong
+    Spectate = 7,    // table id (varint); answered with TableJoined at NO_SEAT, then onlooker views
+    FindMatch = 8,   // seats (u8, 2-4), rating (varint); answered with TableJoined once a table forms
+    CancelMatch = 9, // no payload
+    ClaimSeat = 10,  // table id (varint), seat (u8), token (u64) from Resumable or TableMoved, last version
+                     // applied (varint, 0 for none): takes the seat back, on a new connection after a drop.
+                     // Answered with a fresh Resumable, then the TableDeltas missed since that version,
+                     // or a TableState when the table no longer has them all
+
+    // Sent by a cluster's router on its control link to each node (see Router.h)
+    PeerHello = 11,  // cluster key (string); the connection becomes a control link
+    SetRing = 12,    // this node's name (string), node count (varint), names (string each);
+                     // the node moves out the tables it no longer owns
+    AdoptTable = 13, // table state (varint size, then ServerTable::saveState and a u64 seat token per seat),
+                     // hop (varint): how many times the table has changed nodes, this move included
+
+    UseCompression = 14, // dictionary version (u8, COMPRESSION_DICTIONARY): every later frame from the client
+                         // is packed by a FramePacker (see Compression.h). Answered with CompressionOn, after
+                         // which the server packs its frames too; an unknown version closes the connection
+    ListTables = 15   // seats (u8, 0 for any size), rating (varint), page (varint): answered with a TableList
+                      // of the tables still filling up whose rating is in the same RATING_BUCKET
+};
+
+// Messages sent by the server
+enum class ServerMessage : uint8_t {
+    Welcome = 1,      // session id (varint)
+    TableJoined = 2,  // table id (varint), seat (u8, NO_SEAT for a spectator)
+    TableState = 3,   // TableView as seen from the receiving seat: public part, then private part
+    MoveRejected = 4, // reason (string)
+    GameOver = 5,     // table id (varint), winning seat (signed varint, -1 if abandoned)
+    Pong = 6,         // token (u64)
+    Error = 7,        // reason (string)
+    TableDelta = 8,   // table id (varint), version (varint), cards the receiving seat drew
+                      // (varint count, u16 each), then the public changes (varint count, ViewChange each)
+    TableMoved = 9,   // table id (varint), seat (u8, NO_SEAT for a spectator), token (u64), hop (varint, as in
+                      // AdoptTable): the table went to another node, where the seat is kept for a ClaimSeat
+                      // with the token. A seat's notice follows the answers to every move sent before it
+
+    // Sent by a node on its control link
+    TableExport = 10, // table state, as in AdoptTable, for the router to hand to the table's new owner
+    TableAdopted = 11, // table id (varint), adopted (u8), hop (varint): the table is up on this node and its
+                       // seats can be claimed, or (0) it could not be taken and an Error says why
+
+    Resumable = 12,   // table id (varint), seat (u8), token (u64): sent whenever a player takes a seat. If the
+                      // connection drops mid-game the seat is held for a while for a ClaimSeat with the token
+    CompressionOn = 13, // no payload; the last frame the server sends unpacked
+    Busy = 14,        // reason (string): a new table or search was refused because the server is
+                      // overloaded; try again in a while. Games already running are not affected
+    TableList = 15,   // seats (u8), rating (varint, the bucket's lowest), page (varint), page count (varint),
+                      // table count (varint), then per table: id (varint), seats (u8), seats taken (u8), rating
+                      // (varint). Pages hold up to LOBBY_PAGE_SIZE tables, oldest first
+    MoveBounced = 16  // move (writeMove): a PlayMove for a table that has left the node. Sent in place of the
+                      // MoveRejected until the player starts on another table, so the router can play the move
+                      // where the table went; a Ping answered after the TableMoved follows the last of them
+};
+
+// Changes listed in a TableDelta, each a u8 kind followed by its fields
+enum class ViewChange : uint8_t {
+    Drew = 1,       // seat (u8), count (varint); the receiving seat's cards come from the drawn list
+    Removed = 2,    // seat (u8), hand index (varint): played or dropped
+    Uno = 3,        // seat (u8), called (u8)
+    Eliminated = 4, // seat (u8)
+    Turn = 5,       // current seat (u8)
+    Flags = 6,      // TableViewFlag bits (u8): direction, turn action, finished
+    TopCard = 7     // card (u16), including a chosen wild color
+};
+
+// Bits of TableView::flags
+enum TableViewFlag : uint8_t {
+    VIEW_STARTED = 1,
+    VIEW_REVERSED = 2,
+    VIEW_TURN_ACTION = 4,  // The player to move has already played or drawn
+    VIEW_FINISHED = 8
+};
+
+// What one seat may see of a table: everything public plus its own hand
+struct TableView {
+    uint64_t tableId = 0;
+    uint64_t version = 0;             // Table version shown; each move adds one
+    int seat = NO_SEAT;               // Receiving seat, NO_SEAT for an onlooker
+    int seats = 0;
+    int currentSeat = NO_SEAT;
+    uint8_t flags = 0;
+    CardCode topCard = NO_CARD;
+    std::string names[MAX_SEATS];
+    int handSizes[MAX_SEATS];         // -1 for empty or eliminated seats
+    bool calledUno[MAX_SEATS];
+    std::vector<CardCode> hand;       // The receiving seat's cards
+
+    TableView();
+};
+
+// One table listed in a TableList
+struct LobbyTable {
+    uint64_t tableId = 0;
+    int seats = 0;
+    int taken = 0;
+    int rating = 0;
+};
+
+// A TableList as a client reads it
+struct TableListPage {
+    int seats = 0;
+    int rating = 0;
+    uint64_t page = 0;
+    uint64_t pageCount = 0;
+    std::vector<LobbyTable> tables;
+};
+
+// Starts a frame in out and returns where it begins; finishFrame fills in the size
+size_t beginFrame(std::vector<uint8_t>& out, uint8_t type);
+void finishFrame(std::vector<uint8_t>& out, size_t start);
+
+// Checks whether data starts with a complete frame and sets its total size.
+// Throws InvalidInputException for frames over MAX_FRAME_SIZE.
+bool completeFrame(const uint8_t* data, size_t size, size_t& frameSize);
+
+// A view is written as the part every seat sees alike (ids, turn, flags, top card,
+// names and counts) followed by the receiving seat and its hand, so servers can
+// serialize the public part once per change and reuse it for every seat.
+void writePublicView(ByteWriter& out, const TableView& view);
+void writePrivateView(ByteWriter& out, int seat, const std::vector<CardCode>& hand);
+void writeTableView(ByteWriter& out, const TableView& view);
+void readTableView(ByteReader& in, TableView& view);
+
+// Reads a TableList body; throws InvalidInputException if it is malformed
+void readTableList(ByteReader& in, TableListPage& list);
+
+// Applies a TableDelta body to view. Returns false, leaving view alone, if the
+// delta is for another table or does not follow view.version; the client then
+// waits for the next full TableState. Throws InvalidInputException for deltas
+// that do not fit the view.
+bool applyTableDelta(ByteReader& in, TableView& view);
+
+// Applies to view what the player at view.seat can foresee of its own move,
+// by the rules UnoGame::makeMove enforces: the card leaves the hand and becomes
+// the top card, draw cards add to the next seat's count, and EndTurn passes the
+// turn with Skip and Reverse taken into account. Cards the server deals (a
+// draw, the UNO penalty) and the view version are left to its answer.
+// playedThisTurn says whether the seat has played a card this turn, so that the
+// top card's effect applies on EndTurn; it is updated with view. Throws the
+// engine's exception, leaving both alone, for a move the server would refuse.
+void predictMove(TableView& view, const Move& move, bool& playedThisTurn);
+
+#endif // PROTOCOL_H
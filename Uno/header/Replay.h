@@ -0,0 +1,85 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Move.h"
+#include "Simulator.h"
+
+class UnoGame;
+
+// Everything needed to re-play a recorded game and check it still ends the same way
+struct Replay {
+    unsigned int seed = 0;
+    int players = 0;
+    int turns = 0;
+    int winnerSeat = -1;
+    uint32_t finalCheck = 0;          // stateCheck after the last move
+    std::vector<Move> moves;
+    std::vector<uint16_t> turnChecks; // Low 16 bits of stateCheck after each completed turn
+};
+
+// Digest of the table (seat to move, direction, pending effects, top card,
+// every hand) used to spot the first turn where a re-play drifts
+uint32_t stateCheck(const UnoGame& game);
+
+// Encodes a replay as one archive record payload; decodeReplay reuses out's buffers
+void encodeReplay(const Replay& replay, std::vector<uint8_t>& out);
+void decodeReplay(const uint8_t* data, size_t size, Replay& out);
+
+// Appends simulated games to a replay archive.
+// File layout: magic, then records of [u32 payload size][u32 CRC-32][payload].
+class ReplayWriter : public TurnObserver {
+private:
+    std::ofstream out;
+    std::string path;
+    Replay current;
+    std::vector<uint8_t> buffer;
+    uint64_t games;
+    uint32_t lastCheck;
+
+public:
+    explicit ReplayWriter(const std::string& filePath);
+
+    void onGameStart(const UnoGame& game, unsigned int seed) override;
+    void onTurn(const TurnRecord& record) override;
+    void onMove(const UnoGame& game, const Move& move) override;
+    void onGameEnd(const GameResult& result) override;
+
+    void write(const Replay& replay);
+    void close();
+    uint64_t gamesWritten() const;
+};
+
+// Reads archive records one at a time. next() hands back the raw payload so
+// callers can decode it on another thread.
+class ReplayReader {
+private:
+    std::ifstream in;
+    std::string path;
+
+public:
+    explicit ReplayReader(const std::string& filePath);
+
+    // Fills payload with the next record; false at the end of the archive
+    bool next(std::vector<uint8_t>& payload);
+
+    // Whether the file starts with the archive magic, which text notation never does
+    static bool isArchive(const std::string& filePath);
+};
+
+// Result of re-playing one game
+struct ReplayCheck {
+    bool matched = true;
+    int turn = -1;       // First diverging turn
+    int move = -1;       // Index into Replay::moves, -1 when the difference is in the final result
+    std::string reason;
+};
+
+// Re-plays a game from its seed and moves on a fresh engine, checking that every
+// move is still legal, the per-turn checks agree and the final result is the same
+ReplayCheck verifyReplay(const Replay& replay);
+
+#endif // REPLAY_H
@@ -0,0 +1,179 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "HashRing.h"
+#include "IoBackend.h"
+#include "Protocol.h"
+
+struct Connection;
+class ByteReader;
+
+struct RouterConfig {
+    std::string address = "127.0.0.1";
+    int port = 7700;
+    std::string nodesFile;   // One node per line, "NAME HOST:PORT"; read again by reload()
+    std::string clusterKey;  // The key the nodes were started with
+    IoBackendKind backend = IoBackendKind::Epoll;  // io_uring falls back to epoll where unavailable
+    std::function<void(const std::string&)> log;   // Problems with the nodes, reported on the router's thread
+};
+
+// Front door of a cluster of game servers ("nodes", each a Server started with
+// --cluster-key). Clients connect to the router as they would to one server;
+// it reads their frames and forwards each to the node that should have it, by
+// consistent hashing (HashRing):
+//
+//   - commands for a table go to the owner of its id; nodes only create tables they own
+//   - searches for each table size go to one node, so everyone looking meets there
+//   - new tables go to the owner of a fresh key, which spreads them evenly
+//
+// A client gets an upstream connection to each node it uses, opened on demand,
+// and sees the nodes' frames as if one server sent them. The router also answers
+// UseCompression itself, so the links to the nodes carry plain frames.
+//
+// The router keeps a control link to every node. reload() reads the node list
+// again and sends every node the new ring; each node exports the tables it no
+// longer owns in the game snapshot format (ServerTable::saveState) on its
+// control link, and tells their players. The router hands each table to its new
+// owner and, once that node has adopted it, claims the seats back for the
+// players; what they send meanwhile is held and goes out after the claim.
+// Every move of a table is numbered (its hop), so a notice that trails a later
+// move still claims where the table is now, and a claim the table moved away
+// from is tried again on its next node. The moves the old node could no longer
+// play come back to the router (MoveBounced) and go ahead of the held frames.
+//
+// One thread and one IoBackend. The router only reads frame headers and a few
+// routing fields, so the nodes do the game work. It never waits on a node:
+// links to the nodes connect in the background, frames queue in them until
+// they are up, and a node that does not answer within a couple of seconds
+// counts as unreachable. A reloaded node list takes effect once every new
+// control link it needs is up.
+class Router : private IoHandler {
+private:
+    struct Claim {
+        uint64_t sessionId = 0;
+        int seat = 0;            // NO_SEAT: a spectator, who watches again instead
+        uint64_t token = 0;
+        uint64_t hop = 0;        // The move that must be over first; once sent, the one that took the table there
+        std::chrono::steady_clock::time_point giveUpAt;
+    };
+    struct Session {
+        Connection* client = nullptr;
+        std::string name;                                        // From Hello, repeated to every node
+        std::unordered_map<std::string, Connection*> upstreams;  // By node name
+        std::string tableNode;   // Node of the session's table or search
+        std::string matchNode;   // Node of the session's search
+        bool moving = false;     // Its table moved; frames are held until the move is over
+        bool claimOpen = false;  // The seat is not back yet: the claim waits in claims or is out
+        bool claimSent = false;  // The claim is out on tableNode
+        uint64_t claimTable = 0; // What it claims, to try again if the table moves on first
+        Claim claim;
+        int pings = 0;           // Sent to the nodes the table left, which bounce no move after the Pong
+        std::vector<uint8_t> bounced; // The moves they bounced, as PlayMove frames, sent before held
+        std::vector<uint8_t> held; // Frames sent meanwhile
+    };
+    struct Upstream {
+        uint64_t sessionId = 0;  // 0 for a control link
+        std::string node;
+        bool welcomed = false;   // The node's Welcome was swallowed
+    };
+    struct Node {
+        std::string endpoint;    // "HOST:PORT" as listed
+        sockaddr_storage address;
+        socklen_t addressLength = 0;
+        Connection* control = nullptr;
+    };
+    struct Whereabouts {
+        std::string node;        // The node that adopted it last; empty once it was lost
+        uint64_t adopted = 0;    // The hop that took it there
+        uint64_t exported = 0;   // The last hop seen starting; past adopted while the table is on its way
+        std::chrono::steady_clock::time_point at; // Last heard of
+    };
+
+    RouterConfig config;
+    int listenFd;
+    int boundPort;
+    std::unique_ptr<IoBackend> io;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<bool> reloadRequested;
+
+    std::unordered_map<std::string, Node> nodes;      // Every node listed so far, in the ring or not
+    HashRing ring;
+    std::unordered_map<uint64_t, Session> sessions;   // By the router's session id
+    std::unordered_map<Connection*, Upstream> upstreams;
+    std::unordered_map<uint64_t, std::vector<Claim>> claims;  // Waiting for their tables to arrive, by id
+    std::unordered_map<uint64_t, Whereabouts> moved;           // Tables moved lately, by id
+    std::unordered_map<Connection*, std::chrono::steady_clock::time_point> connecting; // Links not up yet, by deadline
+    std::vector<std::string> pendingRing;  // A node list waiting for its control links
+    std::string ringProblem;               // Why the last node list did not take effect
+    uint64_t nextSessionId;
+    uint64_t nextTableKey;
+    std::vector<uint8_t> unpacked;   // The client frame clientInput last unpacked
+
+    int openListener();
+    void run();
+    void loadNodes();
+    void applyRing();
+    Connection* connectTo(const std::string& node, uint64_t sessionId);
+    void checkConnects();
+    void connectFailed(Connection* connection);
+    Connection* upstreamFor(uint64_t sessionId, Session& session, const std::string& node);
+    std::string nodeFor(uint64_t key) const;
+
+    void clientInput(Connection* connection, Session& session);
+    void routeFrame(uint64_t sessionId, Session& session, const uint8_t* frame, size_t size);
+    void useCompression(Session& session, const uint8_t* frame, size_t size);
+    bool forward(uint64_t sessionId, Session& session, const std::string& node, const uint8_t* frame, size_t size);
+    void upstreamInput(Connection* connection);
+    void controlFrame(const std::string& node, ServerMessage type, ByteReader& frame);
+    void tableMoved(uint64_t sessionId, Session& session, Connection* from, ByteReader& notice);
+    void moveBounced(uint64_t sessionId, Session& session, const std::string& node, const uint8_t* move, size_t size);
+    void tableExported(uint64_t tableId, uint64_t hop);
+    void tableAdopted(const std::string& node, uint64_t tableId, bool ok, uint64_t hop);
+    void placeClaim(uint64_t tableId, const Claim& pending);
+    void claim(uint64_t tableId, const std::string& node, const Claim& pending);
+    bool retryClaim(Session& session);
+    void giveUpClaim(const Claim& pending, const std::string& reason);
+    void expireClaims();
+    void finishMove(uint64_t sessionId);
+    void releaseHeld(uint64_t sessionId);
+    void sendText(Connection* connection, ServerMessage type, const std::string& text);
+    void closeSession(uint64_t sessionId);
+    void closeUpstream(Connection* connection);
+    void closeAll();
+    void report(const std::string& problem);
+
+    void onAccept(int fd) override;
+    void onInput(Connection* connection) override;
+    void onHangup(Connection* connection) override;
+    void onWake() override;
+
+public:
+    explicit Router(const RouterConfig& routerConfig);
+    ~Router() override;
+
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+    // Binds, reads the node list, opens the control links and starts the thread;
+    // throws ResourceException or InvalidInputException on failure
+    void start();
+    void stop();
+    // Reads the node list again and rebalances (thread-safe)
+    void reload();
+
+    int getPort() const;
+    IoBackendKind getBackend() const;
+};
+
+#endif // ROUTER_H
@@ -0,0 +1,112 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "HashRing.h"
+#include "IoBackend.h"
+#include "Lobby.h"
+
+class EventLoop;
+class Matchmaker;
+class MetricsEndpoint;
+class HandoffListener;
+
+struct ServerConfig {
+    std::string address = "127.0.0.1";
+    int port = 7777;   // 0 picks a free port (see Server::getPort)
+    int threads = 0;   // Event loops to run; 0 means one per core
+    int backlog = 1024;
+    IoBackendKind backend = IoBackendKind::Epoll;  // io_uring falls back to epoll where unavailable
+    int turnTimeoutMs = 30000;  // A player who lets it pass draws and passes automatically; 0 turns it off
+    int resumeGraceMs = 60000;  // How long a dropped player's seat waits for a ClaimSeat; 0 frees it at once
+    std::string metricsAddress; // "HOST:PORT" or "unix:PATH" serving Prometheus metrics; empty for none
+    std::string handoffPath;    // Unix socket a successor takes the running server over through; empty for none
+    std::string takeoverPath;   // Take over from the server listening for successors here instead of binding
+    std::string clusterKey;     // Lets a router holding the same key run this server as a cluster node
+    int overloadLagMs = 50;     // A loop that has not caught up for this long sheds load; 0 never sheds
+    int overloadQueueDepth = 10000; // So does one that finds this many messages queued at once
+    int maxTablesPerLoop = 20000; // Tables each loop may host before it refuses new ones; 0 for no limit
+    std::string journalDir;     // Where each loop journals its running games, to recover them after a crash; empty for none
+};
+
+// Headless multi-table game server: one event loop per core, each
+// accepting its share of connections and hosting its share of tables.
+// Speaks the binary protocol in Protocol.h.
+// Tables still filling up are listed in the lobby (see Lobby.h), which
+// clients browse with ListTables.
+//
+// With a handoff path the server can be restarted without dropping anyone: a
+// new process started with the same path as its takeoverPath receives the
+// tables, sessions and sockets (see Handoff.h), and this one stops serving.
+// The successor keeps the loop count of the server it took over from.
+//
+// As a node of a cluster (see Router.h) the server is told the cluster's hash
+// ring, only creates tables whose ids it owns and moves out the others.
+//
+// An overloaded loop sheds load rather than slow down every game it hosts
+// (see EventLoop::isOverloaded): it refuses new tables and searches with Busy,
+// the matchmaker seats new matches elsewhere, and spectators get their
+// updates in batches.
+//
+// Each loop hosts at most maxTablesPerLoop tables, in fixed-size slots (see
+// TableSlab.h); a full loop turns new tables away with Busy as well.
+//
+// With a journal directory, each loop logs its running games there (see
+// MoveJournal.h), and a server started on the same directory after a crash
+// loads them back before it serves. Their players get their seats back with
+// ClaimSeat and the tokens they were given, as after a dropped connection.
+class Server {
+private:
+    ServerConfig config;
+    int boundPort;
+    Lobby lobby;                      // Outlives the loops, which report to it; its thread runs while they do
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::unique_ptr<Matchmaker> matchmaker;
+    std::unique_ptr<MetricsEndpoint> metrics;
+    std::unique_ptr<HandoffListener> handoff;
+    std::atomic<uint64_t> nextSessionId;
+    std::atomic<bool> handedOff;
+
+    mutable std::mutex ringMutex;     // Guards ring and nodeName; loops read them as they create tables
+    HashRing ring;                    // Empty when not part of a cluster
+    std::string nodeName;
+
+    int openListener();
+    void addLoop(int listenFd);
+    void takeOver();
+    void openJournals(bool recover);
+    bool handOff(int channel);  // On the handoff listener's thread
+    void startServing();
+
+public:
+    explicit Server(const ServerConfig& serverConfig);
+    ~Server();
+
+    // Binds the listeners and starts the loops; throws ResourceException on failure
+    void start();
+    // Stops every loop and closes all connections
+    void stop();
+    // True once a successor has taken over; the process should then exit
+    bool isHandedOff() const;
+
+    int getPort() const;
+    int loopCount() const;
+    IoBackendKind getBackend() const;  // The backend actually in use after start()
+    const ServerConfig& getConfig() const;
+    EventLoop& getLoop(int index);
+    EventLoop& loopForTable(uint64_t tableId);  // The shard owning a table
+    Matchmaker& getMatchmaker();
+    Lobby& getLobby();
+    uint64_t newSessionId();
+
+    // Cluster membership, as the router last set it
+    void setRing(const std::string& name, const std::vector<std::string>& nodes);
+    bool ownsTable(uint64_t tableId) const;  // Always true outside a cluster
+};
+
+#endif // SERVER_H
@@ -0,0 +1,128 @@
+#ifndef SERVER_TABLE_H
+#define SERVER_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Move.h"
+#include "Protocol.h"
+#include "Simulator.h"
+
+const int SNAPSHOT_INTERVAL = 16; // Moves sent as deltas between full views
+const int DELTA_HISTORY = 64;     // Recent moves kept as deltas for players resuming after a drop
+
+class UnoGame;
+class Player;
+class ByteWriter;
+class ByteReader;
+
+enum class TableStatus {
+    Waiting,  // Seats are still being filled
+    Playing,
+    Finished  // Someone won, or a player left mid-game
+};
+
+// One hosted game: the seats, who sits in them and the engine running the rules.
+// Knows nothing about sockets; the event loop that owns it does the messaging.
+class ServerTable {
+private:
+    uint64_t id;
+    int seatCount;
+    TableStatus status;
+    UnoGame* game;                   // The engine while a game is on, nullptr before one starts
+    // Made for the first game and kept for every later one in this object (and
+    // so in its table slot): UnoGame::reset clears it and keeps its deck's cards
+    std::unique_ptr<UnoGame> engine;
+    Player* seatPlayers[MAX_SEATS];  // Engine players by seat (the engine renumbers after eliminations)
+    std::string names[MAX_SEATS];
+    bool occupied[MAX_SEATS];
+    int winnerSeat;
+
+    // Serialized views, rebuilt lazily after each change. The public part is written
+    // once per change and copied into every seat's frame; slot MAX_SEATS is the onlooker's.
+    uint64_t version;                           // Bumped by every change a view can show
+    uint64_t publicVersion;
+    std::vector<uint8_t> publicView;
+    uint64_t frameVersions[MAX_SEATS + 1];
+    std::vector<uint8_t> viewFrames[MAX_SEATS + 1];
+
+    // Each of the last DELTA_HISTORY moves as a TableDelta: public changes shared by
+    // every seat, plus the cards each seat drew. The record for version v sits at
+    // v % DELTA_HISTORY; versions that were not moves have none.
+    struct DeltaRecord {
+        uint64_t version = 0;
+        std::vector<uint8_t> changes;
+        std::vector<CardCode> drawn[MAX_SEATS];
+    };
+    DeltaRecord history[DELTA_HISTORY];
+    uint64_t deltaVersion;        // The latest move, unless it goes out as full views
+    int movesSinceSnapshot;
+    uint64_t deltaFrameVersions[MAX_SEATS + 1];
+    std::vector<uint8_t> deltaFrames[MAX_SEATS + 1];
+
+    int seatOf(const Player* player) const;
+    void seatHand(int seat, std::vector<CardCode>& hand) const;
+    uint8_t viewFlags() const;
+    void recordDelta(int previousSeat, uint8_t previousFlags, CardCode previousTop);
+    void writeDeltaFrame(std::vector<uint8_t>& out, int slot, const DeltaRecord& record) const;
+
+public:
+    ServerTable();  // No table yet; reset() or loadState() makes it one
+    ServerTable(uint64_t tableId, int seats);
+    ~ServerTable();
+
+    ServerTable(const ServerTable&) = delete;
+    ServerTable& operator=(const ServerTable&) = delete;
+
+    // Starts over as a new empty table, ending any game. The frame buffers keep
+    // their capacity, so a table reusing the object allocates next to nothing
+    void reset(uint64_t tableId, int seats);
+    // Ends any game and forgets the table, down to no seats, keeping the buffers
+    void clear();
+
+    // Takes the first free seat and returns it, or -1 if the table is full or running
+    int join(const std::string& name);
+    // Frees a seat; leaving a running game abandons it
+    void leave(int seat);
+
+    // Deals the cards once every seat is taken
+    void start(unsigned int seed);
+
+    // Applies a move for seat, throwing the engine's exceptions if it is not legal
+    // or not that seat's turn. Finishes the table when the game ends.
+    void applyMove(int seat, const Move& move);
+
+    // Fills view with what seat may see (NO_SEAT for an onlooker)
+    void buildView(int seat, TableView& view) const;
+    // The TableState frame for seat (NO_SEAT for an onlooker), built at most once per change
+    const std::vector<uint8_t>& viewFrame(int seat);
+    // The TableDelta frame taking seat from the previous version to this one, or nullptr
+    // when a full view must be sent: the last change was not a move, or SNAPSHOT_INTERVAL
+    // moves went by since the last full view, so clients that fell out of step recover.
+    const std::vector<uint8_t>* deltaFrame(int seat);
+    // Appends the TableDelta frames taking seat from version since to this one, for a
+    // player resuming after a drop. Returns false, appending nothing, when the history
+    // no longer holds all of them or a change in between was not a move.
+    bool replayDeltas(int seat, uint64_t since, std::vector<uint8_t>& out) const;
+
+    // Writes seats, names, status and the game's snapshot, everything loadState needs to
+    // carry the table on in another process. Cached frames are left out and rebuilt.
+    void saveState(ByteWriter& writer) const;
+    // Replaces this table with one written by saveState; throws InvalidInputException
+    // if it is malformed, leaving a table only fit for reset()
+    void loadState(ByteReader& reader);
+
+    uint64_t getId() const;
+    uint64_t getVersion() const;
+    int getSeatCount() const;
+    int occupiedSeats() const;
+    bool isSeatOccupied(int seat) const;
+    TableStatus getStatus() const;
+    int getCurrentSeat() const;
+    bool hasTakenTurnAction() const;  // The seat to move has already played or drawn
+    int getWinnerSeat() const;
+    const UnoGame* getGame() const;
+};
+
+#endif // SERVER_TABLE_H
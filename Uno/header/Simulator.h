@@ -0,0 +1,66 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <string>
+#include <vector>
+#include "Move.h"
+#include "CardCode.h"
+
+class Bot;
+class Player;
+class UnoGame;
+
+const int MAX_SEATS = 4; // PLAYER_SETUP offers 2, 3 or 4 players
+
+// What the deciding player saw and chose on one turn
+struct TurnRecord {
+    int game;                  // Game number within the run
+    int turn;                  // Turn number within the game
+    int seat;                  // Seat of the deciding player (seats keep their number after eliminations)
+    int handSizes[MAX_SEATS];  // Cards held per seat, -1 for empty or eliminated seats
+    CardCode topCard;
+    CardColor topColor;
+    Move move;                 // The Play or Draw the player chose
+    CardCode moveCard;         // Card played, NO_CARD for a draw
+    bool calledUno;            // UNO was called earlier in the turn
+    int legalMoves;            // Number of Play/Draw choices available
+    bool reversed;             // Play direction at decision time
+};
+
+// Outcome of one simulated game
+struct GameResult {
+    unsigned int seed;
+    int turns;
+    int moves;
+    int winnerSeat; // -1 if the game hit the turn limit
+};
+
+// Receives every turn of a simulated game
+class TurnObserver {
+public:
+    virtual void onGameStart(const UnoGame& game, unsigned int seed);
+    virtual void onTurn(const TurnRecord& record) = 0;
+    // Called after every applied move, including UNO calls and turn ends
+    virtual void onMove(const UnoGame& game, const Move& move);
+    virtual void onGameEnd(const GameResult& result);
+    virtual ~TurnObserver();
+};
+
+// Plays whole games between bots on the headless engine
+class Simulator {
+private:
+    int numPlayers;
+    int maxTurns;
+    int gamesPlayed;
+
+public:
+    Simulator(int players, int turnLimit = 5000);
+
+    // Plays one game from a seed; bots holds one bot per seat
+    GameResult playGame(unsigned int seed, const std::vector<Bot*>& bots, TurnObserver* observer = nullptr);
+};
+
+// Seat (index into seats) of the player who won a finished game, or -1
+int findWinnerSeat(UnoGame& game, const std::vector<Player*>& seats);
+
+#endif // SIMULATOR_H
@@ -0,0 +1,70 @@
+#ifndef STATE_DELTA_H
+#define STATE_DELTA_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+class Player;
+class Card;
+
+// Primitive state changes recorded while a move is applied
+enum class DeltaOpType {
+    HandPush,       // card appended to player's hand
+    HandErase,      // card removed from player's hand at index
+    UnoFlag,        // player's UNO call flag toggled
+    DrawPop,        // card taken from the top of the draw pile
+    DrawPush,       // card returned to the top of the draw pile
+    DiscardPush,    // card placed on the discard pile
+    Reshuffle,      // discard pile shuffled back into the draw pile
+    TopCard,        // top card replaced (previous -> card)
+    ColorChange,    // card color changed (before -> after)
+    CurrentPlayer,  // current player index changed (before -> after)
+    Direction,      // play direction flipped
+    PendingEffects, // pending skip/reverse flags changed (before -> after)
+    TurnAction,     // "has played or drawn this turn" flag changed (before -> after)
+    Eliminate       // player removed from seat index
+};
+
+// A single recorded change, small enough to be stored by value
+struct DeltaOp {
+    DeltaOpType type;
+    int index;      // Hand index, seat index or offset into StateDelta::cards
+    int before;     // Previous value of the changed field
+    int after;      // New value of the changed field
+    Player* player; // Player whose hand or flag changed
+    Card* card;     // Card that moved, or the new top card
+    Card* previous; // Previous top card (TopCard only)
+    int rngIndex;   // Into StateDelta::rngStates: the shuffle source before, then after (Reshuffle only)
+};
+
+// The deck's shuffle source at one point, put back whole when a reshuffle is
+// undone or redone, so neither has to re-run the engine
+struct RngState {
+    std::mt19937 engine;
+    uint64_t draws;
+};
+
+// Everything one move changed, in the order it happened.
+// Undoing walks the ops backwards, redoing walks them forwards.
+struct StateDelta {
+    std::vector<DeltaOp> ops;
+    std::vector<Card*> cards; // Pile orders saved by Reshuffle ops
+    std::vector<RngState> rngStates; // Shuffle sources saved by Reshuffle ops
+
+    void record(DeltaOpType type, int index = 0, int before = 0, int after = 0,
+                Player* player = nullptr, Card* card = nullptr, Card* previous = nullptr) {
+        ops.push_back(DeltaOp{type, index, before, after, player, card, previous, 0});
+    }
+
+    // Keeps the allocated capacity so ring slots can be reused without allocating
+    void clear() {
+        ops.clear();
+        cards.clear();
+        rngStates.clear();
+    }
+
+    bool empty() const { return ops.empty(); }
+};
+
+#endif // STATE_DELTA_H
@@ -0,0 +1,124 @@
+#ifndef TABLE_SLAB_H
+#define TABLE_SLAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ServerTable.h"
+#include "TimingWheel.h"
+
+class ByteReader;
+
+const int TABLES_PER_SLAB = 64; // Slots carved from one allocation
+
+// Where a seated player's connection lives
+struct SeatRef {
+    int loop = -1;          // -1 for an empty seat
+    uint64_t sessionId = 0;
+};
+
+// A hosted table and the sessions sitting at it
+struct TableEntry {
+    ServerTable* table = nullptr; // In the same slot, so it lives exactly as long as the entry
+    SeatRef seats[MAX_SEATS];
+    std::vector<int> spectators; // Spectator count per loop; the loops keep the connections
+    TimerNode turnTimer;         // Runs while a game is on, restarted by every change
+    uint64_t claimTokens[MAX_SEATS] = {}; // What ClaimSeat must show to take each seat back
+    uint64_t graceUntil[MAX_SEATS] = {};  // Tick an empty seat's hold ends; 0 for none
+    TimerNode graceTimer;        // Due at the earliest of graceUntil
+    std::vector<uint8_t> spectatorBacklog; // Updates held for the spectators while the shard is overloaded
+    TimerNode spectatorTimer;    // Sends the backlog
+    int rating = 0;              // The creator's, shown in the lobby
+    uint64_t hops = 0;           // Times the table changed nodes; names each move to the router
+    bool listed = false;         // In the lobby, as a table still filling up
+};
+
+// One shard's tables, each in a fixed-size slot holding its TableEntry and
+// ServerTable (seats, timers, cached frames and delta history). Slots come
+// from slabs of TABLES_PER_SLAB that are never given back: a closed table's
+// slot goes on a free list and the next new table takes it over, buffers and
+// all, so tables coming and going leave the general heap alone. The slot's
+// engine (ServerTable keeps one UnoGame and its cards for all its games) is
+// made once; only the players and the frames that outgrow a slot's buffers
+// are allocated per game.
+//
+// Tables are found by id through an open-addressed index of slot numbers,
+// probed linearly, which never allocates except to double in size. Slots
+// never move, so entries can be pointed at (the timing wheel links their
+// timers) until they are erased.
+//
+// Not thread-safe: one event loop owns each.
+class TableSlab {
+private:
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Slot {
+        TableEntry entry;
+        ServerTable table;
+        uint64_t id = 0;            // 0 while the slot is free
+        uint32_t nextFree = NO_SLOT;
+    };
+    struct IndexEntry {
+        uint64_t id = 0;            // 0 for an empty position; table ids start at 1
+        uint32_t slot = NO_SLOT;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    uint32_t freeSlots;             // Head of the free list
+    size_t count;
+    size_t limit;                   // 0 for none
+    std::vector<IndexEntry> index;  // Power-of-two sized, at most half full
+
+    Slot& slotAt(uint32_t slot) const { return slabs[slot / TABLES_PER_SLAB][slot % TABLES_PER_SLAB]; }
+    size_t home(uint64_t id) const;
+    uint32_t findSlot(uint64_t id) const;
+    uint32_t takeSlot();
+    void addToIndex(uint64_t id, uint32_t slot);
+    void removeFromIndex(uint64_t id);
+    void release(uint32_t slot);
+
+public:
+    // Holds at most maxTables tables once isFull() is heeded, 0 for no limit
+    explicit TableSlab(size_t maxTables);
+
+    TableSlab(const TableSlab&) = delete;
+    TableSlab& operator=(const TableSlab&) = delete;
+
+    // nullptr if no table has that id
+    TableEntry* find(uint64_t id) const;
+    // A new empty table with no seats taken; id must not be in use. Callers
+    // creating tables for players check isFull() first.
+    TableEntry& create(uint64_t id, int seats);
+    // A table written by ServerTable::saveState. Throws InvalidInputException,
+    // keeping nothing, if it is malformed or its id is already in use.
+    TableEntry& load(ByteReader& reader);
+    // Frees the table's slot. Its timers must not be scheduled.
+    void erase(TableEntry& entry);
+
+    size_t size() const { return count; }
+    bool isFull() const { return limit != 0 && count >= limit; }
+    // Bytes held for slots, in use or free, and the index
+    size_t memoryUsage() const;
+    // Bytes one table takes before its buffers grow
+    static size_t slotSize() { return sizeof(Slot); }
+
+    // Visits the tables in slot order. Erasing the table at hand is fine;
+    // creating tables along the way is not.
+    class iterator {
+    private:
+        const TableSlab* owner;
+        uint32_t slot;
+        void skipFree();
+
+    public:
+        iterator(const TableSlab* slab, uint32_t first) : owner(slab), slot(first) { skipFree(); }
+        TableEntry& operator*() const { return owner->slotAt(slot).entry; }
+        iterator& operator++() { ++slot; skipFree(); return *this; }
+        bool operator!=(const iterator& other) const { return slot != other.slot; }
+    };
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, static_cast<uint32_t>(slabs.size() * TABLES_PER_SLAB)); }
+};
+
+#endif // TABLE_SLAB_H
@@ -0,0 +1,83 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// A timer the owner embeds in its own record, so scheduling allocates nothing
+// and cancelling is an unlink. owner is handed back untouched when it fires.
+struct TimerNode {
+    TimerNode* prev = nullptr;  // nullptr while not scheduled
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;       // Tick the timer fires at
+    uint64_t owner = 0;
+
+    TimerNode() = default;
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+
+    bool isScheduled() const { return prev != nullptr; }
+};
+
+// Hierarchical timing wheel (Varghese and Lauck). Level 0 has one slot per
+// tick; each level above has slots WHEEL_SLOTS times as wide, and its slots are
+// moved down a level ("cascaded") as the wheel turns past them. Scheduling and
+// cancelling are O(1) whatever the number of timers; each timer is touched at
+// most once per level on its way down.
+//
+// Time is counted in ticks chosen by the owner. Not thread-safe: one event
+// loop owns each wheel.
+class TimingWheel {
+public:
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    static const int WHEEL_LEVELS = 4;  // Timers up to 2^24 ticks ahead; later ones are clamped
+
+private:
+    TimerNode slots[WHEEL_LEVELS][WHEEL_SLOTS];  // Sentinels of circular lists
+    uint64_t now;     // Last tick processed
+    size_t count;
+
+    void place(TimerNode* node);
+    void cascade(int level);
+    static void unlink(TimerNode* node);
+
+public:
+    explicit TimingWheel(uint64_t startTick = 0);
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    // (Re)schedules node to fire at tick, at the earliest on the next one
+    void schedule(TimerNode* node, uint64_t tick);
+    // Does nothing if node is not scheduled
+    void cancel(TimerNode* node);
+
+    // Turns the wheel up to tick, calling fire(node) for each timer that comes
+    // due, in tick order. A timer is unscheduled before its call, so fire may
+    // schedule it again or cancel others.
+    template <typename Fire>
+    void advance(uint64_t tick, Fire fire) {
+        while (now < tick) {
+            now++;
+            int slot = static_cast<int>(now & (WHEEL_SLOTS - 1));
+            if (slot == 0) cascade(1);
+            TimerNode* head = &slots[0][slot];
+            while (head->next != head) {
+                TimerNode* node = head->next;
+                unlink(node);
+                count--;
+                fire(node);
+            }
+            if (count == 0) now = tick; // Nothing left to turn past
+        }
+    }
+
+    // Ticks until the next timer might fire: exact for timers on level 0, and
+    // otherwise the next cascade. -1 when no timer is scheduled.
+    int64_t ticksUntilNext() const;
+    uint64_t currentTick() const;
+    size_t size() const;
+};
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,42 @@
+#ifndef UNDO_HISTORY_H
+#define UNDO_HISTORY_H
+
+#include <vector>
+#include "StateDelta.h"
+
+// Bounded ring of move deltas supporting undo and redo.
+// When the ring is full the oldest move is forgotten.
+class UndoHistory {
+private:
+    std::vector<StateDelta> ring;
+    int oldest;     // Slot holding the oldest remembered move
+    int undoable;   // Moves that can be undone
+    int redoable;   // Undone moves that can be redone
+
+    StateDelta& slot(int offset);
+
+public:
+    explicit UndoHistory(int capacity = 64);
+
+    // Stores a finished move and discards the redo tail.
+    // The delta is swapped into the ring and comes back cleared.
+    void push(StateDelta& delta);
+
+    // Returns the move to revert, or nullptr if nothing can be undone
+    StateDelta* undo();
+
+    // Returns the move to replay, or nullptr if nothing can be redone
+    StateDelta* redo();
+
+    // The move undo() would return next, or nullptr
+    const StateDelta* latest() const;
+
+    bool canUndo() const;
+    bool canRedo() const;
+    int capacity() const;
+
+    // Forgets every remembered move
+    void clear();
+};
+
+#endif // UNDO_HISTORY_H
@@ -4,6 +4,9 @@
 #include <vector>
 #include <string>
 #include "../header/Deck.h"
+#include "../header/Move.h"
+#include "../header/StateDelta.h"
+#include "../header/UndoHistory.h"
 
 class Player;
 class Card;
@@ -21,12 +24,35 @@ private:
     // New flags to track pending card effects
     bool pendingSkipEffect = false;
     bool pendingReverseEffect = false;
-    
-    
+
+    bool turnActionTaken = false;           // Current player has already played or drawn this turn
+    std::vector<Player*> eliminatedPlayers; // Players knocked out, kept so eliminations can be undone
+
+    // Undo/redo: every makeMove records its changes into currentDelta,
+    // which is then stored in the bounded history ring
+    StateDelta currentDelta;
+    StateDelta* recorder = nullptr;
+    UndoHistory history;
+
+    void attachRecorder(StateDelta* delta);
+    void revertDelta(const StateDelta& delta);
+    void replayDelta(const StateDelta& delta);
+    void playMove(Player* player, const Move& move);
+    void setPendingEffects(bool skip, bool reverse);
+    void setTurnActionTaken(bool value);
 
 public:
     UnoGame();
     ~UnoGame();
+
+    // The game owns its players and cards through raw pointers, so it is never copied
+    UnoGame(const UnoGame&) = delete;
+    UnoGame& operator=(const UnoGame&) = delete;
+
+    // Deletes the players and forgets the game, leaving it as newly constructed
+    // (the shuffle source keeps its seed). The cards stay with the deck, which
+    // deals them again in the next game rather than allocating new ones.
+    void reset();
     bool getIntegerInput(int& output);
     void addPlayer(Player* player);
     void startGame();
@@ -47,8 +73,8 @@ public:
     bool isGameOver();
     
     // New methods to handle delayed effects
-    void setApplySkipEffect(bool value) { pendingSkipEffect = value; }
-    void setApplyReverseEffect(bool value) { pendingReverseEffect = value; }
+    void setApplySkipEffect(bool value);
+    void setApplyReverseEffect(bool value);
     bool hasPendingSkipEffect() const { return pendingSkipEffect; }
     bool hasPendingReverseEffect() const { return pendingReverseEffect; }
     void applyPendingEffects(); // Method to apply any pending effects
@@ -57,6 +83,40 @@ public:
     Card* getTopCard() const;
     int getPlayerCount() const;
     int nextPlayerIndex() const;
+
+    // Applies a player action, validating it against the rules first.
+    // The move is recorded so it can be undone; illegal moves throw and leave the game unchanged.
+    void makeMove(const Move& move);
+
+    // Reverts or re-applies recorded moves. Bots can also makeMove/undoMove
+    // to explore moves on the live game without cloning it.
+    bool undoMove();
+    bool redoMove();
+    bool canUndo() const;
+    bool canRedo() const;
+    // The changes made by the latest move still in the undo history, or nullptr
+    const StateDelta* lastMoveDelta() const;
+
+    // Fills out with every move the current player may make right now.
+    // Wild cards appear once per color; DropTwo plays leave the drop choice to the caller.
+    void legalMoves(std::vector<Move>& out) const;
+
+    // Seeds the deck so a game can be reproduced from its seed and moves
+    void setSeed(unsigned int seed);
+    Player* getPlayer(int seat) const;
+    bool isDirectionReversed() const;
+
+    bool hasTakenTurnAction() const;
+    void setCardColor(Card* card, CardColor color);
+
+    // Serializes the whole table (players, piles, turn state and shuffle position).
+    // loadSnapshot only accepts a game that has no players yet and starts it with an empty undo history.
+    void saveSnapshot(std::vector<uint8_t>& out) const;
+    void loadSnapshot(const uint8_t* data, size_t size);
 };
 
+// The engine narrates every move on stdout for the console game. Tools that
+// play games without a console call this once at start to mute it.
+void silenceGameNarration();
+
 #endif // UNO_GAME_H
\ No newline at end of file
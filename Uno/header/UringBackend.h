@@ -0,0 +1,89 @@
+#ifndef URING_BACKEND_H
+#define URING_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "IoBackend.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+// io_uring backend, driven through the raw system calls (no liburing).
+//
+// The listener has one multishot accept and every connection one multishot
+// recv, so steady-state traffic needs no re-arming. Received bytes land in a
+// ring of provided buffers registered with the kernel and are handed back as
+// soon as they are copied into the connection. Sends queue submissions that go
+// to the kernel together with the wait for the next batch, so a loop makes one
+// io_uring_enter per iteration however many tables it moved.
+//
+// Needs Linux 6.0 or later (provided buffer rings and multishot recv); waits
+// with a timeout go through IORING_ENTER_EXT_ARG rather than timeout requests.
+class UringBackend : public IoBackend {
+private:
+    IoHandler& handler;
+    int listenFd;
+    int ringFd;
+    int wakeFd;          // eventfd behind wake(), read by a queued READ
+    uint64_t wakeValue;
+
+    // Shared ring memory
+    void* rings;
+    size_t ringsSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqLocalTail;  // Filled entries, published by submit()
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+
+    // Provided receive buffers
+    io_uring_buf_ring* bufferRing;
+    size_t bufferRingSize;
+    uint8_t* buffers;
+    uint16_t bufferTail;
+    bool buffersReturned;
+
+    std::vector<Connection*> settling;  // Released, waiting for their last completion
+    unsigned inFlight;                  // Requests the kernel has not finished with
+    bool quiescing;                     // Between quiesce() and resume(): nothing new is submitted
+
+    void teardown();
+    io_uring_sqe* nextSqe();
+    int submit(unsigned waitFor, int timeoutMs = -1);
+    void provideBuffer(uint16_t id);
+
+    void armAccept();
+    void armWake();
+    void armReceive(Connection* connection);
+    void sendQueued(Connection* connection);
+
+    void dispatch(const io_uring_cqe& cqe);
+    void onReceive(Connection* connection, int result, unsigned flags);
+    void onSend(Connection* connection, int result);
+    void settle();
+
+public:
+    UringBackend(IoHandler& eventHandler, int listenSocket);
+    ~UringBackend() override;
+
+    UringBackend(const UringBackend&) = delete;
+    UringBackend& operator=(const UringBackend&) = delete;
+
+    void attach(Connection* connection) override;
+    void flush(Connection* connection) override;
+    void release(Connection* connection) override;
+    bool poll(int timeoutMs) override;
+    void wake() override;
+    void quiesce() override;
+    void resume(const std::vector<Connection*>& connections) override;
+};
+
+#endif // URING_BACKEND_H
@@ -0,0 +1,116 @@
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include "../header/LoadGenerator.h"
+#include "../header/Exceptions.h"
+
+// Load generator for the game server.
+//
+//   loadgen [--host 127.0.0.1] [--port 7777] [--clients N] [--threads N] [--seats 2-4]
+//           [--seconds S] [--think MS] [--strategy random|first] [--drop-percent P]
+//           [--compress]
+//
+// Every client finds a table through the matchmaker and keeps playing until
+// the time is up; the report gives move round trips as percentiles along
+// with throughput and error rates. --drop-percent makes clients hang up instead
+// of moving that often and claim their seats back on a new connection.
+// --compress has every connection ask for compression; the bytes on the wire
+// are reported either way, for comparing the two.
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: loadgen [--host HOST] [--port PORT] [--clients N] [--threads N] [--seats 2-4]\n"
+                    "               [--seconds S] [--think MS] [--strategy random|first] [--drop-percent P]\n"
+                    "               [--compress]\n");
+}
+
+static double perSecond(uint64_t count, double seconds)
+{
+    return seconds > 0 ? count / seconds : 0;
+}
+
+static double percentOf(uint64_t part, uint64_t whole)
+{
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    LoadConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--compress")
+        {
+            config.compress = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        if (arg == "--host") config.host = argv[++i];
+        else if (arg == "--port") config.port = std::stoi(argv[++i]);
+        else if (arg == "--clients") config.clients = std::stoi(argv[++i]);
+        else if (arg == "--threads") config.threads = std::stoi(argv[++i]);
+        else if (arg == "--seats") config.seats = std::stoi(argv[++i]);
+        else if (arg == "--seconds") config.seconds = std::stoi(argv[++i]);
+        else if (arg == "--think") config.thinkMs = std::stoi(argv[++i]);
+        else if (arg == "--strategy") config.strategy = argv[++i];
+        else if (arg == "--drop-percent") config.dropPercent = std::stoi(argv[++i]);
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        LoadReport report = LoadGenerator(config).run();
+        const LatencyHistogram& latency = report.latency;
+        printf("clients      %d (%llu failed to connect)\n", config.clients,
+               static_cast<unsigned long long>(report.connectFailures));
+        printf("duration     %.1f s\n", report.seconds);
+        printf("moves        %llu (%.0f/s)\n", static_cast<unsigned long long>(report.movesSent),
+               perSecond(report.movesSent, report.seconds));
+        printf("updates      %llu (%.0f/s)\n", static_cast<unsigned long long>(report.updates),
+               perSecond(report.updates, report.seconds));
+        printf("games        %llu (%.1f/s)\n", static_cast<unsigned long long>(report.gamesFinished),
+               perSecond(report.gamesFinished, report.seconds));
+        printf("round trip   p50 %.2f ms  p99 %.2f ms  p99.9 %.2f ms  max %.2f ms\n",
+               latency.percentile(0.5) / 1000.0, latency.percentile(0.99) / 1000.0,
+               latency.percentile(0.999) / 1000.0, latency.max() / 1000.0);
+        printf("rejected     %llu (%.3f%% of moves)\n", static_cast<unsigned long long>(report.movesRejected),
+               percentOf(report.movesRejected, report.movesSent));
+        printf("stale deltas %llu (%.3f%% of updates)\n", static_cast<unsigned long long>(report.staleDeltas),
+               percentOf(report.staleDeltas, report.updates));
+        if (config.dropPercent > 0)
+        {
+            printf("resumes      %llu (%llu followed by a full view)\n", static_cast<unsigned long long>(report.resumes),
+                   static_cast<unsigned long long>(report.resumeSnapshots));
+        }
+        if (report.searchesRefused > 0)
+        {
+            printf("busy         %llu searches refused\n", static_cast<unsigned long long>(report.searchesRefused));
+        }
+        printf("bytes        %llu in, %llu out (%.1f in per update)\n", static_cast<unsigned long long>(report.bytesReceived),
+               static_cast<unsigned long long>(report.bytesSent),
+               report.updates > 0 ? static_cast<double>(report.bytesReceived) / report.updates : 0.0);
+        printf("errors       %llu, disconnects %llu\n", static_cast<unsigned long long>(report.serverErrors),
+               static_cast<unsigned long long>(report.disconnects));
+        return report.connectFailures == 0 && report.disconnects == 0 ? 0 : 1;
+    }
+    catch (const Uno::UnoException &e)
+    {
+        fprintf(stderr, "UNO loadgen error: %s\n", e.what());
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Standard Exception: %s\n", e.what());
+        return 1;
+    }
+}
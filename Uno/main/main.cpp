@@ -5,9 +5,13 @@
 #include <string>
 #include <stdexcept>
 #include <iostream>
+#include <map>
+#include <memory>
 #include "../header/UnoGame.h" 
 #include "../header/Player.h"
 #include "../header/GameUI.h"
+#include "../header/MoveJournal.h"
+#include "../header/GameClient.h"
 #include "../header/Exceptions.h" // Include custom exception header
 
 // Enum to define different states of the game
@@ -17,12 +21,81 @@ enum GameState
     HOW_TO_PLAY,  // How to play rules screen
     PLAYER_SETUP, // Player name input and setup screen
     GAME_SCREEN,  // Main game play screen
+    ONLINE_SCREEN, // Game played at a server table, one player per machine
     END_SCREEN    // Game over screen
 };
 
+// Every move is journaled here so a crashed game can be picked up on the next launch
+static const char *JOURNAL_PATH = "uno_session.journal";
+
+// Network play skips the menus and sits down at a server table:
+//
+//   uno --connect HOST:PORT [--name NAME] [--seats N] [--table ID | --watch ID | --match RATING]
+//
+// Without --table a new table for N players (default 2) is created; others join it by its number.
+// --watch follows a table as a spectator. --match lets the server seat the player at a new
+// N-player table with others of a similar rating.
+struct OnlineOptions
+{
+    std::string host;
+    int port = 0;
+    std::string name = "Player";
+    uint64_t tableId = 0;
+    int seats = 2;
+    bool watch = false;
+    int rating = -1;  // -1 when not matchmaking
+};
+
+static bool parseOnlineOptions(int argc, char *argv[], OnlineOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "--connect")
+        {
+            size_t colon = value.rfind(':');
+            if (colon == std::string::npos)
+                return false;
+            options.host = value.substr(0, colon);
+            options.port = std::stoi(value.substr(colon + 1));
+        }
+        else if (arg == "--name") options.name = value;
+        else if (arg == "--table") options.tableId = std::stoull(value);
+        else if (arg == "--watch")
+        {
+            options.tableId = std::stoull(value);
+            options.watch = true;
+        }
+        else if (arg == "--seats") options.seats = std::stoi(value);
+        else if (arg == "--match") options.rating = std::stoi(value);
+        else
+            return false;
+    }
+    return options.seats >= 2 && options.seats <= MAX_SEATS;
+}
+
 // Main function where the game execution begins
-int main()
+int main(int argc, char *argv[])
 {
+    OnlineOptions online;
+    bool validOptions = false;
+    try
+    {
+        validOptions = parseOnlineOptions(argc, argv, online);
+    }
+    catch (const std::exception &e)
+    {
+        validOptions = false; // Unparsable number
+    }
+    if (!validOptions)
+    {
+        fprintf(stderr, "usage: uno [--connect HOST:PORT [--name NAME] [--seats N] [--table ID | --watch ID | --match RATING]]\n");
+        return 1;
+    }
+
     int screenWidth = 800;  // Initial screen width
     int screenHeight = 600; // Initial screen height
 
@@ -58,6 +131,58 @@ int main()
         UnoGame game;  // Create the game instance
         GameUI gameUI; // Create the UI controller
 
+        // Restore the last unfinished game, if the previous run crashed in the middle of one
+        std::unique_ptr<MoveJournal> journal;
+        uint64_t nextGameId = 1;
+        try
+        {
+            std::map<uint64_t, RecoveredGame> unfinished = MoveJournal::recover(JOURNAL_PATH);
+            journal.reset(new MoveJournal(JOURNAL_PATH));
+            if (!unfinished.empty())
+            {
+                auto last = unfinished.rbegin();
+                nextGameId = last->first + 1;
+                try
+                {
+                    MoveJournal::restoreGame(last->second, game);
+                    gameUI.SetJournal(journal.get(), last->first);
+                    gameUI.ResumeGame(game);
+                    journal->compact({{last->first, &game}});
+                    currentScreen = GAME_SCREEN;
+                    strcpy(statusMessage, "Recovered unfinished game");
+                }
+                catch (const Uno::UnoException &e)
+                {
+                    game.reset();
+                    journal->compact({});
+                    strcpy(statusMessage, "Could not recover the last game");
+                }
+            }
+        }
+        catch (const Uno::ResourceException &e)
+        {
+            // Play on without crash recovery rather than refusing to start
+            std::cerr << "Move journal disabled: " << e.what() << std::endl;
+            journal.reset();
+        }
+
+        // The client's network thread keeps the socket away from the render loop
+        std::unique_ptr<GameClient> client;
+        if (!online.host.empty())
+        {
+            client.reset(new GameClient());
+            client->connect(online.host, online.port, online.name);
+            if (online.rating >= 0)
+                client->findMatch(online.seats, online.rating);
+            else if (online.watch)
+                client->spectate(online.tableId);
+            else if (online.tableId != 0)
+                client->joinTable(online.tableId);
+            else
+                client->createTable(online.seats);
+            currentScreen = ONLINE_SCREEN;
+        }
+
         // Main game loop: continues until window is closed or exit is requested
         while (!WindowShouldClose() && !exitProgram)
         {
@@ -89,10 +214,11 @@ int main()
                 // Return to main menu instead of exiting program
                 currentScreen = MAIN_MENU;
                 // Reset game if returning from game screen to ensure a fresh start
-                game = UnoGame(); // Create a new game instance, effectively resetting it
+                game.reset(); // Free the finished game so a new one can start
                 numPlayers = 0;
                 nameInputBuffer.clear();
                 playerNames.clear();
+                client.reset(); // Leaving an online game closes the connection
             }
 
             // Handle mouse clicks based on current game state
@@ -185,6 +311,14 @@ int main()
 
                                 // Start the game logic (deal cards, set top card)
                                 game.startGame();
+
+                                // The initial snapshot replaces whatever the journal held before
+                                if (journal)
+                                {
+                                    uint64_t gameId = nextGameId++;
+                                    gameUI.SetJournal(journal.get(), gameId);
+                                    journal->compact({{gameId, &game}});
+                                }
                             } else {
                                 strcpy(statusMessage, "Please enter all player names!");
                             }
@@ -197,7 +331,7 @@ int main()
                     {
                         currentScreen = MAIN_MENU; // Return to main menu from end screen
                         // Reset game state for a new game
-                        game = UnoGame();
+                        game.reset();
                         numPlayers = 0;
                         nameInputBuffer.clear();
                         playerNames.clear();
@@ -338,6 +472,29 @@ int main()
                 }
             }
 
+            else if (currentScreen == ONLINE_SCREEN)
+            {
+                try
+                {
+                    if (!client || !gameUI.HandleGameScreen(*client))
+                    {
+                        throw Uno::GuiException("Online game screen handling failed");
+                    }
+                }
+                catch (const Uno::UnoException &e)
+                {
+                    strcpy(statusMessage, e.what());
+                    client.reset();
+                    currentScreen = MAIN_MENU;
+                }
+                catch (const std::exception &e)
+                {
+                    strcpy(statusMessage, TextFormat("Unexpected Error: %s", e.what()));
+                    client.reset();
+                    currentScreen = MAIN_MENU;
+                }
+            }
+
             EndDrawing(); // End drawing frame
         }
 
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../header/UnoGame.h"
+#include "../header/Replay.h"
+#include "../header/Notation.h"
+#include "../header/MappedFile.h"
+#include "../header/Exceptions.h"
+
+// Re-plays archived games on the current engine and reports any that no longer match.
+//
+//   revalidate [--threads N] [--show N] replays.urpl... fixtures.uno...
+//
+// One thread reads records and hands them out in batches; every other core
+// decodes and re-plays them. Archives are written by `simulate --replays FILE`.
+// Any file that does not start with the archive magic is read as text notation
+// (`simulate --notation FILE`, whatever its name); it is memory-mapped and split
+// at "game" lines so the workers parse their slices in place.
+
+static const size_t BATCH_SIZE = 256;  // Records handed to a worker at a time
+static const size_t MAX_QUEUED = 64;   // Batches read ahead of the workers
+static const size_t SLICE_BYTES = 64 * 1024; // Notation text handed to a worker at a time
+
+struct Batch
+{
+    uint64_t firstGame;                       // Archive-wide index of the first record
+    std::vector<std::vector<uint8_t>> records;
+    std::string_view notation;                // Or a slice of a notation file starting at a "game" line
+    int notationLine = 1;
+};
+
+struct Mismatch
+{
+    uint64_t game;
+    unsigned int seed;
+    ReplayCheck check;
+};
+
+// Bounded hand-off between the reader and the workers
+class BatchQueue
+{
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<Batch> batches;
+    bool finished = false;
+
+public:
+    void push(Batch&& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return batches.size() < MAX_QUEUED; });
+        batches.push_back(std::move(batch));
+        notEmpty.notify_one();
+    }
+
+    bool pop(Batch& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return finished || !batches.empty(); });
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        notEmpty.notify_all();
+    }
+};
+
+// Cuts a notation file into slices that each start at a "game" line
+static void queueNotation(const MappedFile& file, uint64_t& game, BatchQueue& queue)
+{
+    std::string_view text = file.text();
+    size_t start = 0;
+    int line = 1;
+    while (start < text.size())
+    {
+        size_t end = start + SLICE_BYTES;
+        if (end >= text.size())
+        {
+            end = text.size();
+        }
+        else
+        {
+            end = text.find("\ngame ", end);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+        }
+
+        Batch batch;
+        batch.firstGame = game;
+        batch.notation = text.substr(start, end - start);
+        batch.notationLine = line;
+        line += std::count(batch.notation.begin(), batch.notation.end(), '\n');
+
+        // Number the games so mismatches can be reported by position in the run
+        size_t games = batch.notation.compare(0, 5, "game ") == 0 ? 1 : 0;
+        for (size_t at = batch.notation.find("\ngame "); at != std::string_view::npos; at = batch.notation.find("\ngame ", at + 1))
+        {
+            games++;
+        }
+        game += games;
+        queue.push(std::move(batch));
+        start = end;
+    }
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: revalidate [--threads N] [--show N] ARCHIVE...\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t show = 20;
+    std::vector<std::string> archives;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "--threads" || arg == "--show") && i + 1 < argc)
+        {
+            int value = std::stoi(argv[++i]);
+            if (value < 1)
+            {
+                printUsage();
+                return 1;
+            }
+            if (arg == "--threads") threads = value;
+            else show = value;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else archives.push_back(arg);
+    }
+    if (archives.empty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    silenceGameNarration();
+
+    BatchQueue queue;
+    std::mutex resultsMutex;
+    std::vector<Mismatch> mismatches;
+    uint64_t gamesChecked = 0;
+    uint64_t movesChecked = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]
+        {
+            Batch batch;
+            Replay replay;
+            std::vector<Mismatch> found;
+            uint64_t games = 0, moves = 0;
+            NotationGame notation;
+            while (queue.pop(batch))
+            {
+                if (!batch.notation.empty())
+                {
+                    NotationParser parser(batch.notation, batch.notationLine);
+                    uint64_t index = batch.firstGame;
+                    try
+                    {
+                        while (parser.next(notation))
+                        {
+                            ReplayCheck check = verifyNotation(notation);
+                            if (!check.matched)
+                                found.push_back({index, notation.seed, check});
+                            index++;
+                            games++;
+                            moves += notation.moves.size();
+                        }
+                    }
+                    catch (const Uno::UnoException& e)
+                    {
+                        // A syntax error ends the slice; report it against the game being parsed
+                        ReplayCheck check;
+                        check.matched = false;
+                        check.reason = e.what();
+                        found.push_back({index, notation.seed, check});
+                    }
+                    continue;
+                }
+                for (size_t i = 0; i < batch.records.size(); i++)
+                {
+                    const std::vector<uint8_t>& record = batch.records[i];
+                    ReplayCheck check;
+                    try
+                    {
+                        decodeReplay(record.data(), record.size(), replay);
+                        check = verifyReplay(replay);
+                    }
+                    catch (const Uno::UnoException& e)
+                    {
+                        check.matched = false;
+                        check.reason = std::string("replay could not be checked: ") + e.what();
+                    }
+                    if (!check.matched)
+                        found.push_back({batch.firstGame + i, replay.seed, check});
+                    games++;
+                    moves += replay.moves.size();
+                }
+            }
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            mismatches.insert(mismatches.end(), found.begin(), found.end());
+            gamesChecked += games;
+            movesChecked += moves;
+        });
+    }
+
+    int status = 0;
+    std::vector<std::unique_ptr<MappedFile>> mapped; // Kept open until the workers finish
+    try
+    {
+        uint64_t game = 0;
+        for (const std::string& path : archives)
+        {
+            if (!ReplayReader::isArchive(path))
+            {
+                mapped.emplace_back(new MappedFile(path));
+                queueNotation(*mapped.back(), game, queue);
+                continue;
+            }
+            ReplayReader reader(path);
+            Batch batch;
+            batch.firstGame = game;
+            batch.records.resize(BATCH_SIZE);
+            size_t filled = 0;
+            try
+            {
+                while (reader.next(batch.records[filled]))
+                {
+                    game++;
+                    if (++filled == BATCH_SIZE)
+                    {
+                        queue.push(std::move(batch));
+                        batch = Batch();
+                        batch.firstGame = game;
+                        batch.records.resize(BATCH_SIZE);
+                        filled = 0;
+                    }
+                }
+            }
+            catch (const Uno::UnoException& e)
+            {
+                // A truncated or damaged archive still has its intact records checked
+                fprintf(stderr, "Replay archive error: %s\n", e.what());
+                status = 2;
+            }
+            if (filled > 0)
+            {
+                batch.records.resize(filled);
+                queue.push(std::move(batch));
+            }
+        }
+    }
+    catch (const Uno::UnoException& e)
+    {
+        fprintf(stderr, "Replay archive error: %s\n", e.what());
+        status = 2;
+    }
+    queue.finish();
+    for (std::thread& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(mismatches.begin(), mismatches.end(), [](const Mismatch& a, const Mismatch& b)
+    {
+        return a.game < b.game;
+    });
+    for (size_t i = 0; i < mismatches.size() && i < show; i++)
+    {
+        const Mismatch& m = mismatches[i];
+        printf("game %llu (seed %u): turn %d, move %d: %s\n", (unsigned long long)m.game, m.seed,
+               m.check.turn, m.check.move, m.check.reason.c_str());
+    }
+    printf("%llu games, %llu moves checked on %d threads in %.2fs (%.0f games/s)\n",
+           (unsigned long long)gamesChecked, (unsigned long long)movesChecked, threads, seconds,
+           seconds > 0 ? gamesChecked / seconds : 0.0);
+    printf("%zu mismatched\n", mismatches.size());
+
+    if (status == 0 && !mismatches.empty())
+        status = 1;
+    return status;
+}
@@ -0,0 +1,111 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "../header/Router.h"
+#include "../header/Exceptions.h"
+
+// Front door of a cluster of game servers.
+//
+//   router --nodes FILE --cluster-key KEY [--address 127.0.0.1] [--port 7700] [--io epoll|uring]
+//
+// FILE lists one node per line, "NAME HOST:PORT", each a server started with
+// the same --cluster-key. Clients connect to the router as to a single server.
+// Edit the file and send SIGHUP to add or remove nodes: the tables whose owner
+// changed move to their new node, with their players, while games go on.
+// Runs until interrupted (Ctrl+C or SIGTERM).
+
+static volatile sig_atomic_t stopRequested = 0;
+static volatile sig_atomic_t reloadRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+static void onHangup(int)
+{
+    reloadRequested = 1;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: router --nodes FILE --cluster-key KEY [--address ADDR] [--port PORT] [--io epoll|uring]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    RouterConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        if (arg == "--address") config.address = argv[++i];
+        else if (arg == "--port") config.port = std::stoi(argv[++i]);
+        else if (arg == "--nodes") config.nodesFile = argv[++i];
+        else if (arg == "--cluster-key") config.clusterKey = argv[++i];
+        else if (arg == "--io")
+        {
+            std::string name = argv[++i];
+            if (name != "epoll" && name != "uring")
+            {
+                printUsage();
+                return 1;
+            }
+            config.backend = parseIoBackendKind(name);
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (config.nodesFile.empty() || config.clusterKey.empty())
+    {
+        printUsage();
+        return 1;
+    }
+    config.log = [](const std::string& problem) { fprintf(stderr, "router: %s\n", problem.c_str()); };
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGHUP, onHangup);
+    signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        Router router(config);
+        router.start();
+        printf("routing %s:%d to the nodes in %s with %s\n", config.address.c_str(), router.getPort(),
+               config.nodesFile.c_str(), ioBackendName(router.getBackend()).c_str());
+        fflush(stdout);
+
+        while (!stopRequested)
+        {
+            usleep(100 * 1000);
+            if (reloadRequested)
+            {
+                reloadRequested = 0;
+                router.reload();
+            }
+        }
+        router.stop();
+        printf("stopped\n");
+        return 0;
+    }
+    catch (const Uno::UnoException &e)
+    {
+        fprintf(stderr, "UNO router error: %s\n", e.what());
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Standard Exception: %s\n", e.what());
+        return 1;
+    }
+}
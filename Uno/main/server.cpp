@@ -0,0 +1,143 @@
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "../header/Server.h"
+#include "../header/UnoGame.h"
+#include "../header/TableSlab.h"
+#include "../header/Metrics.h"
+#include "../header/AllocationCounter.h"
+#include "../header/Exceptions.h"
+
+// Headless multi-table game server.
+//
+//   server [--address 127.0.0.1] [--port 7777] [--threads N] [--io epoll|uring] [--turn-timeout S]
+//          [--resume-grace S] [--metrics HOST:PORT|unix:PATH] [--handoff PATH] [--take-over PATH]
+//          [--cluster-key KEY] [--overload-lag MS] [--overload-depth N] [--max-tables N]
+//          [--journal DIR]
+//
+// --io uring uses io_uring where the kernel supports it and epoll otherwise.
+// --turn-timeout sets how long a player may take over a turn before the server
+// draws and passes for them (default 30 seconds, 0 for no limit).
+// --resume-grace sets how long a player whose connection drops mid-game keeps
+// the seat for a reconnect (default 60 seconds, 0 to free it at once).
+// --metrics serves Prometheus metrics over HTTP on a TCP port or a Unix socket.
+// --handoff listens on a Unix socket for a new server to hand everything to, and
+// --take-over starts one that way: it adopts the running server's tables,
+// players and sockets (and its loop count), after which the old one exits.
+// Passing both the same path allows upgrade after upgrade:
+//
+//   server --handoff /run/uno.sock &
+//   server --handoff /run/uno.sock --take-over /run/uno.sock &
+//
+// --cluster-key lets a router started with the same key (see router.cpp) run
+// this server as one node of a cluster.
+// --overload-lag and --overload-depth set when an event loop counts as
+// overloaded: when it has gone that many milliseconds without catching up
+// (default 50, 0 never sheds load), or finds that many messages queued for
+// it at once (default 10000). It then refuses new tables and searches and
+// batches spectator updates until it has stayed well below both for a while.
+// --max-tables caps the tables each event loop hosts (default 20000, 0 for no
+// limit); a full loop refuses new tables with Busy and matches go elsewhere.
+// Each table takes a fixed slot, whose size the server prints at start.
+// --journal logs the running games in a directory, one file per event loop;
+// after a crash, a server started with the same directory carries them on,
+// and their players claim their seats back as after a dropped connection.
+// Runs until interrupted (Ctrl+C or SIGTERM).
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: server [--address ADDR] [--port PORT] [--threads N] [--io epoll|uring] [--turn-timeout S]\n"
+                    "              [--resume-grace S] [--metrics HOST:PORT|unix:PATH] [--handoff PATH]\n"
+                    "              [--take-over PATH] [--cluster-key KEY] [--overload-lag MS] [--overload-depth N]\n"
+                    "              [--max-tables N] [--journal DIR]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    ServerConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        if (arg == "--address") config.address = argv[++i];
+        else if (arg == "--port") config.port = std::stoi(argv[++i]);
+        else if (arg == "--threads") config.threads = std::stoi(argv[++i]);
+        else if (arg == "--turn-timeout") config.turnTimeoutMs = std::stoi(argv[++i]) * 1000;
+        else if (arg == "--resume-grace") config.resumeGraceMs = std::stoi(argv[++i]) * 1000;
+        else if (arg == "--metrics") config.metricsAddress = argv[++i];
+        else if (arg == "--handoff") config.handoffPath = argv[++i];
+        else if (arg == "--take-over") config.takeoverPath = argv[++i];
+        else if (arg == "--cluster-key") config.clusterKey = argv[++i];
+        else if (arg == "--overload-lag") config.overloadLagMs = std::stoi(argv[++i]);
+        else if (arg == "--overload-depth") config.overloadQueueDepth = std::stoi(argv[++i]);
+        else if (arg == "--max-tables") config.maxTablesPerLoop = std::stoi(argv[++i]);
+        else if (arg == "--journal") config.journalDir = argv[++i];
+        else if (arg == "--io")
+        {
+            std::string name = argv[++i];
+            if (name != "epoll" && name != "uring")
+            {
+                printUsage();
+                return 1;
+            }
+            config.backend = parseIoBackendKind(name);
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    silenceGameNarration();
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        Server server(config);
+        server.start();
+        printf("%s on %s:%d with %d %s event loops\n", config.takeoverPath.empty() ? "listening" : "took over",
+               config.address.c_str(), server.getPort(), server.loopCount(), ioBackendName(server.getBackend()).c_str());
+        printf("tables take %zu bytes each", TableSlab::slotSize());
+        if (config.maxTablesPerLoop > 0)
+            printf(", up to %d per event loop", config.maxTablesPerLoop);
+        printf("\n");
+        fflush(stdout);
+
+        // A handoff happens on the server's own thread, so this checks in now and then
+        while (!stopRequested && !server.isHandedOff())
+            usleep(100 * 1000);
+
+        bool handedOff = server.isHandedOff();
+        server.stop();
+        printf(handedOff ? "handed off\n" : "stopped\n");
+        return 0;
+    }
+    catch (const Uno::UnoException &e)
+    {
+        fprintf(stderr, "UNO server error: %s\n", e.what());
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Standard Exception: %s\n", e.what());
+        return 1;
+    }
+}
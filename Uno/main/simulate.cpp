@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../header/Simulator.h"
+#include "../header/UnoGame.h"
+#include "../header/FeatureExport.h"
+#include "../header/Replay.h"
+#include "../header/Notation.h"
+#include "../header/ColumnarFile.h"
+#include "../header/Bot.h"
+#include "../header/Metrics.h"
+#include "../header/AllocationCounter.h"
+#include "../header/Exceptions.h"
+
+// Headless bot-vs-bot simulator.
+//
+//   simulate --games 10000 --players 4 --seed 1 --bot greedy --out turns.ucol
+//   simulate --read turns.ucol hand_0 legal_moves
+//
+// The first form plays games and streams one row per turn to a columnar file;
+// with --replays it also archives every game for the revalidate tool, and
+// with --notation it writes every game as text notation.
+// The second reads back only the named columns and prints a summary of each.
+// With --metrics HOST:PORT (or unix:PATH) the run serves Prometheus metrics
+// while it plays.
+
+// Passes simulator callbacks on to the feature writer and the optional replay archive
+class SimulationObservers : public TurnObserver
+{
+private:
+    std::vector<TurnObserver*> observers;
+
+public:
+    void add(TurnObserver* observer) { observers.push_back(observer); }
+
+    void onGameStart(const UnoGame& game, unsigned int seed) override
+    {
+        for (TurnObserver* observer : observers) observer->onGameStart(game, seed);
+    }
+    void onTurn(const TurnRecord& record) override
+    {
+        for (TurnObserver* observer : observers) observer->onTurn(record);
+    }
+    void onMove(const UnoGame& game, const Move& move) override
+    {
+        for (TurnObserver* observer : observers) observer->onMove(game, move);
+    }
+    void onGameEnd(const GameResult& result) override
+    {
+        for (TurnObserver* observer : observers) observer->onGameEnd(result);
+    }
+};
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: simulate [--games N] [--players 2-4] [--seed S] [--bot random|greedy] [--out FILE] [--replays FILE] [--notation FILE]\n"
+                    "                [--metrics HOST:PORT|unix:PATH]\n");
+    fprintf(stderr, "       simulate --read FILE COLUMN...\n");
+}
+
+static int readColumns(int argc, char* argv[])
+{
+    ColumnarReader reader(argv[2]);
+    printf("%llu rows, %zu columns\n", (unsigned long long)reader.rowCount(), reader.columns().size());
+
+    std::vector<int64_t> values;
+    for (int i = 3; i < argc; i++)
+    {
+        values.clear();
+        reader.readColumn(argv[i], values);
+        if (values.empty())
+        {
+            printf("%-12s (empty)\n", argv[i]);
+            continue;
+        }
+        int64_t minimum = values[0], maximum = values[0];
+        double sum = 0;
+        for (int64_t value : values)
+        {
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+            sum += value;
+        }
+        printf("%-12s min %lld  max %lld  mean %.3f\n", argv[i], (long long)minimum, (long long)maximum, sum / values.size());
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc >= 3 && strcmp(argv[1], "--read") == 0)
+        {
+            return readColumns(argc, argv);
+        }
+
+        int games = 1000;
+        int players = 4;
+        unsigned int seed = 1;
+        std::string botName = "greedy";
+        std::string outPath = "turns.ucol";
+        std::string replayPath;
+        std::string notationPath;
+        std::string metricsAddress;
+
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                printUsage();
+                return 1;
+            }
+            if (arg == "--games") games = std::stoi(argv[++i]);
+            else if (arg == "--players") players = std::stoi(argv[++i]);
+            else if (arg == "--seed") seed = std::stoul(argv[++i]);
+            else if (arg == "--bot") botName = argv[++i];
+            else if (arg == "--out") outPath = argv[++i];
+            else if (arg == "--replays") replayPath = argv[++i];
+            else if (arg == "--notation") notationPath = argv[++i];
+            else if (arg == "--metrics") metricsAddress = argv[++i];
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+
+        silenceGameNarration();
+
+        std::vector<std::unique_ptr<Bot>> owned;
+        std::vector<Bot*> bots;
+        for (int i = 0; i < players; i++)
+        {
+            owned.emplace_back(createBot(botName, seed + i));
+            bots.push_back(owned.back().get());
+        }
+
+        Simulator simulator(players);
+        TurnFeatureWriter features(outPath);
+        std::unique_ptr<ReplayWriter> replays;
+        std::unique_ptr<NotationWriter> notation;
+        SimulationObservers observers;
+        observers.add(&features);
+        if (!replayPath.empty())
+        {
+            replays.reset(new ReplayWriter(replayPath));
+            observers.add(replays.get());
+        }
+        if (!notationPath.empty())
+        {
+            notation.reset(new NotationWriter(notationPath));
+            observers.add(notation.get());
+        }
+        std::vector<int> wins(players + 1, 0);
+        std::unique_ptr<MetricsEndpoint> metrics;
+        if (!metricsAddress.empty())
+        {
+            Metrics::attachThread();
+            metrics.reset(new MetricsEndpoint(metricsAddress));
+            metrics->start();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int g = 0; g < games; g++)
+        {
+            GameResult result = simulator.playGame(seed + g, bots, &observers);
+            wins[result.winnerSeat + 1]++; // Slot 0 counts unfinished games
+        }
+        features.close();
+        if (replays)
+            replays->close();
+        if (notation)
+            notation->close();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%d games, %llu turns in %.2fs (%.0f turns/s)\n", games,
+               (unsigned long long)features.rowsWritten(), seconds, features.rowsWritten() / seconds);
+        printf("wrote %s: %llu bytes (%.2f bytes/turn)\n", outPath.c_str(),
+               (unsigned long long)features.bytesWritten(),
+               features.rowsWritten() ? (double)features.bytesWritten() / features.rowsWritten() : 0.0);
+        if (replays)
+        {
+            printf("archived %llu games to %s\n", (unsigned long long)replays->gamesWritten(), replayPath.c_str());
+        }
+        for (int s = 0; s < players; s++)
+        {
+            printf("seat %d wins: %d\n", s, wins[s + 1]);
+        }
+        printf("unfinished: %d\n", wins[0]);
+        return 0;
+    }
+    catch (const Uno::UnoException &e)
+    {
+        fprintf(stderr, "UNO simulation error: %s\n", e.what());
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Standard Exception: %s\n", e.what());
+        return 1;
+    }
+}
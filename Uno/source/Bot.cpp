@@ -0,0 +1,116 @@
+#include "../header/Bot.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/Card.h"
+#include "../header/CardCode.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+
+Bot::~Bot() {}
+
+// Fills in which cards a DropTwo play gets rid of. Greedy bots drop their
+// highest ranked cards, random bots any two.
+static void chooseDrops(Player* player, Move& move, std::mt19937* rng) {
+    if (move.type != MoveType::Play) return;
+    Card* card = player->getCardAtIndex(move.handIndex);
+    if (!card || cardCodeKind(encodeCard(card)) != CardKind::DropTwo) return;
+
+    // Indices of the hand once the DropTwo card itself has been played
+    std::vector<int> remaining;
+    for (int i = 0; i < player->getHandSize() - 1; ++i) {
+        remaining.push_back(i);
+    }
+
+    if (rng) {
+        std::shuffle(remaining.begin(), remaining.end(), *rng);
+    } else {
+        // Number cards are the cheapest to keep, so drop the highest numbers first
+        auto rank = [&](int index) {
+            int handIndex = index >= move.handIndex ? index + 1 : index;
+            CardCode code = encodeCard(player->getCardAtIndex(handIndex));
+            return cardCodeKind(code) == CardKind::Number ? cardCodeNumber(code) : -1;
+        };
+        std::stable_sort(remaining.begin(), remaining.end(),
+                         [&](int a, int b) { return rank(a) > rank(b); });
+    }
+
+    move.dropCount = std::min<int>(2, remaining.size());
+    for (int i = 0; i < move.dropCount; ++i) {
+        move.dropIndices[i] = remaining[i];
+    }
+}
+
+RandomBot::RandomBot(unsigned int seed) : rng(seed) {}
+
+Move RandomBot::chooseMove(const UnoGame& game, const std::vector<Move>& legal) {
+    if (legal.empty()) {
+        throw Uno::GameStateException("Bot has no legal move to choose from");
+    }
+    Move move = legal[std::uniform_int_distribution<int>(0, legal.size() - 1)(rng)];
+    chooseDrops(game.getCurrentPlayer(), move, &rng);
+    return move;
+}
+
+std::string RandomBot::getName() const {
+    return "random";
+}
+
+// Higher is better; wild cards are saved because they can be played on anything
+static int playPriority(CardKind kind) {
+    switch (kind) {
+        case CardKind::DrawSix: return 7;
+        case CardKind::DrawTwo: return 6;
+        case CardKind::Skip: return 5;
+        case CardKind::Reverse: return 5;
+        case CardKind::DropTwo: return 4;
+        case CardKind::Number: return 3;
+        case CardKind::Wild: return 1;
+        case CardKind::DrawFour: return 0;
+    }
+    return 0;
+}
+
+Move GreedyBot::chooseMove(const UnoGame& game, const std::vector<Move>& legal) {
+    if (legal.empty()) {
+        throw Uno::GameStateException("Bot has no legal move to choose from");
+    }
+    Player* player = game.getCurrentPlayer();
+
+    // Count colors in hand to decide which color a wild card should name
+    int colorCounts[4] = {0, 0, 0, 0};
+    for (int i = 0; i < player->getHandSize(); ++i) {
+        CardColor color = player->getCardAtIndex(i)->getColor();
+        if (color != CardColor::NONE) colorCounts[static_cast<int>(color)]++;
+    }
+    CardColor bestColor = static_cast<CardColor>(std::max_element(colorCounts, colorCounts + 4) - colorCounts);
+
+    const Move* best = nullptr;
+    int bestScore = -1;
+    for (const Move& move : legal) {
+        if (move.type == MoveType::CallUno) return move; // Never risk the penalty
+        if (move.type == MoveType::EndTurn) best = best ? best : &move;
+        if (move.type != MoveType::Play) continue;
+        if (move.color != CardColor::NONE && move.color != bestColor) continue;
+
+        CardCode code = encodeCard(player->getCardAtIndex(move.handIndex));
+        int score = playPriority(cardCodeKind(code)) * 16 + cardCodeNumber(code);
+        if (score > bestScore) {
+            bestScore = score;
+            best = &move;
+        }
+    }
+
+    Move move = best ? *best : legal.back(); // Draw is always listed last
+    chooseDrops(player, move, nullptr);
+    return move;
+}
+
+std::string GreedyBot::getName() const {
+    return "greedy";
+}
+
+Bot* createBot(const std::string& name, unsigned int seed) {
+    if (name == "random") return new RandomBot(seed);
+    if (name == "greedy") return new GreedyBot();
+    throw Uno::InvalidInputException("Unknown bot strategy: " + name);
+}
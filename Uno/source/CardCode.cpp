@@ -0,0 +1,62 @@
+#include "../header/CardCode.h"
+#include "../header/Card.h"
+#include "../header/NumberCard.h"
+#include "../header/SkipCard.h"
+#include "../header/ReverseCard.h"
+#include "../header/DrawTwoCard.h"
+#include "../header/DrawSixCard.h"
+#include "../header/DropTwoCard.h"
+#include "../header/WildCard.h"
+#include "../header/DrawFourCard.h"
+#include "../header/Exceptions.h"
+
+CardCode encodeCard(const Card* card) {
+    if (!card) return NO_CARD;
+
+    CardColor color = card->getColor();
+    if (const NumberCard* number = dynamic_cast<const NumberCard*>(card)) {
+        return makeCardCode(CardKind::Number, color, number->getNumber());
+    }
+    if (dynamic_cast<const SkipCard*>(card)) return makeCardCode(CardKind::Skip, color);
+    if (dynamic_cast<const ReverseCard*>(card)) return makeCardCode(CardKind::Reverse, color);
+    if (dynamic_cast<const DrawTwoCard*>(card)) return makeCardCode(CardKind::DrawTwo, color);
+    if (dynamic_cast<const DrawSixCard*>(card)) return makeCardCode(CardKind::DrawSix, color);
+    if (dynamic_cast<const DropTwoCard*>(card)) return makeCardCode(CardKind::DropTwo, color);
+    if (dynamic_cast<const WildCard*>(card)) return makeCardCode(CardKind::Wild, color);
+    if (dynamic_cast<const DrawFourCard*>(card)) return makeCardCode(CardKind::DrawFour, color);
+
+    throw Uno::CardException("Cannot encode card of unknown type: " + card->getName());
+}
+
+Card* decodeCard(CardCode code) {
+    if (code == NO_CARD) return nullptr;
+
+    CardColor color = cardCodeColor(code);
+    if (color > CardColor::NONE) {
+        throw Uno::CardException("Card code has an invalid color");
+    }
+
+    Card* card = nullptr;
+    switch (cardCodeKind(code)) {
+        case CardKind::Number:
+            if (cardCodeNumber(code) > 9) {
+                throw Uno::CardException("Card code has an invalid number");
+            }
+            card = new NumberCard(cardCodeNumber(code), color);
+            break;
+        case CardKind::Skip: card = new SkipCard(color); break;
+        case CardKind::Reverse: card = new ReverseCard(color); break;
+        case CardKind::DrawTwo: card = new DrawTwoCard(color); break;
+        case CardKind::DrawSix: card = new DrawSixCard(color); break;
+        case CardKind::DropTwo: card = new DropTwoCard(color); break;
+        case CardKind::Wild:
+            card = new WildCard();
+            card->setColor(color); // Keep the color chosen when it was played
+            break;
+        case CardKind::DrawFour:
+            card = new DrawFourCard();
+            card->setColor(color);
+            break;
+    }
+    return card;
+}
@@ -0,0 +1,321 @@
+#include "../header/ColumnarFile.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <cstring>
+
+static const char COLUMNAR_MAGIC[8] = {'U', 'N', 'O', 'C', 'O', 'L', '1', '\0'};
+
+// Packs values LSB-first at a fixed width; widths above 32 bits go in two pieces
+class BitPacker {
+private:
+    ByteWriter& out;
+    uint64_t bits;
+    int count;
+
+    void putPiece(uint64_t value, int width) {
+        bits |= (value & ((uint64_t(1) << width) - 1)) << count;
+        count += width;
+        while (count >= 8) {
+            out.putU8(bits & 0xFF);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+public:
+    explicit BitPacker(ByteWriter& writer) : out(writer), bits(0), count(0) {}
+
+    void put(uint64_t value, int width) {
+        for (int shift = 0; shift < width; shift += 32) {
+            putPiece(value >> shift, std::min(32, width - shift));
+        }
+    }
+
+    void finish() {
+        if (count > 0) out.putU8(bits & 0xFF);
+        bits = 0;
+        count = 0;
+    }
+};
+
+class BitUnpacker {
+private:
+    ByteReader& in;
+    uint64_t bits;
+    int count;
+
+    uint64_t getPiece(int width) {
+        while (count < width) {
+            bits |= static_cast<uint64_t>(in.getU8()) << count;
+            count += 8;
+        }
+        uint64_t value = bits & ((uint64_t(1) << width) - 1);
+        bits >>= width;
+        count -= width;
+        return value;
+    }
+
+public:
+    explicit BitUnpacker(ByteReader& reader) : in(reader), bits(0), count(0) {}
+
+    uint64_t get(int width) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < width; shift += 32) {
+            value |= getPiece(std::min(32, width - shift)) << shift;
+        }
+        return value;
+    }
+};
+
+static int bitWidth(uint64_t range) {
+    int width = 0;
+    while (range) {
+        width++;
+        range >>= 1;
+    }
+    return width;
+}
+
+static void encodeBitPacked(const std::vector<int64_t>& values, std::vector<uint8_t>& out) {
+    out.clear();
+    ByteWriter writer(out);
+    int64_t minimum = *std::min_element(values.begin(), values.end());
+    int64_t maximum = *std::max_element(values.begin(), values.end());
+    int width = bitWidth(static_cast<uint64_t>(maximum) - static_cast<uint64_t>(minimum));
+
+    writer.putVarint(values.size());
+    writer.putSigned(minimum);
+    writer.putU8(width);
+    BitPacker packer(writer);
+    for (int64_t value : values) {
+        packer.put(static_cast<uint64_t>(value) - static_cast<uint64_t>(minimum), width);
+    }
+    packer.finish();
+}
+
+static void encodeRunLength(const std::vector<int64_t>& values, std::vector<uint8_t>& out) {
+    out.clear();
+    ByteWriter writer(out);
+    writer.putVarint(values.size());
+    size_t i = 0;
+    while (i < values.size()) {
+        size_t run = 1;
+        while (i + run < values.size() && values[i + run] == values[i]) run++;
+        writer.putSigned(values[i]);
+        writer.putVarint(run);
+        i += run;
+    }
+}
+
+static void decodeChunk(ByteReader& reader, ColumnEncoding encoding, std::vector<int64_t>& out) {
+    uint64_t count = reader.getVarint();
+    if (encoding == ColumnEncoding::BitPacked) {
+        int64_t minimum = reader.getSigned();
+        int width = reader.getU8();
+        if (width > 64) {
+            throw Uno::ResourceException("Column chunk has an invalid bit width");
+        }
+        BitUnpacker unpacker(reader);
+        for (uint64_t i = 0; i < count; ++i) {
+            out.push_back(static_cast<int64_t>(static_cast<uint64_t>(minimum) + unpacker.get(width)));
+        }
+    } else if (encoding == ColumnEncoding::RunLength) {
+        uint64_t decoded = 0;
+        while (decoded < count) {
+            int64_t value = reader.getSigned();
+            uint64_t run = reader.getVarint();
+            if (run == 0 || run > count - decoded) {
+                throw Uno::ResourceException("Column chunk has an invalid run length");
+            }
+            out.insert(out.end(), run, value);
+            decoded += run;
+        }
+    } else {
+        throw Uno::ResourceException("Column chunk has an unknown encoding");
+    }
+}
+
+ColumnarWriter::ColumnarWriter(const std::string& filePath, const std::vector<std::string>& names, int rowsPerGroup)
+    : path(filePath), columnNames(names), rowGroupSize(rowsPerGroup), offset(0), totalRows(0), closed(false) {
+    if (names.empty() || rowsPerGroup <= 0) {
+        throw Uno::InvalidInputException("Columnar file needs at least one column and a positive row group size");
+    }
+
+    out.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw Uno::ResourceException("Cannot open columnar file for writing: " + filePath);
+    }
+
+    columns.resize(names.size());
+    for (auto& column : columns) {
+        column.reserve(rowGroupSize);
+    }
+
+    out.write(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    offset = sizeof(COLUMNAR_MAGIC);
+}
+
+ColumnarWriter::~ColumnarWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Destructors must not throw; an unfinished file simply has no footer
+    }
+}
+
+void ColumnarWriter::appendRow(const int64_t* values) {
+    if (closed) {
+        throw Uno::GameStateException("Cannot append to a closed columnar file");
+    }
+    for (size_t c = 0; c < columns.size(); ++c) {
+        columns[c].push_back(values[c]);
+    }
+    totalRows++;
+    if ((int)columns[0].size() == rowGroupSize) {
+        flushRowGroup();
+    }
+}
+
+void ColumnarWriter::write(const std::vector<uint8_t>& bytes) {
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!out) {
+        throw Uno::ResourceException("Failed writing columnar file: " + path);
+    }
+    offset += bytes.size();
+}
+
+void ColumnarWriter::flushRowGroup() {
+    if (columns[0].empty()) return;
+
+    groupRows.push_back(columns[0].size());
+    for (auto& column : columns) {
+        // Encode both ways and keep the smaller chunk
+        encodeBitPacked(column, packed);
+        encodeRunLength(column, runs);
+        bool useRuns = runs.size() < packed.size();
+        const std::vector<uint8_t>& chunk = useRuns ? runs : packed;
+
+        chunks.push_back(ColumnChunk{offset, chunk.size(), useRuns ? ColumnEncoding::RunLength : ColumnEncoding::BitPacked});
+        write(chunk);
+        column.clear(); // Keeps capacity for the next group
+    }
+}
+
+void ColumnarWriter::close() {
+    if (closed) return;
+    closed = true;
+    flushRowGroup();
+
+    std::vector<uint8_t> footer;
+    ByteWriter writer(footer);
+    writer.putVarint(columnNames.size());
+    for (const auto& name : columnNames) {
+        writer.putString(name);
+    }
+    writer.putVarint(groupRows.size());
+    for (size_t g = 0; g < groupRows.size(); ++g) {
+        writer.putVarint(groupRows[g]);
+        for (size_t c = 0; c < columnNames.size(); ++c) {
+            const ColumnChunk& chunk = chunks[g * columnNames.size() + c];
+            writer.putVarint(chunk.offset);
+            writer.putVarint(chunk.size);
+            writer.putU8(static_cast<uint8_t>(chunk.encoding));
+        }
+    }
+    uint64_t footerOffset = offset;
+    writer.putU64(footerOffset);
+    writer.putBytes(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    write(footer);
+    out.close();
+}
+
+uint64_t ColumnarWriter::rowsWritten() const {
+    return totalRows;
+}
+
+uint64_t ColumnarWriter::bytesWritten() const {
+    return offset;
+}
+
+ColumnarReader::ColumnarReader(const std::string& filePath) : totalRows(0) {
+    in.open(filePath, std::ios::binary);
+    if (!in) {
+        throw Uno::ResourceException("Cannot open columnar file: " + filePath);
+    }
+
+    // Trailer: footer offset then magic
+    const int trailerSize = 8 + sizeof(COLUMNAR_MAGIC);
+    in.seekg(0, std::ios::end);
+    int64_t fileSize = in.tellg();
+    if (fileSize < (int64_t)sizeof(COLUMNAR_MAGIC) + trailerSize) {
+        throw Uno::ResourceException("Columnar file is too short (was the run interrupted?): " + filePath);
+    }
+    std::vector<uint8_t> trailer(trailerSize);
+    in.seekg(fileSize - trailerSize);
+    in.read(reinterpret_cast<char*>(trailer.data()), trailerSize);
+    if (memcmp(trailer.data() + 8, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0) {
+        throw Uno::ResourceException("Columnar file has no footer: " + filePath);
+    }
+    uint64_t footerOffset = ByteReader(trailer).getU64();
+    if (footerOffset >= (uint64_t)(fileSize - trailerSize)) {
+        throw Uno::ResourceException("Columnar file footer offset is invalid: " + filePath);
+    }
+
+    std::vector<uint8_t> footer(fileSize - trailerSize - footerOffset);
+    in.seekg(footerOffset);
+    in.read(reinterpret_cast<char*>(footer.data()), footer.size());
+
+    ByteReader reader(footer);
+    uint64_t columnCount = reader.getVarint();
+    for (uint64_t c = 0; c < columnCount; ++c) {
+        columnNames.push_back(reader.getString());
+    }
+    uint64_t groupCount = reader.getVarint();
+    for (uint64_t g = 0; g < groupCount; ++g) {
+        groupRows.push_back(reader.getVarint());
+        totalRows += groupRows.back();
+        for (uint64_t c = 0; c < columnCount; ++c) {
+            ColumnChunk chunk;
+            chunk.offset = reader.getVarint();
+            chunk.size = reader.getVarint();
+            chunk.encoding = static_cast<ColumnEncoding>(reader.getU8());
+            chunks.push_back(chunk);
+        }
+    }
+}
+
+const std::vector<std::string>& ColumnarReader::columns() const {
+    return columnNames;
+}
+
+uint64_t ColumnarReader::rowCount() const {
+    return totalRows;
+}
+
+int ColumnarReader::columnIndex(const std::string& name) const {
+    for (size_t c = 0; c < columnNames.size(); ++c) {
+        if (columnNames[c] == name) return c;
+    }
+    return -1;
+}
+
+void ColumnarReader::readColumn(const std::string& name, std::vector<int64_t>& out) {
+    int column = columnIndex(name);
+    if (column < 0) {
+        throw Uno::InvalidInputException("No such column: " + name);
+    }
+
+    std::vector<uint8_t> bytes;
+    for (size_t g = 0; g < groupRows.size(); ++g) {
+        const ColumnChunk& chunk = chunks[g * columnNames.size() + column];
+        bytes.resize(chunk.size);
+        in.seekg(chunk.offset);
+        in.read(reinterpret_cast<char*>(bytes.data()), chunk.size);
+        if (!in) {
+            throw Uno::ResourceException("Failed reading column chunk for " + name);
+        }
+        ByteReader reader(bytes);
+        decodeChunk(reader, chunk.encoding, out);
+    }
+}
@@ -0,0 +1,293 @@
+#include "../header/Compression.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include "../header/Protocol.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t MIN_MATCH = 3;
+static const int MAX_CHAIN = 4;  // Candidates tried per position; more gain about 1% for twice the time
+static const size_t MAX_PACKED_SIZE = MAX_FRAME_SIZE + MAX_FRAME_SIZE / 8 + 16; // All literals, with tokens
+
+// Typical frames as a fresh connection sees them, so its first frames already
+// have something to match. Built from the frames of recorded games; changing it
+// needs a new COMPRESSION_DICTIONARY.
+static const uint8_t DICTIONARY[] = {
+    0x05, 0x00, 0x06, 0x03, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xd7, 0xb6, 0x01,
+    0xe8, 0x02, 0x00, 0x02, 0x05, 0x00, 0x06, 0x03, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00,
+    0x08, 0x90, 0x9e, 0x05, 0xf8, 0x05, 0x00, 0x02, 0x05, 0x03, 0x06, 0x01, 0x14, 0x00, 0x00, 0x00,
+    0x10, 0x00, 0x00, 0x00, 0x08, 0xec, 0x89, 0x01, 0xbb, 0x12, 0x00, 0x03, 0x02, 0x00, 0x00, 0x06,
+    0x05, 0x07, 0x01, 0x00, 0x17, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00, 0x08, 0x98, 0xaa, 0x05,
+    0xda, 0x07, 0x00, 0x04, 0x02, 0x01, 0x02, 0x01, 0x02, 0x04, 0x06, 0x07, 0x07, 0xb0, 0x03, 0x17,
+    0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00, 0x08, 0xdf, 0xca, 0x01, 0x85, 0x01, 0x00, 0x04, 0x02,
+    0x01, 0x03, 0x01, 0x02, 0x06, 0x06, 0x05, 0x07, 0x30, 0x02, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00,
+    0x00, 0x00, 0x08, 0x82, 0xb4, 0x05, 0x9b, 0x17, 0x00, 0x02, 0x05, 0x01, 0x06, 0x03, 0x10, 0x00,
+    0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xb2, 0x8f, 0x06, 0x92, 0x05, 0x00, 0x02, 0x05, 0x00,
+    0x06, 0x01, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xd8, 0x8c, 0x02, 0xc4, 0x04,
+    0x00, 0x02, 0x05, 0x01, 0x06, 0x03, 0x0f, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x08, 0xc5,
+    0x40, 0x84, 0x03, 0x00, 0x02, 0x05, 0x01, 0x06, 0x01, 0x14, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+    0x00, 0x08, 0xfe, 0xe1, 0x02, 0xe7, 0x0b, 0x00, 0x03, 0x02, 0x03, 0x00, 0x06, 0x05, 0x07, 0x26,
+    0x00, 0x17, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00, 0x08, 0xa3, 0x94, 0x01, 0xc9, 0x06, 0x00,
+    0x04, 0x02, 0x03, 0x01, 0x01, 0x02, 0x06, 0x06, 0x07, 0x07, 0x20, 0x02, 0x17, 0x00, 0x00, 0x00,
+    0x13, 0x00, 0x00, 0x00, 0x08, 0x97, 0xe2, 0x03, 0xcc, 0x03, 0x00, 0x04, 0x02, 0x02, 0x03, 0x01,
+    0x01, 0x04, 0x06, 0x07, 0x07, 0xb0, 0x03, 0x14, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08,
+    0x82, 0xaf, 0x04, 0xdd, 0x03, 0x00, 0x03, 0x02, 0x02, 0x05, 0x06, 0x07, 0x07, 0xb0, 0x02, 0x13,
+    0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x08, 0xd3, 0xcb, 0x01, 0x3a, 0x00, 0x03, 0x02, 0x02,
+    0x03, 0x06, 0x07, 0x07, 0x38, 0x00, 0x51, 0x00, 0x00, 0x00, 0x4d, 0x00, 0x00, 0x00, 0x03, 0xcf,
+    0xce, 0x02, 0xd5, 0x0c, 0x03, 0x00, 0x01, 0x20, 0x02, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x32,
+    0x32, 0x31, 0x31, 0x1c, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x34, 0x30, 0x31, 0x30, 0x0c,
+    0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x34, 0x38, 0x38, 0x36, 0x12, 0x00, 0x00, 0x0e, 0x30,
+    0x02, 0x90, 0x01, 0xb0, 0x01, 0x90, 0x03, 0x29, 0x00, 0x39, 0x00, 0x09, 0x00, 0xb0, 0x00, 0xb0,
+    0x00, 0x10, 0x01, 0xb0, 0x03, 0x30, 0x03, 0x28, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x0d,
+    0x00, 0x00, 0x00, 0x08, 0xf8, 0x8f, 0x05, 0xba, 0x06, 0x00, 0x02, 0x01, 0x02, 0x01, 0x06, 0x07,
+    0x14, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08, 0xfa, 0xc4, 0x04, 0x87, 0x16, 0x00, 0x03,
+    0x02, 0x01, 0x00, 0x06, 0x05, 0x07, 0x39, 0x00, 0x34, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00,
+    0x03, 0x8f, 0x77, 0xe5, 0x0a, 0x03, 0x02, 0x01, 0x80, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d,
+    0x31, 0x37, 0x34, 0x36, 0x01, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x32, 0x38, 0x39, 0x39,
+    0x24, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x33, 0x36, 0x34, 0x30, 0x12, 0x00, 0x00, 0x00,
+    0x17, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00, 0x08, 0xa8, 0x89, 0x01, 0xd1, 0x10, 0x00, 0x04,
+    0x02, 0x02, 0x03, 0x01, 0x03, 0x04, 0x06, 0x05, 0x07, 0xb0, 0x03, 0x0d, 0x00, 0x00, 0x00, 0x09,
+    0x00, 0x00, 0x00, 0x08, 0xc7, 0x5e, 0xec, 0x08, 0x00, 0x01, 0x06, 0x01, 0x10, 0x00, 0x00, 0x00,
+    0x0c, 0x00, 0x00, 0x00, 0x08, 0x8c, 0xb5, 0x01, 0xaf, 0x03, 0x00, 0x02, 0x05, 0x01, 0x06, 0x03,
+    0x13, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x08, 0xf8, 0x46, 0xab, 0x04, 0x00, 0x03, 0x02,
+    0x00, 0x00, 0x06, 0x07, 0x07, 0x35, 0x00, 0x14, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x08,
+    0xf0, 0xdc, 0x05, 0xf8, 0x13, 0x00, 0x03, 0x02, 0x01, 0x00, 0x06, 0x07, 0x07, 0x11, 0x00, 0x49,
+    0x00, 0x00, 0x00, 0x45, 0x00, 0x00, 0x00, 0x03, 0xce, 0xe4, 0x02, 0xa6, 0x0b, 0x04, 0x00, 0x03,
+    0xb0, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x33, 0x35, 0x32, 0x38, 0x08, 0x00, 0x09, 0x6c,
+    0x6f, 0x61, 0x64, 0x2d, 0x34, 0x32, 0x37, 0x31, 0x0c, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d,
+    0x33, 0x35, 0x37, 0x31, 0x0e, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x31, 0x33, 0x34, 0x34,
+    0x06, 0x00, 0x00, 0x04, 0x00, 0x02, 0x12, 0x00, 0x04, 0x00, 0x00, 0x01, 0x14, 0x00, 0x00, 0x00,
+    0x10, 0x00, 0x00, 0x00, 0x08, 0xea, 0xe8, 0x05, 0xf8, 0x04, 0x00, 0x03, 0x02, 0x02, 0x00, 0x06,
+    0x07, 0x07, 0xa0, 0x02, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0x87, 0x93, 0x02,
+    0xc9, 0x0a, 0x00, 0x02, 0x05, 0x00, 0x06, 0x01, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00,
+    0x08, 0xd1, 0xdc, 0x05, 0xe8, 0x07, 0x00, 0x02, 0x05, 0x02, 0x06, 0x03, 0x10, 0x00, 0x00, 0x00,
+    0x0c, 0x00, 0x00, 0x00, 0x08, 0x87, 0xbd, 0x02, 0xa4, 0x04, 0x00, 0x02, 0x05, 0x02, 0x06, 0x01,
+    0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xe2, 0xf6, 0x04, 0xef, 0x06, 0x00, 0x02,
+    0x05, 0x01, 0x06, 0x03, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xd0, 0xff, 0x05,
+    0xfb, 0x13, 0x00, 0x02, 0x05, 0x01, 0x06, 0x03, 0x17, 0x00, 0x00, 0x00, 0x13, 0x00, 0x00, 0x00,
+    0x08, 0xe0, 0xd6, 0x03, 0xb5, 0x02, 0x00, 0x04, 0x02, 0x00, 0x03, 0x01, 0x03, 0x06, 0x06, 0x07,
+    0x07, 0x30, 0x02, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0x9f, 0xce, 0x05, 0xb8,
+    0x0e, 0x00, 0x02, 0x05, 0x01, 0x06, 0x03, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08,
+    0xb1, 0x8c, 0x03, 0xba, 0x11, 0x00, 0x02, 0x05, 0x03, 0x06, 0x01, 0x10, 0x00, 0x00, 0x00, 0x0c,
+    0x00, 0x00, 0x00, 0x08, 0xbd, 0xfd, 0x02, 0xae, 0x10, 0x00, 0x02, 0x05, 0x01, 0x06, 0x01, 0x41,
+    0x00, 0x00, 0x00, 0x3d, 0x00, 0x00, 0x00, 0x03, 0x84, 0xa7, 0x01, 0x85, 0x01, 0x03, 0x01, 0x03,
+    0x20, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d, 0x34, 0x36, 0x38, 0x34, 0x0c, 0x00, 0x09, 0x6c,
+    0x6f, 0x61, 0x64, 0x2d, 0x32, 0x32, 0x39, 0x36, 0x08, 0x00, 0x09, 0x6c, 0x6f, 0x61, 0x64, 0x2d,
+    0x34, 0x35, 0x30, 0x31, 0x06, 0x00, 0x00, 0x06, 0x80, 0x01, 0x38, 0x00, 0x00, 0x02, 0x00, 0x01,
+    0xb0, 0x01, 0x26, 0x00, 0x10, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x08, 0xf1, 0xb0, 0x04,
+    0x81, 0x0f, 0x00, 0x02, 0x05, 0x00, 0x06, 0x03, 0x14, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+    0x08, 0xae, 0xce, 0x01, 0x85, 0x08, 0x00, 0x03, 0x02, 0x00, 0x00, 0x06, 0x05, 0x07, 0x20, 0x01,
+};
+
+CompressionHistory::CompressionHistory() : position(0) {
+    memset(ring, 0, sizeof(ring));
+    append(DICTIONARY, sizeof(DICTIONARY));
+}
+
+void CompressionHistory::append(const uint8_t* bytes, size_t size) {
+    if (size > COMPRESSION_WINDOW) {
+        position += static_cast<uint32_t>(size - COMPRESSION_WINDOW);
+        bytes += size - COMPRESSION_WINDOW;
+        size = COMPRESSION_WINDOW;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        ring[position & (COMPRESSION_WINDOW - 1)] = bytes[i];
+        position++;
+    }
+}
+
+void CompressionHistory::saveState(ByteWriter& writer) const {
+    writer.putVarint(position);
+    writer.putBytes(ring, sizeof(ring));
+}
+
+void CompressionHistory::loadState(ByteReader& reader) {
+    position = static_cast<uint32_t>(reader.getVarint());
+    memcpy(ring, reader.getBytes(sizeof(ring)), sizeof(ring));
+}
+
+static uint32_t hashAt(uint8_t a, uint8_t b, uint8_t c) {
+    uint32_t key = a | (b << 8) | (c << 16);
+    return (key * 2654435761u) >> 22;
+}
+
+static void putLength(std::vector<uint8_t>& out, uint32_t extra) {
+    while (extra >= 0x80) {
+        out.push_back((extra & 0x7F) | 0x80);
+        extra >>= 7;
+    }
+    out.push_back(extra);
+}
+
+FramePacker::FramePacker() : hashed(0) {
+    memset(head, 0, sizeof(head));
+    memset(chain, 0, sizeof(chain));
+    if (position >= MIN_MATCH - 1) insertHashes(position - (MIN_MATCH - 1), nullptr, position);
+}
+
+// Adds every position from hashed up to end; bytes from frameStart on come from frame
+void FramePacker::insertHashes(uint32_t end, const uint8_t* frame, uint32_t frameStart) {
+    auto byteAt = [&](uint32_t offset) {
+        uint32_t inFrame = offset - frameStart;
+        return inFrame < 0x80000000u ? frame[inFrame] : at(offset);
+    };
+    for (; hashed != end; ++hashed) {
+        uint32_t hash = hashAt(byteAt(hashed), byteAt(hashed + 1), byteAt(hashed + 2));
+        uint32_t distance = head[hash] ? hashed - (head[hash] - 1) : 0;
+        chain[hashed & (COMPRESSION_WINDOW - 1)] = distance <= COMPRESSION_WINDOW ? static_cast<uint16_t>(distance) : 0;
+        head[hash] = hashed + 1;
+    }
+}
+
+void FramePacker::pack(const uint8_t* frame, size_t size, std::vector<uint8_t>& out) {
+    uint32_t frameStart = position;
+    uint32_t end = frameStart + static_cast<uint32_t>(size);
+    auto byteAt = [&](uint32_t offset) {
+        uint32_t inFrame = offset - frameStart;
+        return inFrame < size ? frame[inFrame] : at(offset);
+    };
+    size_t packedStart = out.size();
+
+    // Sequences: literals from literalStart up to a match at p
+    auto emit = [&](uint32_t literalStart, uint32_t p, uint32_t length, uint32_t distance) {
+        uint32_t literals = p - literalStart;
+        uint32_t matchCode = length ? length - MIN_MATCH : 0;
+        out.push_back(static_cast<uint8_t>((std::min<uint32_t>(literals, 15) << 4) | std::min<uint32_t>(matchCode, 15)));
+        if (literals >= 15) putLength(out, literals - 15);
+        out.insert(out.end(), frame + (literalStart - frameStart), frame + (p - frameStart));
+        if (length == 0) return;
+        putLength(out, distance);
+        if (matchCode >= 15) putLength(out, matchCode - 15);
+    };
+
+    uint32_t literalStart = frameStart;
+    uint32_t p = frameStart;
+    while (end - p >= MIN_MATCH) {
+        insertHashes(p, frame, frameStart);
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        uint32_t hash = hashAt(byteAt(p), byteAt(p + 1), byteAt(p + 2));
+        uint32_t candidate = head[hash];
+        for (int tries = 0; candidate != 0 && tries < MAX_CHAIN; ++tries) {
+            uint32_t from = candidate - 1;
+            uint32_t distance = p - from;
+            if (distance == 0 || distance > COMPRESSION_WINDOW) break;
+            uint32_t length = 0;
+            while (p + length != end && byteAt(from + length) == byteAt(p + length)) length++;
+            if (length > bestLength) {
+                bestLength = length;
+                bestDistance = distance;
+            }
+            uint16_t step = chain[from & (COMPRESSION_WINDOW - 1)];
+            candidate = step ? candidate - step : 0;
+        }
+        if (bestLength >= MIN_MATCH) {
+            emit(literalStart, p, bestLength, bestDistance);
+            p += bestLength;
+            literalStart = p;
+        } else {
+            p++;
+        }
+    }
+    if (literalStart != end) emit(literalStart, end, 0, 0);
+    uint32_t hashEnd = end - std::min<uint32_t>(end - frameStart, MIN_MATCH - 1);
+    if (hashEnd - hashed < 0x80000000u) insertHashes(hashEnd, frame, frameStart);
+    append(frame, size);
+
+    // Prefix the sequences with their size, now that it is known
+    uint8_t header[5];
+    size_t headerSize = 0;
+    for (uint32_t packed = static_cast<uint32_t>(out.size() - packedStart); ; packed >>= 7) {
+        header[headerSize++] = static_cast<uint8_t>(packed < 0x80 ? packed : (packed & 0x7F) | 0x80);
+        if (packed < 0x80) break;
+    }
+    out.insert(out.begin() + packedStart, header, header + headerSize);
+}
+
+void FramePacker::packFrames(const uint8_t* frames, size_t size, std::vector<uint8_t>& out) {
+    size_t offset = 0;
+    size_t frameSize;
+    while (offset < size && completeFrame(frames + offset, size - offset, frameSize)) {
+        pack(frames + offset, frameSize, out);
+        offset += frameSize;
+    }
+    if (offset != size) {
+        throw Uno::InvalidInputException("Only whole frames can be packed");
+    }
+}
+
+void FramePacker::loadState(ByteReader& reader) {
+    CompressionHistory::loadState(reader);
+    memset(head, 0, sizeof(head));
+    memset(chain, 0, sizeof(chain));
+    hashed = position - COMPRESSION_WINDOW;
+    insertHashes(position - (MIN_MATCH - 1), nullptr, position);
+}
+
+// Reads a varint from [in, end); false if it runs past end
+static bool readLength(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (in == end) return false;
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    throw Uno::InvalidInputException("Packed frame has an oversized length");
+}
+
+size_t FrameUnpacker::unpack(const uint8_t* data, size_t size, std::vector<uint8_t>& frame) {
+    const uint8_t* in = data;
+    uint32_t packedSize;
+    if (!readLength(in, data + size, packedSize)) return 0;
+    if (packedSize > MAX_PACKED_SIZE) {
+        throw Uno::InvalidInputException("Packed frame size " + std::to_string(packedSize) + " is out of range");
+    }
+    if (static_cast<size_t>(data + size - in) < packedSize) return 0;
+    const uint8_t* end = in + packedSize;
+
+    frame.clear();
+    uint32_t frameStart = position;
+    const char* malformed = "Packed frame is malformed";
+    while (in != end) {
+        uint8_t token = *in++;
+        uint32_t literals = token >> 4;
+        uint32_t extra;
+        if (literals == 15) {
+            if (!readLength(in, end, extra)) throw Uno::InvalidInputException(malformed);
+            literals += extra;
+        }
+        if (literals > static_cast<size_t>(end - in) || frame.size() + literals > MAX_FRAME_SIZE + 4) {
+            throw Uno::InvalidInputException(malformed);
+        }
+        frame.insert(frame.end(), in, in + literals);
+        in += literals;
+        if (in == end) {
+            if (token & 0x0F) throw Uno::InvalidInputException(malformed);
+            break;
+        }
+
+        uint32_t distance;
+        uint32_t length = (token & 0x0F) + MIN_MATCH;
+        if (!readLength(in, end, distance)) throw Uno::InvalidInputException(malformed);
+        if ((token & 0x0F) == 15) {
+            if (!readLength(in, end, extra)) throw Uno::InvalidInputException(malformed);
+            length += extra;
+        }
+        if (distance == 0 || distance > COMPRESSION_WINDOW || frame.size() + length > MAX_FRAME_SIZE + 4) {
+            throw Uno::InvalidInputException(malformed);
+        }
+        for (uint32_t i = 0; i < length; ++i) {
+            uint32_t from = frameStart + static_cast<uint32_t>(frame.size()) - distance;
+            uint32_t inFrame = from - frameStart;
+            frame.push_back(inFrame < frame.size() ? frame[inFrame] : at(from));
+        }
+    }
+
+    size_t frameSize;
+    if (!completeFrame(frame.data(), frame.size(), frameSize) || frameSize != frame.size()) {
+        throw Uno::InvalidInputException("Packed frame does not hold one frame");
+    }
+    append(frame.data(), frame.size());
+    return end - data;
+}
@@ -9,27 +9,82 @@
 #include "../header/DrawFourCard.h"
 #include "../header/DrawSixCard.h"
 #include "../header/DropTwoCard.h"
+#include "../header/Metrics.h"
+#include "../header/StateDelta.h"
+#include "../header/CardCode.h"
+#include "../header/ByteBuffer.h"
 #include <iostream>
 #include <ctime>
 #include <cstdlib>
 #include <algorithm>
 #include <random>
 
-Deck::Deck() {}
+Deck::Deck() : recorder(nullptr) {
+    rng.seed(std::random_device{}());
+}
+
+// Appends a pile's cards from bottom to top, leaving out the top skipTop cards
+static void appendPile(std::stack<Card*> pile, std::vector<Card*>& out, int skipTop = 0) {
+    for (int i = 0; i < skipTop && !pile.empty(); ++i) {
+        pile.pop();
+    }
+    size_t start = out.size();
+    while (!pile.empty()) {
+        out.push_back(pile.top());
+        pile.pop();
+    }
+    std::reverse(out.begin() + start, out.end());
+}
 
 Deck::~Deck() {
-    // Cleanup: Delete all cards in the drawPile and discardPile
+    clear();
+    for (auto& entry : spareCards) {
+        for (Card* card : entry.second) {
+            delete card;
+        }
+    }
+}
+
+void Deck::clear() {
     while (!drawPile.empty()) {
-        delete drawPile.top();
+        recycle(drawPile.top());
         drawPile.pop();
     }
 
     while (!discardPile.empty()) {
-        delete discardPile.top();
+        recycle(discardPile.top());
         discardPile.pop();
     }
 }
 
+static bool isWildKind(CardKind kind) {
+    return kind == CardKind::Wild || kind == CardKind::DrawFour;
+}
+
+Card* Deck::makeCard(CardCode code) {
+    if (code == NO_CARD) return nullptr;
+    CardKind kind = cardCodeKind(code);
+    CardColor color = cardCodeColor(code);
+    bool wild = isWildKind(kind);
+    if (color <= CardColor::NONE) {
+        auto found = spareCards.find(wild ? makeCardCode(kind, CardColor::NONE) : code);
+        if (found != spareCards.end() && !found->second.empty()) {
+            Card* card = found->second.back();
+            found->second.pop_back();
+            if (wild) card->setColor(color);
+            return card;
+        }
+    }
+    return decodeCard(code); // Throws for a code no card has
+}
+
+void Deck::recycle(Card* card) {
+    if (!card) return;
+    CardCode code = encodeCard(card);
+    CardKind kind = cardCodeKind(code);
+    spareCards[isWildKind(kind) ? makeCardCode(kind, CardColor::NONE) : code].push_back(card);
+}
+
 void Deck::initializeDeck() {
     addStandardUNODeck();  // Fill the deck with the standard UNO cards
 }
@@ -45,28 +100,28 @@ void Deck::addStandardUNODeck() {
 
     for (const auto& color : colors) {
         // One 0 card per color
-        drawPile.push(new NumberCard(0, color));
+        drawPile.push(makeCard(makeCardCode(CardKind::Number, color, 0)));
         
         // Two of each 1-9 cards per color
         for (int i = 1; i <= 9; ++i) {
-            drawPile.push(new NumberCard(i, color));
-            drawPile.push(new NumberCard(i, color));
+            drawPile.push(makeCard(makeCardCode(CardKind::Number, color, i)));
+            drawPile.push(makeCard(makeCardCode(CardKind::Number, color, i)));
         }
         
         // Two of each action card per color
         for (int i = 0; i < 2; ++i) {
-            drawPile.push(new SkipCard(color));
-            drawPile.push(new ReverseCard(color));
-            drawPile.push(new DrawTwoCard(color));
-            drawPile.push(new DrawSixCard(color));  // New card type
-            drawPile.push(new DropTwoCard(color));  // New card type
+            drawPile.push(makeCard(makeCardCode(CardKind::Skip, color)));
+            drawPile.push(makeCard(makeCardCode(CardKind::Reverse, color)));
+            drawPile.push(makeCard(makeCardCode(CardKind::DrawTwo, color)));
+            drawPile.push(makeCard(makeCardCode(CardKind::DrawSix, color)));  // New card type
+            drawPile.push(makeCard(makeCardCode(CardKind::DropTwo, color)));  // New card type
         }
     }
 
     // Add wild cards
     for (int i = 0; i < 4; ++i) {
-        drawPile.push(new WildCard());
-        drawPile.push(new DrawFourCard());
+        drawPile.push(makeCard(makeCardCode(CardKind::Wild, CardColor::NONE)));
+        drawPile.push(makeCard(makeCardCode(CardKind::DrawFour, CardColor::NONE)));
     }
 }
 
@@ -80,9 +135,7 @@ void Deck::shuffleDeck() {
     }
 
     // Shuffle using modern C++ random facilities
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(allCards.begin(), allCards.end(), g);
+    std::shuffle(allCards.begin(), allCards.end(), rng);
 
     // Push the shuffled cards back into the drawPile
     for (auto& card : allCards) {
@@ -96,10 +149,14 @@ Card* Deck::drawCard() {
             return nullptr; // No cards left in the game
         }
         reshuffleDiscardIntoDeck();
+        if (drawPile.empty()) {
+            return nullptr; // Only the discard top was left, so nothing to draw
+        }
     }
     
     Card* top = drawPile.top();
     drawPile.pop();
+    if (recorder) recorder->record(DeltaOpType::DrawPop, 0, 0, 0, nullptr, top);
     return top;
 }
 
@@ -109,9 +166,23 @@ bool Deck::isEmpty() const {
 
 void Deck::placeInDiscard(Card* card) {
     discardPile.push(card);
+    if (recorder) recorder->record(DeltaOpType::DiscardPush, 0, 0, 0, nullptr, card);
 }
 
 void Deck::reshuffleDiscardIntoDeck() {
+    // Remember both piles so the reshuffle can be undone
+    int offset = 0;
+    int drawCount = drawPile.size();
+    int discardCount = discardPile.empty() ? 0 : discardPile.size() - 1;
+    int rngIndex = 0;
+    if (recorder) {
+        offset = recorder->cards.size();
+        appendPile(drawPile, recorder->cards);
+        appendPile(discardPile, recorder->cards, 1);
+        rngIndex = recorder->rngStates.size();
+        recorder->rngStates.push_back(RngState{rng.engine, rng.draws});
+    }
+
     // Save the top card of the discard pile
     Card* topCard = nullptr;
     if (!discardPile.empty()) {
@@ -132,10 +203,19 @@ void Deck::reshuffleDiscardIntoDeck() {
     if (topCard) {
         discardPile.push(topCard);
     }
+
+    if (recorder) {
+        appendPile(drawPile, recorder->cards);
+        recorder->rngStates.push_back(RngState{rng.engine, rng.draws});
+        recorder->record(DeltaOpType::Reshuffle, offset, drawCount, discardCount);
+        recorder->ops.back().rngIndex = rngIndex;
+    }
+    Metrics::count(Counter::Reshuffles);
 }
 
 void Deck::returnCardToDeck(Card* card) {
     drawPile.push(card);
+    if (recorder) recorder->record(DeltaOpType::DrawPush, 0, 0, 0, nullptr, card);
 }
 
 Card* Deck::getTopDiscard() const {
@@ -143,4 +223,140 @@ Card* Deck::getTopDiscard() const {
         return discardPile.top();
     }
     return nullptr;
-}
\ No newline at end of file
+}
+
+void Deck::saveState(ByteWriter& out) const {
+    out.putU32(rng.seedValue);
+    out.putVarint(rng.draws);
+
+    std::vector<Card*> cards;
+    appendPile(drawPile, cards);
+    out.putVarint(cards.size());
+    for (Card* card : cards) {
+        out.putU16(encodeCard(card));
+    }
+
+    cards.clear();
+    appendPile(discardPile, cards);
+    out.putVarint(cards.size());
+    for (Card* card : cards) {
+        out.putU16(encodeCard(card));
+    }
+}
+
+// Reads a pile written bottom to top by saveState
+void Deck::loadPile(ByteReader& in, std::stack<Card*>& pile) {
+    uint64_t count = in.getVarint();
+    if (count > in.remaining() / 2) {
+        throw Uno::InvalidInputException("Snapshot pile size is larger than the snapshot");
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        Card* card = makeCard(in.getU16());
+        if (!card) {
+            throw Uno::CardException("Snapshot pile contains an empty card slot");
+        }
+        pile.push(card);
+    }
+}
+
+void Deck::loadState(ByteReader& in) {
+    clear(); // Whatever the deck held before goes to the spares
+
+    unsigned int seedValue = in.getU32();
+    uint64_t draws = in.getVarint();
+    loadPile(in, drawPile);
+    loadPile(in, discardPile);
+    rng.seed(seedValue, draws);
+}
+
+void Deck::seed(unsigned int value) {
+    rng.seed(value);
+}
+
+int Deck::randomInt(int bound) {
+    return std::uniform_int_distribution<int>(0, bound - 1)(rng);
+}
+
+void Deck::setRecorder(StateDelta* delta) {
+    recorder = delta;
+}
+
+void Deck::revertOp(const DeltaOp& op, const StateDelta& delta) {
+    switch (op.type) {
+        case DeltaOpType::DrawPop:
+            drawPile.push(op.card);
+            break;
+        case DeltaOpType::DrawPush:
+            drawPile.pop();
+            break;
+        case DeltaOpType::DiscardPush:
+            discardPile.pop();
+            break;
+        case DeltaOpType::Reshuffle: {
+            // Saved layout: draw pile before, discard pile before (without its top), draw pile after
+            Card* const* saved = delta.cards.data() + op.index;
+            Card* keep = nullptr;
+            if (!discardPile.empty()) {
+                keep = discardPile.top();
+                discardPile.pop();
+            }
+            while (!drawPile.empty()) {
+                drawPile.pop();
+            }
+            for (int i = 0; i < op.after; ++i) {
+                discardPile.push(saved[op.before + i]);
+            }
+            if (keep) {
+                discardPile.push(keep);
+            }
+            for (int i = 0; i < op.before; ++i) {
+                drawPile.push(saved[i]);
+            }
+            rng.engine = delta.rngStates[op.rngIndex].engine;
+            rng.draws = delta.rngStates[op.rngIndex].draws;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Deck::replayOp(const DeltaOp& op, const StateDelta& delta) {
+    switch (op.type) {
+        case DeltaOpType::DrawPop:
+            drawPile.pop();
+            break;
+        case DeltaOpType::DrawPush:
+            drawPile.push(op.card);
+            break;
+        case DeltaOpType::DiscardPush:
+            discardPile.push(op.card);
+            break;
+        case DeltaOpType::Reshuffle: {
+            // Rebuild the shuffled draw pile in the recorded order instead of shuffling again
+            Card* const* shuffled = delta.cards.data() + op.index + op.before + op.after;
+            Card* keep = nullptr;
+            if (!discardPile.empty()) {
+                keep = discardPile.top();
+                discardPile.pop();
+            }
+            for (int i = 0; i < op.after; ++i) {
+                discardPile.pop();
+            }
+            while (!drawPile.empty()) {
+                drawPile.pop();
+            }
+            for (int i = 0; i < op.before + op.after; ++i) {
+                drawPile.push(shuffled[i]);
+            }
+            if (keep) {
+                discardPile.push(keep);
+            }
+            rng.engine = delta.rngStates[op.rngIndex + 1].engine;
+            rng.draws = delta.rngStates[op.rngIndex + 1].draws;
+            break;
+        }
+        default:
+            break;
+    }
+}
@@ -0,0 +1,1753 @@
+#include "../header/EventLoop.h"
+#include "../header/Server.h"
+#include "../header/ServerTable.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include "../header/Metrics.h"
+#include "../header/MoveJournal.h"
+#include <algorithm>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int TIMER_TICK_MS = 10;
+
+static const size_t MAX_NAME_LENGTH = 32;
+static const uint64_t MAX_CLUSTER_NODES = 1024;
+static const int MAX_ID_TRIES = 256; // Each try has a 1/N chance of an id this node owns
+static const int LOAD_WINDOW_MS = 100;
+static const int CALM_WINDOWS = 10;      // How long load must stay low before shedding stops
+static const int64_t IDLE_WAIT_US = 50;  // A poll that waited this long for its first event found the loop caught up
+static const int SPECTATOR_DELAY_MS = 250; // How long spectator updates are held while overloaded
+static const uint64_t JOURNAL_RECORDS_PER_TABLE = 64; // Logged per hosted table before the journal is compacted
+static const uint64_t JOURNAL_MIN_RECORDS = 4096;
+
+static void appendText(std::vector<uint8_t>& out, ServerMessage type, const std::string& text) {
+    size_t start = beginFrame(out, static_cast<uint8_t>(type));
+    ByteWriter writer(out);
+    writer.putString(text);
+    finishFrame(out, start);
+}
+
+void Connection::sendFrames(const uint8_t* frames, size_t size) {
+    if (packer) {
+        packer->packFrames(frames, size, output);
+    } else {
+        output.insert(output.end(), frames, frames + size);
+    }
+}
+
+void Connection::queueShared(const SharedBytes& frame) {
+    if (packer) {
+        sendFrames(*frame);
+        return;
+    }
+    sealOutput();
+    queued.push_back(frame);
+}
+
+void Connection::sealOutput() {
+    if (outputStart == output.size()) return;
+    if (outputStart > 0) output.erase(output.begin(), output.begin() + outputStart);
+    queued.push_back(std::make_shared<const std::vector<uint8_t>>(std::move(output)));
+    output.clear();
+    outputStart = 0;
+}
+
+bool Connection::hasOutput() const {
+    return !queued.empty() || outputStart < output.size();
+}
+
+int Connection::gatherOutput(iovec* vectors, int maxVectors) const {
+    int count = 0;
+    size_t skip = queuedStart;
+    for (const SharedBytes& bytes : queued) {
+        if (count == maxVectors) return count;
+        vectors[count].iov_base = const_cast<uint8_t*>(bytes->data() + skip);
+        vectors[count].iov_len = bytes->size() - skip;
+        count++;
+        skip = 0;
+    }
+    if (count < maxVectors && outputStart < output.size()) {
+        vectors[count].iov_base = const_cast<uint8_t*>(output.data() + outputStart);
+        vectors[count].iov_len = output.size() - outputStart;
+        count++;
+    }
+    return count;
+}
+
+void Connection::consumeOutput(size_t sent) {
+    while (sent > 0 && !queued.empty()) {
+        size_t left = queued.front()->size() - queuedStart;
+        if (sent < left) {
+            queuedStart += sent;
+            return;
+        }
+        sent -= left;
+        queued.pop_front();
+        queuedStart = 0;
+    }
+    outputStart += sent;
+    if (outputStart == output.size()) {
+        output.clear();
+        outputStart = 0;
+    }
+}
+
+void Connection::clearOutput() {
+    queued.clear();
+    queuedStart = 0;
+    output.clear();
+    outputStart = 0;
+}
+
+EventLoop::EventLoop(Server& owner, int loopIndex, int listenSocket, IoBackendKind backend)
+    : server(owner), index(loopIndex), listenFd(listenSocket),
+      stopping(false), tables(static_cast<size_t>(std::max(owner.getConfig().maxTablesPerLoop, 0))),
+      nextTableSerial(0), seeds(std::random_device{}()), wakePending(false),
+      clockStart(std::chrono::steady_clock::now()), full(false), overloaded(false), working(false),
+      journalRecords(0), worstLagUs(0), deepestInbox(0), calmWindows(0) {
+    io.reset(createIoBackend(backend, *this, listenFd));
+    int timeoutMs = server.getConfig().turnTimeoutMs;
+    turnTicks = timeoutMs > 0 ? (timeoutMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS : 0;
+    int graceMs = server.getConfig().resumeGraceMs;
+    graceTicks = graceMs > 0 ? (graceMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS : 0;
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    join();
+    io.reset(); // Frees what the backend still holds before the connections go
+    for (auto& entry : connections) {
+        close(entry.second->fd);
+        delete entry.second;
+    }
+    close(listenFd);
+}
+
+void EventLoop::start() {
+    stopping = false; // Started again when a handoff falls through
+    thread = std::thread(&EventLoop::run, this);
+}
+
+void EventLoop::stop() {
+    stopping = true;
+    if (io) io->wake();
+}
+
+void EventLoop::join() {
+    if (thread.joinable()) thread.join();
+}
+
+int EventLoop::getIndex() const {
+    return index;
+}
+
+int EventLoop::getListenFd() const {
+    return listenFd;
+}
+
+// Only the first post after the loop last drained its inbox pays for a wake-up
+void EventLoop::post(LoopMessage message) {
+    Metrics::count(Counter::MessagesPosted); // In the poster's slot
+    inbox.push(std::move(message));
+    if (!wakePending.exchange(true, std::memory_order_acq_rel)) {
+        io->wake();
+    }
+}
+
+void EventLoop::run() {
+    Metrics::attachThread();
+    reportTables(); // Adopted ones included
+    Metrics::setGauge(Gauge::OpenConnections, static_cast<int64_t>(connections.size()));
+    behindSince = std::chrono::steady_clock::now();
+    windowEnd = behindSince + std::chrono::milliseconds(LOAD_WINDOW_MS);
+    for (;;) {
+        flushOutput();
+        auto polledAt = std::chrono::steady_clock::now();
+        if (stopping || !io->poll(timerWait())) break;
+        expireTimers();
+        measureLoad(polledAt);
+    }
+}
+
+void EventLoop::noteWork() {
+    if (working) return;
+    working = true;
+    workSince = std::chrono::steady_clock::now();
+}
+
+// Ends one poll's worth of work and, once a window is over, decides whether the loop is overloaded
+void EventLoop::measureLoad(std::chrono::steady_clock::time_point polledAt) {
+    auto now = std::chrono::steady_clock::now();
+    if (working) {
+        working = false;
+        // Work that was ready the moment the loop polled means it is still behind since it last waited
+        if (workSince - polledAt >= std::chrono::microseconds(IDLE_WAIT_US)) behindSince = workSince;
+        worstLagUs = std::max<int64_t>(worstLagUs, std::chrono::duration_cast<std::chrono::microseconds>(now - behindSince).count());
+    } else {
+        behindSince = now;
+    }
+    if (now < windowEnd) return;
+    windowEnd = now + std::chrono::milliseconds(LOAD_WINDOW_MS);
+
+    const ServerConfig& config = server.getConfig();
+    int64_t lagLimitUs = static_cast<int64_t>(config.overloadLagMs) * 1000;
+    size_t depthLimit = static_cast<size_t>(std::max(config.overloadQueueDepth, 0));
+    bool over = lagLimitUs > 0 && (worstLagUs > lagLimitUs || (depthLimit > 0 && deepestInbox > depthLimit));
+    bool calm = worstLagUs < lagLimitUs / 2 && (depthLimit == 0 || deepestInbox < depthLimit / 2);
+    worstLagUs = 0;
+    deepestInbox = 0;
+    calmWindows = calm ? calmWindows + 1 : 0;
+    if (over == overloaded.load(std::memory_order_relaxed)) return;
+    if (!over && calmWindows < CALM_WINDOWS) return;
+    overloaded.store(over, std::memory_order_relaxed);
+    Metrics::setGauge(Gauge::OverloadedLoops, over ? 1 : 0);
+}
+
+bool EventLoop::isOverloaded() const {
+    return overloaded.load(std::memory_order_relaxed);
+}
+
+bool EventLoop::isFull() const {
+    return full.load(std::memory_order_relaxed);
+}
+
+bool EventLoop::canHostTables() const {
+    return !isOverloaded() && !isFull();
+}
+
+void EventLoop::reportTables() {
+    full.store(tables.isFull(), std::memory_order_relaxed);
+    Metrics::setGauge(Gauge::ActiveTables, static_cast<int64_t>(tables.size()));
+    Metrics::setGauge(Gauge::TableMemory, static_cast<int64_t>(tables.memoryUsage()));
+}
+
+uint64_t EventLoop::currentTick() const {
+    auto elapsed = std::chrono::steady_clock::now() - clockStart;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / TIMER_TICK_MS;
+}
+
+int EventLoop::timerWait() const {
+    // An overloaded loop wakes at least once a window, so it notices the load is gone
+    int64_t limit = overloaded.load(std::memory_order_relaxed) ? LOAD_WINDOW_MS : -1;
+    int64_t ticks = turnTimers.ticksUntilNext();
+    if (ticks < 0) return static_cast<int>(limit);
+    auto due = clockStart + std::chrono::milliseconds((turnTimers.currentTick() + ticks) * TIMER_TICK_MS);
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()).count();
+    wait = std::max<int64_t>(wait, 0);
+    return static_cast<int>(limit >= 0 ? std::min(wait, limit) : wait);
+}
+
+void EventLoop::expireTimers() {
+    turnTimers.advance(currentTick(), [this](TimerNode* timer) {
+        noteWork();
+        TableEntry* entry = tables.find(timer->owner);
+        if (entry && timer == &entry->graceTimer) {
+            endGrace(timer->owner);
+        } else if (entry && timer == &entry->spectatorTimer) {
+            sendSpectatorBacklog(timer->owner, *entry);
+        } else {
+            timeOutTurn(timer->owner);
+        }
+    });
+}
+
+void EventLoop::onAccept(int fd) {
+    noteWork();
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    Connection* connection = new Connection();
+    connection->fd = fd;
+    connection->sessionId = server.newSessionId();
+    connection->name = "Player " + std::to_string(connection->sessionId);
+    connections[connection->sessionId] = connection;
+    io->attach(connection);
+    Metrics::count(Counter::Connections);
+    Metrics::setGauge(Gauge::OpenConnections, static_cast<int64_t>(connections.size()));
+}
+
+void EventLoop::onWake() {
+    noteWork();
+    runQueued();
+}
+
+bool EventLoop::runQueued() {
+    // Cleared before draining, so a post that lands after the drain wakes us again
+    wakePending.store(false, std::memory_order_release);
+    size_t ran = 0;
+    LoopMessage message;
+    while (inbox.pop(message)) {
+        execute(message);
+        Metrics::count(Counter::MessagesHandled);
+        ran++;
+    }
+    deepestInbox = std::max(deepestInbox, ran);
+    return ran > 0;
+}
+
+void EventLoop::onInput(Connection* connection) {
+    noteWork();
+    processInput(connection);
+}
+
+void EventLoop::onHangup(Connection* connection) {
+    noteWork();
+    closeConnection(connection);
+}
+
+void EventLoop::execute(LoopMessage& message) {
+    switch (message.command) {
+        case LoopCommand::JoinTable:
+            joinTable(message);
+            break;
+        case LoopCommand::PlayMove:
+            playMove(message);
+            break;
+        case LoopCommand::LeaveTable:
+            leaveTable(message);
+            break;
+        case LoopCommand::Detach:
+            detachSeat(message);
+            break;
+        case LoopCommand::CreateMatch:
+            createMatch(message);
+            break;
+        case LoopCommand::Watch:
+            watchTable(message);
+            break;
+        case LoopCommand::Unwatch:
+            unwatchTable(message);
+            break;
+        case LoopCommand::ClaimSeat:
+            claimSeat(message);
+            break;
+        case LoopCommand::AdoptTable:
+            adoptTable(message);
+            break;
+        case LoopCommand::Rebalance:
+            rebalance(message);
+            break;
+        case LoopCommand::Drain:
+            message.command = LoopCommand::Drained; // Everything the session sent before it is handled
+            sendToLoop(message.fromLoop, message);
+            break;
+        case LoopCommand::Seated:
+            handleSeated(message);
+            break;
+        case LoopCommand::Watching:
+            handleWatching(message);
+            break;
+        case LoopCommand::Matched:
+            handleMatched(message);
+            break;
+        case LoopCommand::Deliver:
+            handleDeliver(message);
+            break;
+        case LoopCommand::Broadcast:
+            handleBroadcast(message);
+            break;
+        case LoopCommand::Moved:
+            handleMoved(message);
+            break;
+        case LoopCommand::Drained:
+            handleDrained(message);
+            break;
+        case LoopCommand::Unplayed:
+            handleUnplayed(message);
+            break;
+    }
+}
+
+void EventLoop::sendToLoop(int loop, LoopMessage& message) {
+    if (loop == index) {
+        execute(message);
+    } else {
+        server.getLoop(loop).post(std::move(message));
+    }
+}
+
+void EventLoop::processInput(Connection* connection) {
+    try {
+        size_t frameSize;
+        while (connection->fd >= 0) {
+            const uint8_t* data = connection->input.data() + connection->inputStart;
+            size_t size = connection->input.size() - connection->inputStart;
+            if (connection->unpacker) {
+                size_t packedSize = connection->unpacker->unpack(data, size, unpacked);
+                if (packedSize == 0) break;
+                connection->inputStart += packedSize;
+                ByteReader frame(unpacked.data() + 4, unpacked.size() - 4);
+                handleFrame(connection, frame);
+            } else {
+                if (!completeFrame(data, size, frameSize)) break;
+                ByteReader frame(data + 4, frameSize - 4);
+                handleFrame(connection, frame);
+                connection->inputStart += frameSize;
+            }
+        }
+    } catch (const Uno::InvalidInputException& e) {
+        sendText(connection, ServerMessage::Error, e.what());
+        closeConnection(connection);
+        return;
+    }
+
+    // Drop consumed bytes once they make up most of the buffer
+    if (connection->inputStart == connection->input.size()) {
+        connection->input.clear();
+        connection->inputStart = 0;
+    } else if (connection->inputStart > connection->input.size() / 2) {
+        connection->input.erase(connection->input.begin(), connection->input.begin() + connection->inputStart);
+        connection->inputStart = 0;
+    }
+}
+
+void EventLoop::handleFrame(Connection* connection, ByteReader& frame) {
+    ClientMessage type = static_cast<ClientMessage>(frame.getU8());
+    switch (type) {
+        case ClientMessage::Hello: {
+            std::string name = frame.getString();
+            if (!name.empty()) connection->name = name.substr(0, MAX_NAME_LENGTH);
+            std::vector<uint8_t> welcome;
+            size_t start = beginFrame(welcome, static_cast<uint8_t>(ServerMessage::Welcome));
+            ByteWriter writer(welcome);
+            writer.putVarint(connection->sessionId);
+            finishFrame(welcome, start);
+            connection->sendFrames(welcome);
+            scheduleFlush(connection);
+            return;
+        }
+        case ClientMessage::CreateTable: {
+            int seats = frame.getU8();
+            int rating = frame.atEnd() ? 0 : static_cast<int>(std::min<uint64_t>(frame.getVarint(), MAX_RATING));
+            if (refuseIfBusy(connection) || refuseIfOverloaded(connection) || refuseIfFull(connection)) {
+                return;
+            } else if (seats < 2 || seats > MAX_SEATS) {
+                sendText(connection, ServerMessage::Error, "Tables need between 2 and 4 seats");
+            } else {
+                createTable(connection, seats, rating);
+            }
+            return;
+        }
+        case ClientMessage::JoinTable: {
+            uint64_t tableId = frame.getVarint();
+            if (refuseIfBusy(connection)) {
+                return;
+            } else if (tableId == 0) {
+                sendText(connection, ServerMessage::Error, "No such table");
+            } else {
+                connection->tableId = tableId;
+                connection->seat = NO_SEAT;
+                connection->movedTableId = 0;
+                routeToTable(connection, LoopCommand::JoinTable);
+            }
+            return;
+        }
+        case ClientMessage::Spectate: {
+            uint64_t tableId = frame.getVarint();
+            if (refuseIfBusy(connection)) {
+                return;
+            } else if (tableId == 0) {
+                sendText(connection, ServerMessage::Error, "No such table");
+            } else {
+                connection->tableId = tableId;
+                connection->seat = NO_SEAT;
+                connection->movedTableId = 0;
+                connection->spectating = true;
+                routeToTable(connection, LoopCommand::Watch);
+            }
+            return;
+        }
+        case ClientMessage::FindMatch: {
+            int seats = frame.getU8();
+            int rating = static_cast<int>(std::min<uint64_t>(frame.getVarint(), MAX_RATING));
+            if (refuseIfBusy(connection) || refuseIfOverloaded(connection)) {
+                return;
+            } else if (seats < 2 || seats > MAX_SEATS) {
+                sendText(connection, ServerMessage::Error, "Tables need between 2 and 4 seats");
+            } else {
+                connection->matchTicket = server.getMatchmaker().enqueue(
+                    connection->sessionId, index, connection->name, seats, rating);
+                connection->matchSeats = seats;
+                connection->matchRating = rating;
+            }
+            return;
+        }
+        case ClientMessage::ListTables: {
+            int seats = frame.getU8();
+            int rating = static_cast<int>(std::min<uint64_t>(frame.getVarint(), MAX_RATING));
+            uint64_t page = frame.getVarint();
+            connection->queueShared(server.getLobby().page(seats, rating, page)); // Shared with every reader of the page
+            scheduleFlush(connection);
+            return;
+        }
+        case ClientMessage::CancelMatch:
+            if (connection->matchTicket != 0) {
+                server.getMatchmaker().cancel(connection->sessionId);
+                connection->matchTicket = 0;
+            }
+            return;
+        case ClientMessage::PlayMove: {
+            Move move = readMove(frame);
+            if (connection->spectating) {
+                sendText(connection, ServerMessage::MoveRejected, "Spectators cannot play");
+            } else if (connection->seat == NO_SEAT && connection->movedTableId != 0) {
+                bounceMove(connection, move);
+            } else if (connection->seat == NO_SEAT) {
+                sendText(connection, ServerMessage::MoveRejected, "Not at a table");
+            } else {
+                routeToTable(connection, LoopCommand::PlayMove, move);
+            }
+            return;
+        }
+        case ClientMessage::LeaveTable:
+            if (connection->spectating) {
+                stopWatching(connection);
+            } else if (connection->tableId != 0) {
+                routeToTable(connection, LoopCommand::LeaveTable);
+                connection->tableId = 0;
+                connection->seat = NO_SEAT;
+            }
+            connection->movedTableId = 0;
+            return;
+        case ClientMessage::ClaimSeat: {
+            uint64_t tableId = frame.getVarint();
+            int seat = frame.getU8();
+            uint64_t token = frame.getU64();
+            uint64_t version = frame.getVarint();
+            if (refuseIfBusy(connection)) {
+                return;
+            } else if (tableId == 0) {
+                sendText(connection, ServerMessage::Error, "No such table");
+            } else {
+                connection->tableId = tableId;
+                connection->seat = NO_SEAT;
+                connection->movedTableId = 0;
+                LoopMessage message;
+                message.command = LoopCommand::ClaimSeat;
+                message.fromLoop = index;
+                message.sessionId = connection->sessionId;
+                message.tableId = tableId;
+                message.seat = seat;
+                message.ticket = token;
+                message.version = version;
+                sendToLoop(server.loopForTable(tableId).getIndex(), message);
+            }
+            return;
+        }
+        case ClientMessage::PeerHello: {
+            std::string key = frame.getString();
+            const std::string& expected = server.getConfig().clusterKey;
+            if (expected.empty() || key != expected) {
+                sendText(connection, ServerMessage::Error, "Not a node of that cluster");
+            } else {
+                connection->peer = true;
+            }
+            return;
+        }
+        case ClientMessage::SetRing: {
+            std::string name = frame.getString();
+            uint64_t count = frame.getVarint();
+            if (count > MAX_CLUSTER_NODES) {
+                throw Uno::InvalidInputException("Too many nodes in the ring");
+            }
+            std::vector<std::string> nodes;
+            for (uint64_t i = 0; i < count; ++i) {
+                nodes.push_back(frame.getString());
+            }
+            if (refuseUnlessPeer(connection)) return;
+            server.setRing(name, nodes);
+            for (int loop = 0; loop < server.loopCount(); ++loop) {
+                LoopMessage message;
+                message.command = LoopCommand::Rebalance;
+                message.fromLoop = index;
+                message.sessionId = connection->sessionId;
+                sendToLoop(loop, message);
+            }
+            return;
+        }
+        case ClientMessage::AdoptTable: {
+            size_t size = frame.getVarint();
+            const uint8_t* state = frame.getBytes(size);
+            uint64_t hop = frame.getVarint();
+            if (refuseUnlessPeer(connection)) return;
+            LoopMessage message;
+            message.command = LoopCommand::AdoptTable;
+            message.fromLoop = index;
+            message.sessionId = connection->sessionId;
+            message.bytes.assign(state, state + size);
+            message.version = hop;
+            ByteReader id(state, size);
+            message.tableId = id.getVarint();
+            sendToLoop(server.loopForTable(message.tableId).getIndex(), message);
+            return;
+        }
+        case ClientMessage::Ping: {
+            uint64_t token = frame.getU64();
+            std::vector<uint8_t> pong;
+            size_t start = beginFrame(pong, static_cast<uint8_t>(ServerMessage::Pong));
+            ByteWriter writer(pong);
+            writer.putU64(token);
+            finishFrame(pong, start);
+            connection->sendFrames(pong);
+            scheduleFlush(connection);
+            return;
+        }
+        case ClientMessage::UseCompression: {
+            int dictionary = frame.getU8();
+            if (dictionary != COMPRESSION_DICTIONARY) {
+                throw Uno::InvalidInputException("Unknown compression dictionary " + std::to_string(dictionary));
+            }
+            if (connection->packer) {
+                sendText(connection, ServerMessage::Error, "Compression is already on");
+                return;
+            }
+            // The answer goes out unpacked; everything after it is packed
+            finishFrame(connection->output, beginFrame(connection->output, static_cast<uint8_t>(ServerMessage::CompressionOn)));
+            connection->packer.reset(new FramePacker());
+            connection->unpacker.reset(new FrameUnpacker());
+            scheduleFlush(connection);
+            return;
+        }
+    }
+    throw Uno::InvalidInputException("Unknown message type " + std::to_string(static_cast<int>(type)));
+}
+
+// Sends a command about the connection's table to the shard that owns it
+void EventLoop::routeToTable(Connection* connection, LoopCommand command, const Move& move) {
+    LoopMessage message;
+    message.command = command;
+    message.fromLoop = index;
+    message.sessionId = connection->sessionId;
+    message.tableId = connection->tableId;
+    message.seat = connection->seat;
+    if (command == LoopCommand::JoinTable) message.name = connection->name;
+    message.move = move;
+    if (command == LoopCommand::PlayMove) message.readAt = std::chrono::steady_clock::now();
+    sendToLoop(server.loopForTable(connection->tableId).getIndex(), message);
+}
+
+void EventLoop::handleSeated(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return; // Closed; its LeaveTable is already queued behind the join
+    Connection* connection = found->second;
+    if (connection->tableId != message.tableId) return; // Left before the answer arrived
+
+    connection->seat = message.seat;
+    if (message.seat == NO_SEAT) {
+        connection->tableId = 0;
+        connection->spectating = false;
+    }
+    connection->sendFrames(message.bytes);
+    scheduleFlush(connection);
+}
+
+void EventLoop::handleDeliver(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return;
+    Connection* connection = found->second;
+    if (connection->tableId != message.tableId) return; // From a table it has left
+
+    connection->sendFrames(message.bytes);
+    scheduleFlush(connection);
+}
+
+void EventLoop::handleWatching(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return; // Closed; its Unwatch is already queued behind the watch
+    Connection* connection = found->second;
+    if (!connection->spectating || connection->tableId != message.tableId) return;
+
+    spectators[message.tableId].push_back(connection);
+    connection->sendFrames(message.bytes);
+    scheduleFlush(connection);
+}
+
+// Hands one update to every spectator of the table on this loop; they all queue the same buffer
+void EventLoop::handleBroadcast(LoopMessage& message) {
+    auto found = spectators.find(message.tableId);
+    if (found == spectators.end()) return;
+    for (Connection* connection : found->second) {
+        connection->queueShared(message.shared);
+        scheduleFlush(connection);
+    }
+}
+
+// A table formed for the search; if the player stopped looking, the seat is given up again.
+// Table id 0 means the loop picked to host it had no room, and the search is over.
+void EventLoop::handleMatched(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    Connection* connection = found == connections.end() ? nullptr : found->second;
+    if (message.tableId == 0) {
+        if (!connection || connection->matchTicket != message.ticket) return;
+        connection->matchTicket = 0;
+        connection->sendFrames(message.bytes);
+        scheduleFlush(connection);
+        return;
+    }
+    if (!connection || connection->matchTicket != message.ticket) {
+        LoopMessage leave;
+        leave.command = LoopCommand::LeaveTable;
+        leave.fromLoop = index;
+        leave.sessionId = message.sessionId;
+        leave.tableId = message.tableId;
+        // Queued even for this loop: the table may still be seating the rest of the match
+        server.loopForTable(message.tableId).post(std::move(leave));
+        return;
+    }
+    connection->matchTicket = 0;
+    connection->tableId = message.tableId;
+    connection->seat = message.seat;
+    connection->movedTableId = 0;
+    connection->sendFrames(message.bytes);
+    scheduleFlush(connection);
+}
+
+// Refuses a second table or search while one is going on
+bool EventLoop::refuseIfBusy(Connection* connection) {
+    if (connection->tableId != 0) {
+        sendText(connection, ServerMessage::Error, "Already at a table");
+        return true;
+    }
+    if (connection->matchTicket != 0) {
+        sendText(connection, ServerMessage::Error, "Already looking for a match");
+        return true;
+    }
+    return false;
+}
+
+// New tables and searches wait while the loop is overloaded; games under way go on
+bool EventLoop::refuseIfOverloaded(Connection* connection) {
+    if (!isOverloaded()) return false;
+    Metrics::count(Counter::Shed);
+    sendText(connection, ServerMessage::Busy, "The server is busy; try again in a moment");
+    return true;
+}
+
+// A table created by a player lives on the player's loop, so it needs room here
+bool EventLoop::refuseIfFull(Connection* connection) {
+    if (!tables.isFull()) return false;
+    Metrics::count(Counter::Shed);
+    sendText(connection, ServerMessage::Busy, "The server has no room for another table; try again in a moment");
+    return true;
+}
+
+bool EventLoop::refuseUnlessPeer(Connection* connection) {
+    if (connection->peer) return false;
+    sendText(connection, ServerMessage::Error, "Only the cluster router may do that");
+    return true;
+}
+
+// The session's table left this node (seat set), or its seat was taken back from it (NO_SEAT): it
+// hears why, and is free here again. A seat's TableMoved waits for the shard to answer the moves
+// already sent there, so none of them comes back after the notice (see handleUnplayed)
+void EventLoop::handleMoved(LoopMessage& message) {
+    if (message.sessionId == 0) {
+        auto found = spectators.find(message.tableId);
+        if (found == spectators.end()) return;
+        for (Connection* connection : found->second) {
+            connection->sendFrames(message.bytes);
+            connection->tableId = 0;
+            connection->spectating = false;
+            scheduleFlush(connection);
+        }
+        spectators.erase(found);
+        return;
+    }
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return;
+    Connection* connection = found->second;
+    if (connection->tableId != message.tableId) return;
+    connection->seat = NO_SEAT;
+    if (message.seat != NO_SEAT) {
+        connection->movedTableId = message.tableId; // Moves from now on are bounced here
+        message.command = LoopCommand::Drain;
+        message.fromLoop = index;
+        sendToLoop(server.loopForTable(message.tableId).getIndex(), message);
+        return;
+    }
+    connection->sendFrames(message.bytes);
+    connection->tableId = 0;
+    scheduleFlush(connection);
+}
+
+void EventLoop::handleDrained(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return;
+    Connection* connection = found->second;
+    if (connection->tableId != message.tableId) return; // Left meanwhile, and needs no notice
+    connection->sendFrames(message.bytes);
+    connection->tableId = 0;
+    scheduleFlush(connection);
+}
+
+// A move that reached the shard after its table was gone. If the table left
+// the node under the seat, the move goes back to be played where it went;
+// otherwise it is refused as any move from a player without a seat.
+void EventLoop::handleUnplayed(LoopMessage& message) {
+    auto found = connections.find(message.sessionId);
+    if (found == connections.end()) return;
+    Connection* connection = found->second;
+    if (connection->movedTableId == message.tableId) {
+        bounceMove(connection, message.move);
+    } else if (connection->tableId == message.tableId) {
+        sendText(connection, ServerMessage::MoveRejected, "Not at a table");
+    }
+}
+
+void EventLoop::bounceMove(Connection* connection, const Move& move) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ServerMessage::MoveBounced));
+    ByteWriter writer(frame);
+    writeMove(writer, move);
+    finishFrame(frame, start);
+    connection->sendFrames(frame);
+    scheduleFlush(connection);
+}
+
+void EventLoop::stopWatching(Connection* connection) {
+    auto found = spectators.find(connection->tableId);
+    if (found != spectators.end()) {
+        std::vector<Connection*>& watching = found->second;
+        for (size_t i = 0; i < watching.size(); ++i) {
+            if (watching[i] == connection) {
+                watching[i] = watching.back();
+                watching.pop_back();
+                break;
+            }
+        }
+        if (watching.empty()) spectators.erase(found);
+    }
+    routeToTable(connection, LoopCommand::Unwatch); // Sent even before Watching arrives, to undo the count
+    connection->tableId = 0;
+    connection->spectating = false;
+}
+
+// Table ids are chosen so that id % loop count names this loop and, in a
+// cluster, so that the ring gives them to this node. A node left out of the
+// ring owns nothing; it takes any id and moves the table out at the next rebalance.
+uint64_t EventLoop::newTableId() {
+    uint64_t id = ++nextTableSerial * server.loopCount() + index;
+    for (int tries = 1; tries < MAX_ID_TRIES && !server.ownsTable(id); ++tries) {
+        id = ++nextTableSerial * server.loopCount() + index;
+    }
+    return id;
+}
+
+void EventLoop::createTable(Connection* connection, int seats, int rating) {
+    uint64_t id = newTableId();
+    tables.create(id, seats).rating = rating; // Listed once the creator's seat is taken
+    reportTables();
+    connection->tableId = id;
+    connection->movedTableId = 0;
+    routeToTable(connection, LoopCommand::JoinTable); // Runs right here
+}
+
+void EventLoop::createMatch(const LoopMessage& message) {
+    if (tables.isFull()) {
+        refuseMatch(message);
+        return;
+    }
+    uint64_t id = newTableId();
+    TableEntry& entry = tables.create(id, static_cast<int>(message.match.size()));
+    reportTables();
+    for (const MatchTicket& player : message.match) {
+        int seat = entry.table->join(player.name);
+        entry.seats[seat].loop = player.loop;
+        entry.seats[seat].sessionId = player.sessionId;
+
+        LoopMessage reply;
+        reply.command = LoopCommand::Matched;
+        reply.sessionId = player.sessionId;
+        reply.tableId = id;
+        reply.seat = seat;
+        reply.ticket = player.ticket;
+        size_t start = beginFrame(reply.bytes, static_cast<uint8_t>(ServerMessage::TableJoined));
+        ByteWriter writer(reply.bytes);
+        writer.putVarint(id);
+        writer.putU8(seat);
+        finishFrame(reply.bytes, start);
+        appendResumable(reply.bytes, entry, seat);
+        sendToLoop(player.loop, reply);
+    }
+    entry.table->start(seeds());
+    journalTable(entry);
+    sendState(entry);
+}
+
+// The matchmaker picked this loop before it filled up; the players hear Busy and may search again
+void EventLoop::refuseMatch(const LoopMessage& message) {
+    for (const MatchTicket& player : message.match) {
+        LoopMessage reply;
+        reply.command = LoopCommand::Matched;
+        reply.sessionId = player.sessionId;
+        reply.tableId = 0;
+        reply.seat = NO_SEAT;
+        reply.ticket = player.ticket;
+        appendText(reply.bytes, ServerMessage::Busy, "The server has no room for another table; try again in a moment");
+        sendToLoop(player.loop, reply);
+    }
+    Metrics::count(Counter::Shed, message.match.size());
+}
+
+void EventLoop::joinTable(const LoopMessage& message) {
+    SeatRef seat;
+    seat.loop = message.fromLoop;
+    seat.sessionId = message.sessionId;
+
+    LoopMessage reply;
+    reply.command = LoopCommand::Seated;
+    reply.sessionId = message.sessionId;
+    reply.tableId = message.tableId;
+    reply.seat = NO_SEAT;
+
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) {
+        appendText(reply.bytes, ServerMessage::Error, "No such table");
+        sendToLoop(seat.loop, reply);
+        return;
+    }
+    TableEntry& entry = *found;
+    int taken = entry.table->join(message.name);
+    if (taken < 0) {
+        appendText(reply.bytes, ServerMessage::Error, "Table is full or already playing");
+        sendToLoop(seat.loop, reply);
+        return;
+    }
+    entry.seats[taken] = seat;
+
+    reply.seat = taken;
+    size_t start = beginFrame(reply.bytes, static_cast<uint8_t>(ServerMessage::TableJoined));
+    ByteWriter writer(reply.bytes);
+    writer.putVarint(message.tableId);
+    writer.putU8(taken);
+    finishFrame(reply.bytes, start);
+    appendResumable(reply.bytes, entry, taken);
+    sendToLoop(seat.loop, reply);
+
+    if (entry.table->occupiedSeats() == entry.table->getSeatCount()) {
+        entry.table->start(seeds());
+        journalTable(entry);
+    }
+    updateLobby(entry);
+    sendState(entry);
+}
+
+void EventLoop::playMove(const LoopMessage& message) {
+    SeatRef sender;
+    sender.loop = message.fromLoop;
+    sender.sessionId = message.sessionId;
+
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) {
+        LoopMessage unplayed; // The session's loop knows whether the table moved away under it
+        unplayed.command = LoopCommand::Unplayed;
+        unplayed.sessionId = message.sessionId;
+        unplayed.tableId = message.tableId;
+        unplayed.move = message.move;
+        sendToLoop(message.fromLoop, unplayed);
+        return;
+    }
+    if (message.seat < 0 || message.seat >= MAX_SEATS || found->seats[message.seat].sessionId != message.sessionId) {
+        std::vector<uint8_t> frames;
+        appendText(frames, ServerMessage::MoveRejected, "Not at a table");
+        sendTo(message.tableId, sender, frames);
+        return;
+    }
+    TableEntry& entry = *found;
+    try {
+        entry.table->applyMove(message.seat, message.move);
+    } catch (const Uno::UnoException& e) {
+        Metrics::count(Counter::MovesRejected);
+        std::vector<uint8_t> frames;
+        appendText(frames, ServerMessage::MoveRejected, e.what());
+        sendTo(message.tableId, sender, frames);
+        return;
+    }
+    journalMove(entry, message.move, message.seat);
+    sendState(entry);
+    if (entry.table->getStatus() == TableStatus::Finished) {
+        sendGameOver(entry);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - message.readAt;
+    Metrics::observeMoveLatency(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+}
+
+void EventLoop::leaveTable(const LoopMessage& message) {
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) return;
+
+    TableEntry& entry = *found;
+    int seat = NO_SEAT;
+    for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+        if (entry.seats[s].loop >= 0 && entry.seats[s].sessionId == message.sessionId) seat = s;
+    }
+    if (seat == NO_SEAT) return; // The join was refused
+    vacateSeat(entry, seat);
+}
+
+// Frees a seat for good; false if that closed the table
+bool EventLoop::vacateSeat(TableEntry& entry, int seat) {
+    bool wasPlaying = entry.table->getStatus() == TableStatus::Playing;
+    entry.table->leave(seat);
+    entry.seats[seat] = SeatRef();
+    entry.claimTokens[seat] = 0;
+    entry.graceUntil[seat] = 0;
+    updateLobby(entry);
+
+    if (entry.table->occupiedSeats() == 0) {
+        if (wasPlaying) journalEnd(entry.table->getId());
+        std::vector<uint8_t> frames;
+        appendText(frames, ServerMessage::Error, "The table was closed");
+        broadcast(entry.table->getId(), entry, frames);
+        turnTimers.cancel(&entry.turnTimer);
+        turnTimers.cancel(&entry.graceTimer);
+        turnTimers.cancel(&entry.spectatorTimer);
+        tables.erase(entry);
+        reportTables();
+        return false;
+    }
+    if (wasPlaying) {
+        sendGameOver(entry); // The game was abandoned
+    } else {
+        sendState(entry);
+    }
+    return true;
+}
+
+// A dropped player keeps a seat in a game under way for the grace period; the
+// turn timer plays for them meanwhile. Anywhere else the seat is simply left.
+void EventLoop::detachSeat(const LoopMessage& message) {
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) return;
+    TableEntry& entry = *found;
+    int seat = NO_SEAT;
+    for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+        if (entry.seats[s].loop >= 0 && entry.seats[s].sessionId == message.sessionId) seat = s;
+    }
+    if (seat == NO_SEAT) return; // Refused, or already claimed by a new connection
+    if (graceTicks == 0 || entry.table->getStatus() != TableStatus::Playing) {
+        vacateSeat(entry, seat);
+        return;
+    }
+    entry.seats[seat] = SeatRef();
+    entry.graceUntil[seat] = currentTick() + graceTicks;
+    armGraceTimer(entry);
+}
+
+// Gives the seat a fresh token and tells its player
+void EventLoop::appendResumable(std::vector<uint8_t>& frames, TableEntry& entry, int seat) {
+    uint64_t token = 0;
+    while (token == 0) {
+        token = (static_cast<uint64_t>(entropy()) << 32) | entropy();
+    }
+    entry.claimTokens[seat] = token;
+    size_t start = beginFrame(frames, static_cast<uint8_t>(ServerMessage::Resumable));
+    ByteWriter writer(frames);
+    writer.putVarint(entry.table->getId());
+    writer.putU8(seat);
+    writer.putU64(token);
+    finishFrame(frames, start);
+}
+
+void EventLoop::watchTable(const LoopMessage& message) {
+    LoopMessage reply;
+    reply.sessionId = message.sessionId;
+    reply.tableId = message.tableId;
+    reply.seat = NO_SEAT;
+
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) {
+        reply.command = LoopCommand::Seated;
+        appendText(reply.bytes, ServerMessage::Error, "No such table");
+        sendToLoop(message.fromLoop, reply);
+        return;
+    }
+    TableEntry& entry = *found;
+    sendSpectatorBacklog(message.tableId, entry); // The view below is newer than anything held
+    if (entry.spectators.empty()) entry.spectators.resize(server.loopCount(), 0);
+    entry.spectators[message.fromLoop]++;
+
+    reply.command = LoopCommand::Watching;
+    size_t start = beginFrame(reply.bytes, static_cast<uint8_t>(ServerMessage::TableJoined));
+    ByteWriter writer(reply.bytes);
+    writer.putVarint(message.tableId);
+    writer.putU8(NO_SEAT);
+    finishFrame(reply.bytes, start);
+    const std::vector<uint8_t>& view = entry.table->viewFrame(NO_SEAT);
+    reply.bytes.insert(reply.bytes.end(), view.begin(), view.end());
+    sendToLoop(message.fromLoop, reply);
+}
+
+void EventLoop::unwatchTable(const LoopMessage& message) {
+    TableEntry* found = tables.find(message.tableId);
+    if (!found) return;
+    std::vector<int>& counts = found->spectators;
+    if (message.fromLoop < static_cast<int>(counts.size()) && counts[message.fromLoop] > 0) {
+        counts[message.fromLoop]--;
+    }
+}
+
+// A player takes a seat back with its token: after a dropped connection, after
+// the table moved here from another node, or from a connection that has not
+// noticed it is dead yet, which then loses the seat. The player gets what it
+// missed since the version it last applied, as deltas when the table still has
+// them all.
+void EventLoop::claimSeat(const LoopMessage& message) {
+    SeatRef seat;
+    seat.loop = message.fromLoop;
+    seat.sessionId = message.sessionId;
+
+    LoopMessage reply;
+    reply.command = LoopCommand::Seated;
+    reply.sessionId = message.sessionId;
+    reply.tableId = message.tableId;
+    reply.seat = NO_SEAT;
+
+    TableEntry* found = tables.find(message.tableId);
+    if (!found || message.seat < 0 || message.seat >= found->table->getSeatCount() ||
+        found->claimTokens[message.seat] == 0 || found->claimTokens[message.seat] != message.ticket) {
+        appendText(reply.bytes, ServerMessage::Error, "No seat to claim");
+        sendToLoop(seat.loop, reply);
+        return;
+    }
+    TableEntry& entry = *found;
+    const SeatRef& previous = entry.seats[message.seat];
+    if (previous.loop >= 0 && previous.sessionId != seat.sessionId) {
+        LoopMessage ousted;
+        ousted.command = LoopCommand::Moved;
+        ousted.sessionId = previous.sessionId;
+        ousted.tableId = message.tableId;
+        appendText(ousted.bytes, ServerMessage::Error, "Your seat was taken back from another connection");
+        sendToLoop(previous.loop, ousted);
+    }
+    entry.seats[message.seat] = seat;
+    if (entry.graceUntil[message.seat] != 0) {
+        entry.graceUntil[message.seat] = 0;
+        armGraceTimer(entry);
+    }
+
+    reply.seat = message.seat;
+    appendResumable(reply.bytes, entry, message.seat);
+    journalTable(entry); // Recovery must know the new token
+    if (message.version == 0 || !entry.table->replayDeltas(message.seat, message.version, reply.bytes)) {
+        const std::vector<uint8_t>& view = entry.table->viewFrame(message.seat);
+        reply.bytes.insert(reply.bytes.end(), view.begin(), view.end());
+    }
+    sendToLoop(seat.loop, reply);
+}
+
+// A table that moved here from another node. Its seats stay empty until their
+// players claim them, but its turn clock runs from now.
+void EventLoop::adoptTable(const LoopMessage& message) {
+    SeatRef router;
+    router.loop = message.fromLoop;
+    router.sessionId = message.sessionId;
+
+    std::vector<uint8_t> frames;
+    bool adopted = false;
+    try {
+        if (tables.isFull()) {
+            throw Uno::ResourceException("This node has no room for another table");
+        }
+        ByteReader reader(message.bytes);
+        TableEntry& entry = tables.load(reader);
+        try {
+            for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+                entry.claimTokens[s] = reader.getU64();
+            }
+        } catch (const Uno::UnoException&) {
+            tables.erase(entry);
+            throw;
+        }
+        entry.hops = message.version;
+        const uint64_t* tokens = entry.claimTokens;
+        armTurnTimer(entry);
+        for (int s = 0; graceTicks > 0 && s < entry.table->getSeatCount(); ++s) {
+            if (tokens[s] != 0) entry.graceUntil[s] = currentTick() + graceTicks;
+        }
+        armGraceTimer(entry);
+        updateLobby(entry);
+        reportTables();
+        journalTable(entry);
+        adopted = true;
+    } catch (const Uno::UnoException& e) {
+        appendText(frames, ServerMessage::Error, "Cannot adopt table " + std::to_string(message.tableId) + ": " + e.what());
+    }
+    size_t start = beginFrame(frames, static_cast<uint8_t>(ServerMessage::TableAdopted));
+    ByteWriter writer(frames);
+    writer.putVarint(message.tableId);
+    writer.putU8(adopted ? 1 : 0);
+    writer.putVarint(message.version);
+    finishFrame(frames, start);
+    sendTo(0, router, frames);
+}
+
+// Moves out every table the ring now gives to another node: its state goes to
+// the router on the control link, and its players and spectators hear where it went
+void EventLoop::rebalance(const LoopMessage& message) {
+    SeatRef router;
+    router.loop = message.fromLoop;
+    router.sessionId = message.sessionId;
+
+    for (TableEntry& entry : tables) {
+        uint64_t id = entry.table->getId();
+        if (server.ownsTable(id)) continue;
+        ServerTable* table = entry.table;
+        const uint64_t* tokens = entry.claimTokens; // Players keep theirs; TableMoved repeats them
+        uint64_t hop = entry.hops + 1;
+
+        std::vector<uint8_t> state;
+        ByteWriter stateWriter(state);
+        table->saveState(stateWriter);
+        for (int s = 0; s < table->getSeatCount(); ++s) {
+            stateWriter.putU64(tokens[s]);
+        }
+        std::vector<uint8_t> exported;
+        size_t start = beginFrame(exported, static_cast<uint8_t>(ServerMessage::TableExport));
+        ByteWriter writer(exported);
+        writer.putVarint(state.size());
+        writer.putBytes(state.data(), state.size());
+        writer.putVarint(hop);
+        finishFrame(exported, start);
+        sendTo(0, router, exported);
+
+        for (int s = 0; s < table->getSeatCount(); ++s) {
+            if (entry.seats[s].loop < 0) continue;
+            LoopMessage moved;
+            moved.command = LoopCommand::Moved;
+            moved.sessionId = entry.seats[s].sessionId;
+            moved.tableId = id;
+            moved.seat = s;
+            size_t frame = beginFrame(moved.bytes, static_cast<uint8_t>(ServerMessage::TableMoved));
+            ByteWriter notice(moved.bytes);
+            notice.putVarint(id);
+            notice.putU8(s);
+            notice.putU64(tokens[s]);
+            notice.putVarint(hop);
+            finishFrame(moved.bytes, frame);
+            sendToLoop(entry.seats[s].loop, moved);
+        }
+        sendSpectatorBacklog(id, entry);
+        for (int loop = 0; loop < static_cast<int>(entry.spectators.size()); ++loop) {
+            if (entry.spectators[loop] == 0) continue;
+            LoopMessage moved;
+            moved.command = LoopCommand::Moved;
+            moved.tableId = id;
+            size_t frame = beginFrame(moved.bytes, static_cast<uint8_t>(ServerMessage::TableMoved));
+            ByteWriter notice(moved.bytes);
+            notice.putVarint(id);
+            notice.putU8(NO_SEAT);
+            notice.putU64(0);
+            notice.putVarint(hop);
+            finishFrame(moved.bytes, frame);
+            sendToLoop(loop, moved);
+        }
+
+        turnTimers.cancel(&entry.turnTimer);
+        turnTimers.cancel(&entry.graceTimer);
+        turnTimers.cancel(&entry.spectatorTimer);
+        if (entry.listed) server.getLobby().unlist(id);
+        if (table->getStatus() == TableStatus::Playing) journalEnd(id); // The next node journals it
+        tables.erase(entry); // Only marks the slot free, so the loop goes on from it
+    }
+    reportTables();
+}
+
+// Keeps the table's lobby listing current after its seats or status changed:
+// it is listed while some but not all seats are taken and the game has not begun
+void EventLoop::updateLobby(TableEntry& entry) {
+    ServerTable* table = entry.table;
+    int taken = table->occupiedSeats();
+    if (table->getStatus() == TableStatus::Waiting && taken > 0 && taken < table->getSeatCount()) {
+        LobbyTable listing;
+        listing.tableId = table->getId();
+        listing.seats = table->getSeatCount();
+        listing.taken = taken;
+        listing.rating = entry.rating;
+        server.getLobby().list(listing);
+        entry.listed = true;
+    } else if (entry.listed) {
+        server.getLobby().unlist(table->getId());
+        entry.listed = false;
+    }
+}
+
+// Serializes nothing per spectator: one shared copy of frames goes to each loop that has any
+void EventLoop::broadcast(uint64_t tableId, TableEntry& entry, const std::vector<uint8_t>& frames) {
+    if (!entry.spectatorBacklog.empty()) {
+        entry.spectatorBacklog.insert(entry.spectatorBacklog.end(), frames.begin(), frames.end());
+        sendSpectatorBacklog(tableId, entry); // Held updates go first, in the same message
+        return;
+    }
+    SharedBytes shared;
+    for (int loop = 0; loop < static_cast<int>(entry.spectators.size()); ++loop) {
+        if (entry.spectators[loop] == 0) continue;
+        if (!shared) shared = std::make_shared<const std::vector<uint8_t>>(frames);
+        LoopMessage message;
+        message.command = LoopCommand::Broadcast;
+        message.tableId = tableId;
+        message.shared = shared;
+        sendToLoop(loop, message);
+    }
+}
+
+// While the loop is overloaded spectators get their updates every SPECTATOR_DELAY_MS,
+// several moves to a message and a write, which leaves more of the loop to the players
+void EventLoop::sendSpectatorBacklog(uint64_t tableId, TableEntry& entry) {
+    turnTimers.cancel(&entry.spectatorTimer);
+    if (entry.spectatorBacklog.empty()) return;
+    std::vector<uint8_t> held;
+    held.swap(entry.spectatorBacklog);
+    broadcast(tableId, entry, held);
+}
+
+void EventLoop::sendTo(uint64_t tableId, const SeatRef& seat, std::vector<uint8_t>& frames) {
+    LoopMessage message;
+    message.command = LoopCommand::Deliver;
+    message.sessionId = seat.sessionId;
+    message.tableId = tableId;
+    message.bytes.swap(frames);
+    sendToLoop(seat.loop, message);
+}
+
+void EventLoop::sendText(Connection* connection, ServerMessage type, const std::string& text) {
+    std::vector<uint8_t> frame;
+    appendText(frame, type, text);
+    connection->sendFrames(frame);
+    scheduleFlush(connection);
+}
+
+void EventLoop::sendState(TableEntry& entry) {
+    armTurnTimer(entry);
+    for (int seat = 0; seat < entry.table->getSeatCount(); ++seat) {
+        if (entry.seats[seat].loop < 0) continue;
+        const std::vector<uint8_t>* update = entry.table->deltaFrame(seat);
+        if (!update) update = &entry.table->viewFrame(seat);
+        std::vector<uint8_t> frames(update->begin(), update->end());
+        sendTo(entry.table->getId(), entry.seats[seat], frames);
+    }
+    if (!entry.spectators.empty()) {
+        const std::vector<uint8_t>* update = entry.table->deltaFrame(NO_SEAT);
+        if (!update) update = &entry.table->viewFrame(NO_SEAT);
+        if (isOverloaded()) {
+            if (entry.spectatorBacklog.empty()) {
+                entry.spectatorTimer.owner = entry.table->getId();
+                turnTimers.schedule(&entry.spectatorTimer, currentTick() + SPECTATOR_DELAY_MS / TIMER_TICK_MS);
+            }
+            entry.spectatorBacklog.insert(entry.spectatorBacklog.end(), update->begin(), update->end());
+            Metrics::count(Counter::DelayedUpdates);
+        } else {
+            broadcast(entry.table->getId(), entry, *update);
+        }
+    }
+}
+
+void EventLoop::sendGameOver(TableEntry& entry) {
+    journalEnd(entry.table->getId());
+    turnTimers.cancel(&entry.turnTimer);
+    armGraceTimer(entry); // Held seats go once the players still here have heard
+    Metrics::count(Counter::GamesFinished);
+    std::vector<uint8_t> gameOver;
+    size_t start = beginFrame(gameOver, static_cast<uint8_t>(ServerMessage::GameOver));
+    ByteWriter writer(gameOver);
+    writer.putVarint(entry.table->getId());
+    writer.putSigned(entry.table->getWinnerSeat());
+    finishFrame(gameOver, start);
+
+    for (int seat = 0; seat < entry.table->getSeatCount(); ++seat) {
+        if (entry.seats[seat].loop < 0) continue;
+        std::vector<uint8_t> frames(gameOver);
+        sendTo(entry.table->getId(), entry.seats[seat], frames);
+    }
+    broadcast(entry.table->getId(), entry, gameOver);
+}
+
+void EventLoop::armTurnTimer(TableEntry& entry) {
+    if (turnTicks == 0) return;
+    if (entry.table->getStatus() == TableStatus::Playing) {
+        entry.turnTimer.owner = entry.table->getId();
+        turnTimers.schedule(&entry.turnTimer, currentTick() + turnTicks);
+    } else {
+        turnTimers.cancel(&entry.turnTimer);
+    }
+}
+
+// Plays out the turn of a seat that let its time run out: it draws if it has
+// not played or drawn yet, then the turn passes. Each step goes out on its own
+// so clients can follow with deltas.
+void EventLoop::timeOutTurn(uint64_t tableId) {
+    TableEntry* found = tables.find(tableId);
+    if (!found) return;
+    TableEntry& entry = *found;
+    ServerTable* table = entry.table;
+    if (table->getStatus() != TableStatus::Playing) return;
+
+    int seat = table->getCurrentSeat();
+    try {
+        if (!table->hasTakenTurnAction()) {
+            table->applyMove(seat, Move::draw());
+            journalMove(entry, Move::draw(), seat);
+            sendState(entry);
+        }
+        if (table->getStatus() == TableStatus::Playing && table->getCurrentSeat() == seat) {
+            table->applyMove(seat, Move::endTurn());
+            journalMove(entry, Move::endTurn(), seat);
+            sendState(entry);
+        }
+    } catch (const Uno::UnoException&) {
+        // The rules refused the automatic move; try again after another full timeout
+        armTurnTimer(entry);
+    }
+    if (table->getStatus() == TableStatus::Finished) {
+        sendGameOver(entry);
+    }
+}
+
+// Due at the earliest hold's end, or at once when the game is over and nobody
+// will come back for the seats
+void EventLoop::armGraceTimer(TableEntry& entry) {
+    uint64_t due = 0;
+    for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+        if (entry.graceUntil[s] != 0 && (due == 0 || entry.graceUntil[s] < due)) due = entry.graceUntil[s];
+    }
+    if (due == 0) {
+        turnTimers.cancel(&entry.graceTimer);
+        return;
+    }
+    if (entry.table->getStatus() != TableStatus::Playing) due = currentTick();
+    entry.graceTimer.owner = entry.table->getId();
+    turnTimers.schedule(&entry.graceTimer, due);
+}
+
+// Frees the held seats nobody claimed in time, which abandons the game
+void EventLoop::endGrace(uint64_t tableId) {
+    TableEntry* found = tables.find(tableId);
+    if (!found) return;
+    TableEntry& entry = *found;
+    uint64_t now = currentTick();
+    for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+        if (entry.graceUntil[s] == 0) continue;
+        if (entry.graceUntil[s] > now && entry.table->getStatus() == TableStatus::Playing) continue;
+        if (!vacateSeat(entry, s)) return;
+    }
+    armGraceTimer(entry);
+}
+
+std::string EventLoop::journalPath(const std::string& directory, int loopIndex) {
+    return directory + "/loop-" + std::to_string(loopIndex) + ".journal";
+}
+
+// What recovery needs besides the table itself: the seats' tokens, so the
+// players can claim them, and what the lobby and router know it by
+void EventLoop::saveJournaled(const TableEntry& entry, std::vector<uint8_t>& out) const {
+    ByteWriter writer(out);
+    entry.table->saveState(writer);
+    for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+        writer.putU64(entry.claimTokens[s]);
+    }
+    writer.putVarint(entry.rating);
+    writer.putVarint(entry.hops);
+}
+
+void EventLoop::journalTable(TableEntry& entry) {
+    if (!journal || entry.table->getStatus() != TableStatus::Playing) return;
+    journalState.clear();
+    saveJournaled(entry, journalState);
+    try {
+        journal->logSnapshot(entry.table->getId(), journalState);
+        journalRecords++;
+    } catch (const Uno::ResourceException&) {
+        dropJournal();
+    }
+}
+
+// A game that ended with the move is logged as ended instead
+void EventLoop::journalMove(TableEntry& entry, const Move& move, int seat) {
+    if (!journal || entry.table->getStatus() != TableStatus::Playing) return;
+    try {
+        journal->logMove(entry.table->getId(), move);
+        journalRecords++;
+    } catch (const Uno::ResourceException&) {
+        dropJournal();
+        return;
+    }
+    // Compacting at a turn boundary snapshots no game part way through a turn
+    if (entry.table->getCurrentSeat() != seat &&
+        journalRecords > JOURNAL_RECORDS_PER_TABLE * tables.size() + JOURNAL_MIN_RECORDS) {
+        compactJournal();
+    }
+}
+
+void EventLoop::journalEnd(uint64_t tableId) {
+    if (!journal) return;
+    try {
+        journal->logGameEnd(tableId);
+        journalRecords++;
+    } catch (const Uno::ResourceException&) {
+        dropJournal();
+    }
+}
+
+// The flusher writes the new journal; the loop only serializes the games.
+// Returns the LSN that is durable once it is in place
+uint64_t EventLoop::rewriteJournal() {
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> running;
+    for (const TableEntry& entry : tables) {
+        if (entry.table->getStatus() != TableStatus::Playing) continue;
+        running.emplace_back(entry.table->getId(), std::vector<uint8_t>());
+        saveJournaled(entry, running.back().second);
+    }
+    uint64_t lsn = journal->compactLater(running);
+    journalRecords = 0;
+    return lsn;
+}
+
+void EventLoop::compactJournal() {
+    try {
+        rewriteJournal();
+    } catch (const Uno::ResourceException&) {
+        dropJournal();
+    }
+}
+
+// The games go on unprotected rather than stop
+void EventLoop::dropJournal() {
+    journal.reset();
+    Metrics::count(Counter::JournalFailures);
+}
+
+void EventLoop::recoverTable(uint64_t tableId, const RecoveredGame& recovered) {
+    if (tables.find(tableId)) return; // Also left in a removed loop's journal by a crash during recovery
+    ByteReader reader(recovered.snapshot);
+    TableEntry& entry = tables.load(reader); // Even past the limit: none of them may be lost
+    ServerTable* table = entry.table;
+    try {
+        if (table->getId() != tableId) {
+            throw Uno::InvalidInputException("Journaled table has another id");
+        }
+        for (int s = 0; s < table->getSeatCount(); ++s) {
+            entry.claimTokens[s] = reader.getU64();
+        }
+        entry.rating = static_cast<int>(std::min<uint64_t>(reader.getVarint(), MAX_RATING));
+        entry.hops = reader.getVarint();
+        for (const JournalOp& op : recovered.ops) {
+            if (op.type != JournalRecordType::Move) {
+                throw Uno::InvalidInputException("Server journals hold no undo or redo");
+            }
+            table->applyMove(table->getCurrentSeat(), op.move); // Only the seat to move ever has one accepted
+        }
+        if (table->getStatus() != TableStatus::Playing) {
+            throw Uno::InvalidInputException("Journaled game is over but was not ended");
+        }
+    } catch (const Uno::UnoException&) {
+        tables.erase(entry);
+        throw;
+    }
+    // New tables of this loop must not take the id again
+    nextTableSerial = std::max<uint64_t>(nextTableSerial, tableId / server.loopCount());
+    armTurnTimer(entry);
+    for (int s = 0; graceTicks > 0 && s < table->getSeatCount(); ++s) {
+        if (entry.claimTokens[s] != 0) entry.graceUntil[s] = currentTick() + graceTicks;
+    }
+    armGraceTimer(entry);
+}
+
+void EventLoop::openJournal() {
+    journal.reset(); // Flushes the old one first, after a handoff that fell through
+    journal.reset(new MoveJournal(journalPath(server.getConfig().journalDir, index)));
+    journal->waitDurable(rewriteJournal());
+}
+
+void EventLoop::closeConnection(Connection* connection) {
+    if (connection->fd < 0) return;
+    connections.erase(connection->sessionId);
+    Metrics::setGauge(Gauge::OpenConnections, static_cast<int64_t>(connections.size()));
+    if (connection->matchTicket != 0) {
+        server.getMatchmaker().cancel(connection->sessionId);
+    }
+    if (connection->spectating) {
+        stopWatching(connection);
+    } else if (connection->tableId != 0) {
+        routeToTable(connection, LoopCommand::Detach); // The player may come back for the seat
+        connection->tableId = 0;
+    }
+    if (connection->flushPending) {
+        io->flush(connection); // Last words, such as the Error that closed it, still go out
+        connection->flushPending = false;
+        unflushed.erase(std::find(unflushed.begin(), unflushed.end(), connection));
+    }
+    io->release(connection); // Freed once the backend is done with it
+}
+
+void EventLoop::scheduleFlush(Connection* connection) {
+    if (connection->flushPending) return;
+    connection->flushPending = true;
+    unflushed.push_back(connection);
+}
+
+void EventLoop::flushOutput() {
+    for (Connection* connection : unflushed) {
+        connection->flushPending = false;
+        io->flush(connection);
+    }
+    unflushed.clear();
+}
+
+void EventLoop::quiesce() {
+    for (TableEntry& entry : tables) {
+        sendSpectatorBacklog(entry.table->getId(), entry); // Drained with the inboxes, before the export
+    }
+    io->quiesce();
+}
+
+void EventLoop::resume() {
+    std::vector<Connection*> open;
+    for (auto& entry : connections) {
+        open.push_back(entry.second);
+    }
+    io->resume(open);
+}
+
+// Runs after quiesce() and with every inbox drained, so nothing is in flight
+// between loops: each seat, spectator and search is settled on both sides.
+void EventLoop::exportState(ByteWriter& writer, std::vector<int>& fds) const {
+    writer.putVarint(nextTableSerial);
+    writer.putVarint(tables.size());
+    uint64_t now = currentTick();
+    for (const TableEntry& entry : tables) {
+        entry.table->saveState(writer);
+        for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+            writer.putSigned(entry.seats[s].loop);
+            writer.putVarint(entry.seats[s].sessionId);
+        }
+        writer.putVarint(entry.spectators.size());
+        for (int count : entry.spectators) {
+            writer.putVarint(count);
+        }
+        for (int s = 0; s < entry.table->getSeatCount(); ++s) {
+            writer.putU64(entry.claimTokens[s]);
+            uint64_t until = entry.graceUntil[s]; // Ticks left on the seat's hold, 0 for none
+            writer.putVarint(until == 0 ? 0 : (until > now ? until - now : 1));
+        }
+        // Ticks left on the turn clock, 0 when it is not running
+        uint64_t expires = entry.turnTimer.expires;
+        writer.putVarint(entry.turnTimer.isScheduled() ? (expires > now ? expires - now : 1) : 0);
+        writer.putVarint(entry.rating);
+        writer.putVarint(entry.hops);
+    }
+
+    writer.putVarint(connections.size());
+    for (const auto& found : connections) {
+        const Connection* connection = found.second;
+        writer.putVarint(fds.size());
+        fds.push_back(connection->fd);
+        writer.putVarint(connection->sessionId);
+        writer.putString(connection->name);
+        writer.putVarint(connection->tableId);
+        writer.putSigned(connection->seat);
+        writer.putU8(connection->spectating ? 1 : 0);
+        writer.putU8(connection->peer ? 1 : 0);
+        writer.putU8(connection->matchTicket != 0 ? connection->matchSeats : 0);
+        writer.putVarint(connection->matchRating);
+        // Both histories, so the peer's next packed frame still unpacks
+        writer.putU8(connection->packer ? 1 : 0);
+        if (connection->packer) {
+            connection->packer->saveState(writer);
+            connection->unpacker->saveState(writer);
+        }
+
+        size_t unread = connection->input.size() - connection->inputStart;
+        writer.putVarint(unread);
+        writer.putBytes(connection->input.data() + connection->inputStart, unread);
+        std::vector<iovec> unsent(connection->queued.size() + 1);
+        int count = connection->gatherOutput(unsent.data(), static_cast<int>(unsent.size()));
+        size_t total = 0;
+        for (int i = 0; i < count; ++i) {
+            total += unsent[i].iov_len;
+        }
+        writer.putVarint(total);
+        for (int i = 0; i < count; ++i) {
+            writer.putBytes(static_cast<const uint8_t*>(unsent[i].iov_base), unsent[i].iov_len);
+        }
+    }
+}
+
+void EventLoop::importState(ByteReader& reader, const std::vector<int>& fds) {
+    nextTableSerial = reader.getVarint();
+    uint64_t tableCount = reader.getVarint();
+    for (uint64_t t = 0; t < tableCount; ++t) {
+        TableEntry& entry = tables.load(reader); // Even past the limit: none of them may be lost
+        ServerTable* table = entry.table;
+        for (int s = 0; s < table->getSeatCount(); ++s) {
+            entry.seats[s].loop = static_cast<int>(reader.getSigned());
+            entry.seats[s].sessionId = reader.getVarint();
+        }
+        uint64_t loops = reader.getVarint();
+        if (loops != 0 && loops != static_cast<uint64_t>(server.loopCount())) {
+            throw Uno::InvalidInputException("Saved table counts spectators for another number of loops");
+        }
+        for (uint64_t loop = 0; loop < loops; ++loop) {
+            entry.spectators.push_back(static_cast<int>(reader.getVarint()));
+        }
+        for (int s = 0; s < table->getSeatCount(); ++s) {
+            entry.claimTokens[s] = reader.getU64();
+            uint64_t holdLeft = reader.getVarint();
+            if (holdLeft > 0) entry.graceUntil[s] = currentTick() + holdLeft;
+        }
+        armGraceTimer(entry);
+        uint64_t ticksLeft = reader.getVarint();
+        if (ticksLeft > 0 && turnTicks > 0 && table->getStatus() == TableStatus::Playing) {
+            entry.turnTimer.owner = table->getId();
+            turnTimers.schedule(&entry.turnTimer, currentTick() + std::min(ticksLeft, turnTicks));
+        } else {
+            armTurnTimer(entry);
+        }
+        entry.rating = static_cast<int>(std::min<uint64_t>(reader.getVarint(), MAX_RATING));
+        entry.hops = reader.getVarint();
+        updateLobby(entry);
+    }
+
+    uint64_t connectionCount = reader.getVarint();
+    for (uint64_t c = 0; c < connectionCount; ++c) {
+        uint64_t fdIndex = reader.getVarint();
+        if (fdIndex >= fds.size()) {
+            throw Uno::InvalidInputException("Saved connection refers to a missing socket");
+        }
+        Connection* connection = new Connection();
+        connection->fd = fds[fdIndex];
+        connection->sessionId = reader.getVarint();
+        connections[connection->sessionId] = connection;
+        connection->name = reader.getString();
+        connection->tableId = reader.getVarint();
+        connection->seat = static_cast<int>(reader.getSigned());
+        connection->spectating = reader.getU8() != 0;
+        connection->peer = reader.getU8() != 0;
+        int matchSeats = reader.getU8();
+        int matchRating = static_cast<int>(reader.getVarint());
+        if (reader.getU8() != 0) {
+            connection->packer.reset(new FramePacker());
+            connection->packer->loadState(reader);
+            connection->unpacker.reset(new FrameUnpacker());
+            connection->unpacker->loadState(reader);
+        }
+        size_t unread = reader.getVarint();
+        const uint8_t* input = reader.getBytes(unread);
+        connection->input.assign(input, input + unread);
+        size_t unsent = reader.getVarint();
+        const uint8_t* output = reader.getBytes(unsent);
+        connection->output.assign(output, output + unsent);
+
+        if (connection->spectating) spectators[connection->tableId].push_back(connection);
+        // The old process's matchmaker went with it, so the search starts over
+        if (matchSeats != 0) {
+            connection->matchTicket = server.getMatchmaker().enqueue(
+                connection->sessionId, index, connection->name, matchSeats, matchRating);
+            connection->matchSeats = matchSeats;
+            connection->matchRating = matchRating;
+        }
+        io->attach(connection);
+    }
+}
@@ -1,6 +1,6 @@
 #include <exception>
 #include <stdexcept>
-#include "..\header\Exceptions.h"
+#include "../header/Exceptions.h"
 
 namespace Uno
 {
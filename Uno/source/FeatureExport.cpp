@@ -0,0 +1,43 @@
+#include "../header/FeatureExport.h"
+
+static std::vector<std::string> featureColumns() {
+    return {"game", "turn", "seat", "hand_0", "hand_1", "hand_2", "hand_3",
+            "top_card", "top_color", "move_type", "move_card", "move_color",
+            "called_uno", "legal_moves", "reversed"};
+}
+
+TurnFeatureWriter::TurnFeatureWriter(const std::string& path)
+    : writer(path, featureColumns()) {}
+
+void TurnFeatureWriter::onTurn(const TurnRecord& record) {
+    int64_t row[] = {
+        record.game,
+        record.turn,
+        record.seat,
+        record.handSizes[0],
+        record.handSizes[1],
+        record.handSizes[2],
+        record.handSizes[3],
+        record.topCard,
+        static_cast<int64_t>(record.topColor),
+        static_cast<int64_t>(record.move.type),
+        record.moveCard == NO_CARD ? -1 : record.moveCard, // -1 for draws
+        static_cast<int64_t>(record.move.color),
+        record.calledUno,
+        record.legalMoves,
+        record.reversed
+    };
+    writer.appendRow(row);
+}
+
+void TurnFeatureWriter::close() {
+    writer.close();
+}
+
+uint64_t TurnFeatureWriter::rowsWritten() const {
+    return writer.rowsWritten();
+}
+
+uint64_t TurnFeatureWriter::bytesWritten() const {
+    return writer.bytesWritten();
+}
@@ -0,0 +1,543 @@
+#include "../header/GameClient.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Compression.h"
+#include "../header/Exceptions.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+typedef WSAPOLLFD PollEntry;
+static const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+typedef pollfd PollEntry;
+static const SocketHandle NO_SOCKET = -1;
+#endif
+
+static const size_t READ_CHUNK = 16 * 1024;
+static const int RESUME_ATTEMPTS = 6;       // Reconnects tried after a drop, RESUME_FIRST_DELAY_MS apart and doubling
+static const int RESUME_FIRST_DELAY_MS = 250;
+
+// Thin wrappers so the network thread reads the same on every platform
+static void closeSocket(SocketHandle socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static void setNonBlocking(SocketHandle socket) {
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(socket, FIONBIO, &on);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+// Resolves and connects, blocking; this only ever runs on the network thread
+static SocketHandle openConnection(const std::string& host, int port) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+        return NO_SOCKET;
+    }
+    SocketHandle result = NO_SOCKET;
+    for (addrinfo* address = found; address && result == NO_SOCKET; address = address->ai_next) {
+        SocketHandle candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (candidate == NO_SOCKET) continue;
+        if (::connect(candidate, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) {
+            result = candidate;
+        } else {
+            closeSocket(candidate);
+        }
+    }
+    freeaddrinfo(found);
+    if (result != NO_SOCKET) {
+        int noDelay = 1;
+        setsockopt(result, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        setNonBlocking(result);
+    }
+    return result;
+}
+
+GameClient::GameClient() : port(0), stopping(false), resumeToken(0), confirmedPlayed(false), predictedPlayed(false) {
+    wakeFds[0] = wakeFds[1] = -1;
+}
+
+GameClient::~GameClient() {
+    disconnect();
+}
+
+void GameClient::connect(const std::string& serverHost, int serverPort, const std::string& name) {
+    if (thread.joinable()) {
+        throw Uno::GameStateException("Client is already connected");
+    }
+    host = serverHost;
+    port = serverPort;
+    playerName = name;
+    stopping = false;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        state = RemoteTable();
+        resumeToken = 0;
+    }
+#ifndef _WIN32
+    if (pipe(wakeFds) != 0) {
+        throw Uno::ResourceException("Cannot create client wake-up pipe");
+    }
+    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+#endif
+
+    std::vector<uint8_t> hello;
+    size_t start = beginFrame(hello, static_cast<uint8_t>(ClientMessage::Hello));
+    ByteWriter writer(hello);
+    writer.putString(playerName);
+    finishFrame(hello, start);
+    outbox.push(std::move(hello)); // Goes out first, once connected
+
+    thread = std::thread(&GameClient::run, this);
+}
+
+void GameClient::disconnect() {
+    if (!thread.joinable()) return;
+    stopping = true;
+    wake();
+    thread.join();
+#ifndef _WIN32
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+#endif
+    std::vector<uint8_t> unsent;
+    while (outbox.pop(unsent)) {
+    }
+}
+
+void GameClient::wake() {
+#ifndef _WIN32
+    char byte = 1;
+    if (write(wakeFds[1], &byte, 1) < 0) {
+        // A full pipe already wakes the thread
+    }
+#endif
+}
+
+void GameClient::queue(std::vector<uint8_t>& frame) {
+    outbox.push(std::move(frame));
+    wake();
+}
+
+void GameClient::createTable(int seats, int rating) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::CreateTable));
+    ByteWriter writer(frame);
+    writer.putU8(seats);
+    writer.putVarint(rating);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::joinTable(uint64_t tableId) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::JoinTable));
+    ByteWriter writer(frame);
+    writer.putVarint(tableId);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::spectate(uint64_t tableId) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::Spectate));
+    ByteWriter writer(frame);
+    writer.putVarint(tableId);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::findMatch(int seats, int rating) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::FindMatch));
+    ByteWriter writer(frame);
+    writer.putU8(seats);
+    writer.putVarint(rating);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::cancelMatch() {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::CancelMatch));
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::listTables(int seats, int rating, uint64_t page) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::ListTables));
+    ByteWriter writer(frame);
+    writer.putU8(seats);
+    writer.putVarint(rating);
+    writer.putVarint(page);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::sendMove(const Move& move) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!state.hasView) {
+            throw Uno::GameStateException("Table is not running a game");
+        }
+        TableView view = state.view;
+        bool played = predictedPlayed;
+        predictMove(view, move, played);
+        state.view = view;
+        predictedPlayed = played;
+        pendingMoves.push_back(move);
+        state.pendingMoves = static_cast<int>(pendingMoves.size());
+        state.version++;
+    }
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::PlayMove));
+    ByteWriter writer(frame);
+    writeMove(writer, move);
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+void GameClient::leaveTable() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        resumeToken = 0; // The seat is given up, so a drop from here on is not resumed
+    }
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::LeaveTable));
+    finishFrame(frame, start);
+    queue(frame);
+}
+
+bool GameClient::sync(RemoteTable& table) {
+    std::unique_lock<std::mutex> lock(stateMutex, std::try_to_lock);
+    if (!lock.owns_lock() || state.version == table.version) return false;
+
+    std::vector<std::string> earlier;
+    earlier.swap(table.notices); // Notices the caller has not shown yet stay in front
+    std::vector<std::string> fresh;
+    fresh.swap(state.notices);
+    table = state;
+    table.notices.swap(earlier);
+    table.notices.insert(table.notices.end(), fresh.begin(), fresh.end());
+    return true;
+}
+
+void GameClient::fail(const std::string& reason) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    state.status = ClientStatus::Disconnected;
+    state.disconnectReason = reason;
+    state.version++;
+}
+
+void GameClient::run() {
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        fail("Networking is not available");
+        return;
+    }
+#endif
+    SocketHandle socket = openConnection(host, port);
+    if (socket == NO_SOCKET) {
+        fail("Cannot connect to " + host + ":" + std::to_string(port));
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            state.status = ClientStatus::Connected;
+            state.version++;
+        }
+        std::vector<uint8_t> greeting; // Hello is already first in the outbox
+        for (;;) {
+            std::string reason = exchange(static_cast<intptr_t>(socket), std::move(greeting));
+            closeSocket(socket);
+            if (reason.empty()) break;
+            greeting.clear();
+            socket = static_cast<SocketHandle>(resume(reason, greeting));
+            if (socket == NO_SOCKET) {
+                if (!stopping) fail(reason);
+                break;
+            }
+        }
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Moves bytes both ways, starting with greeting, until the server hangs up or disconnect() is called.
+// Every connection asks for compression first and packs all it sends after that.
+std::string GameClient::exchange(intptr_t handle, std::vector<uint8_t> greeting) {
+    SocketHandle socket = static_cast<SocketHandle>(handle);
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    size_t outputStart = 0;
+    std::vector<uint8_t> frame;
+    std::unique_ptr<FramePacker> packer(new FramePacker());
+    std::unique_ptr<FrameUnpacker> unpacker(new FrameUnpacker());
+    bool unpacking = false; // The server's frames are packed after its CompressionOn
+
+    size_t start = beginFrame(output, static_cast<uint8_t>(ClientMessage::UseCompression));
+    ByteWriter writer(output);
+    writer.putU8(COMPRESSION_DICTIONARY);
+    finishFrame(output, start);
+    packer->packFrames(greeting.data(), greeting.size(), output);
+
+    while (!stopping) {
+        while (outbox.pop(frame)) {
+            packer->packFrames(frame.data(), frame.size(), output);
+        }
+        while (outputStart < output.size()) {
+            int sent = static_cast<int>(send(socket, reinterpret_cast<const char*>(output.data() + outputStart),
+                                             static_cast<int>(output.size() - outputStart), 0));
+            if (sent > 0) {
+                outputStart += sent;
+            } else if (sent < 0 && wouldBlock()) {
+                break;
+            } else {
+                return "Lost connection to the server";
+            }
+        }
+        if (outputStart == output.size()) {
+            output.clear();
+            outputStart = 0;
+        }
+
+        PollEntry entries[2];
+        memset(entries, 0, sizeof(entries));
+        entries[0].fd = socket;
+        entries[0].events = POLLIN | (output.empty() ? 0 : POLLOUT);
+#ifdef _WIN32
+        // Windows has no pipe to poll, so queued commands wait at most one short timeout
+        int ready = WSAPoll(entries, 1, 10);
+#else
+        entries[1].fd = wakeFds[0];
+        entries[1].events = POLLIN;
+        int ready = poll(entries, 2, -1);
+        if (entries[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+#endif
+        if (ready < 0 && !wouldBlock()) {
+            return "Lost connection to the server";
+        }
+        if (!(entries[0].revents & (POLLIN | POLLERR | POLLHUP))) continue;
+
+        for (;;) {
+            size_t used = input.size();
+            input.resize(used + READ_CHUNK);
+            int received = static_cast<int>(recv(socket, reinterpret_cast<char*>(input.data() + used),
+                                                 static_cast<int>(READ_CHUNK), 0));
+            input.resize(used + (received > 0 ? received : 0));
+            if (received > 0) continue;
+            if (received < 0 && wouldBlock()) break;
+            return received == 0 ? "The server closed the connection" : "Lost connection to the server";
+        }
+
+        try {
+            size_t consumed = 0;
+            size_t frameSize;
+            while (consumed < input.size()) {
+                if (unpacking) {
+                    size_t packedSize = unpacker->unpack(input.data() + consumed, input.size() - consumed, frame);
+                    if (packedSize == 0) break;
+                    ByteReader reader(frame.data() + 4, frame.size() - 4);
+                    handleFrame(reader);
+                    consumed += packedSize;
+                } else {
+                    if (!completeFrame(input.data() + consumed, input.size() - consumed, frameSize)) break;
+                    ByteReader reader(input.data() + consumed + 4, frameSize - 4);
+                    if (input[consumed + 4] == static_cast<uint8_t>(ServerMessage::CompressionOn)) {
+                        unpacking = true;
+                    } else {
+                        handleFrame(reader);
+                    }
+                    consumed += frameSize;
+                }
+            }
+            input.erase(input.begin(), input.begin() + consumed);
+        } catch (const Uno::InvalidInputException& e) {
+            fail(std::string("Bad message from the server: ") + e.what());
+            return "";
+        }
+    }
+    return "";
+}
+
+// Only a game under way holds the seat, so anything else ends with the drop.
+// Frames still in the outbox go out after the claim.
+intptr_t GameClient::resume(const std::string& reason, std::vector<uint8_t>& greeting) {
+    uint64_t tableId;
+    int seat;
+    uint64_t token;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        bool underway = state.hasView && (state.view.flags & VIEW_STARTED) && !(state.view.flags & VIEW_FINISHED);
+        if (resumeToken == 0 || !underway || state.gameOver || state.seat == NO_SEAT) {
+            return static_cast<intptr_t>(NO_SOCKET);
+        }
+        tableId = state.tableId;
+        seat = state.seat;
+        token = resumeToken;
+        version = confirmedView.version;
+        // Moves lost with the connection are not coming back; those that went through are in the replay
+        pendingMoves.clear();
+        reconcile();
+        state.status = ClientStatus::Reconnecting;
+        state.disconnectReason = reason;
+        state.version++;
+    }
+
+    int delayMs = RESUME_FIRST_DELAY_MS;
+    for (int attempt = 0; attempt < RESUME_ATTEMPTS && !stopping; ++attempt) {
+        SocketHandle socket = openConnection(host, port);
+        if (socket != NO_SOCKET) {
+            size_t start = beginFrame(greeting, static_cast<uint8_t>(ClientMessage::Hello));
+            ByteWriter hello(greeting);
+            hello.putString(playerName);
+            finishFrame(greeting, start);
+            start = beginFrame(greeting, static_cast<uint8_t>(ClientMessage::ClaimSeat));
+            ByteWriter claim(greeting);
+            claim.putVarint(tableId);
+            claim.putU8(seat);
+            claim.putU64(token);
+            claim.putVarint(version);
+            finishFrame(greeting, start);
+
+            std::lock_guard<std::mutex> lock(stateMutex);
+            state.status = ClientStatus::Connected;
+            state.version++;
+            return static_cast<intptr_t>(socket);
+        }
+        for (int waited = 0; waited < delayMs && !stopping; waited += 50) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Short steps so disconnect() is not held up
+        }
+        delayMs *= 2;
+    }
+    return static_cast<intptr_t>(NO_SOCKET);
+}
+
+// Applies one server message to the shared state
+void GameClient::handleFrame(ByteReader& frame) {
+    ServerMessage type = static_cast<ServerMessage>(frame.getU8());
+    std::lock_guard<std::mutex> lock(stateMutex);
+    switch (type) {
+        case ServerMessage::Welcome:
+            state.sessionId = frame.getVarint();
+            break;
+        case ServerMessage::TableJoined:
+            state.tableId = frame.getVarint();
+            state.seat = frame.getU8();
+            state.hasView = false;
+            state.gameOver = false;
+            state.winnerSeat = -1;
+            pendingMoves.clear();
+            confirmedPlayed = false;
+            break;
+        case ServerMessage::TableState:
+        case ServerMessage::TableDelta: {
+            // Only this seat moves during its turn, so an update then answers its oldest move
+            bool answers = state.hasView && confirmedView.currentSeat == state.seat;
+            if (type == ServerMessage::TableState) {
+                readTableView(frame, confirmedView);
+                state.hasView = true;
+            } else if (!state.hasView || !applyTableDelta(frame, confirmedView)) {
+                return; // A delta that does not follow the view is skipped; the next full view catches up
+            }
+            if (answers) settleMove(true);
+            if (confirmedView.currentSeat != state.seat || !(confirmedView.flags & VIEW_TURN_ACTION)) {
+                confirmedPlayed = false;
+            }
+            reconcile();
+            break;
+        }
+        case ServerMessage::MoveRejected:
+            settleMove(false);
+            reconcile();
+            state.notices.push_back(frame.getString());
+            break;
+        case ServerMessage::Error:
+        case ServerMessage::Busy:
+            state.notices.push_back(frame.getString());
+            break;
+        case ServerMessage::GameOver:
+            frame.getVarint();
+            state.winnerSeat = static_cast<int>(frame.getSigned());
+            state.gameOver = true;
+            resumeToken = 0;
+            break;
+        case ServerMessage::Resumable:
+            frame.getVarint();
+            frame.getU8();
+            resumeToken = frame.getU64();
+            return;
+        case ServerMessage::Pong:
+            return;
+        case ServerMessage::TableList:
+            readTableList(frame, state.lobby);
+            break;
+        default:
+            throw Uno::InvalidInputException("Unknown message type " + std::to_string(static_cast<int>(type)));
+    }
+    state.version++;
+}
+
+void GameClient::settleMove(bool applied) {
+    if (pendingMoves.empty()) return;
+    if (applied && pendingMoves.front().type == MoveType::Play) confirmedPlayed = true;
+    pendingMoves.erase(pendingMoves.begin());
+}
+
+void GameClient::reconcile() {
+    TableView view = confirmedView;
+    bool played = confirmedPlayed;
+    size_t kept = 0;
+    for (; kept < pendingMoves.size(); ++kept) {
+        try {
+            predictMove(view, pendingMoves[kept], played);
+        } catch (const Uno::UnoException&) {
+            break; // The server refuses it as well, and says why; the moves built on it go with it
+        }
+    }
+    pendingMoves.erase(pendingMoves.begin() + kept, pendingMoves.end());
+    state.view = view;
+    predictedPlayed = played;
+    state.pendingMoves = static_cast<int>(pendingMoves.size());
+}
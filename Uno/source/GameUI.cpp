@@ -4,9 +4,10 @@
 #include <stdexcept>
 #include <algorithm>
 #include "../header/Exceptions.h" // Include custom exception header
+#include "../header/CardCode.h"
+#include "../header/CardUtils.h"
 
 using namespace std;
-bool GameUI::effectsApplied = false;
 
 // Constructor for GameUI class
 GameUI::GameUI()
@@ -15,8 +16,13 @@ GameUI::GameUI()
       viewingEndScreen(false),    // Whether the end game screen is being displayed
       cardDrawnThisTurn(false),   // Whether the current player has drawn a card this turn
       showContinueButton(false),  // Whether the "End Turn" button should be shown
-      cardNeedingColorChoice(nullptr), // Tracks if a card requires a color to be chosen (Wild/DrawFour)
-      selectingCardsToDrop(false) // Tracks if the player is selecting cards to drop (for DropTwo card)
+      pendingPlayIndex(-1),       // Hand index of a card waiting for a color or drop choice (Wild/DrawFour/DropTwo)
+      selectingCardsToDrop(false), // Tracks if the player is selecting cards to drop (for DropTwo card)
+      movesThisTurn(0),           // Moves made this turn that can be undone
+      redoableThisTurn(0),        // Moves undone this turn that can be redone
+      journal(nullptr),           // No crash journal until SetJournal is called
+      journalGameId(0),
+      turnsSinceCompact(0)
 {
     strcpy(statusMessage, ""); // Clear status message at initialization
     selectedCardIndices.clear(); // Clear selected card indices
@@ -71,6 +77,15 @@ void GameUI::DrawPlayerHand(Player *player, std::vector<Rectangle> &cardRects)
         throw Uno::NullPointerException("player in DrawPlayerHand");
     }
 
+    std::vector<Card*> cards;
+    for (int i = 0; i < player->getHandSize(); i++)
+        cards.push_back(player->getCardAtIndex(i));
+    DrawHandCards(cards, cardRects);
+}
+
+// Lays out and draws a hand of cards, storing their screen rectangles for click detection
+void GameUI::DrawHandCards(const std::vector<Card*> &cards, std::vector<Rectangle> &cardRects)
+{
     int screenWidth = GetScreenWidth();
     int screenHeight = GetScreenHeight();
 
@@ -79,7 +94,7 @@ void GameUI::DrawPlayerHand(Player *player, std::vector<Rectangle> &cardRects)
     int cardSpacing = 10;
     int maxCardsPerRow = 12; // Maximum cards to show in a row
 
-    int handSize = player->getHandSize();
+    int handSize = (int)cards.size();
     int rows = (handSize + maxCardsPerRow - 1) / maxCardsPerRow; // Calculate number of rows needed (ceiling division)
     int cardsInLastRow = handSize % maxCardsPerRow;
     if (cardsInLastRow == 0 && handSize > 0)
@@ -106,7 +121,7 @@ void GameUI::DrawPlayerHand(Player *player, std::vector<Rectangle> &cardRects)
             cardRects.push_back(cardRect); // Store card rectangle for click detection
 
             try {
-                Card* card = player->getCardAtIndex(cardIndex); // Get card from player's hand
+                Card* card = cards[cardIndex]; // Get card from the hand
                 if (!card) {
                     throw Uno::CardException(TextFormat("Card at index %d is null in player's hand.", cardIndex));
                 }
@@ -283,7 +298,6 @@ void GameUI::DrawPlayerTransitionScreen(const std::string &nextPlayerName)
         awaitingPlayerChange = false;
         cardDrawnThisTurn = false; // Reset for new player's turn
         showContinueButton = false;
-        effectsApplied = false; // Reset this when transitioning to a new player
     }
 
     // Update and draw the fullscreen toggle button
@@ -291,17 +305,119 @@ void GameUI::DrawPlayerTransitionScreen(const std::string &nextPlayerName)
     DrawButton(fullscreenToggleButton);
 }
 
-// Requests the player to choose a color for a Wild or Draw Four card
-void GameUI::RequestColorChoice(Card *card)
+// Requests the player to choose a color for a Wild or Draw Four card before it is played
+void GameUI::RequestColorChoice(int handIndex)
 {
-    // Check for null card pointer to prevent crashes
-    if (!card) {
-        throw Uno::NullPointerException("card in RequestColorChoice");
+    // Check for an invalid hand index to prevent playing a missing card
+    if (handIndex < 0) {
+        throw Uno::InvalidInputException("Card index in RequestColorChoice must not be negative");
     }
-    cardNeedingColorChoice = card; // Store the card that needs a color choice
+    pendingPlayIndex = handIndex; // Store the card that needs a color choice
     colorSelector.Show(); // Display the color selection UI
 }
 
+// Applies a move through the game engine and updates the turn buttons to match
+void GameUI::ApplyMove(UnoGame &game, const Move &move)
+{
+    game.makeMove(move); // Throws without changing anything if the move is illegal
+    movesThisTurn++;
+    redoableThisTurn = 0; // A new move replaces anything that was undone
+    showContinueButton = game.hasTakenTurnAction();
+    if (journal)
+        journal->logMove(journalGameId, move); // Synced in the background; the frame does not wait
+}
+
+// Builds the pending DropTwo move from the chosen cards and leaves drop selection mode
+Move GameUI::TakeDropMove()
+{
+    Move move = Move::play(pendingPlayIndex);
+    move.dropCount = selectedCardIndices.size();
+    for (int i = 0; i < move.dropCount; i++)
+    {
+        // Selections were made on the full hand; the engine counts without the DropTwo card
+        int index = selectedCardIndices[i];
+        move.dropIndices[i] = index > pendingPlayIndex ? index - 1 : index;
+    }
+
+    selectingCardsToDrop = false; // Exit drop selection mode
+    selectedCardIndices.clear(); // Clear selected indices
+    pendingPlayIndex = -1;
+    return move;
+}
+
+// Plays the pending DropTwo card once the cards to drop have been chosen
+void GameUI::FinishDropSelection(UnoGame &game)
+{
+    Move move = TakeDropMove();
+    ApplyMove(game, move);
+    SetStatusMessage(TextFormat("Dropped %d card(s). Your turn is over.", move.dropCount));
+}
+
+// Reverts the current player's last move
+void GameUI::UndoLastMove(UnoGame &game)
+{
+    // A half-finished DropTwo selection has not reached the game yet, so just cancel it
+    if (selectingCardsToDrop)
+    {
+        selectingCardsToDrop = false;
+        selectedCardIndices.clear();
+        pendingPlayIndex = -1;
+        SetStatusMessage("Drop Two cancelled.");
+        return;
+    }
+
+    if (movesThisTurn == 0 || !game.undoMove())
+    {
+        SetStatusMessage("Nothing to undo this turn.");
+        return;
+    }
+    if (journal)
+        journal->logUndo(journalGameId);
+    movesThisTurn--;
+    redoableThisTurn++;
+    showContinueButton = game.hasTakenTurnAction();
+    if (!showContinueButton)
+        cardDrawnThisTurn = false; // The draw (if any) was undone
+    SetStatusMessage("Move undone.");
+}
+
+// Re-applies the current player's last undone move
+void GameUI::RedoLastMove(UnoGame &game)
+{
+    if (redoableThisTurn == 0 || !game.redoMove())
+    {
+        SetStatusMessage("Nothing to redo.");
+        return;
+    }
+    if (journal)
+        journal->logRedo(journalGameId);
+    movesThisTurn++;
+    redoableThisTurn--;
+    showContinueButton = game.hasTakenTurnAction();
+    SetStatusMessage("Move redone.");
+}
+
+void GameUI::SetJournal(MoveJournal *moveJournal, uint64_t gameId)
+{
+    journal = moveJournal;
+    journalGameId = gameId;
+    turnsSinceCompact = 0;
+}
+
+void GameUI::ResumeGame(UnoGame &game)
+{
+    awaitingPlayerChange = true; // Hide the hand until the right player is at the device
+    viewingEndScreen = false;
+    showContinueButton = game.hasTakenTurnAction();
+    cardDrawnThisTurn = showContinueButton;
+    pendingPlayIndex = -1;
+    selectingCardsToDrop = false;
+    selectedCardIndices.clear();
+    movesThisTurn = 0; // Recovered games start with an empty undo history
+    redoableThisTurn = 0;
+    SetStatusMessage("Recovered unfinished game.");
+}
+
 // Updates the position and handles clicks for the fullscreen toggle button
 void GameUI::UpdateFullscreenButton()
 {
@@ -348,7 +464,11 @@ bool GameUI::HandleGameScreen(UnoGame &game)
     if (game.isGameOver())
     {
         if (!viewingEndScreen)
+        {
             viewingEndScreen = true;
+            if (journal)
+                journal->logGameEnd(journalGameId); // Nothing left to recover
+        }
         DrawEndGameScreen(game);
         return true; // Still updating the game screen (end screen)
     }
@@ -358,17 +478,16 @@ bool GameUI::HandleGameScreen(UnoGame &game)
     {
         if (colorSelector.Update())
         {
-            // A color was selected
-            if (cardNeedingColorChoice)
+            // A color was selected, so the Wild card can now be played with it
+            if (pendingPlayIndex >= 0)
             {
                 try {
-                    cardNeedingColorChoice->setColor(colorSelector.GetSelectedColor()); // Set the chosen color
+                    ApplyMove(game, Move::play(pendingPlayIndex, colorSelector.GetSelectedColor()));
                     SetStatusMessage("Color selected!");
-                    showContinueButton = true; // Show continue button after color selection
-                    cardNeedingColorChoice = nullptr; // Clear the card needing color choice
-                } catch (const Uno::CardException& e) {
+                } catch (const Uno::UnoException& e) {
                     SetStatusMessage(TextFormat("Card Error: %s", e.what()));
                 }
+                pendingPlayIndex = -1; // Clear the card needing color choice
             }
         }
         return true; // Keep processing color selector until a choice is made
@@ -381,26 +500,6 @@ bool GameUI::HandleGameScreen(UnoGame &game)
         return true; // Keep displaying transition screen
     }
 
-    // Apply any pending effects from the last turn's action cards (e.g., Skip, Reverse)
-    if (!effectsApplied)
-    {
-        try {
-            game.applyPendingEffects();
-            effectsApplied = true;
-
-            // The hasPendingSkipEffect method is commented out in UnoGame.h,
-            // so this logic might need adjustment based on its re-introduction or alternative
-            // if (game.hasPendingSkipEffect())
-            // {
-            //     awaitingPlayerChange = true;
-            //     effectsApplied = false; // Reset for next transition
-            //     return true;
-            // }
-        } catch (const Uno::GameStateException& e) {
-            SetStatusMessage(TextFormat("Game State Error: %s", e.what()));
-        }
-    }
-
     // Draw player information and the top card on the discard pile
     DrawPlayerInfo(currentPlayer);
     try {
@@ -440,6 +539,21 @@ bool GameUI::HandleGameScreen(UnoGame &game)
         (Color){144, 238, 144, 255}, // Light green
         false};
 
+    // Undo and redo buttons for taking back misclicks during this turn
+    Button undoButton = {
+        {40.0f, 120.0f, 180.0f, 50.0f},
+        "Undo",
+        (Color){70, 130, 180, 255},  // Steel blue
+        (Color){135, 206, 235, 255}, // Sky blue
+        false};
+
+    Button redoButton = {
+        {40.0f, 180.0f, 180.0f, 50.0f},
+        "Redo",
+        (Color){70, 130, 180, 255},  // Steel blue
+        (Color){135, 206, 235, 255}, // Sky blue
+        false};
+
     // Vector to store card rectangles for click detection
     std::vector<Rectangle> cardRects;
 
@@ -462,26 +576,42 @@ bool GameUI::HandleGameScreen(UnoGame &game)
         DrawButton(continueButton);
     }
 
+    // Draw undo/redo buttons
+    DrawButton(undoButton);
+    DrawButton(redoButton);
+
     // Get mouse position for input handling
     Vector2 mousePos = GetMousePosition();
+    bool ctrlHeld = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
 
     // Handle button clicks
-    if (IsButtonClicked(unoButton, mousePos))
+    if (IsButtonClicked(undoButton, mousePos) || (ctrlHeld && IsKeyPressed(KEY_Z)))
+    {
+        UndoLastMove(game); // Take back the last move of this turn
+        return true;
+    }
+    else if (IsButtonClicked(redoButton, mousePos) || (ctrlHeld && IsKeyPressed(KEY_Y)))
+    {
+        RedoLastMove(game); // Re-apply a move that was just undone
+        return true;
+    }
+    else if (IsButtonClicked(unoButton, mousePos))
     {
         try {
-            currentPlayer->callUNO(); // Player attempts to call UNO
+            ApplyMove(game, Move::callUno()); // Player attempts to call UNO
             SetStatusMessage(currentPlayer->getHandSize() == 2 ? "UNO called successfully!" : "You must have exactly 2 cards to call UNO!");
-        } catch (const Uno::PlayerException& e) {
+        } catch (const Uno::UnoException& e) {
             SetStatusMessage(TextFormat("Player Error: %s", e.what()));
         }
     }
     else if (IsButtonClicked(drawButton, mousePos))
     {
         try {
-            game.drawCard(currentPlayer); // Player draws a card
+            ApplyMove(game, Move::draw()); // Player draws a card
             SetStatusMessage("Card drawn. Look at your new card and end your turn when ready.");
-            showContinueButton = true; // Show continue button after drawing
             cardDrawnThisTurn = true; // Mark that a card was drawn this turn
+        } catch (const Uno::InvalidInputException& e) {
+            SetStatusMessage(TextFormat("Invalid Input Error: %s", e.what()));
         } catch (const Uno::CardException& e) {
             SetStatusMessage(TextFormat("Card Error: %s", e.what()));
         } catch (const Uno::GameStateException& e) {
@@ -492,13 +622,24 @@ bool GameUI::HandleGameScreen(UnoGame &game)
     {
         // Player has seen their drawn card/played a card and wants to end turn
         try {
-            game.nextTurn(); // Advance to the next turn
+            game.makeMove(Move::endTurn()); // Advance to the next turn and apply Skip/Reverse effects
             awaitingPlayerChange = true; // Go to transition screen
             showContinueButton = false; // Hide continue button
             cardDrawnThisTurn = false; // Reset card drawn status
+            movesThisTurn = 0; // The next player cannot undo this player's moves
+            redoableThisTurn = 0;
             SetStatusMessage(""); // Clear status message
-            effectsApplied = false; // Reset effects applied for the next player
-        } catch (const Uno::GameStateException& e) {
+            if (journal)
+            {
+                journal->logMove(journalGameId, Move::endTurn());
+                // Turns cannot be undone, so a snapshot here can replace the log behind it
+                if (++turnsSinceCompact >= 50)
+                {
+                    journal->compact({{journalGameId, &game}});
+                    turnsSinceCompact = 0;
+                }
+            }
+        } catch (const Uno::UnoException& e) {
             SetStatusMessage(TextFormat("Game State Error: %s", e.what()));
         }
     }
@@ -506,6 +647,8 @@ bool GameUI::HandleGameScreen(UnoGame &game)
     {
         // Set exit flag to return to main menu
         exitRequested = true;
+        if (journal)
+            journal->logGameEnd(journalGameId); // An abandoned game is not offered for recovery
         SetStatusMessage("Returning to main menu...");
         return true;
     }
@@ -535,40 +678,31 @@ bool GameUI::HandleGameScreen(UnoGame &game)
                 // If already in DropTwo selection mode
                 if (selectingCardsToDrop)
                 {
+                    int dropsNeeded = std::min(2, currentPlayer->getHandSize() - 1);
                     // Allow selecting cards to drop
-                    if (std::find(selectedCardIndices.begin(), selectedCardIndices.end(), i) == selectedCardIndices.end())
+                    if (i == pendingPlayIndex)
+                    {
+                        SetStatusMessage("That is the Drop Two card being played! Choose another.");
+                    }
+                    else if (std::find(selectedCardIndices.begin(), selectedCardIndices.end(), i) == selectedCardIndices.end())
                     {
                         selectedCardIndices.push_back(i); // Add card to selected list
-                        SetStatusMessage(TextFormat("Selected card %d to drop. Select %d more.", i, 2 - (int)selectedCardIndices.size()));
+                        SetStatusMessage(TextFormat("Selected card %d to drop. Select %d more.", i, dropsNeeded - (int)selectedCardIndices.size()));
                     }
                     else
                     {
                         SetStatusMessage("Card already selected! Choose another.");
                     }
-                    // If 2 cards are selected, drop them
-                    if (selectedCardIndices.size() == 2)
+                    // If enough cards are selected, play DropTwo and drop them
+                    if ((int)selectedCardIndices.size() == dropsNeeded)
                     {
-                        // Drop the selected cards using UnoGame's dropCardFromPlayer
-                        // Drop in descending order to avoid index shifts when removing from hand
-                        std::sort(selectedCardIndices.begin(), selectedCardIndices.end(), std::greater<int>());
-                        for (int index : selectedCardIndices)
-                        {
-                            try {
-                                game.dropCardFromPlayer(currentPlayer, index);
-                            } catch (const Uno::CardException& e) {
-                                SetStatusMessage(TextFormat("Card Error: %s", e.what()));
-                            } catch (const Uno::PlayerException& e) {
-                                SetStatusMessage(TextFormat("Player Error: %s", e.what()));
-                            } catch (const Uno::InvalidInputException& e) {
-                                SetStatusMessage(TextFormat("Invalid Input Error: %s", e.what()));
-                            }
+                        try {
+                            FinishDropSelection(game);
+                        } catch (const Uno::UnoException& e) {
+                            SetStatusMessage(TextFormat("Card Error: %s", e.what()));
                         }
-                        selectingCardsToDrop = false; // Exit drop selection mode
-                        selectedCardIndices.clear(); // Clear selected indices
-                        SetStatusMessage("Dropped 2 cards. Your turn is over.");
-                        showContinueButton = true; // Show continue button to end turn
                     }
-                    continue; // Consume this click handling and do not attempt to play any card
+                    break; // Consume this click; the hand may have changed
                 }
 
                 // Attempt to play the selected card
@@ -578,25 +712,22 @@ bool GameUI::HandleGameScreen(UnoGame &game)
                         // Handle special cards (Wild, DrawFour, DropTwo)
                         if (selectedCard->getName() == "Wild" || selectedCard->getName() == "DrawFour")
                         {
-                            currentPlayer->playCard(i, game); // Play the card
-                            RequestColorChoice(game.getTopCard()); // Request color choice from player
+                            RequestColorChoice(i); // Card is played once the player picks a color
                             SetStatusMessage("Choose a color for your Wild card");
-                            game.enforceUNOCall(currentPlayer); // Enforce UNO call rules
                         }
                         else if (selectedCard->getName() == "DropTwo")
                         {
-                            Card *dropTwoCard = selectedCard; // Get a copy of the selected card
-                            currentPlayer->removeCardFromHand(i); // Remove the card from player's hand
-                            game.setTopCard(dropTwoCard); // Manually set it as the top card
-                            game.enforceUNOCall(currentPlayer); // Check for UNO call
+                            pendingPlayIndex = i; // Card is played once the cards to drop are chosen
                             selectingCardsToDrop = true; // Enter card selection mode for dropping
                             selectedCardIndices.clear();
-                            SetStatusMessage("Drop Two played! Select up to 2 cards to drop.");
+                            if (currentPlayer->getHandSize() == 1)
+                                FinishDropSelection(game); // Nothing left to drop
+                            else
+                                SetStatusMessage("Drop Two played! Select up to 2 cards to drop. Undo cancels.");
                         }
                         else
                         {
-                            currentPlayer->playCard(i, game); // Play the card normally
-                            game.enforceUNOCall(currentPlayer); // Check for UNO call
+                            ApplyMove(game, Move::play(i)); // Play the card normally and check for UNO call
 
                             // Check if the current player has won
                             if (currentPlayer->hasWon())
@@ -631,3 +762,300 @@ bool GameUI::HandleGameScreen(UnoGame &game)
 
     return true; // Continue updating the game screen
 }
+
+// Pulls whatever the server sent since the last frame and decodes the cards to draw
+void GameUI::SyncRemote(GameClient &client)
+{
+    if (!client.sync(remote))
+        return; // Nothing new, or the network thread is busy; try again next frame
+
+    if (!remote.notices.empty())
+    {
+        SetStatusMessage(remote.notices.back().c_str());
+        remote.notices.clear();
+    }
+
+    remoteHand.clear();
+    for (CardCode code : remote.view.hand)
+        remoteHand.emplace_back(decodeCard(code));
+    remoteTopCard.reset(remote.view.topCard == NO_CARD ? nullptr : decodeCard(remote.view.topCard));
+}
+
+// Sends a move and shows its predicted result in this frame; the server's answer confirms
+// or corrects it. A move the server would refuse is refused here, without a round trip.
+bool GameUI::SendRemoteMove(GameClient &client, const Move &move)
+{
+    try {
+        client.sendMove(move);
+    } catch (const Uno::UnoException& e) {
+        SetStatusMessage(e.what());
+        return false;
+    }
+    SyncRemote(client);
+    return true;
+}
+
+// Handles a click on card index of the remote hand, using the same rules as UnoGame::isCardPlayable
+void GameUI::HandleRemoteCardClick(GameClient &client, int index)
+{
+    Card *selectedCard = remoteHand[index].get();
+    int handSize = (int)remoteHand.size();
+
+    if (selectingCardsToDrop)
+    {
+        int dropsNeeded = std::min(2, handSize - 1);
+        if (index == pendingPlayIndex)
+        {
+            SetStatusMessage("That is the Drop Two card being played! Choose another.");
+        }
+        else if (std::find(selectedCardIndices.begin(), selectedCardIndices.end(), index) == selectedCardIndices.end())
+        {
+            selectedCardIndices.push_back(index);
+            SetStatusMessage(TextFormat("Selected card %d to drop. Select %d more.", index, dropsNeeded - (int)selectedCardIndices.size()));
+        }
+        else
+        {
+            SetStatusMessage("Card already selected! Choose another.");
+        }
+        if ((int)selectedCardIndices.size() == dropsNeeded)
+            SendRemoteMove(client, TakeDropMove());
+        return;
+    }
+
+    if (!areCardsPlayable(selectedCard, remoteTopCard.get()))
+    {
+        SetStatusMessage("This card cannot be played! Try another or draw.");
+        return;
+    }
+
+    if (selectedCard->getName() == "Wild" || selectedCard->getName() == "DrawFour")
+    {
+        RequestColorChoice(index); // Sent once the player picks a color
+        SetStatusMessage("Choose a color for your Wild card");
+    }
+    else if (selectedCard->getName() == "DropTwo")
+    {
+        pendingPlayIndex = index;
+        selectingCardsToDrop = true;
+        selectedCardIndices.clear();
+        if (handSize == 1)
+            SendRemoteMove(client, TakeDropMove()); // Nothing left to drop
+        else
+            SetStatusMessage("Drop Two played! Select up to 2 cards to drop. Undo cancels.");
+    }
+    else if (SendRemoteMove(client, Move::play(index)))
+    {
+        SetStatusMessage("Card played.");
+    }
+}
+
+// Lists every seat with its hand size down the left side of the screen
+void GameUI::DrawRemoteSeats()
+{
+    for (int s = 0; s < remote.view.seats; s++)
+    {
+        const char *name = remote.view.names[s].empty() ? "(empty seat)" : remote.view.names[s].c_str();
+        const char *line;
+        if (remote.view.handSizes[s] < 0)
+            line = TextFormat("%s%s", name, s == remote.seat ? " (you)" : "");
+        else
+            line = TextFormat("%s%s: %d cards%s", name, s == remote.seat ? " (you)" : "",
+                              remote.view.handSizes[s], remote.view.calledUno[s] ? " - UNO!" : "");
+        DrawText(line, 40, 250 + s * 25, 20, s == remote.view.currentSeat ? YELLOW : WHITE);
+    }
+}
+
+// Draws a centered message with a main menu button, for connecting, waiting and disconnected states
+void GameUI::DrawRemoteMessage(const char *title, const char *detail)
+{
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
+    int buttonWidth = 200;
+    int buttonHeight = 60;
+
+    DrawText(title, screenWidth / 2 - MeasureText(title, 30) / 2, screenHeight / 2 - 100, 30, WHITE);
+    DrawText(detail, screenWidth / 2 - MeasureText(detail, 20) / 2, screenHeight / 2 - 50, 20, GRAY);
+
+    Rectangle menuButton = {(float)(screenWidth / 2 - buttonWidth / 2), (float)(screenHeight / 2 + 40), (float)buttonWidth, (float)buttonHeight};
+    bool menuHover = CheckCollisionPointRec(GetMousePosition(), menuButton);
+    DrawRectangleRec(menuButton, menuHover ? (Color){255, 140, 0, 255} : (Color){255, 69, 0, 255});
+    DrawText("Main Menu", screenWidth / 2 - MeasureText("Main Menu", 30) / 2, (int)(menuButton.y + buttonHeight / 2 - 15), 30, BLACK);
+    if (menuHover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+    {
+        exitRequested = true;
+    }
+
+    UpdateFullscreenButton();
+    DrawButton(fullscreenToggleButton);
+}
+
+// Draws the end of a network game, naming the winning seat
+void GameUI::DrawRemoteEndScreen()
+{
+    if (remote.winnerSeat >= 0 && remote.winnerSeat < remote.view.seats)
+    {
+        const std::string &winner = remote.view.names[remote.winnerSeat];
+        DrawRemoteMessage("Game Over!", remote.winnerSeat == remote.seat ? "You win!" : TextFormat("%s wins!", winner.c_str()));
+    }
+    else
+    {
+        DrawRemoteMessage("Game Over!", "A player left the table.");
+    }
+}
+
+bool GameUI::HandleGameScreen(GameClient &client)
+{
+    ClearBackground((Color){40, 0, 50, 255}); // Same dark navy background as local games
+
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
+
+    SyncRemote(client); // Never waits: the network thread owns the socket
+
+    if (remote.status == ClientStatus::Disconnected)
+    {
+        DrawRemoteMessage("Disconnected", remote.disconnectReason.c_str());
+        return true;
+    }
+    if (remote.status == ClientStatus::Connecting)
+    {
+        DrawRemoteMessage("Connecting...", statusMessage);
+        return true;
+    }
+    if (remote.status == ClientStatus::Reconnecting)
+    {
+        DrawRemoteMessage("Reconnecting...", remote.disconnectReason.c_str());
+        return true;
+    }
+    if (remote.tableId == 0 || !remote.hasView)
+    {
+        DrawRemoteMessage("Finding a table...", statusMessage);
+        return true;
+    }
+    if (remote.gameOver || (remote.view.flags & VIEW_FINISHED))
+    {
+        DrawRemoteEndScreen();
+        return true;
+    }
+    if (!(remote.view.flags & VIEW_STARTED))
+    {
+        DrawRemoteMessage(TextFormat("Table %llu", (unsigned long long)remote.tableId),
+                          "Waiting for players to join...");
+        DrawRemoteSeats();
+        return true;
+    }
+
+    bool myTurn = remote.seat != NO_SEAT && remote.view.currentSeat == remote.seat; // Never for a spectator
+    bool canAct = myTurn; // The view already shows the moves the server has not answered
+
+    // Handle color selector if it's active (for Wild/DrawFour cards)
+    if (colorSelector.IsActive())
+    {
+        if (colorSelector.Update() && pendingPlayIndex >= 0)
+        {
+            if (SendRemoteMove(client, Move::play(pendingPlayIndex, colorSelector.GetSelectedColor())))
+                SetStatusMessage("Color selected!");
+            pendingPlayIndex = -1;
+        }
+        return true;
+    }
+
+    // Whose turn it is, the top card and every seat's hand size
+    const char *turnText = myTurn ? "Your Turn" : TextFormat("%s's Turn", remote.view.names[remote.view.currentSeat].c_str());
+    DrawText(turnText, screenWidth / 2 - MeasureText(turnText, 40) / 2, 20, 40, WHITE);
+    DrawTopCard(remoteTopCard.get());
+    DrawRemoteSeats();
+
+    Button unoButton = {
+        {screenWidth - 220.0f, screenHeight - 120.0f, 180.0f, 50.0f},
+        "Call UNO!",
+        (Color){255, 105, 180, 255}, // Hot pink
+        (Color){255, 182, 193, 255}, // Light pink
+        false};
+
+    Button drawButton = {
+        {screenWidth / 2 - 90.0f, screenHeight - 120.0f, 180.0f, 50.0f},
+        "Draw Card",
+        (Color){60, 179, 113, 255},  // Medium sea green
+        (Color){144, 238, 144, 255}, // Light green
+        false};
+
+    Button quitButton = {
+        {40.0f, screenHeight - 120.0f, 180.0f, 50.0f},
+        "Main Menu",
+        (Color){255, 69, 0, 255},  // Orange red
+        (Color){255, 140, 0, 255}, // Dark orange
+        false};
+
+    Button continueButton = {
+        {screenWidth / 2 - 90.0f, 350.0f, 180.0f, 50.0f},
+        "End Turn",
+        (Color){60, 179, 113, 255},  // Medium sea green
+        (Color){144, 238, 144, 255}, // Light green
+        false};
+
+    // The player's own hand is always visible: nobody else looks at this screen
+    std::vector<Card*> cards;
+    for (const auto &card : remoteHand)
+        cards.push_back(card.get());
+    std::vector<Rectangle> cardRects;
+    DrawHandCards(cards, cardRects);
+
+    DrawText(statusMessage, screenWidth / 2 - MeasureText(statusMessage, 20) / 2, 220, 20, YELLOW);
+    DrawGameButtons(unoButton, drawButton, quitButton);
+
+    bool turnActionTaken = (remote.view.flags & VIEW_TURN_ACTION) != 0;
+    if (myTurn && turnActionTaken)
+    {
+        DrawButton(continueButton);
+    }
+
+    Vector2 mousePos = GetMousePosition();
+    if (IsButtonClicked(quitButton, mousePos))
+    {
+        client.leaveTable(); // Abandons the game for everyone at the table
+        exitRequested = true;
+        SetStatusMessage("Returning to main menu...");
+        return true;
+    }
+    if (!canAct)
+        return true; // Input waits for our turn and for the answer to the last move
+
+    bool ctrlHeld = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+    if (selectingCardsToDrop && ctrlHeld && IsKeyPressed(KEY_Z))
+    {
+        selectingCardsToDrop = false; // Nothing was sent yet, so this is a local undo
+        selectedCardIndices.clear();
+        pendingPlayIndex = -1;
+        SetStatusMessage("Drop Two cancelled.");
+    }
+    else if (IsButtonClicked(unoButton, mousePos))
+    {
+        bool canCall = remoteHand.size() == 2;
+        if (SendRemoteMove(client, Move::callUno()))
+            SetStatusMessage(canCall ? "UNO called!" : "You must have exactly 2 cards to call UNO!");
+    }
+    else if (!turnActionTaken && IsButtonClicked(drawButton, mousePos))
+    {
+        if (SendRemoteMove(client, Move::draw()))
+            SetStatusMessage("Card drawn. Look at your new card and end your turn when ready.");
+    }
+    else if (turnActionTaken && IsButtonClicked(continueButton, mousePos))
+    {
+        if (SendRemoteMove(client, Move::endTurn()))
+            SetStatusMessage("");
+    }
+    else if (!turnActionTaken && IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+    {
+        for (int i = 0; i < (int)cardRects.size() && i < (int)remoteHand.size(); i++)
+        {
+            if (CheckCollisionPointRec(mousePos, cardRects[i]))
+            {
+                HandleRemoteCardClick(client, i);
+                break;
+            }
+        }
+    }
+
+    return true; // Continue updating the game screen
+}
@@ -0,0 +1,252 @@
+#include "../header/Handoff.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const size_t HEADER_SIZE = 12; // Segment size (u64) and descriptor count (u32)
+
+static bool makeAddress(const std::string& path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static void setTimeouts(int channel) {
+    timeval timeout = {HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(channel, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// One message carrying data and, when count > 0, descriptors
+static bool sendMessage(int channel, const void* data, size_t size, const int* fds, size_t count) {
+    iovec vector;
+    vector.iov_base = const_cast<void*>(data);
+    vector.iov_len = size;
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+    if (count > 0) {
+        header.msg_control = control.data();
+        header.msg_controllen = control.size();
+        cmsghdr* rights = CMSG_FIRSTHDR(&header);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(rights), fds, sizeof(int) * count);
+    }
+    ssize_t sent;
+    do {
+        sent = sendmsg(channel, &header, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(size);
+}
+
+// Receives one message, appending the descriptors it carried to fds; -1 on failure
+static ssize_t receiveMessage(int channel, void* data, size_t size, std::vector<int>& fds) {
+    iovec vector;
+    vector.iov_base = data;
+    vector.iov_len = size;
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE));
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+    header.msg_control = control.data();
+    header.msg_controllen = control.size();
+
+    ssize_t received;
+    do {
+        received = recvmsg(channel, &header, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received < 0) return -1;
+
+    for (cmsghdr* entry = CMSG_FIRSTHDR(&header); entry; entry = CMSG_NXTHDR(&header, entry)) {
+        if (entry->cmsg_level != SOL_SOCKET || entry->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (entry->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* at = CMSG_DATA(entry);
+        for (size_t i = 0; i < count; ++i) {
+            int fd;
+            memcpy(&fd, at + i * sizeof(int), sizeof(int));
+            fds.push_back(fd);
+        }
+    }
+    if (header.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) return -1;
+    return received;
+}
+
+bool sendHandoffStep(int channel, char step) {
+    return sendMessage(channel, &step, 1, nullptr, 0);
+}
+
+bool receiveHandoffStep(int channel, char step) {
+    char received = 0;
+    std::vector<int> none;
+    return receiveMessage(channel, &received, 1, none) == 1 && none.empty() && received == step;
+}
+
+void sendHandoff(int channel, const std::vector<uint8_t>& state, const std::vector<int>& fds) {
+    int segment = memfd_create("uno-handoff", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (segment < 0) {
+        throw Uno::ResourceException(std::string("Cannot create the handoff segment: ") + strerror(errno));
+    }
+    size_t written = 0;
+    while (written < state.size()) {
+        ssize_t count = write(segment, state.data() + written, state.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            close(segment);
+            throw Uno::ResourceException("Cannot fill the handoff segment");
+        }
+        written += count;
+    }
+    // Sealed, so the reader can parse it in place knowing it will not change under it
+    fcntl(segment, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+    std::vector<uint8_t> header;
+    ByteWriter writer(header);
+    writer.putU64(state.size());
+    writer.putU32(static_cast<uint32_t>(fds.size()));
+    bool sent = sendMessage(channel, header.data(), header.size(), &segment, 1);
+    close(segment); // The receiver holds its own reference
+    for (size_t first = 0; sent && first < fds.size(); first += HANDOFF_FDS_PER_MESSAGE) {
+        size_t count = std::min<size_t>(HANDOFF_FDS_PER_MESSAGE, fds.size() - first);
+        char batch = 0;
+        sent = sendMessage(channel, &batch, 1, fds.data() + first, count);
+    }
+    if (!sent) {
+        throw Uno::ResourceException(std::string("Cannot send the handoff: ") + strerror(errno));
+    }
+}
+
+ReceivedHandoff::ReceivedHandoff(const std::string& path) : channel(-1), data(nullptr), size(0) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        throw Uno::InvalidInputException("Invalid handoff socket path: " + path);
+    }
+    channel = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (channel < 0 || connect(channel, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::string reason = strerror(errno);
+        if (channel >= 0) close(channel);
+        throw Uno::ResourceException("Cannot reach the running server at " + path + ": " + reason);
+    }
+    setTimeouts(channel);
+
+    std::vector<int> segments;
+    uint8_t header[HEADER_SIZE];
+    if (!sendHandoffStep(channel, HANDOFF_REQUEST) ||
+        receiveMessage(channel, header, sizeof(header), segments) != static_cast<ssize_t>(sizeof(header)) ||
+        segments.size() != 1) {
+        for (int fd : segments) close(fd);
+        close(channel);
+        throw Uno::ResourceException("The running server refused the handoff");
+    }
+    ByteReader reader(header, sizeof(header));
+    size = static_cast<size_t>(reader.getU64());
+    size_t expected = reader.getU32();
+
+    struct stat status;
+    bool mapped = fstat(segments[0], &status) == 0 && static_cast<size_t>(status.st_size) == size;
+    if (mapped && size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, segments[0], 0);
+        mapped = mapping != MAP_FAILED;
+        if (mapped) data = static_cast<const uint8_t*>(mapping);
+    }
+    close(segments[0]); // The mapping keeps the segment alive
+
+    while (mapped && fds.size() < expected) {
+        char batch;
+        if (receiveMessage(channel, &batch, 1, fds) != 1) break;
+    }
+    if (!mapped || fds.size() != expected) {
+        for (int fd : fds) close(fd);
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+        close(channel);
+        throw Uno::ResourceException("The handoff from the running server was incomplete");
+    }
+}
+
+ReceivedHandoff::~ReceivedHandoff() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    if (channel >= 0) close(channel);
+    channel = -1;
+}
+
+void ReceivedHandoff::confirm() {
+    if (!sendHandoffStep(channel, HANDOFF_ADOPTED) || !receiveHandoffStep(channel, HANDOFF_COMMIT)) {
+        throw Uno::ResourceException("The running server backed out of the handoff");
+    }
+}
+
+HandoffListener::HandoffListener(const std::string& socketPath, std::function<bool(int)> onRequest)
+    : path(socketPath), listenFd(-1), wakeFd(-1), handOff(std::move(onRequest)) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        throw Uno::InvalidInputException("Invalid handoff socket path: " + path);
+    }
+    listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw Uno::ResourceException("Cannot create the handoff socket");
+    }
+    unlink(path.c_str()); // Left by the server this one took over from, or by an earlier run
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 1) != 0) {
+        std::string reason = strerror(errno);
+        close(listenFd);
+        throw Uno::ResourceException("Cannot listen for handoffs on " + path + ": " + reason);
+    }
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        close(listenFd);
+        throw Uno::ResourceException("Cannot create the handoff wake-up event");
+    }
+}
+
+// The socket file is left alone: once handed off, it belongs to the successor
+HandoffListener::~HandoffListener() {
+    stop();
+    close(listenFd);
+    close(wakeFd);
+}
+
+void HandoffListener::start() {
+    if (!thread.joinable()) thread = std::thread(&HandoffListener::run, this);
+}
+
+void HandoffListener::stop() {
+    if (!thread.joinable()) return;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the thread anyway
+    }
+    thread.join();
+}
+
+void HandoffListener::run() {
+    for (;;) {
+        pollfd entries[2] = {{listenFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        if (::poll(entries, 2, -1) < 0 && errno != EINTR) return;
+        if (entries[1].revents & POLLIN) return;
+        if (!(entries[0].revents & POLLIN)) continue;
+        int channel = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (channel < 0) continue;
+        setTimeouts(channel);
+        bool handedOff = receiveHandoffStep(channel, HANDOFF_REQUEST) && handOff(channel);
+        close(channel);
+        if (handedOff) return;
+    }
+}
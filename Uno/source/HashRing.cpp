@@ -0,0 +1,45 @@
+#include "../header/HashRing.h"
+#include <algorithm>
+
+// splitmix64's finalizer: every input bit affects every output bit
+uint64_t HashRing::hashKey(uint64_t key) {
+    key += 0x9E3779B97F4A7C15ull;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+    return key ^ (key >> 31);
+}
+
+static uint64_t hashName(const std::string& name) {
+    uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+HashRing::HashRing(const std::vector<std::string>& nodeNames) : nodes(nodeNames) {
+    points.reserve(nodes.size() * POINTS_PER_NODE);
+    for (int n = 0; n < static_cast<int>(nodes.size()); ++n) {
+        uint64_t base = hashName(nodes[n]);
+        for (int p = 0; p < POINTS_PER_NODE; ++p) {
+            points.emplace_back(hashKey(base + p), n);
+        }
+    }
+    std::sort(points.begin(), points.end());
+}
+
+int HashRing::owner(uint64_t key) const {
+    if (points.empty()) return -1;
+    uint64_t hash = hashKey(key);
+    auto found = std::lower_bound(points.begin(), points.end(), std::make_pair(hash, 0));
+    if (found == points.end()) found = points.begin(); // Past the last point: wraps to the first
+    return found->second;
+}
+
+const std::vector<std::string>& HashRing::getNodes() const {
+    return nodes;
+}
+
+bool HashRing::empty() const {
+    return nodes.empty();
+}
@@ -0,0 +1,193 @@
+#include "../header/IoBackend.h"
+#include "../header/UringBackend.h"
+#include "../header/EventLoop.h"
+#include "../header/Exceptions.h"
+#include "../header/Metrics.h"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int MAX_EVENTS = 256;
+static const size_t READ_CHUNK = 16 * 1024;
+
+IoHandler::~IoHandler() {}
+
+IoBackend::~IoBackend() {}
+
+IoBackendKind parseIoBackendKind(const std::string& name) {
+    if (name == "epoll") return IoBackendKind::Epoll;
+    if (name == "uring" || name == "io_uring") return IoBackendKind::IoUring;
+    throw Uno::InvalidInputException("Unknown I/O backend: " + name);
+}
+
+std::string ioBackendName(IoBackendKind kind) {
+    return kind == IoBackendKind::IoUring ? "io_uring" : "epoll";
+}
+
+IoBackend* createIoBackend(IoBackendKind kind, IoHandler& handler, int listenSocket) {
+    if (kind == IoBackendKind::IoUring) {
+        return new UringBackend(handler, listenSocket);
+    }
+    return new EpollBackend(handler, listenSocket);
+}
+
+EpollBackend::EpollBackend(IoHandler& eventHandler, int listenSocket)
+    : handler(eventHandler), listenFd(listenSocket), epollFd(-1), wakeFd(-1) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        throw Uno::ResourceException("Cannot create event loop");
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.ptr = &wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+EpollBackend::~EpollBackend() {
+    for (Connection* connection : closed) {
+        delete connection;
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void EpollBackend::wake() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the loop anyway
+    }
+}
+
+// Level-triggered readiness leaves unread bytes in the socket and unsent ones in
+// the connection, so there is nothing to withdraw
+void EpollBackend::quiesce() {
+}
+
+void EpollBackend::resume(const std::vector<Connection*>&) {
+}
+
+// Registers or updates a connection, asking for writability only while output is queued
+void EpollBackend::watch(Connection* connection, int operation) {
+    epoll_event event{};
+    event.events = EPOLLIN | (connection->waitingToWrite ? uint32_t(EPOLLOUT) : 0u);
+    event.data.ptr = connection;
+    epoll_ctl(epollFd, operation, connection->fd, &event);
+}
+
+void EpollBackend::attach(Connection* connection) {
+    watch(connection, EPOLL_CTL_ADD);
+    if (connection->waitingToWrite) flush(connection);
+}
+
+void EpollBackend::release(Connection* connection) {
+    if (connection->fd < 0) return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+    connection->fd = -1; // flush() ignores it from here on
+    closed.push_back(connection); // Later events in this batch may still point at it
+}
+
+bool EpollBackend::poll(int timeoutMs) {
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+    if (count < 0) {
+        return errno == EINTR;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        void* tag = events[i].data.ptr;
+        if (tag == &listenFd) {
+            acceptConnections();
+        } else if (tag == &wakeFd) {
+            uint64_t value;
+            if (read(wakeFd, &value, sizeof(value)) < 0) {
+                // Nothing to clear
+            }
+            handler.onWake();
+        } else {
+            Connection* connection = static_cast<Connection*>(tag);
+            if (connection->fd < 0) continue; // Closed earlier in this batch
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                handler.onHangup(connection);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) flush(connection);
+            if (connection->fd >= 0 && (events[i].events & EPOLLIN)) readFrom(connection);
+        }
+    }
+
+    for (Connection* connection : closed) {
+        delete connection;
+    }
+    closed.clear();
+    return true;
+}
+
+void EpollBackend::acceptConnections() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN means the backlog is drained; other errors (e.g. EMFILE) are retried on the next event
+            return;
+        }
+        handler.onAccept(fd);
+    }
+}
+
+void EpollBackend::readFrom(Connection* connection) {
+    for (;;) {
+        size_t used = connection->input.size();
+        connection->input.resize(used + READ_CHUNK);
+        ssize_t received = recv(connection->fd, connection->input.data() + used, READ_CHUNK, 0);
+        connection->input.resize(used + (received > 0 ? received : 0));
+        if (received > 0) continue;
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            handler.onHangup(connection);
+            return;
+        }
+        if (errno != EINTR) break;
+    }
+    handler.onInput(connection);
+}
+
+// Writes as much queued output as the socket takes, shared frames included, in
+// one sendmsg per MAX_SEND_VECTORS segments; the rest waits for EPOLLOUT
+void EpollBackend::flush(Connection* connection) {
+    if (connection->fd < 0) return;
+    while (connection->hasOutput()) {
+        iovec vectors[MAX_SEND_VECTORS];
+        msghdr message{};
+        message.msg_iov = vectors;
+        message.msg_iovlen = connection->gatherOutput(vectors, MAX_SEND_VECTORS);
+        ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+        Metrics::count(Counter::SocketWrites);
+        if (sent > 0) {
+            connection->consumeOutput(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!connection->waitingToWrite) {
+                connection->waitingToWrite = true;
+                watch(connection, EPOLL_CTL_MOD);
+            }
+            return;
+        }
+        // The peer is gone; its read side will report the close
+        connection->clearOutput();
+        return;
+    }
+
+    if (connection->waitingToWrite) {
+        connection->waitingToWrite = false;
+        watch(connection, EPOLL_CTL_MOD);
+    }
+}
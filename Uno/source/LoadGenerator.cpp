@@ -0,0 +1,523 @@
+#include "../header/LoadGenerator.h"
+#include "../header/Protocol.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Compression.h"
+#include "../header/CardCode.h"
+#include "../header/CardUtils.h"
+#include "../header/Card.h"
+#include "../header/Move.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <queue>
+#include <random>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int SUB_BITS = 5;
+static const int SUB_BUCKETS = 1 << SUB_BITS;  // Buckets per power of two
+static const size_t READ_CHUNK = 16 * 1024;
+static const int MAX_EVENTS = 256;
+static const int MATCH_RATING = 1000;         // Every client asks for the same bucket
+static const int BUSY_RETRY_MS = 500;         // Wait before searching again after Busy, plus up to as much again
+
+LatencyHistogram::LatencyHistogram()
+    : counts(SUB_BUCKETS + (64 - SUB_BITS) * SUB_BUCKETS, 0), total(0), maximum(0) {
+}
+
+// Values below SUB_BUCKETS get a bucket each; above that, every power of two
+// is split into SUB_BUCKETS equal buckets
+int LatencyHistogram::bucketOf(uint64_t micros) {
+    if (micros < static_cast<uint64_t>(SUB_BUCKETS)) return static_cast<int>(micros);
+    int shift = 63 - __builtin_clzll(micros) - SUB_BITS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + static_cast<int>((micros >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucketTop(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t top = SUB_BUCKETS + (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    counts[bucketOf(micros)]++;
+    total++;
+    maximum = std::max(maximum, micros);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    maximum = std::max(maximum, other.maximum);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) return 0;
+    uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= wanted) return std::min(bucketTop(static_cast<int>(i)), maximum);
+    }
+    return maximum;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return total;
+}
+
+uint64_t LatencyHistogram::max() const {
+    return maximum;
+}
+
+void LoadReport::merge(const LoadReport& other) {
+    latency.merge(other.latency);
+    movesSent += other.movesSent;
+    movesRejected += other.movesRejected;
+    updates += other.updates;
+    staleDeltas += other.staleDeltas;
+    gamesFinished += other.gamesFinished;
+    serverErrors += other.serverErrors;
+    disconnects += other.disconnects;
+    connectFailures += other.connectFailures;
+    resumes += other.resumes;
+    resumeSnapshots += other.resumeSnapshots;
+    bytesSent += other.bytesSent;
+    bytesReceived += other.bytesReceived;
+    searchesRefused += other.searchesRefused;
+    seconds = std::max(seconds, other.seconds);
+}
+
+// One simulated player
+struct SimClient {
+    int fd = -1;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    bool waitingToWrite = false;
+    std::unique_ptr<FramePacker> packer;     // Set when the client asked for compression
+    std::unique_ptr<FrameUnpacker> unpacker;
+    bool unpacking = false;      // The server's CompressionOn came; its frames are packed from here
+    TableView view;
+    bool hasView = false;
+    bool awaiting = false;       // A move is out and its answer has not come back
+    bool moveScheduled = false;  // Thinking before the next move
+    bool fallback = false;       // The last move was rejected; draw or end the turn instead
+    uint64_t tableId = 0;
+    uint64_t token = 0;          // From Resumable, 0 once the game is over
+    bool resuming = false;       // The seat was claimed back and no update has come since
+    bool dropping = false;       // Hang up instead of making the scheduled move
+    bool searchRefused = false;  // The server was busy; the timer searches again
+    Clock::time_point sentAt;
+    std::mt19937 rng;
+};
+
+static void queueFrame(SimClient& client, ClientMessage type, const std::function<void(ByteWriter&)>& fill) {
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t>& out = client.packer ? frame : client.output;
+    size_t start = beginFrame(out, static_cast<uint8_t>(type));
+    ByteWriter writer(out);
+    fill(writer);
+    finishFrame(out, start);
+    if (client.packer) client.packer->pack(frame.data(), frame.size(), client.output);
+}
+
+// The first frames on a new connection: UseCompression when asked for, then Hello
+static void queueGreeting(SimClient& client, const std::string& name, bool compress) {
+    client.packer.reset();
+    client.unpacker.reset();
+    client.unpacking = false;
+    if (compress) {
+        queueFrame(client, ClientMessage::UseCompression, [](ByteWriter& writer) { writer.putU8(COMPRESSION_DICTIONARY); });
+        client.packer.reset(new FramePacker());
+        client.unpacker.reset(new FrameUnpacker());
+    }
+    queueFrame(client, ClientMessage::Hello, [&name](ByteWriter& writer) { writer.putString(name); });
+}
+
+static void queueFindMatch(SimClient& client, int seats) {
+    queueFrame(client, ClientMessage::FindMatch, [seats](ByteWriter& writer) {
+        writer.putU8(seats);
+        writer.putVarint(MATCH_RATING);
+    });
+}
+
+// Picks a move from what the client can see, the way the GUI's rules allow it
+static Move chooseMove(SimClient& client, bool pickRandom) {
+    const TableView& view = client.view;
+    if (client.fallback) {
+        client.fallback = false;
+        return (view.flags & VIEW_TURN_ACTION) ? Move::endTurn() : Move::draw();
+    }
+    if (view.flags & VIEW_TURN_ACTION) return Move::endTurn();
+    if (view.hand.size() == 2 && !view.calledUno[view.seat]) return Move::callUno();
+
+    std::unique_ptr<Card> top(decodeCard(view.topCard));
+    std::vector<int> playable;
+    int colorCounts[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < view.hand.size(); ++i) {
+        std::unique_ptr<Card> card(decodeCard(view.hand[i]));
+        if (areCardsPlayable(card.get(), top.get())) playable.push_back(static_cast<int>(i));
+        int color = static_cast<int>(cardCodeColor(view.hand[i]));
+        if (color < 4) colorCounts[color]++;
+    }
+    if (playable.empty()) return Move::draw();
+
+    int index = pickRandom ? playable[client.rng() % playable.size()] : playable[0];
+    Move move = Move::play(index);
+    CardKind kind = cardCodeKind(view.hand[index]);
+    if (kind == CardKind::Wild || kind == CardKind::DrawFour) {
+        move.color = static_cast<CardColor>(std::max_element(colorCounts, colorCounts + 4) - colorCounts);
+    } else if (kind == CardKind::DropTwo) {
+        move.dropCount = std::min(2, static_cast<int>(view.hand.size()) - 1);
+        for (int d = 0; d < move.dropCount; ++d) {
+            move.dropIndices[d] = d;
+        }
+    }
+    return move;
+}
+
+static bool openClient(const addrinfo* address, SimClient& client) {
+    int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (fd < 0) return false;
+    if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+        close(fd);
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    client.fd = fd;
+    return true;
+}
+
+LoadGenerator::LoadGenerator(const LoadConfig& loadConfig) : config(loadConfig) {
+}
+
+LoadReport LoadGenerator::run() {
+    if (config.clients <= 0 || config.seconds <= 0 || config.thinkMs < 0) {
+        throw Uno::InvalidInputException("Clients and seconds must be positive");
+    }
+    if (config.seats < 2 || config.seats > MAX_SEATS) {
+        throw Uno::InvalidInputException("Tables need between 2 and 4 seats");
+    }
+    if (config.dropPercent < 0 || config.dropPercent > 100) {
+        throw Uno::InvalidInputException("Drop percentage must be between 0 and 100");
+    }
+    if (config.strategy != "random" && config.strategy != "first") {
+        throw Uno::InvalidInputException("Unknown strategy: " + config.strategy);
+    }
+    int threads = config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, config.clients);
+
+    std::vector<LoadReport> reports(threads);
+    std::vector<std::thread> workers;
+    int first = 0;
+    for (int t = 0; t < threads; ++t) {
+        int count = config.clients / threads + (t < config.clients % threads ? 1 : 0);
+        workers.emplace_back(&LoadGenerator::runThread, this, t, first, count, std::ref(reports[t]));
+        first += count;
+    }
+    LoadReport total;
+    for (int t = 0; t < threads; ++t) {
+        workers[t].join();
+        total.merge(reports[t]);
+    }
+    return total;
+}
+
+void LoadGenerator::runThread(int thread, int firstClient, int clientCount, LoadReport& report) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* address = nullptr;
+    if (getaddrinfo(config.host.c_str(), std::to_string(config.port).c_str(), &hints, &address) != 0) {
+        report.connectFailures = clientCount;
+        return;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<SimClient> clients(clientCount);
+    for (int i = 0; i < clientCount; ++i) {
+        SimClient& client = clients[i];
+        client.rng.seed(firstClient + i + 1);
+        if (!openClient(address, client)) {
+            report.connectFailures++;
+            continue;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+        queueGreeting(client, "load-" + std::to_string(firstClient + i), config.compress);
+        queueFindMatch(client, config.seats);
+    }
+
+    bool pickRandom = config.strategy == "random";
+    typedef std::pair<Clock::time_point, int> Timer;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> thinking;
+
+    auto closeClient = [&](SimClient& client) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        client.fd = -1;
+    };
+    auto flush = [&](int index) {
+        SimClient& client = clients[index];
+        size_t sent = 0;
+        while (sent < client.output.size()) {
+            ssize_t written = send(client.fd, client.output.data() + sent, client.output.size() - sent, MSG_NOSIGNAL);
+            if (written > 0) {
+                sent += written;
+                report.bytesSent += written;
+            } else if (written < 0 && errno == EINTR) {
+                continue;
+            } else {
+                break;
+            }
+        }
+        client.output.erase(client.output.begin(), client.output.begin() + sent);
+        bool wantWrite = !client.output.empty();
+        if (wantWrite != client.waitingToWrite) {
+            client.waitingToWrite = wantWrite;
+            epoll_event event{};
+            event.events = EPOLLIN | (wantWrite ? uint32_t(EPOLLOUT) : 0u);
+            event.data.u32 = index;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+        }
+    };
+    // Hangs up and claims the seat back on a new connection, as a mobile client would
+    auto dropAndResume = [&](int index) {
+        SimClient& client = clients[index];
+        closeClient(client);
+        client.input.clear();
+        client.output.clear();
+        client.waitingToWrite = false;
+        if (!openClient(address, client)) {
+            report.connectFailures++;
+            return;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = index;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+        queueGreeting(client, "load-" + std::to_string(firstClient + index), config.compress);
+        queueFrame(client, ClientMessage::ClaimSeat, [&client](ByteWriter& writer) {
+            writer.putVarint(client.tableId);
+            writer.putU8(client.view.seat);
+            writer.putU64(client.token);
+            writer.putVarint(client.view.version);
+        });
+        client.resuming = true;
+        report.resumes++;
+        flush(index);
+    };
+    auto sendMove = [&](int index) {
+        SimClient& client = clients[index];
+        client.moveScheduled = false;
+        if (client.fd < 0 || !client.hasView || client.view.currentSeat != client.view.seat) return;
+        if (client.dropping) {
+            client.dropping = false;
+            dropAndResume(index);
+            return;
+        }
+        Move move = chooseMove(client, pickRandom);
+        queueFrame(client, ClientMessage::PlayMove, [&move](ByteWriter& writer) { writeMove(writer, move); });
+        client.awaiting = true;
+        client.sentAt = Clock::now();
+        report.movesSent++;
+        flush(index);
+    };
+    auto searchAgain = [&](int index) {
+        SimClient& client = clients[index];
+        client.searchRefused = false;
+        if (client.fd < 0) return;
+        queueFindMatch(client, config.seats);
+        flush(index);
+    };
+    auto answered = [&](SimClient& client) {
+        if (!client.awaiting) return;
+        client.awaiting = false;
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.sentAt).count();
+        report.latency.record(static_cast<uint64_t>(micros));
+    };
+    auto maybeMove = [&](int index) {
+        SimClient& client = clients[index];
+        const TableView& view = client.view;
+        if (!client.hasView || client.awaiting || client.moveScheduled) return;
+        if (view.seat == NO_SEAT || view.currentSeat != view.seat || (view.flags & VIEW_FINISHED)) return;
+        // A drop replaces the connection, so it never happens while its input is being read
+        client.dropping = config.dropPercent > 0 && client.token != 0 &&
+                          static_cast<int>(client.rng() % 100) < config.dropPercent;
+        if (config.thinkMs > 0 || client.dropping) {
+            client.moveScheduled = true;
+            thinking.push(Timer(Clock::now() + std::chrono::milliseconds(config.thinkMs), index));
+        } else {
+            sendMove(index);
+        }
+    };
+    auto handleFrame = [&](int index, ByteReader& frame) {
+        SimClient& client = clients[index];
+        ServerMessage type = static_cast<ServerMessage>(frame.getU8());
+        switch (type) {
+            case ServerMessage::TableJoined:
+                frame.getVarint();
+                client.view.seat = frame.getU8();
+                client.hasView = false;
+                break;
+            case ServerMessage::TableState:
+                readTableView(frame, client.view);
+                client.hasView = true;
+                report.updates++;
+                if (client.resuming) report.resumeSnapshots++;
+                client.resuming = false;
+                answered(client);
+                maybeMove(index);
+                break;
+            case ServerMessage::TableDelta:
+                report.updates++;
+                client.resuming = false;
+                if (!client.hasView || !applyTableDelta(frame, client.view)) {
+                    report.staleDeltas++;
+                    break;
+                }
+                answered(client);
+                maybeMove(index);
+                break;
+            case ServerMessage::MoveRejected:
+                report.movesRejected++;
+                answered(client);
+                client.fallback = true;
+                maybeMove(index);
+                break;
+            case ServerMessage::Resumable:
+                client.tableId = frame.getVarint();
+                frame.getU8();
+                client.token = frame.getU64();
+                // Nobody else moves during this client's turn, so an empty replay leaves it to move
+                if (client.resuming) maybeMove(index);
+                break;
+            case ServerMessage::GameOver:
+                if (client.view.seat == 0) report.gamesFinished++; // Counted once per table
+                client.token = 0;
+                client.hasView = false;
+                client.awaiting = false;
+                queueFrame(client, ClientMessage::LeaveTable, [](ByteWriter&) {});
+                queueFindMatch(client, config.seats);
+                flush(index);
+                break;
+            case ServerMessage::Error:
+                report.serverErrors++;
+                break;
+            case ServerMessage::Busy:
+                report.searchesRefused++;
+                client.searchRefused = true;
+                thinking.push(Timer(Clock::now() + std::chrono::milliseconds(BUSY_RETRY_MS + client.rng() % BUSY_RETRY_MS), index));
+                break;
+            default:
+                break;
+        }
+    };
+    std::vector<uint8_t> unpacked;
+    auto readFrom = [&](int index) {
+        SimClient& client = clients[index];
+        for (;;) {
+            size_t used = client.input.size();
+            client.input.resize(used + READ_CHUNK);
+            ssize_t received = recv(client.fd, client.input.data() + used, READ_CHUNK, 0);
+            client.input.resize(used + (received > 0 ? received : 0));
+            if (received > 0) {
+                report.bytesReceived += received;
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (received < 0 && errno == EINTR) continue;
+            report.disconnects++;
+            closeClient(client);
+            return;
+        }
+        size_t consumed = 0;
+        size_t frameSize;
+        try {
+            while (client.fd >= 0) {
+                const uint8_t* data = client.input.data() + consumed;
+                size_t size = client.input.size() - consumed;
+                if (client.unpacking) {
+                    size_t packedSize = client.unpacker->unpack(data, size, unpacked);
+                    if (packedSize == 0) break;
+                    consumed += packedSize;
+                    ByteReader frame(unpacked.data() + 4, unpacked.size() - 4);
+                    handleFrame(index, frame);
+                } else {
+                    if (!completeFrame(data, size, frameSize)) break;
+                    consumed += frameSize;
+                    if (data[4] == static_cast<uint8_t>(ServerMessage::CompressionOn)) {
+                        client.unpacking = client.unpacker != nullptr;
+                        continue;
+                    }
+                    ByteReader frame(data + 4, frameSize - 4);
+                    handleFrame(index, frame);
+                }
+            }
+        } catch (const Uno::InvalidInputException&) {
+            report.serverErrors++;
+            closeClient(client);
+            return;
+        }
+        client.input.erase(client.input.begin(), client.input.begin() + consumed);
+    };
+
+    for (int i = 0; i < clientCount; ++i) {
+        if (clients[i].fd >= 0) flush(i);
+    }
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::seconds(config.seconds);
+    epoll_event events[MAX_EVENTS];
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        while (!thinking.empty() && thinking.top().first <= now) {
+            int index = thinking.top().second;
+            thinking.pop();
+            if (clients[index].searchRefused) {
+                searchAgain(index);
+            } else {
+                sendMove(index);
+            }
+        }
+        if (now >= deadline) break;
+        Clock::time_point wakeAt = thinking.empty() ? deadline : std::min(deadline, thinking.top().first);
+        int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count()) + 1;
+
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        for (int e = 0; e < count; ++e) {
+            int index = static_cast<int>(events[e].data.u32);
+            if (clients[index].fd < 0) continue;
+            if (events[e].events & EPOLLOUT) flush(index);
+            if (events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) readFrom(index);
+        }
+    }
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (SimClient& client : clients) {
+        if (client.fd >= 0) close(client.fd);
+    }
+    close(epollFd);
+    freeaddrinfo(address);
+    (void)thread;
+}
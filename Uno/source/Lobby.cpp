@@ -0,0 +1,185 @@
+#include "../header/Lobby.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static bool byId(const LobbyTable& table, uint64_t tableId) {
+    return table.tableId < tableId;
+}
+
+Lobby::Lobby() : stopping(false), wakeFd(-1), wakePending(false), listed(0) {
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        throw Uno::ResourceException("Cannot create lobby wake-up eventfd");
+    }
+    for (int seats = 0; seats <= MAX_SEATS; ++seats) {
+        for (int bucket = 0; bucket < LOBBY_BUCKETS; ++bucket) {
+            publish(seats, bucket, listings[seats][bucket]); // One empty page each
+        }
+    }
+}
+
+Lobby::~Lobby() {
+    stop();
+    close(wakeFd);
+}
+
+void Lobby::start() {
+    stopping = false;
+    thread = std::thread(&Lobby::run, this);
+}
+
+void Lobby::stop() {
+    stopping = true;
+    wake();
+    if (thread.joinable()) thread.join();
+}
+
+void Lobby::wake() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the thread anyway
+    }
+}
+
+void Lobby::post(const Change& change) {
+    inbox.push(change);
+    if (!wakePending.exchange(true, std::memory_order_acq_rel)) wake();
+}
+
+void Lobby::list(const LobbyTable& table) {
+    if (table.seats < 2 || table.seats > MAX_SEATS) return;
+    Change change;
+    change.table = table;
+    post(change);
+}
+
+void Lobby::unlist(uint64_t tableId) {
+    Change change;
+    change.unlist = true;
+    change.table.tableId = tableId;
+    post(change);
+}
+
+void Lobby::run() {
+    while (!stopping) {
+        pollfd entry{wakeFd, POLLIN, 0};
+        poll(&entry, 1, -1);
+        uint64_t value;
+        if (read(wakeFd, &value, sizeof(value)) < 0) {
+            // Nothing to clear
+        }
+        drain();
+    }
+}
+
+// Applies every change queued so far, then republishes the listings they touched
+void Lobby::drain() {
+    wakePending.store(false, std::memory_order_release);
+    Change change;
+    while (inbox.pop(change)) {
+        auto found = tables.find(change.table.tableId);
+        if (found != tables.end()) {
+            remove(found->second); // Its seat count never changes, but the pages showing it do
+            if (change.unlist) {
+                tables.erase(found);
+            } else {
+                found->second = change.table;
+            }
+        } else if (!change.unlist) {
+            tables.emplace(change.table.tableId, change.table);
+        }
+        if (!change.unlist) add(change.table);
+    }
+    for (int seats = 0; seats <= MAX_SEATS; ++seats) {
+        for (int bucket = 0; bucket < LOBBY_BUCKETS; ++bucket) {
+            Listing& listing = listings[seats][bucket];
+            if (listing.changedFrom != UNCHANGED) publish(seats, bucket, listing);
+        }
+    }
+    listed.store(tables.size(), std::memory_order_relaxed);
+}
+
+int Lobby::bucketOf(int rating) {
+    return std::min(std::max(rating, 0), MAX_RATING) / RATING_BUCKET;
+}
+
+void Lobby::add(const LobbyTable& table) {
+    int bucket = bucketOf(table.rating);
+    for (int seats : {0, table.seats}) {
+        Listing& listing = listings[seats][bucket];
+        auto at = std::lower_bound(listing.tables.begin(), listing.tables.end(), table.tableId, byId);
+        listing.changedFrom = std::min<size_t>(listing.changedFrom, at - listing.tables.begin());
+        listing.tables.insert(at, table);
+    }
+}
+
+void Lobby::remove(const LobbyTable& table) {
+    int bucket = bucketOf(table.rating);
+    for (int seats : {0, table.seats}) {
+        Listing& listing = listings[seats][bucket];
+        auto at = std::lower_bound(listing.tables.begin(), listing.tables.end(), table.tableId, byId);
+        if (at == listing.tables.end() || at->tableId != table.tableId) continue;
+        listing.changedFrom = std::min<size_t>(listing.changedFrom, at - listing.tables.begin());
+        listing.tables.erase(at);
+    }
+}
+
+// Rewrites the listing's pages from the first one a change fell on; the pages
+// before it are shared with the last publication, unless the page count moved
+void Lobby::publish(int seats, int bucket, Listing& listing) {
+    size_t size = listing.tables.size();
+    uint64_t pageCount = std::max<uint64_t>((size + LOBBY_PAGE_SIZE - 1) / LOBBY_PAGE_SIZE, 1);
+    const Pages& previous = listing.pages; // Only this thread stores it
+    uint64_t kept = 0;
+    if (previous && previous->size() == pageCount) {
+        kept = std::min<uint64_t>(listing.changedFrom / LOBBY_PAGE_SIZE, pageCount);
+    }
+
+    auto pages = std::make_shared<std::vector<Page>>();
+    pages->reserve(pageCount);
+    if (kept > 0) pages->insert(pages->end(), previous->begin(), previous->begin() + kept);
+    for (uint64_t page = kept; page < pageCount; ++page) {
+        size_t first = std::min<size_t>(page * LOBBY_PAGE_SIZE, size);
+        size_t count = std::min<size_t>(size - first, LOBBY_PAGE_SIZE);
+        pages->push_back(writePage(seats, bucket, page, pageCount, listing.tables.data() + first, count));
+    }
+    std::atomic_store(&listing.pages, Pages(std::move(pages)));
+    listing.changedFrom = UNCHANGED;
+}
+
+Lobby::Page Lobby::writePage(int seats, int bucket, uint64_t page, uint64_t pageCount,
+                             const LobbyTable* rows, size_t count) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ServerMessage::TableList));
+    ByteWriter writer(frame);
+    writer.putU8(seats);
+    writer.putVarint(bucket * RATING_BUCKET);
+    writer.putVarint(page);
+    writer.putVarint(pageCount);
+    writer.putVarint(count);
+    for (size_t i = 0; i < count; ++i) {
+        const LobbyTable& table = rows[i];
+        writer.putVarint(table.tableId);
+        writer.putU8(table.seats);
+        writer.putU8(table.taken);
+        writer.putVarint(std::max(table.rating, 0));
+    }
+    finishFrame(frame, start);
+    return std::make_shared<const std::vector<uint8_t>>(std::move(frame));
+}
+
+Lobby::Page Lobby::page(int seats, int rating, uint64_t page) const {
+    if (seats < 0 || seats > MAX_SEATS || seats == 1) seats = 0;
+    int bucket = bucketOf(rating);
+    Pages pages = std::atomic_load(&listings[seats][bucket].pages);
+    if (page < pages->size()) return (*pages)[page];
+    return writePage(seats, bucket, page, pages->size(), nullptr, 0); // Empty, but says how many there are
+}
+
+size_t Lobby::size() const {
+    return listed.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#include "../header/MappedFile.h"
+#include "../header/Exceptions.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filePath) : data(nullptr), length(0) {
+#ifdef _WIN32
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) {
+        throw Uno::ResourceException("Cannot open file: " + filePath);
+    }
+    in.seekg(0, std::ios::end);
+    fallback.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(fallback.data(), fallback.size());
+    data = fallback.data();
+    length = fallback.size();
+#else
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw Uno::ResourceException("Cannot open file: " + filePath);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw Uno::ResourceException("Cannot read file size: " + filePath);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw Uno::ResourceException("Cannot map file: " + filePath);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL); // Parsers read front to back
+        data = static_cast<const char*>(mapping);
+    }
+    close(fd); // The mapping stays valid without the descriptor
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (data && length > 0) {
+        munmap(const_cast<char*>(data), length);
+    }
+#endif
+}
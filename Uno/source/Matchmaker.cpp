@@ -0,0 +1,189 @@
+#include "../header/Matchmaker.h"
+#include "../header/EventLoop.h"
+#include "../header/Server.h"
+#include "../header/Exceptions.h"
+#include "../header/Metrics.h"
+#include <algorithm>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static const int TICK_MS = WIDEN_AFTER_MS / 4; // How often waiting tickets are looked at again
+
+Matchmaker::Matchmaker(Server& owner)
+    : server(owner), stopping(false), wakeFd(-1), wakePending(false),
+      nextTicket(1), matchesFormed(0), nextLoop(0) {
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        throw Uno::ResourceException("Cannot create matchmaker wake-up eventfd");
+    }
+}
+
+Matchmaker::~Matchmaker() {
+    stop();
+    for (auto& entry : bySession) {
+        delete entry.second;
+    }
+    close(wakeFd);
+}
+
+void Matchmaker::start() {
+    stopping = false; // Started again when a handoff falls through
+    thread = std::thread(&Matchmaker::run, this);
+}
+
+void Matchmaker::stop() {
+    stopping = true;
+    wake();
+    if (thread.joinable()) thread.join();
+}
+
+void Matchmaker::wake() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the thread anyway
+    }
+}
+
+uint64_t Matchmaker::enqueue(uint64_t sessionId, int loop, const std::string& name, int seats, int rating) {
+    Request request;
+    request.ticket.ticket = nextTicket++;
+    request.ticket.sessionId = sessionId;
+    request.ticket.loop = loop;
+    request.ticket.name = name;
+    request.ticket.seats = seats;
+    request.ticket.rating = std::min(std::max(rating, 0), MAX_RATING);
+    request.ticket.since = std::chrono::steady_clock::now();
+    uint64_t ticket = request.ticket.ticket;
+    inbox.push(std::move(request));
+    if (!wakePending.exchange(true, std::memory_order_acq_rel)) wake();
+    return ticket;
+}
+
+void Matchmaker::cancel(uint64_t sessionId) {
+    Request request;
+    request.cancel = true;
+    request.ticket.sessionId = sessionId;
+    inbox.push(std::move(request));
+    if (!wakePending.exchange(true, std::memory_order_acq_rel)) wake();
+}
+
+uint64_t Matchmaker::getMatchesFormed() const {
+    return matchesFormed.load(std::memory_order_relaxed);
+}
+
+void Matchmaker::run() {
+    Metrics::attachThread();
+    while (!stopping) {
+        pollfd entry{wakeFd, POLLIN, 0};
+        poll(&entry, 1, bySession.empty() ? -1 : TICK_MS);
+        uint64_t value;
+        if (read(wakeFd, &value, sizeof(value)) < 0) {
+            // Woken by the timeout
+        }
+        drain();
+        widen();
+        Metrics::setGauge(Gauge::MatchmakingWaiting, static_cast<int64_t>(bySession.size()));
+    }
+}
+
+// New tickets only match inside their own bucket; wider matches wait for widen()
+void Matchmaker::drain() {
+    wakePending.store(false, std::memory_order_release);
+    Request request;
+    while (inbox.pop(request)) {
+        auto found = bySession.find(request.ticket.sessionId);
+        if (found != bySession.end()) {
+            MatchTicket* previous = found->second;
+            remove(previous); // Cancelled, or replaced by a newer search
+            delete previous;
+        }
+        if (request.cancel) continue;
+
+        MatchTicket* ticket = new MatchTicket(request.ticket);
+        add(ticket);
+        tryMatch(ticket, 0);
+    }
+}
+
+void Matchmaker::add(MatchTicket* ticket) {
+    Queue& queue = queues[ticket->seats];
+    queue.byRating.insert(ticket);
+    queue.byAge.insert(ticket);
+    bySession[ticket->sessionId] = ticket;
+}
+
+void Matchmaker::remove(MatchTicket* ticket) {
+    Queue& queue = queues[ticket->seats];
+    queue.byRating.erase(ticket);
+    queue.byAge.erase(ticket);
+    bySession.erase(ticket->sessionId);
+}
+
+// Looks for seats - 1 other tickets within the given number of buckets of the
+// anchor's, nearest ratings first, and forms the table if there are enough
+bool Matchmaker::tryMatch(MatchTicket* anchor, int buckets) {
+    Queue& queue = queues[anchor->seats];
+    int bucket = anchor->rating / RATING_BUCKET;
+    int lowest = (bucket - buckets) * RATING_BUCKET;
+    int highest = (bucket + buckets + 1) * RATING_BUCKET - 1;
+
+    std::vector<MatchTicket*> players;
+    players.push_back(anchor);
+    auto at = queue.byRating.find(anchor);
+    auto below = at;
+    auto above = std::next(at);
+    while (static_cast<int>(players.size()) < anchor->seats) {
+        bool hasBelow = below != queue.byRating.begin() && (*std::prev(below))->rating >= lowest;
+        bool hasAbove = above != queue.byRating.end() && (*above)->rating <= highest;
+        if (!hasBelow && !hasAbove) return false;
+        if (hasBelow && (!hasAbove || anchor->rating - (*std::prev(below))->rating <= (*above)->rating - anchor->rating)) {
+            --below;
+            players.push_back(*below);
+        } else {
+            players.push_back(*above);
+            ++above;
+        }
+    }
+    formTable(players);
+    return true;
+}
+
+// Gives every ticket that has waited a while another try with a wider range, oldest first
+void Matchmaker::widen() {
+    auto now = std::chrono::steady_clock::now();
+    for (int seats = 2; seats <= MAX_SEATS; ++seats) {
+        Queue& queue = queues[seats];
+        auto it = queue.byAge.begin();
+        while (it != queue.byAge.end()) {
+            MatchTicket* ticket = *it;
+            auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - ticket->since).count();
+            if (waited < WIDEN_AFTER_MS) break; // The rest are younger still
+            int buckets = static_cast<int>(waited / WIDEN_AFTER_MS);
+            if (tryMatch(ticket, buckets)) {
+                it = queue.byAge.begin(); // Matched tickets are gone; start again from the oldest
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+// Hands the group to a shard owner in turn, which seats them and deals. Loops
+// that are overloaded or full are passed over, unless every one is; a full
+// one that gets the group anyway answers Busy.
+void Matchmaker::formTable(std::vector<MatchTicket*>& players) {
+    LoopMessage message;
+    message.command = LoopCommand::CreateMatch;
+    for (MatchTicket* ticket : players) {
+        remove(ticket);
+        message.match.push_back(*ticket);
+        delete ticket;
+    }
+    int loop = nextLoop++ % server.loopCount();
+    for (int tries = 1; tries < server.loopCount() && !server.getLoop(loop).canHostTables(); ++tries) {
+        loop = nextLoop++ % server.loopCount();
+    }
+    server.getLoop(loop).post(std::move(message));
+    matchesFormed.fetch_add(1, std::memory_order_relaxed);
+}
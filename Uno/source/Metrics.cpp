@@ -0,0 +1,272 @@
+#include "../header/Metrics.h"
+#include "../header/Exceptions.h"
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+thread_local MetricSlot* threadMetrics = nullptr;
+
+static const uint64_t LATENCY_BOUNDS_US[LATENCY_BUCKETS] = {
+    5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000
+};
+static const int REQUEST_LIMIT = 8 * 1024;
+
+// Set during static initialisation, before any thread can scrape
+static bool allocationsCounted = false;
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+static const MetricInfo COUNTER_INFO[COUNTER_COUNT] = {
+    {"uno_moves_total", "Moves the engine applied"},
+    {"uno_moves_rejected_total", "Moves the server refused"},
+    {"uno_games_finished_total", "Games played to the end or abandoned"},
+    {"uno_reshuffles_total", "Discard piles shuffled back into the draw pile"},
+    {"uno_allocations_total", "Calls to operator new on threads that record metrics"},
+    {"uno_loop_messages_posted_total", "Work queued for an event loop"},
+    {"uno_loop_messages_handled_total", "Queued work an event loop ran"},
+    {"uno_connections_total", "Client connections accepted"},
+    {"uno_shed_total", "New tables and searches refused while overloaded or full"},
+    {"uno_delayed_updates_total", "Spectator updates held back while overloaded"},
+    {"uno_socket_writes_total", "Send calls made for connection output"},
+    {"uno_journal_failures_total", "Event loops that stopped journaling their games after a write failed"}
+};
+
+static const MetricInfo GAUGE_INFO[GAUGE_COUNT] = {
+    {"uno_active_tables", "Tables hosted"},
+    {"uno_open_connections", "Client connections open"},
+    {"uno_matchmaking_waiting", "Players waiting for a match"},
+    {"uno_overloaded_loops", "Event loops shedding load"},
+    {"uno_table_memory_bytes", "Memory held by table slots, in use or free"}
+};
+
+// Every slot ever handed out; only attachThread and render take the lock
+static std::mutex registryMutex;
+static std::vector<MetricSlot*>& registry() {
+    static std::vector<MetricSlot*>* slots = new std::vector<MetricSlot*>(); // Outlives every thread
+    return *slots;
+}
+
+MetricSlot::MetricSlot() : latencySumUs(0) {
+    for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    for (auto& gauge : gauges) gauge.store(0, std::memory_order_relaxed);
+    for (auto& bucket : latencyBuckets) bucket.store(0, std::memory_order_relaxed);
+}
+
+void Metrics::attachThread() {
+    if (threadMetrics) return;
+    MetricSlot* slot = new MetricSlot();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry().push_back(slot);
+    }
+    threadMetrics = slot;
+}
+
+void Metrics::countAllocations() {
+    allocationsCounted = true;
+}
+
+void Metrics::observeMoveLatency(uint64_t micros) {
+    MetricSlot* slot = threadMetrics;
+    if (!slot) return;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS && micros > LATENCY_BOUNDS_US[bucket]) {
+        bucket++;
+    }
+    std::atomic<uint64_t>& count = slot->latencyBuckets[bucket];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot->latencySumUs.store(slot->latencySumUs.load(std::memory_order_relaxed) + micros, std::memory_order_relaxed);
+}
+
+static void appendLine(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    out += line;
+}
+
+std::string Metrics::render() {
+    uint64_t counters[COUNTER_COUNT] = {};
+    int64_t gauges[GAUGE_COUNT] = {};
+    uint64_t buckets[LATENCY_BUCKETS + 1] = {};
+    uint64_t latencySum = 0;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const MetricSlot* slot : registry()) {
+            for (int i = 0; i < COUNTER_COUNT; ++i) counters[i] += slot->counters[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < GAUGE_COUNT; ++i) gauges[i] += slot->gauges[i].load(std::memory_order_relaxed);
+            for (int i = 0; i <= LATENCY_BUCKETS; ++i) buckets[i] += slot->latencyBuckets[i].load(std::memory_order_relaxed);
+            latencySum += slot->latencySumUs.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::string out;
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (i == static_cast<int>(Counter::Allocations) && !allocationsCounted) continue;
+        appendLine(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", COUNTER_INFO[i].name, COUNTER_INFO[i].help,
+                   COUNTER_INFO[i].name, COUNTER_INFO[i].name, static_cast<unsigned long long>(counters[i]));
+    }
+    for (int i = 0; i < GAUGE_COUNT; ++i) {
+        appendLine(out, "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n", GAUGE_INFO[i].name, GAUGE_INFO[i].help,
+                   GAUGE_INFO[i].name, GAUGE_INFO[i].name, static_cast<long long>(gauges[i]));
+    }
+
+    // Posts and runs are counted by different threads, so a scrape can catch one ahead of the other
+    int64_t posted = static_cast<int64_t>(counters[static_cast<int>(Counter::MessagesPosted)]);
+    int64_t handled = static_cast<int64_t>(counters[static_cast<int>(Counter::MessagesHandled)]);
+    appendLine(out, "# HELP uno_loop_queue_depth Work queued for event loops and not yet run\n"
+                    "# TYPE uno_loop_queue_depth gauge\nuno_loop_queue_depth %lld\n",
+               static_cast<long long>(posted > handled ? posted - handled : 0));
+
+    const char* latency = "uno_move_latency_seconds";
+    appendLine(out, "# HELP %s From reading a move to queueing its update (server), or applying one move in 16 (simulator)\n"
+                    "# TYPE %s histogram\n", latency, latency);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        cumulative += buckets[i];
+        appendLine(out, "%s_bucket{le=\"%g\"} %llu\n", latency, LATENCY_BOUNDS_US[i] / 1e6,
+                   static_cast<unsigned long long>(cumulative));
+    }
+    cumulative += buckets[LATENCY_BUCKETS];
+    appendLine(out, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.6f\n%s_count %llu\n", latency,
+               static_cast<unsigned long long>(cumulative), latency, latencySum / 1e6, latency,
+               static_cast<unsigned long long>(cumulative));
+    return out;
+}
+
+#ifndef _WIN32
+static int openListener(const std::string& address) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(local.sun_path)) return -1;
+        memcpy(local.sun_path, path.c_str(), path.size());
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        unlink(path.c_str()); // A socket file left by an earlier run
+        if (bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 || listen(fd, 16) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) return -1;
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(), &hints, &found) != 0) {
+        return -1;
+    }
+    int fd = socket(found->ai_family, found->ai_socktype | SOCK_CLOEXEC, found->ai_protocol);
+    int reuse = 1;
+    if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (fd >= 0 && (bind(fd, found->ai_addr, found->ai_addrlen) != 0 || listen(fd, 16) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+MetricsEndpoint::MetricsEndpoint(const std::string& listenAddress)
+    : address(listenAddress), listenFd(-1), wakeFd(-1) {
+    listenFd = openListener(address);
+    if (listenFd < 0) {
+        throw Uno::ResourceException("Cannot serve metrics on " + address + ": " + strerror(errno));
+    }
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        close(listenFd);
+        throw Uno::ResourceException("Cannot create the metrics wake-up event");
+    }
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    stop();
+    close(listenFd);
+    close(wakeFd);
+    if (address.compare(0, 5, "unix:") == 0) unlink(address.substr(5).c_str());
+}
+
+void MetricsEndpoint::start() {
+    if (!thread.joinable()) thread = std::thread(&MetricsEndpoint::run, this);
+}
+
+void MetricsEndpoint::stop() {
+    if (!thread.joinable()) return;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the thread anyway
+    }
+    thread.join();
+}
+
+void MetricsEndpoint::run() {
+    for (;;) {
+        pollfd entries[2] = {{listenFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        if (::poll(entries, 2, -1) < 0 && errno != EINTR) return;
+        if (entries[1].revents & POLLIN) return;
+        if (!(entries[0].revents & POLLIN)) continue;
+        int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        serve(client);
+        close(client);
+    }
+}
+
+// One request per connection; whatever the path, a GET gets the metrics
+void MetricsEndpoint::serve(int client) {
+    timeval timeout = {1, 0}; // A client that never finishes its request cannot hold up the next scrape
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < REQUEST_LIMIT) {
+        ssize_t received = recv(client, chunk, sizeof(chunk), 0);
+        if (received <= 0) break;
+        request.append(chunk, received);
+    }
+
+    std::string body;
+    std::string status = "200 OK";
+    if (request.compare(0, 4, "GET ") == 0) {
+        body = Metrics::render();
+    } else {
+        status = "400 Bad Request";
+    }
+    std::string response = "HTTP/1.0 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) return;
+        sent += written;
+    }
+}
+#endif
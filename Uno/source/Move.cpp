@@ -0,0 +1,44 @@
+#include "../header/Move.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+
+void writeMove(ByteWriter& out, const Move& move) {
+    out.putU8(static_cast<uint8_t>(move.type));
+    if (move.type != MoveType::Play) return;
+
+    out.putVarint(move.handIndex);
+    out.putU8(static_cast<uint8_t>(move.color));
+    out.putU8(move.dropCount);
+    for (int i = 0; i < move.dropCount; ++i) {
+        out.putVarint(move.dropIndices[i]);
+    }
+}
+
+Move readMove(ByteReader& in) {
+    uint8_t type = in.getU8();
+    if (type > static_cast<uint8_t>(MoveType::EndTurn)) {
+        throw Uno::InvalidInputException("Unknown move type in encoded move");
+    }
+
+    Move move;
+    move.type = static_cast<MoveType>(type);
+    if (move.type != MoveType::Play) return move;
+
+    uint64_t index = in.getVarint();
+    uint8_t color = in.getU8();
+    uint8_t drops = in.getU8();
+    if (index > 0xFFFF || color > static_cast<uint8_t>(CardColor::NONE) || drops > 2) {
+        throw Uno::InvalidInputException("Encoded move has out of range fields");
+    }
+    move.handIndex = static_cast<int>(index);
+    move.color = static_cast<CardColor>(color);
+    move.dropCount = drops;
+    for (int i = 0; i < drops; ++i) {
+        uint64_t drop = in.getVarint();
+        if (drop > 0xFFFF) {
+            throw Uno::InvalidInputException("Encoded move has an out of range drop index");
+        }
+        move.dropIndices[i] = static_cast<int>(drop);
+    }
+    return move;
+}
@@ -0,0 +1,422 @@
+#include "../header/MoveJournal.h"
+#include "../header/UnoGame.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Checksum.h"
+#include "../header/Exceptions.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char JOURNAL_MAGIC[8] = {'U', 'N', 'O', 'W', 'A', 'L', '1', '\0'};
+static const size_t RECORD_HEADER_SIZE = 8; // Payload size + CRC
+
+// Thin wrappers so the flusher can use plain file descriptors on every platform
+static int openJournalFile(const std::string& filePath, bool truncate) {
+#ifdef _WIN32
+    int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND);
+    return _open(filePath.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | (truncate ? O_TRUNC : O_APPEND);
+    return open(filePath.c_str(), flags, 0644);
+#endif
+}
+
+static bool writeAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned int>(size));
+#else
+        ssize_t written = write(fd, data, size);
+#endif
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool syncFile(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+static void closeFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+static bool readWholeFile(const std::string& filePath, std::vector<uint8_t>& out) {
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    out.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(reinterpret_cast<char*>(out.data()), out.size());
+    return static_cast<bool>(in) || out.empty();
+}
+
+// Reserves the record header and writes the start of the payload
+static size_t beginRecordIn(std::vector<uint8_t>& buffer, JournalRecordType type, uint64_t gameId) {
+    size_t start = buffer.size();
+    buffer.resize(start + RECORD_HEADER_SIZE);
+    ByteWriter writer(buffer);
+    writer.putU8(static_cast<uint8_t>(type));
+    writer.putVarint(gameId);
+    return start;
+}
+
+// Fills in the header once the payload is complete
+static void finishRecordIn(std::vector<uint8_t>& buffer, size_t start) {
+    const uint8_t* payload = buffer.data() + start + RECORD_HEADER_SIZE;
+    uint32_t size = static_cast<uint32_t>(buffer.size() - start - RECORD_HEADER_SIZE);
+    uint32_t crc = crc32(payload, size);
+    for (int i = 0; i < 4; ++i) {
+        buffer[start + i] = (size >> (8 * i)) & 0xFF;
+        buffer[start + 4 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+}
+
+static void appendSnapshotIn(std::vector<uint8_t>& buffer, uint64_t gameId, const std::vector<uint8_t>& state) {
+    size_t start = beginRecordIn(buffer, JournalRecordType::Snapshot, gameId);
+    buffer.insert(buffer.end(), state.begin(), state.end());
+    finishRecordIn(buffer, start);
+}
+
+// Walks the records of a journal image, optionally collecting unfinished games,
+// and returns how many leading bytes are intact
+static size_t scanJournal(const std::vector<uint8_t>& bytes, std::map<uint64_t, RecoveredGame>* games) {
+    size_t offset = sizeof(JOURNAL_MAGIC);
+    while (bytes.size() - offset >= RECORD_HEADER_SIZE) {
+        ByteReader header(bytes.data() + offset, RECORD_HEADER_SIZE);
+        uint32_t size = header.getU32();
+        uint32_t crc = header.getU32();
+        if (size > bytes.size() - offset - RECORD_HEADER_SIZE) break; // Torn write
+        const uint8_t* payload = bytes.data() + offset + RECORD_HEADER_SIZE;
+        if (crc32(payload, size) != crc) break;
+
+        if (games) {
+            try {
+                ByteReader reader(payload, size);
+                JournalRecordType type = static_cast<JournalRecordType>(reader.getU8());
+                uint64_t gameId = reader.getVarint();
+                if (type == JournalRecordType::Snapshot) {
+                    RecoveredGame& game = (*games)[gameId];
+                    game.snapshot.assign(payload + reader.offset(), payload + size);
+                    game.ops.clear();
+                } else if (type == JournalRecordType::GameEnd) {
+                    games->erase(gameId);
+                } else {
+                    auto found = games->find(gameId);
+                    if (found != games->end()) {
+                        JournalOp op;
+                        op.type = type;
+                        if (type == JournalRecordType::Move) {
+                            op.move = readMove(reader);
+                        } else if (type != JournalRecordType::Undo && type != JournalRecordType::Redo) {
+                            throw Uno::InvalidInputException("Unknown journal record type");
+                        }
+                        found->second.ops.push_back(op);
+                    }
+                }
+            } catch (const Uno::InvalidInputException&) {
+                break; // Checksum matched but the payload makes no sense; treat as the end
+            }
+        }
+        offset += RECORD_HEADER_SIZE + size;
+    }
+    return offset;
+}
+
+MoveJournal::MoveJournal(const std::string& filePath, int commitWindowMicros)
+    : path(filePath), fd(-1), appendedLsn(0), durable(0),
+      commitWindowMicros(commitWindowMicros), stopping(false) {
+    openFile();
+    flusher = std::thread(&MoveJournal::flushLoop, this);
+}
+
+MoveJournal::~MoveJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    hasWork.notify_one();
+    flusher.join(); // Flushes whatever is still pending before it exits
+    if (fd >= 0) closeFile(fd);
+}
+
+void MoveJournal::openFile() {
+    std::vector<uint8_t> existing;
+    bool exists = readWholeFile(path, existing);
+
+    if (exists && !existing.empty()) {
+        if (existing.size() < sizeof(JOURNAL_MAGIC) ||
+            std::memcmp(existing.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+            throw Uno::ResourceException("Not a move journal: " + path);
+        }
+        // Drop a torn tail so new records are not appended after garbage
+        size_t valid = scanJournal(existing, nullptr);
+        if (valid < existing.size()) {
+            std::error_code error;
+            std::filesystem::resize_file(path, valid, error);
+            if (error) {
+                throw Uno::ResourceException("Cannot truncate move journal: " + path);
+            }
+        }
+    }
+
+    fd = openJournalFile(path, false);
+    if (fd < 0) {
+        throw Uno::ResourceException("Cannot open move journal: " + path);
+    }
+    if (!exists || existing.empty()) {
+        if (!writeAll(fd, reinterpret_cast<const uint8_t*>(JOURNAL_MAGIC), sizeof(JOURNAL_MAGIC)) || !syncFile(fd)) {
+            throw Uno::ResourceException("Failed writing move journal: " + path);
+        }
+    }
+}
+
+void MoveJournal::flushLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            hasWork.wait(lock, [this] { return stopping || !pending.empty() || !nextImage.empty(); });
+            if (pending.empty() && nextImage.empty()) return; // Stopping with nothing left to write
+        }
+
+        // Give concurrent appenders a moment to join this batch
+        if (commitWindowMicros > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(commitWindowMicros));
+        }
+
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        uint64_t target;
+        std::vector<uint8_t> image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writing.swap(pending);
+            image.swap(nextImage);
+            target = appendedLsn;
+        }
+        if (writing.empty() && image.empty()) continue; // compact already covered these records
+
+        std::string error = image.empty() ? std::string() : replaceFile(image);
+        if (error.empty() && !writing.empty() && !(writeAll(fd, writing.data(), writing.size()) && syncFile(fd))) {
+            error = "Failed writing move journal: " + path;
+        }
+        bool ok = error.empty();
+        writing.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                durable = target;
+            } else {
+                failure = error;
+            }
+        }
+        flushed.notify_all();
+        if (!ok) return;
+    }
+}
+
+void MoveJournal::beginRecord(JournalRecordType type, uint64_t gameId, size_t& start) {
+    if (!failure.empty()) {
+        throw Uno::ResourceException(failure);
+    }
+    start = beginRecordIn(pending, type, gameId);
+}
+
+uint64_t MoveJournal::endRecord(size_t start) {
+    finishRecordIn(pending, start);
+    uint64_t lsn = ++appendedLsn;
+    hasWork.notify_one();
+    return lsn;
+}
+
+uint64_t MoveJournal::append(JournalRecordType type, uint64_t gameId, const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t start;
+    beginRecord(type, gameId, start);
+    pending.insert(pending.end(), data, data + size);
+    return endRecord(start);
+}
+
+uint64_t MoveJournal::logSnapshot(uint64_t gameId, const UnoGame& game) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t start;
+    beginRecord(JournalRecordType::Snapshot, gameId, start);
+    try {
+        game.saveSnapshot(pending);
+    } catch (...) {
+        pending.resize(start); // Never leave half a record behind
+        throw;
+    }
+    return endRecord(start);
+}
+
+uint64_t MoveJournal::logSnapshot(uint64_t gameId, const std::vector<uint8_t>& state) {
+    return append(JournalRecordType::Snapshot, gameId, state.data(), state.size());
+}
+
+uint64_t MoveJournal::logMove(uint64_t gameId, const Move& move) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t start;
+    beginRecord(JournalRecordType::Move, gameId, start);
+    ByteWriter writer(pending);
+    writeMove(writer, move);
+    return endRecord(start);
+}
+
+uint64_t MoveJournal::logUndo(uint64_t gameId) {
+    return append(JournalRecordType::Undo, gameId, nullptr, 0);
+}
+
+uint64_t MoveJournal::logRedo(uint64_t gameId) {
+    return append(JournalRecordType::Redo, gameId, nullptr, 0);
+}
+
+uint64_t MoveJournal::logGameEnd(uint64_t gameId) {
+    return append(JournalRecordType::GameEnd, gameId, nullptr, 0);
+}
+
+void MoveJournal::waitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushed.wait(lock, [&] { return durable >= lsn || !failure.empty(); });
+    if (durable < lsn) {
+        throw Uno::ResourceException(failure);
+    }
+}
+
+uint64_t MoveJournal::durableLsn() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return durable;
+}
+
+void MoveJournal::compact(const std::vector<std::pair<uint64_t, const UnoGame*>>& liveGames) {
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!failure.empty()) {
+        throw Uno::ResourceException(failure);
+    }
+
+    std::vector<uint8_t> image(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+    for (const auto& entry : liveGames) {
+        if (!entry.second) {
+            throw Uno::NullPointerException("game passed to MoveJournal::compact");
+        }
+        size_t start = beginRecordIn(image, JournalRecordType::Snapshot, entry.first);
+        entry.second->saveSnapshot(image);
+        finishRecordIn(image, start);
+    }
+    std::string error = replaceFile(image);
+    if (!error.empty()) {
+        if (fd < 0) failure = error;
+        throw Uno::ResourceException(error);
+    }
+
+    // Everything appended so far is superseded by the snapshots
+    pending.clear();
+    nextImage.clear();
+    durable = appendedLsn;
+    flushed.notify_all();
+}
+
+uint64_t MoveJournal::compactLater(const std::vector<std::pair<uint64_t, std::vector<uint8_t>>>& liveStates) {
+    std::vector<uint8_t> image(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+    for (const auto& entry : liveStates) {
+        appendSnapshotIn(image, entry.first, entry.second);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!failure.empty()) {
+        throw Uno::ResourceException(failure);
+    }
+    nextImage.swap(image);
+    pending.clear(); // Superseded by the states
+    uint64_t lsn = ++appendedLsn;
+    hasWork.notify_one();
+    return lsn;
+}
+
+// Writes the new image beside the journal, then swaps it in atomically. On
+// failure the old journal stays, unless it could not be reopened (fd is then -1).
+std::string MoveJournal::replaceFile(const std::vector<uint8_t>& image) {
+    std::string tempPath = path + ".tmp";
+    int tempFd = openJournalFile(tempPath, true);
+    if (tempFd < 0) {
+        return "Cannot create move journal: " + tempPath;
+    }
+    bool ok = writeAll(tempFd, image.data(), image.size()) && syncFile(tempFd);
+    closeFile(tempFd);
+    std::error_code error;
+    if (ok) std::filesystem::rename(tempPath, path, error);
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        return "Failed compacting move journal: " + path;
+    }
+#ifndef _WIN32
+    // Make the rename itself durable
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int dirFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+#endif
+
+    closeFile(fd);
+    fd = openJournalFile(path, false);
+    if (fd < 0) {
+        return "Cannot reopen move journal: " + path;
+    }
+    return std::string();
+}
+
+std::map<uint64_t, RecoveredGame> MoveJournal::recover(const std::string& filePath) {
+    std::map<uint64_t, RecoveredGame> games;
+    std::vector<uint8_t> bytes;
+    if (!readWholeFile(filePath, bytes) || bytes.empty()) {
+        return games; // Nothing was ever logged
+    }
+    if (bytes.size() < sizeof(JOURNAL_MAGIC) || std::memcmp(bytes.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        throw Uno::ResourceException("Not a move journal: " + filePath);
+    }
+    scanJournal(bytes, &games);
+    return games;
+}
+
+void MoveJournal::restoreGame(const RecoveredGame& recovered, UnoGame& game) {
+    game.loadSnapshot(recovered.snapshot.data(), recovered.snapshot.size());
+    for (const JournalOp& op : recovered.ops) {
+        switch (op.type) {
+            case JournalRecordType::Move:
+                game.makeMove(op.move);
+                break;
+            case JournalRecordType::Undo:
+                if (!game.undoMove()) {
+                    throw Uno::GameStateException("Journal undo has no move to revert");
+                }
+                break;
+            case JournalRecordType::Redo:
+                if (!game.redoMove()) {
+                    throw Uno::GameStateException("Journal redo has no move to re-apply");
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,395 @@
+#include "../header/Notation.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <charconv>
+
+static const int TURNS_PER_LINE = 8; // formatNotation wraps after this many turns
+
+bool parseInteger(std::string_view text, int& output) {
+    if (text.empty()) return false;
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, output);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Parses a run of digits (no sign) that fills the entire view
+static bool parseIndex(std::string_view text, int& output) {
+    return !text.empty() && text[0] >= '0' && text[0] <= '9' && parseInteger(text, output);
+}
+
+// Seeds use the full unsigned range
+static bool parseSeed(std::string_view text, unsigned int& output) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, output);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+static CardColor colorFromLetter(char letter) {
+    switch (letter) {
+        case 'r': case 'R': return CardColor::Red;
+        case 'b': case 'B': return CardColor::Blue;
+        case 'g': case 'G': return CardColor::Green;
+        case 'y': case 'Y': return CardColor::Yellow;
+        default: return CardColor::NONE;
+    }
+}
+
+static char letterFromColor(CardColor color) {
+    switch (color) {
+        case CardColor::Red: return 'r';
+        case CardColor::Blue: return 'b';
+        case CardColor::Green: return 'g';
+        case CardColor::Yellow: return 'y';
+        default: return '?';
+    }
+}
+
+NotationParser::NotationParser(std::string_view input, int firstLine)
+    : text(input), position(0), lineNumber(firstLine), pendingGame(false) {}
+
+void NotationParser::fail(const std::string& message) const {
+    throw Uno::InvalidInputException("Notation line " + std::to_string(lineNumber) + ": " + message);
+}
+
+// Reads the next token; lineStart is set when a line break came before it.
+// "/" is a token of its own so turns can be written as "3/d/".
+bool NotationParser::nextToken(std::string_view& token, bool& lineStart) {
+    lineStart = position == 0;
+    while (position < text.size()) {
+        char c = text[position];
+        if (c == '\n') {
+            lineNumber++;
+            lineStart = true;
+            position++;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            position++;
+        } else if (c == '#') {
+            while (position < text.size() && text[position] != '\n') position++;
+        } else {
+            break;
+        }
+    }
+    if (position >= text.size()) return false;
+
+    size_t start = position;
+    if (text[position] == '/') {
+        position++;
+    } else {
+        while (position < text.size()) {
+            char c = text[position];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#' || c == '/') break;
+            position++;
+        }
+    }
+    token = text.substr(start, position - start);
+    return true;
+}
+
+void NotationParser::parseMove(std::string_view token, NotationMove& out) const {
+    out.penalty = -1;
+    if (token == "/") {
+        out.move = Move::endTurn();
+        return;
+    }
+    if (token == "d") {
+        out.move = Move::draw();
+        return;
+    }
+    if (token == "u") {
+        out.move = Move::callUno();
+        return;
+    }
+
+    // <index>[color][^a[,b]][+penalty]
+    size_t i = 0;
+    while (i < token.size() && token[i] >= '0' && token[i] <= '9') i++;
+    int index;
+    if (!parseIndex(token.substr(0, i), index)) {
+        fail("unknown move '" + std::string(token) + "'");
+    }
+    out.move = Move::play(index);
+
+    if (i < token.size() && colorFromLetter(token[i]) != CardColor::NONE) {
+        out.move.color = colorFromLetter(token[i]);
+        i++;
+    }
+    if (i < token.size() && token[i] == '^') {
+        i++;
+        while (out.move.dropCount < 2) {
+            size_t start = i;
+            while (i < token.size() && token[i] >= '0' && token[i] <= '9') i++;
+            int drop;
+            if (!parseIndex(token.substr(start, i - start), drop)) {
+                fail("bad drop list in '" + std::string(token) + "'");
+            }
+            out.move.dropIndices[out.move.dropCount++] = drop;
+            if (i < token.size() && token[i] == ',') i++;
+            else break;
+        }
+    }
+    if (i < token.size() && token[i] == '+') {
+        int penalty;
+        if (!parseIndex(token.substr(i + 1), penalty)) {
+            fail("bad penalty in '" + std::string(token) + "'");
+        }
+        out.penalty = penalty;
+        i = token.size();
+    }
+    if (i != token.size()) {
+        fail("unexpected text in move '" + std::string(token) + "'");
+    }
+}
+
+bool NotationParser::next(NotationGame& game) {
+    std::string_view token;
+    bool lineStart;
+
+    game.moves.clear();
+    for (std::string_view& name : game.names) name = std::string_view();
+    game.winnerSeat = -2;
+
+    if (!pendingGame) {
+        if (!nextToken(token, lineStart)) return false;
+        if (!lineStart || token != "game") {
+            fail("expected a 'game' line");
+        }
+    }
+    pendingGame = false;
+    game.line = lineNumber;
+
+    unsigned int seed;
+    int players;
+    if (!nextToken(token, lineStart) || lineStart || !parseSeed(token, seed)) {
+        fail("'game' needs a seed");
+    }
+    if (!nextToken(token, lineStart) || lineStart || !parseIndex(token, players) ||
+        players < 2 || players > MAX_SEATS) {
+        fail("'game' needs 2 to 4 players");
+    }
+    game.seed = seed;
+    game.players = players;
+
+    while (nextToken(token, lineStart)) {
+        if (lineStart && token == "game") {
+            pendingGame = true; // The next call starts from this header
+            return true;
+        }
+        if (lineStart && token == "name") {
+            int seat;
+            if (!nextToken(token, lineStart) || lineStart || !parseIndex(token, seat) || seat >= players) {
+                fail("'name' needs a seat number");
+            }
+            // The name is the rest of the line, without surrounding blanks or a comment
+            size_t end = position;
+            while (end < text.size() && text[end] != '\n' && text[end] != '#') end++;
+            std::string_view name = text.substr(position, end - position);
+            size_t first = name.find_first_not_of(" \t\r");
+            size_t last = name.find_last_not_of(" \t\r");
+            game.names[seat] = first == std::string_view::npos ? std::string_view() : name.substr(first, last - first + 1);
+            position = end;
+            continue;
+        }
+        if (lineStart && token == "result") {
+            if (!nextToken(token, lineStart) || lineStart) {
+                fail("'result' needs a seat or 'none'");
+            }
+            if (token == "none") {
+                game.winnerSeat = -1;
+            } else if (!parseIndex(token, game.winnerSeat) || game.winnerSeat >= players) {
+                fail("'result' needs a seat or 'none'");
+            }
+            continue;
+        }
+
+        game.moves.emplace_back();
+        parseMove(token, game.moves.back());
+    }
+    return true;
+}
+
+void formatNotation(const NotationGame& game, std::string& out) {
+    out += "game " + std::to_string(game.seed) + " " + std::to_string(game.players) + "\n";
+    for (int seat = 0; seat < game.players; ++seat) {
+        if (!game.names[seat].empty()) {
+            out += "name " + std::to_string(seat) + " ";
+            out += game.names[seat];
+            out += "\n";
+        }
+    }
+
+    int turnsOnLine = 0;
+    bool lineEmpty = true;
+    for (const NotationMove& entry : game.moves) {
+        const Move& move = entry.move;
+        if (!lineEmpty) out += ' ';
+        lineEmpty = false;
+        switch (move.type) {
+            case MoveType::Draw: out += 'd'; break;
+            case MoveType::CallUno: out += 'u'; break;
+            case MoveType::EndTurn: out += '/'; break;
+            case MoveType::Play:
+                out += std::to_string(move.handIndex);
+                if (move.color != CardColor::NONE) out += letterFromColor(move.color);
+                for (int i = 0; i < move.dropCount; ++i) {
+                    out += i == 0 ? '^' : ',';
+                    out += std::to_string(move.dropIndices[i]);
+                }
+                if (entry.penalty > 0) out += "+" + std::to_string(entry.penalty);
+                break;
+        }
+        if (move.type == MoveType::EndTurn && ++turnsOnLine == TURNS_PER_LINE) {
+            out += '\n';
+            turnsOnLine = 0;
+            lineEmpty = true;
+        }
+    }
+    if (!lineEmpty) out += '\n';
+
+    if (game.winnerSeat == -1) out += "result none\n";
+    else if (game.winnerSeat >= 0) out += "result " + std::to_string(game.winnerSeat) + "\n";
+}
+
+// Cards held by every player still in the game
+static int cardsInHands(const UnoGame& game) {
+    int total = 0;
+    for (int p = 0; p < game.getPlayerCount(); ++p) {
+        total += game.getPlayer(p)->getHandSize();
+    }
+    return total;
+}
+
+// Penalty cards dealt by a move: hand growth beyond what the move itself explains
+static int penaltyDealt(const Move& move, int before, int after) {
+    if (move.type != MoveType::Play) return 0;
+    return after - before + 1 + move.dropCount;
+}
+
+NotationWriter::NotationWriter(const std::string& filePath)
+    : out(filePath, std::ios::binary | std::ios::trunc), path(filePath), cardsBefore(0), games(0) {
+    if (!out) {
+        throw Uno::ResourceException("Cannot open notation file for writing: " + filePath);
+    }
+}
+
+void NotationWriter::onGameStart(const UnoGame& table, unsigned int seed) {
+    game.seed = seed;
+    game.players = table.getPlayerCount();
+    game.moves.clear();
+    cardsBefore = cardsInHands(table);
+}
+
+void NotationWriter::onTurn(const TurnRecord&) {}
+
+void NotationWriter::onMove(const UnoGame& table, const Move& move) {
+    int cardsAfter = cardsInHands(table);
+    NotationMove entry;
+    entry.move = move;
+    int penalty = penaltyDealt(move, cardsBefore, cardsAfter);
+    entry.penalty = penalty > 0 ? penalty : -1;
+    game.moves.push_back(entry);
+    cardsBefore = cardsAfter;
+}
+
+void NotationWriter::onGameEnd(const GameResult& result) {
+    game.winnerSeat = result.winnerSeat;
+    text.clear();
+    formatNotation(game, text);
+    out.write(text.data(), text.size());
+    if (!out) {
+        throw Uno::ResourceException("Failed writing notation file: " + path);
+    }
+    games++;
+}
+
+void NotationWriter::close() {
+    out.close();
+}
+
+uint64_t NotationWriter::gamesWritten() const {
+    return games;
+}
+
+// Seats the players of a notated or recorded game and deals the cards
+static void setUpGame(UnoGame& game, unsigned int seed, int players, const std::string_view* names,
+                      std::vector<Player*>& seats) {
+    game.setSeed(seed);
+    for (int i = 0; i < players; ++i) {
+        std::string name = names && !names[i].empty() ? std::string(names[i]) : "Bot " + std::to_string(i + 1);
+        Player* player = new Player(name);
+        seats.push_back(player);
+        game.addPlayer(player);
+    }
+    game.startGame();
+}
+
+void replayToNotation(const Replay& replay, NotationGame& out) {
+    UnoGame game;
+    std::vector<Player*> seats;
+    setUpGame(game, replay.seed, replay.players, nullptr, seats);
+
+    out.seed = replay.seed;
+    out.players = replay.players;
+    for (std::string_view& name : out.names) name = std::string_view();
+    out.moves.clear();
+    for (const Move& move : replay.moves) {
+        int before = cardsInHands(game);
+        game.makeMove(move);
+        NotationMove entry;
+        entry.move = move;
+        int penalty = penaltyDealt(move, before, cardsInHands(game));
+        entry.penalty = penalty > 0 ? penalty : -1;
+        out.moves.push_back(entry);
+    }
+    out.winnerSeat = replay.winnerSeat;
+}
+
+ReplayCheck verifyNotation(const NotationGame& notation) {
+    UnoGame game;
+    std::vector<Player*> seats;
+    setUpGame(game, notation.seed, notation.players, notation.names, seats);
+
+    ReplayCheck check;
+    int turn = 0;
+    for (size_t i = 0; i < notation.moves.size() && check.matched; ++i) {
+        const NotationMove& entry = notation.moves[i];
+        check.turn = turn;
+        check.move = i;
+        if (game.isGameOver()) {
+            check.matched = false;
+            check.reason = "game ended before the notated moves ran out";
+            break;
+        }
+
+        int before = cardsInHands(game);
+        try {
+            game.makeMove(entry.move);
+        } catch (const Uno::UnoException& e) {
+            check.matched = false;
+            check.reason = std::string("move is not legal: ") + e.what();
+            break;
+        }
+        int penalty = penaltyDealt(entry.move, before, cardsInHands(game));
+        if (entry.penalty >= 0 && entry.penalty != std::max(penalty, 0)) {
+            check.matched = false;
+            check.reason = "move dealt " + std::to_string(penalty) + " penalty cards, notation says " +
+                           std::to_string(entry.penalty);
+        }
+        if (entry.move.type == MoveType::EndTurn) turn++;
+    }
+    if (!check.matched) return check;
+
+    check.turn = turn;
+    check.move = -1;
+    if (notation.winnerSeat != -2) {
+        int winner = findWinnerSeat(game, seats);
+        if (winner != notation.winnerSeat) {
+            check.matched = false;
+            check.reason = "winner differs: seat " + std::to_string(winner) + " vs " +
+                           std::to_string(notation.winnerSeat);
+        }
+    }
+    return check;
+}
@@ -2,16 +2,20 @@
 #include "../header/Card.h"
 #include "../header/Deck.h"
 #include "../header/UnoGame.h"
+#include "../header/StateDelta.h"
+#include "../header/CardCode.h"
+#include "../header/ByteBuffer.h"
 #include <iostream>
 
 Player::Player(const std::string& n)
-    : name(n), hasCalledUNO(false) {
+    : name(n), hasCalledUNO(false), recorder(nullptr) {
 }
 
 void Player::drawCard(Deck& deck) {
     Card* drawnCard = deck.drawCard();
     if (drawnCard) {
         hand.push_back(drawnCard); // Add the drawn card to the player's hand
+        if (recorder) recorder->record(DeltaOpType::HandPush, hand.size() - 1, 0, 0, this, drawnCard);
         // Reset UNO call if player has more than one card now
         if (hand.size() > 1) {
             resetUNOCall();
@@ -25,6 +29,7 @@ void Player::playCard(int index, UnoGame& game) {
         
         // Remove the card from the player's hand
         hand.erase(hand.begin() + index);
+        if (recorder) recorder->record(DeltaOpType::HandErase, index, 0, 0, this, cardToPlay);
         
         // Then play the card which applies its effects
         cardToPlay->play(game, this);
@@ -49,6 +54,7 @@ void Player::displayHand() const {
 
 void Player::callUNO() {
     if (hand.size() == 2) {
+        if (recorder && !hasCalledUNO) recorder->record(DeltaOpType::UnoFlag, 0, false, true, this);
         hasCalledUNO = true;
         std::cout << name << " has called UNO!" << std::endl;
     } else {
@@ -61,12 +67,14 @@ bool Player::hasCalledUNOStatus() const {
 }
 
 void Player::resetUNOCall() {
+    if (recorder && hasCalledUNO) recorder->record(DeltaOpType::UnoFlag, 0, true, false, this);
     hasCalledUNO = false;
 }
 
 void Player::removeCardFromHand(int index) {
     if (index >= 0 && index < hand.size()) {
         // Don't delete the card as it will be used elsewhere (transferred ownership)
+        if (recorder) recorder->record(DeltaOpType::HandErase, index, 0, 0, this, hand[index]);
         hand.erase(hand.begin() + index);
     }
 }
@@ -95,6 +103,79 @@ void Player::drawHand(int startX, int startY) const {
     }
 }
 
+void Player::setRecorder(StateDelta* delta) {
+    recorder = delta;
+}
+
+void Player::revertOp(const DeltaOp& op) {
+    switch (op.type) {
+        case DeltaOpType::HandPush:
+            hand.pop_back(); // The drawn card is returned to the deck by its own op
+            break;
+        case DeltaOpType::HandErase:
+            hand.insert(hand.begin() + op.index, op.card);
+            break;
+        case DeltaOpType::UnoFlag:
+            hasCalledUNO = op.before;
+            break;
+        default:
+            break;
+    }
+}
+
+void Player::replayOp(const DeltaOp& op) {
+    switch (op.type) {
+        case DeltaOpType::HandPush:
+            hand.push_back(op.card);
+            break;
+        case DeltaOpType::HandErase:
+            hand.erase(hand.begin() + op.index);
+            break;
+        case DeltaOpType::UnoFlag:
+            hasCalledUNO = op.after;
+            break;
+        default:
+            break;
+    }
+}
+
+void Player::saveState(ByteWriter& out) const {
+    out.putString(name);
+    out.putU8(hasCalledUNO ? 1 : 0);
+    out.putVarint(hand.size());
+    for (Card* card : hand) {
+        out.putU16(encodeCard(card));
+    }
+}
+
+Player* Player::loadState(ByteReader& in, Deck& deck) {
+    Player* player = new Player(in.getString());
+    try {
+        player->hasCalledUNO = in.getU8() != 0;
+        uint64_t count = in.getVarint();
+        if (count > in.remaining() / 2) {
+            throw Uno::InvalidInputException("Snapshot hand size is larger than the snapshot");
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            Card* card = deck.makeCard(in.getU16());
+            if (!card) {
+                throw Uno::CardException("Snapshot hand contains an empty card slot");
+            }
+            player->hand.push_back(card);
+        }
+    } catch (...) {
+        delete player;
+        throw;
+    }
+    return player;
+}
+
+void Player::returnHand(Deck& deck) {
+    for (Card* card : hand) {
+        deck.recycle(card);
+    }
+    hand.clear();
+}
 
 Player::~Player() {
     for (Card* card : hand) {
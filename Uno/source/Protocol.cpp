@@ -0,0 +1,347 @@
+#include "../header/Protocol.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Card.h"
+#include "../header/CardUtils.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <memory>
+
+static const size_t FRAME_HEADER_SIZE = 4;
+static const int ELIMINATION_HAND_SIZE = 21; // As in UnoGame::drawCard and makeNextPlayerDraw
+
+TableView::TableView() {
+    for (int s = 0; s < MAX_SEATS; ++s) {
+        handSizes[s] = -1;
+        calledUno[s] = false;
+    }
+}
+
+size_t beginFrame(std::vector<uint8_t>& out, uint8_t type) {
+    size_t start = out.size();
+    out.resize(start + FRAME_HEADER_SIZE);
+    out.push_back(type);
+    return start;
+}
+
+void finishFrame(std::vector<uint8_t>& out, size_t start) {
+    uint32_t size = static_cast<uint32_t>(out.size() - start - FRAME_HEADER_SIZE);
+    for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+        out[start + i] = (size >> (8 * i)) & 0xFF;
+    }
+}
+
+bool completeFrame(const uint8_t* data, size_t size, size_t& frameSize) {
+    if (size < FRAME_HEADER_SIZE) return false;
+    uint32_t body = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    if (body == 0 || body > MAX_FRAME_SIZE) {
+        throw Uno::InvalidInputException("Frame size " + std::to_string(body) + " is out of range");
+    }
+    frameSize = FRAME_HEADER_SIZE + body;
+    return size >= frameSize;
+}
+
+void writePublicView(ByteWriter& out, const TableView& view) {
+    out.putVarint(view.tableId);
+    out.putVarint(view.version);
+    out.putU8(view.seats);
+    out.putU8(view.currentSeat);
+    out.putU8(view.flags);
+    out.putU16(view.topCard);
+    for (int s = 0; s < view.seats; ++s) {
+        out.putString(view.names[s]);
+        out.putSigned(view.handSizes[s]);
+        out.putU8(view.calledUno[s] ? 1 : 0);
+    }
+}
+
+void writePrivateView(ByteWriter& out, int seat, const std::vector<CardCode>& hand) {
+    out.putU8(seat);
+    out.putVarint(hand.size());
+    for (CardCode code : hand) {
+        out.putU16(code);
+    }
+}
+
+void writeTableView(ByteWriter& out, const TableView& view) {
+    writePublicView(out, view);
+    writePrivateView(out, view.seat, view.hand);
+}
+
+void readTableView(ByteReader& in, TableView& view) {
+    view.tableId = in.getVarint();
+    view.version = in.getVarint();
+    view.seats = in.getU8();
+    view.currentSeat = in.getU8();
+    view.flags = in.getU8();
+    view.topCard = in.getU16();
+    if (view.seats > MAX_SEATS) {
+        throw Uno::InvalidInputException("Table view has too many seats");
+    }
+    for (int s = 0; s < MAX_SEATS; ++s) {
+        if (s < view.seats) {
+            view.names[s] = in.getString();
+            view.handSizes[s] = static_cast<int>(in.getSigned());
+            view.calledUno[s] = in.getU8() != 0;
+        } else {
+            view.names[s].clear();
+            view.handSizes[s] = -1;
+            view.calledUno[s] = false;
+        }
+    }
+    view.seat = in.getU8();
+    uint64_t count = in.getVarint();
+    if (count > in.remaining() / 2) {
+        throw Uno::InvalidInputException("Table view hand is larger than the message");
+    }
+    view.hand.clear();
+    for (uint64_t i = 0; i < count; ++i) {
+        view.hand.push_back(in.getU16());
+    }
+}
+
+static int readSeat(ByteReader& in, const TableView& view) {
+    int seat = in.getU8();
+    if (seat >= view.seats) {
+        throw Uno::InvalidInputException("Table delta names seat " + std::to_string(seat));
+    }
+    return seat;
+}
+
+void readTableList(ByteReader& in, TableListPage& list) {
+    list.seats = in.getU8();
+    list.rating = static_cast<int>(in.getVarint());
+    list.page = in.getVarint();
+    list.pageCount = in.getVarint();
+    uint64_t count = in.getVarint();
+    if (count > in.remaining() / 4) {
+        throw Uno::InvalidInputException("Table list is longer than the message");
+    }
+    list.tables.resize(count);
+    for (LobbyTable& table : list.tables) {
+        table.tableId = in.getVarint();
+        table.seats = in.getU8();
+        table.taken = in.getU8();
+        table.rating = static_cast<int>(in.getVarint());
+    }
+}
+
+bool applyTableDelta(ByteReader& in, TableView& view) {
+    uint64_t tableId = in.getVarint();
+    uint64_t version = in.getVarint();
+    if (tableId != view.tableId || version != view.version + 1) return false;
+
+    uint64_t drawnCount = in.getVarint();
+    if (drawnCount > in.remaining() / 2) {
+        throw Uno::InvalidInputException("Table delta draws more cards than the message holds");
+    }
+    std::vector<CardCode> drawn;
+    for (uint64_t i = 0; i < drawnCount; ++i) {
+        drawn.push_back(in.getU16());
+    }
+    size_t nextDrawn = 0;
+
+    uint64_t changes = in.getVarint();
+    for (uint64_t c = 0; c < changes; ++c) {
+        ViewChange kind = static_cast<ViewChange>(in.getU8());
+        switch (kind) {
+            case ViewChange::Drew: {
+                int seat = readSeat(in, view);
+                uint64_t count = in.getVarint();
+                if (seat == view.seat) {
+                    if (count > drawn.size() - nextDrawn) {
+                        throw Uno::InvalidInputException("Table delta is missing drawn cards");
+                    }
+                    view.hand.insert(view.hand.end(), drawn.begin() + nextDrawn, drawn.begin() + nextDrawn + count);
+                    nextDrawn += count;
+                }
+                view.handSizes[seat] += static_cast<int>(count);
+                break;
+            }
+            case ViewChange::Removed: {
+                int seat = readSeat(in, view);
+                uint64_t index = in.getVarint();
+                if (seat == view.seat) {
+                    if (index >= view.hand.size()) {
+                        throw Uno::InvalidInputException("Table delta removes a card the hand does not have");
+                    }
+                    view.hand.erase(view.hand.begin() + index);
+                }
+                view.handSizes[seat]--;
+                break;
+            }
+            case ViewChange::Uno: {
+                int seat = readSeat(in, view);
+                view.calledUno[seat] = in.getU8() != 0;
+                break;
+            }
+            case ViewChange::Eliminated: {
+                int seat = readSeat(in, view);
+                view.handSizes[seat] = -1;
+                view.calledUno[seat] = false;
+                if (seat == view.seat) view.hand.clear();
+                break;
+            }
+            case ViewChange::Turn:
+                view.currentSeat = in.getU8();
+                break;
+            case ViewChange::Flags:
+                view.flags = in.getU8();
+                break;
+            case ViewChange::TopCard:
+                view.topCard = in.getU16();
+                break;
+            default:
+                throw Uno::InvalidInputException("Unknown table change " + std::to_string(static_cast<int>(kind)));
+        }
+    }
+    view.version = version;
+    return true;
+}
+
+// The next seat still in the game, as UnoGame::nextPlayerIndex counts players
+static int nextSeat(const TableView& view, int seat) {
+    int step = (view.flags & VIEW_REVERSED) ? view.seats - 1 : 1;
+    for (int i = 0; i < view.seats; ++i) {
+        seat = (seat + step) % view.seats;
+        if (view.handSizes[seat] >= 0) break;
+    }
+    return seat;
+}
+
+// UnoGame::eliminatePlayer: the seat leaves the turn order while the engine's
+// current index stays put, so the turn can land on another seat
+static void eliminateSeat(TableView& view, int seat) {
+    int order[MAX_SEATS];
+    int count = 0;
+    int current = 0;
+    for (int s = 0; s < view.seats; ++s) {
+        if (view.handSizes[s] < 0 || s == seat) continue;
+        order[count++] = s;
+    }
+    for (int s = 0; s < view.seats; ++s) {
+        if (s == view.currentSeat) break;
+        if (view.handSizes[s] >= 0) current++;
+    }
+    if (current >= count) current = 0;
+    if (count > 0) view.currentSeat = order[current];
+    view.handSizes[seat] = -1;
+    view.calledUno[seat] = false;
+    if (seat == view.seat) view.hand.clear();
+}
+
+static int cardsDealtNext(CardKind kind) {
+    switch (kind) {
+        case CardKind::DrawTwo: return 2;
+        case CardKind::DrawSix: return 6;
+        case CardKind::DrawFour: return 4;
+        default: return 0;
+    }
+}
+
+void predictMove(TableView& view, const Move& move, bool& playedThisTurn) {
+    // UnoGame::isGameOver, which the server learns of before the view says so
+    int players = 0;
+    bool won = false;
+    for (int s = 0; s < view.seats; ++s) {
+        if (view.handSizes[s] >= 0) players++;
+        if (view.handSizes[s] == 0) won = true;
+    }
+    if (view.seat == NO_SEAT || !(view.flags & VIEW_STARTED) || (view.flags & VIEW_FINISHED) || won || players <= 1) {
+        throw Uno::GameStateException("Table is not running a game");
+    }
+    if (view.currentSeat != view.seat) {
+        throw Uno::GameStateException("It is not your turn");
+    }
+    bool turnActionTaken = (view.flags & VIEW_TURN_ACTION) != 0;
+
+    switch (move.type) {
+        case MoveType::CallUno:
+            if (view.hand.size() == 2) view.calledUno[view.seat] = true;
+            return;
+        case MoveType::Draw:
+            if (turnActionTaken) {
+                throw Uno::InvalidInputException("You have already played or drawn this turn");
+            }
+            // The card itself comes with the server's answer, unless it is one too many
+            view.calledUno[view.seat] = false; // Player::drawCard takes back an UNO call
+            if (view.handSizes[view.seat] + 1 >= ELIMINATION_HAND_SIZE) eliminateSeat(view, view.seat);
+            view.flags |= VIEW_TURN_ACTION;
+            return;
+        case MoveType::EndTurn: {
+            if (!turnActionTaken) {
+                throw Uno::InvalidInputException("Play or draw a card before ending the turn");
+            }
+            // Like UnoGame::applyPendingEffects: the turn passes, then a reverse, then a skip
+            int next = nextSeat(view, view.seat);
+            if (playedThisTurn) {
+                CardKind kind = cardCodeKind(view.topCard);
+                if (kind == CardKind::Reverse && players > 2) view.flags ^= VIEW_REVERSED;
+                if (kind == CardKind::Skip || (kind == CardKind::Reverse && players == 2)) next = nextSeat(view, next);
+            }
+            view.currentSeat = next;
+            view.flags &= ~VIEW_TURN_ACTION;
+            playedThisTurn = false;
+            return;
+        }
+        case MoveType::Play:
+            break;
+    }
+
+    // The checks of UnoGame::playMove, in its order and with its messages
+    if (turnActionTaken) {
+        throw Uno::InvalidInputException("You have already played or drawn this turn");
+    }
+    if (move.handIndex < 0 || move.handIndex >= static_cast<int>(view.hand.size())) {
+        throw Uno::InvalidInputException("Card index out of bounds for playing card");
+    }
+    if (view.topCard == NO_CARD) {
+        throw Uno::CardException("Top card is null when checking card playability");
+    }
+    CardCode code = view.hand[move.handIndex];
+    std::unique_ptr<Card> card(decodeCard(code));
+    std::unique_ptr<Card> top(decodeCard(view.topCard));
+    if (!areCardsPlayable(card.get(), top.get())) {
+        throw Uno::CardException("That card cannot be played on the current top card");
+    }
+    CardKind kind = cardCodeKind(code);
+    bool isWild = kind == CardKind::Wild || kind == CardKind::DrawFour;
+    if (isWild && move.color == CardColor::NONE) {
+        throw Uno::InvalidInputException("A color must be chosen for a wild card");
+    }
+    int remaining = static_cast<int>(view.hand.size()) - 1;
+    if (kind == CardKind::DropTwo) {
+        if (move.dropCount < 0 || move.dropCount > 2 || move.dropCount > remaining) {
+            throw Uno::InvalidInputException("DropTwo can drop at most two cards from the hand");
+        }
+        for (int i = 0; i < move.dropCount; ++i) {
+            if (move.dropIndices[i] < 0 || move.dropIndices[i] >= remaining) {
+                throw Uno::InvalidInputException("Card index out of bounds for dropping card");
+            }
+        }
+        if (move.dropCount == 2 && move.dropIndices[0] == move.dropIndices[1]) {
+            throw Uno::InvalidInputException("The same card cannot be dropped twice");
+        }
+    }
+
+    view.hand.erase(view.hand.begin() + move.handIndex);
+    view.handSizes[view.seat]--;
+    view.topCard = isWild ? makeCardCode(kind, move.color, cardCodeNumber(code)) : code;
+    if (kind == CardKind::DropTwo && move.dropCount > 0) {
+        // Highest index first, so the other still points at the same card
+        int first = move.dropCount == 2 ? std::max(move.dropIndices[0], move.dropIndices[1]) : move.dropIndices[0];
+        view.hand.erase(view.hand.begin() + first);
+        if (move.dropCount == 2) {
+            view.hand.erase(view.hand.begin() + std::min(move.dropIndices[0], move.dropIndices[1]));
+        }
+        view.handSizes[view.seat] -= move.dropCount;
+    }
+    int dealt = cardsDealtNext(kind);
+    if (dealt > 0) {
+        int next = nextSeat(view, view.seat);
+        view.handSizes[next] += dealt;
+        view.calledUno[next] = false;
+        if (view.handSizes[next] >= ELIMINATION_HAND_SIZE) eliminateSeat(view, next);
+    }
+    view.flags |= VIEW_TURN_ACTION;
+    playedThisTurn = true;
+}
@@ -0,0 +1,242 @@
+#include "../header/Replay.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/Card.h"
+#include "../header/CardCode.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Checksum.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <cstring>
+
+static const char REPLAY_MAGIC[8] = {'U', 'N', 'O', 'R', 'P', 'L', '1', '\0'};
+
+uint32_t stateCheck(const UnoGame& game) {
+    uint8_t bytes[4];
+    uint32_t crc = 0;
+
+    int currentSeat = 0xFF;
+    try {
+        Player* current = game.getCurrentPlayer();
+        for (int p = 0; p < game.getPlayerCount(); ++p) {
+            if (game.getPlayer(p) == current) currentSeat = p;
+        }
+    } catch (const Uno::GameStateException&) {
+        // A finished game may have no valid player to move
+    }
+    CardCode top = encodeCard(game.getTopCard());
+    bytes[0] = currentSeat;
+    bytes[1] = (game.isDirectionReversed() ? 1 : 0) | (game.hasPendingSkipEffect() ? 2 : 0) |
+               (game.hasPendingReverseEffect() ? 4 : 0) | (game.hasTakenTurnAction() ? 8 : 0);
+    bytes[2] = top & 0xFF;
+    bytes[3] = top >> 8;
+    crc = crc32(bytes, 4, crc);
+
+    for (int p = 0; p < game.getPlayerCount(); ++p) {
+        Player* player = game.getPlayer(p);
+        int size = player->getHandSize();
+        bytes[0] = size & 0xFF;
+        bytes[1] = size >> 8;
+        bytes[2] = player->hasCalledUNOStatus() ? 1 : 0;
+        crc = crc32(bytes, 3, crc);
+        for (int i = 0; i < size; ++i) {
+            CardCode code = encodeCard(player->getCardAtIndex(i));
+            bytes[0] = code & 0xFF;
+            bytes[1] = code >> 8;
+            crc = crc32(bytes, 2, crc);
+        }
+    }
+    return crc;
+}
+
+void encodeReplay(const Replay& replay, std::vector<uint8_t>& out) {
+    ByteWriter writer(out);
+    writer.putU32(replay.seed);
+    writer.putU8(replay.players);
+    writer.putVarint(replay.turns);
+    writer.putSigned(replay.winnerSeat);
+    writer.putU32(replay.finalCheck);
+    writer.putVarint(replay.moves.size());
+    for (const Move& move : replay.moves) {
+        writeMove(writer, move);
+    }
+    writer.putVarint(replay.turnChecks.size());
+    for (uint16_t check : replay.turnChecks) {
+        writer.putU16(check);
+    }
+}
+
+void decodeReplay(const uint8_t* data, size_t size, Replay& out) {
+    ByteReader reader(data, size);
+    out.seed = reader.getU32();
+    out.players = reader.getU8();
+    out.turns = static_cast<int>(reader.getVarint());
+    out.winnerSeat = static_cast<int>(reader.getSigned());
+    out.finalCheck = reader.getU32();
+    if (out.players < 2 || out.players > MAX_SEATS || out.winnerSeat < -1 || out.winnerSeat >= out.players) {
+        throw Uno::InvalidInputException("Replay has an invalid table setup");
+    }
+
+    // Every move takes at least one byte and every check two, which bounds the counts
+    uint64_t count = reader.getVarint();
+    if (count > reader.remaining()) {
+        throw Uno::InvalidInputException("Replay move count is larger than the record");
+    }
+    out.moves.clear();
+    for (uint64_t i = 0; i < count; ++i) {
+        out.moves.push_back(readMove(reader));
+    }
+    count = reader.getVarint();
+    if (count > reader.remaining() / 2) {
+        throw Uno::InvalidInputException("Replay turn count is larger than the record");
+    }
+    out.turnChecks.clear();
+    for (uint64_t i = 0; i < count; ++i) {
+        out.turnChecks.push_back(reader.getU16());
+    }
+}
+
+ReplayWriter::ReplayWriter(const std::string& filePath)
+    : out(filePath, std::ios::binary | std::ios::trunc), path(filePath), games(0), lastCheck(0) {
+    if (!out) {
+        throw Uno::ResourceException("Cannot open replay archive for writing: " + filePath);
+    }
+    out.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+}
+
+void ReplayWriter::onGameStart(const UnoGame& game, unsigned int seed) {
+    current.seed = seed;
+    current.players = game.getPlayerCount();
+    current.moves.clear();
+    current.turnChecks.clear();
+    lastCheck = stateCheck(game);
+}
+
+void ReplayWriter::onTurn(const TurnRecord&) {}
+
+void ReplayWriter::onMove(const UnoGame& game, const Move& move) {
+    current.moves.push_back(move);
+    lastCheck = stateCheck(game);
+    if (move.type == MoveType::EndTurn) {
+        current.turnChecks.push_back(lastCheck & 0xFFFF);
+    }
+}
+
+void ReplayWriter::onGameEnd(const GameResult& result) {
+    current.turns = result.turns;
+    current.winnerSeat = result.winnerSeat;
+    current.finalCheck = lastCheck;
+    write(current);
+}
+
+void ReplayWriter::write(const Replay& replay) {
+    buffer.assign(8, 0); // Size and CRC are filled in once the payload is known
+    encodeReplay(replay, buffer);
+    uint32_t size = buffer.size() - 8;
+    uint32_t crc = crc32(buffer.data() + 8, size);
+    for (int i = 0; i < 4; ++i) {
+        buffer[i] = (size >> (8 * i)) & 0xFF;
+        buffer[4 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!out) {
+        throw Uno::ResourceException("Failed writing replay archive: " + path);
+    }
+    games++;
+}
+
+void ReplayWriter::close() {
+    out.close();
+}
+
+uint64_t ReplayWriter::gamesWritten() const {
+    return games;
+}
+
+ReplayReader::ReplayReader(const std::string& filePath)
+    : in(filePath, std::ios::binary), path(filePath) {
+    char magic[sizeof(REPLAY_MAGIC)];
+    if (!in || !in.read(magic, sizeof(magic)) || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0) {
+        throw Uno::ResourceException("Not a replay archive: " + filePath);
+    }
+}
+
+bool ReplayReader::isArchive(const std::string& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    char magic[sizeof(REPLAY_MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) == 0;
+}
+
+bool ReplayReader::next(std::vector<uint8_t>& payload) {
+    uint8_t header[8];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        if (in.gcount() == 0) return false; // Clean end of the archive
+        throw Uno::ResourceException("Replay archive ends inside a record header: " + path);
+    }
+    ByteReader reader(header, sizeof(header));
+    uint32_t size = reader.getU32();
+    uint32_t crc = reader.getU32();
+
+    payload.resize(size);
+    if (!in.read(reinterpret_cast<char*>(payload.data()), size)) {
+        throw Uno::ResourceException("Replay archive ends inside a record: " + path);
+    }
+    if (crc32(payload.data(), size) != crc) {
+        throw Uno::ResourceException("Replay record failed its checksum: " + path);
+    }
+    return true;
+}
+
+// Fills a mismatch result and returns it
+static ReplayCheck mismatch(int turn, int move, const std::string& reason) {
+    ReplayCheck check;
+    check.matched = false;
+    check.turn = turn;
+    check.move = move;
+    check.reason = reason;
+    return check;
+}
+
+ReplayCheck verifyReplay(const Replay& replay) {
+    UnoGame game;
+    game.setSeed(replay.seed);
+    std::vector<Player*> seats;
+    for (int i = 0; i < replay.players; ++i) {
+        Player* player = new Player("Bot " + std::to_string(i + 1));
+        seats.push_back(player);
+        game.addPlayer(player);
+    }
+    game.startGame();
+
+    int turn = 0;
+    for (size_t i = 0; i < replay.moves.size(); ++i) {
+        if (game.isGameOver()) {
+            return mismatch(turn, i, "game ended before the recorded moves ran out");
+        }
+        const Move& move = replay.moves[i];
+        try {
+            game.makeMove(move);
+        } catch (const Uno::UnoException& e) {
+            return mismatch(turn, i, std::string("recorded move is no longer legal: ") + e.what());
+        }
+
+        if (move.type == MoveType::EndTurn) {
+            if (turn >= (int)replay.turnChecks.size() || (stateCheck(game) & 0xFFFF) != replay.turnChecks[turn]) {
+                return mismatch(turn, i, "table state differs at the end of the turn");
+            }
+            turn++;
+        }
+    }
+
+    if (turn != replay.turns) {
+        return mismatch(turn, -1, "turn count differs: " + std::to_string(turn) + " vs " + std::to_string(replay.turns));
+    }
+    int winner = findWinnerSeat(game, seats);
+    if (winner != replay.winnerSeat) {
+        return mismatch(turn, -1, "winner differs: seat " + std::to_string(winner) + " vs " + std::to_string(replay.winnerSeat));
+    }
+    if (stateCheck(game) != replay.finalCheck) {
+        return mismatch(turn, -1, "final table state differs");
+    }
+    return ReplayCheck();
+}
@@ -0,0 +1,910 @@
+#include "../header/Router.h"
+#include "../header/EventLoop.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const size_t MAX_HELD_BYTES = 64 * 1024;        // Sent by one client while its table moves
+static const uint64_t MATCH_KEY = 1ull << 63;           // Plus the table size: where searches meet
+static const auto ADOPTION_MEMORY = std::chrono::seconds(60); // How long a TableMoved may trail its TableAdopted
+static const auto CLAIM_PATIENCE = std::chrono::seconds(10);  // How long a claim may wait for its table
+static const int CLAIM_CHECK_MS = 500;                          // Poll timeout while claims wait
+static const auto CONNECT_PATIENCE = std::chrono::seconds(2);   // How long a node may take to accept a link
+static const int CONNECT_CHECK_MS = 50;                         // Poll timeout while links connect
+
+static void appendText(std::vector<uint8_t>& out, ServerMessage type, const std::string& text) {
+    size_t start = beginFrame(out, static_cast<uint8_t>(type));
+    ByteWriter writer(out);
+    writer.putString(text);
+    finishFrame(out, start);
+}
+
+Router::Router(const RouterConfig& routerConfig)
+    : config(routerConfig), listenFd(-1), boundPort(routerConfig.port), stopping(false), reloadRequested(false),
+      nextSessionId(1), nextTableKey(1) {
+}
+
+Router::~Router() {
+    stop();
+    closeAll();
+}
+
+int Router::openListener() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw Uno::ResourceException("Cannot create listening socket");
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(boundPort);
+    if (inet_pton(AF_INET, config.address.c_str(), &address.sin_addr) != 1) {
+        close(fd);
+        throw Uno::InvalidInputException("Invalid listen address: " + config.address);
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        throw Uno::ResourceException("Cannot listen on " + config.address + ":" + std::to_string(boundPort));
+    }
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+    return fd;
+}
+
+void Router::start() {
+    if (thread.joinable()) {
+        throw Uno::GameStateException("Router is already running");
+    }
+    listenFd = openListener();
+    try {
+        try {
+            io.reset(createIoBackend(config.backend, *this, listenFd));
+        } catch (const Uno::ResourceException&) {
+            if (config.backend == IoBackendKind::Epoll) throw;
+            config.backend = IoBackendKind::Epoll; // No usable io_uring on this kernel
+            io.reset(createIoBackend(config.backend, *this, listenFd));
+        }
+        loadNodes();
+        // The first node list must take effect before the thread serves anyone
+        while (!pendingRing.empty() && io->poll(CONNECT_CHECK_MS)) {
+            checkConnects();
+        }
+        if (ring.getNodes().empty()) {
+            throw Uno::ResourceException(ringProblem.empty() ? "Cannot reach the nodes in " + config.nodesFile : ringProblem);
+        }
+    } catch (const Uno::UnoException&) {
+        closeAll();
+        throw;
+    }
+    stopping = false;
+    thread = std::thread(&Router::run, this);
+}
+
+void Router::stop() {
+    stopping = true;
+    if (io) io->wake();
+    if (thread.joinable()) thread.join();
+}
+
+void Router::reload() {
+    reloadRequested = true;
+    if (io) io->wake();
+}
+
+int Router::getPort() const {
+    return boundPort;
+}
+
+IoBackendKind Router::getBackend() const {
+    return config.backend;
+}
+
+void Router::run() {
+    while (!stopping && io->poll(!connecting.empty() ? CONNECT_CHECK_MS : claims.empty() ? -1 : CLAIM_CHECK_MS)) {
+        if (!connecting.empty()) checkConnects();
+        if (!claims.empty()) expireClaims();
+    }
+}
+
+// Everything the router opened, once its thread is gone
+void Router::closeAll() {
+    io.reset(); // Frees what the backend still holds before the connections go
+    for (auto& entry : sessions) {
+        close(entry.second.client->fd);
+        delete entry.second.client;
+    }
+    for (auto& entry : upstreams) {
+        close(entry.first->fd);
+        delete entry.first;
+    }
+    sessions.clear();
+    upstreams.clear();
+    connecting.clear();
+    pendingRing.clear();
+    for (auto& entry : nodes) {
+        entry.second.control = nullptr;
+    }
+    if (listenFd >= 0) close(listenFd);
+    listenFd = -1;
+}
+
+void Router::report(const std::string& problem) {
+    if (config.log) config.log(problem);
+}
+
+// Reads the whole list and opens a control link to every listed node; the ring
+// changes once they are all up (applyRing), so a bad list or an unreachable
+// node leaves the cluster as it was. Nodes
+// dropped from the list keep their control links and sessions: they hand their
+// tables over and serve the players who have not moved yet.
+void Router::loadNodes() {
+    std::ifstream in(config.nodesFile);
+    if (!in) {
+        throw Uno::ResourceException("Cannot read the node list " + config.nodesFile);
+    }
+    std::vector<std::string> names;
+    std::unordered_map<std::string, Node> listed;
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        std::string name, endpoint, extra;
+        if (!(fields >> name) || name[0] == '#') continue;
+        size_t colon = std::string::npos;
+        if (fields >> endpoint) colon = endpoint.rfind(':');
+        if (colon == std::string::npos || colon == 0 || (fields >> extra)) {
+            throw Uno::InvalidInputException(config.nodesFile + ":" + std::to_string(number) + ": expected NAME HOST:PORT");
+        }
+        if (listed.count(name)) {
+            throw Uno::InvalidInputException(config.nodesFile + ":" + std::to_string(number) + ": node " + name + " listed twice");
+        }
+        auto known = nodes.find(name);
+        if (known != nodes.end()) {
+            if (known->second.endpoint != endpoint) {
+                throw Uno::InvalidInputException("Node " + name + " cannot move to " + endpoint + "; list it under a new name");
+            }
+            listed[name] = known->second;
+        } else {
+            addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* found = nullptr;
+            if (getaddrinfo(endpoint.substr(0, colon).c_str(), endpoint.substr(colon + 1).c_str(), &hints, &found) != 0) {
+                throw Uno::InvalidInputException("Cannot resolve node " + name + " at " + endpoint);
+            }
+            Node& node = listed[name];
+            node.endpoint = endpoint;
+            memcpy(&node.address, found->ai_addr, found->ai_addrlen);
+            node.addressLength = found->ai_addrlen;
+            freeaddrinfo(found);
+        }
+        names.push_back(name);
+    }
+    if (names.empty()) {
+        throw Uno::InvalidInputException("No nodes listed in " + config.nodesFile);
+    }
+
+    for (auto& entry : listed) {
+        if (!nodes.count(entry.first)) nodes[entry.first] = entry.second;
+    }
+    for (const std::string& name : names) {
+        Node& node = nodes[name];
+        if (node.control) continue;
+        node.control = connectTo(name, 0);
+        if (!node.control) {
+            throw Uno::ResourceException("Cannot reach node " + name + " at " + node.endpoint);
+        }
+        size_t start = beginFrame(node.control->output, static_cast<uint8_t>(ClientMessage::PeerHello));
+        ByteWriter writer(node.control->output);
+        writer.putString(config.clusterKey);
+        finishFrame(node.control->output, start);
+        io->flush(node.control);
+    }
+
+    pendingRing = names;
+    ringProblem.clear();
+    applyRing();
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = moved.begin(); it != moved.end();) {
+        if (now - it->second.at > ADOPTION_MEMORY && !claims.count(it->first)) {
+            it = moved.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Switches to the pending node list once every control link it needs is up
+void Router::applyRing() {
+    for (const std::string& name : pendingRing) {
+        if (connecting.count(nodes[name].control)) return;
+    }
+    std::vector<std::string> names;
+    names.swap(pendingRing);
+    ring = HashRing(names);
+    for (auto& entry : nodes) {
+        Connection* control = entry.second.control;
+        if (!control) continue;
+        size_t start = beginFrame(control->output, static_cast<uint8_t>(ClientMessage::SetRing));
+        ByteWriter writer(control->output);
+        writer.putString(entry.first);
+        writer.putVarint(names.size());
+        for (const std::string& name : names) {
+            writer.putString(name);
+        }
+        finishFrame(control->output, start);
+        io->flush(control);
+    }
+}
+
+// Starts connecting and returns at once; nullptr if the connect fails outright.
+// Frames queued meanwhile go out when the socket turns writable, and
+// checkConnects gives up on a link that takes longer than CONNECT_PATIENCE.
+Connection* Router::connectTo(const std::string& name, uint64_t sessionId) {
+    const Node& node = nodes.at(name);
+    int fd = socket(node.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return nullptr;
+    bool up = connect(fd, reinterpret_cast<const sockaddr*>(&node.address), node.addressLength) == 0;
+    if (!up && errno != EINPROGRESS) {
+        close(fd);
+        return nullptr;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    Connection* connection = new Connection();
+    connection->fd = fd;
+    connection->sessionId = sessionId;
+    Upstream& upstream = upstreams[connection];
+    upstream.sessionId = sessionId;
+    upstream.node = name;
+    io->attach(connection);
+    if (!up) connecting[connection] = std::chrono::steady_clock::now() + CONNECT_PATIENCE;
+    return connection;
+}
+
+// Settles the links still connecting: those that came up leave the list, and
+// those that failed or ran out of time are given up on
+void Router::checkConnects() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<Connection*> failed;
+    for (auto it = connecting.begin(); it != connecting.end();) {
+        int fd = it->first->fd;
+        int error = 0;
+        socklen_t length = sizeof(error);
+        sockaddr_storage peer;
+        socklen_t peerLength = sizeof(peer);
+        bool broken = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0;
+        if (!broken && getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &peerLength) == 0) {
+            it = connecting.erase(it);
+            continue;
+        }
+        if (broken || now >= it->second) failed.push_back(it->first);
+        ++it;
+    }
+    for (Connection* connection : failed) {
+        connectFailed(connection);
+    }
+    if (!pendingRing.empty()) applyRing();
+}
+
+// A link that never came up. A session gets an error and tries the node again
+// with its next frame for it; a control link keeps its node list from taking effect.
+void Router::connectFailed(Connection* connection) {
+    connecting.erase(connection);
+    auto found = upstreams.find(connection);
+    if (found == upstreams.end()) return;
+    std::string node = found->second.node;
+    uint64_t sessionId = found->second.sessionId;
+    upstreams.erase(found);
+    io->release(connection);
+
+    if (sessionId == 0) {
+        Node& listed = nodes[node];
+        if (listed.control == connection) listed.control = nullptr;
+        std::string problem = "Cannot reach node " + node + " at " + listed.endpoint;
+        if (std::find(pendingRing.begin(), pendingRing.end(), node) != pendingRing.end()) {
+            pendingRing.clear();
+            ringProblem = problem;
+            if (ring.getNodes().empty()) return; // start() throws it
+            problem = "Node list not reloaded: " + problem;
+        }
+        report(problem);
+        return;
+    }
+    auto owner = sessions.find(sessionId);
+    if (owner == sessions.end()) return;
+    Session& session = owner->second;
+    session.upstreams.erase(node);
+    sendText(session.client, ServerMessage::Error, "Node " + node + " is unreachable");
+    if (session.claimSent && session.tableNode == node) {
+        session.claimSent = false; // As when claim() cannot forward at all
+        session.claimOpen = false;
+        finishMove(sessionId);
+    }
+}
+
+// The session's connection to node, opened and introduced on first use
+Connection* Router::upstreamFor(uint64_t sessionId, Session& session, const std::string& node) {
+    auto found = session.upstreams.find(node);
+    if (found != session.upstreams.end()) return found->second;
+    Connection* connection = connectTo(node, sessionId);
+    if (!connection) return nullptr;
+    size_t start = beginFrame(connection->output, static_cast<uint8_t>(ClientMessage::Hello));
+    ByteWriter writer(connection->output);
+    writer.putString(session.name);
+    finishFrame(connection->output, start);
+    session.upstreams[node] = connection;
+    return connection;
+}
+
+std::string Router::nodeFor(uint64_t key) const {
+    int owner = ring.owner(key);
+    return owner < 0 ? std::string() : ring.getNodes()[owner];
+}
+
+void Router::onAccept(int fd) {
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    Connection* connection = new Connection();
+    connection->fd = fd;
+    connection->sessionId = nextSessionId++;
+    sessions[connection->sessionId].client = connection;
+    io->attach(connection);
+}
+
+void Router::onInput(Connection* connection) {
+    if (upstreams.count(connection)) {
+        upstreamInput(connection);
+        return;
+    }
+    auto found = sessions.find(connection->sessionId);
+    if (found != sessions.end()) clientInput(connection, found->second);
+}
+
+void Router::onHangup(Connection* connection) {
+    if (upstreams.count(connection)) {
+        closeUpstream(connection);
+    } else {
+        closeSession(connection->sessionId);
+    }
+}
+
+void Router::onWake() {
+    if (!reloadRequested.exchange(false)) return;
+    try {
+        loadNodes();
+    } catch (const Uno::UnoException& e) {
+        report(std::string("Node list not reloaded: ") + e.what());
+    }
+}
+
+// Drops consumed bytes once they make up most of the buffer
+static void compactInput(Connection* connection) {
+    if (connection->inputStart == connection->input.size()) {
+        connection->input.clear();
+        connection->inputStart = 0;
+    } else if (connection->inputStart > connection->input.size() / 2) {
+        connection->input.erase(connection->input.begin(), connection->input.begin() + connection->inputStart);
+        connection->inputStart = 0;
+    }
+}
+
+void Router::clientInput(Connection* connection, Session& session) {
+    uint64_t sessionId = connection->sessionId;
+    try {
+        size_t frameSize;
+        while (true) {
+            const uint8_t* frame = connection->input.data() + connection->inputStart;
+            size_t size = connection->input.size() - connection->inputStart;
+            if (connection->unpacker) {
+                size_t packedSize = connection->unpacker->unpack(frame, size, unpacked);
+                if (packedSize == 0) break;
+                connection->inputStart += packedSize;
+                frame = unpacked.data();
+                frameSize = unpacked.size();
+            } else {
+                if (!completeFrame(frame, size, frameSize)) break;
+                connection->inputStart += frameSize;
+            }
+            routeFrame(sessionId, session, frame, frameSize);
+            if (!sessions.count(sessionId)) return;
+        }
+    } catch (const Uno::InvalidInputException& e) {
+        sendText(connection, ServerMessage::Error, e.what());
+        closeSession(sessionId);
+        return;
+    }
+    compactInput(connection);
+}
+
+// Sends one client frame where it belongs. The router answers Hello and Ping
+// itself; everything else goes to a node, which validates it as usual.
+void Router::routeFrame(uint64_t sessionId, Session& session, const uint8_t* frame, size_t size) {
+    if (frame[4] == static_cast<uint8_t>(ClientMessage::UseCompression)) {
+        useCompression(session, frame, size); // Not held: the frames after it are packed already
+        return;
+    }
+    if (session.moving) {
+        if (session.held.size() + size > MAX_HELD_BYTES) {
+            throw Uno::InvalidInputException("Too much sent while the table moved");
+        }
+        session.held.insert(session.held.end(), frame, frame + size);
+        return;
+    }
+    ByteReader reader(frame + 4, size - 4);
+    ClientMessage type = static_cast<ClientMessage>(reader.getU8());
+    switch (type) {
+        case ClientMessage::Hello: {
+            session.name = reader.getString();
+            for (auto& entry : session.upstreams) {
+                upstreams[entry.second].welcomed = false; // Its node welcomes the new name again
+                entry.second->output.insert(entry.second->output.end(), frame, frame + size);
+                io->flush(entry.second);
+            }
+            std::vector<uint8_t> welcome;
+            size_t start = beginFrame(welcome, static_cast<uint8_t>(ServerMessage::Welcome));
+            ByteWriter writer(welcome);
+            writer.putVarint(sessionId);
+            finishFrame(welcome, start);
+            session.client->sendFrames(welcome);
+            io->flush(session.client);
+            return;
+        }
+        case ClientMessage::Ping: {
+            uint64_t token = reader.getU64();
+            std::vector<uint8_t> pong;
+            size_t start = beginFrame(pong, static_cast<uint8_t>(ServerMessage::Pong));
+            ByteWriter writer(pong);
+            writer.putU64(token);
+            finishFrame(pong, start);
+            session.client->sendFrames(pong);
+            io->flush(session.client);
+            return;
+        }
+        case ClientMessage::CreateTable:
+        case ClientMessage::JoinTable:
+        case ClientMessage::Spectate:
+        case ClientMessage::ClaimSeat:
+        case ClientMessage::FindMatch: {
+            std::string node;
+            if (type == ClientMessage::CreateTable) {
+                node = nodeFor(nextTableKey++);
+            } else if (type == ClientMessage::FindMatch) {
+                node = nodeFor(MATCH_KEY | reader.getU8());
+            } else {
+                node = nodeFor(reader.getVarint());
+            }
+            // A node refuses a second table itself; one elsewhere is left first
+            if (!session.tableNode.empty() && session.tableNode != node) {
+                std::vector<uint8_t> leave;
+                finishFrame(leave, beginFrame(leave, static_cast<uint8_t>(ClientMessage::LeaveTable)));
+                forward(sessionId, session, session.tableNode, leave.data(), leave.size());
+            }
+            if (type == ClientMessage::FindMatch) session.matchNode = node;
+            session.tableNode = node;
+            forward(sessionId, session, node, frame, size);
+            return;
+        }
+        case ClientMessage::CancelMatch:
+            if (!session.matchNode.empty()) forward(sessionId, session, session.matchNode, frame, size);
+            return;
+        case ClientMessage::PlayMove:
+            if (session.tableNode.empty()) {
+                sendText(session.client, ServerMessage::MoveRejected, "Not at a table");
+            } else {
+                forward(sessionId, session, session.tableNode, frame, size);
+            }
+            return;
+        case ClientMessage::LeaveTable:
+            if (!session.tableNode.empty()) forward(sessionId, session, session.tableNode, frame, size);
+            session.tableNode.clear();
+            return;
+        case ClientMessage::UseCompression:
+            return; // Handled above
+        case ClientMessage::ListTables:
+            // Each node lists only its own tables, and the router keeps no lobby of its own
+            sendText(session.client, ServerMessage::Error, "Table lists are not available through the router");
+            return;
+        case ClientMessage::PeerHello:
+        case ClientMessage::SetRing:
+        case ClientMessage::AdoptTable:
+            sendText(session.client, ServerMessage::Error, "Only the cluster router may do that");
+            return;
+    }
+    throw Uno::InvalidInputException("Unknown message type " + std::to_string(static_cast<int>(type)));
+}
+
+// Compression is between the client and the router; the nodes always get plain frames
+void Router::useCompression(Session& session, const uint8_t* frame, size_t size) {
+    ByteReader reader(frame + 5, size - 5);
+    int dictionary = reader.getU8();
+    if (dictionary != COMPRESSION_DICTIONARY) {
+        throw Uno::InvalidInputException("Unknown compression dictionary " + std::to_string(dictionary));
+    }
+    Connection* client = session.client;
+    if (client->packer) {
+        sendText(client, ServerMessage::Error, "Compression is already on");
+        return;
+    }
+    finishFrame(client->output, beginFrame(client->output, static_cast<uint8_t>(ServerMessage::CompressionOn)));
+    client->packer.reset(new FramePacker());
+    client->unpacker.reset(new FrameUnpacker());
+    io->flush(client);
+}
+
+bool Router::forward(uint64_t sessionId, Session& session, const std::string& node, const uint8_t* frame, size_t size) {
+    if (node.empty()) {
+        sendText(session.client, ServerMessage::Error, "No nodes in the cluster");
+        return false;
+    }
+    Connection* upstream = upstreamFor(sessionId, session, node);
+    if (!upstream) {
+        sendText(session.client, ServerMessage::Error, "Node " + node + " is unreachable");
+        return false;
+    }
+    upstream->output.insert(upstream->output.end(), frame, frame + size);
+    io->flush(upstream);
+    return true;
+}
+
+void Router::upstreamInput(Connection* connection) {
+    Upstream& upstream = upstreams[connection];
+    uint64_t sessionId = upstream.sessionId;
+    std::string node = upstream.node;
+    try {
+        size_t frameSize;
+        while (completeFrame(connection->input.data() + connection->inputStart,
+                             connection->input.size() - connection->inputStart, frameSize)) {
+            const uint8_t* frame = connection->input.data() + connection->inputStart;
+            connection->inputStart += frameSize;
+            ByteReader reader(frame + 4, frameSize - 4);
+            ServerMessage type = static_cast<ServerMessage>(reader.getU8());
+            if (sessionId == 0) {
+                controlFrame(node, type, reader);
+                continue;
+            }
+
+            auto found = sessions.find(sessionId);
+            if (found == sessions.end()) return;
+            Session& session = found->second;
+            if (type == ServerMessage::Welcome && !upstream.welcomed) {
+                upstream.welcomed = true; // The client has the router's
+                continue;
+            }
+            if (type == ServerMessage::TableMoved) {
+                tableMoved(sessionId, session, connection, reader);
+                if (!sessions.count(sessionId)) return;
+                continue;
+            }
+            if (type == ServerMessage::MoveBounced) {
+                moveBounced(sessionId, session, node, frame + 5, frameSize - 5);
+                if (!sessions.count(sessionId)) return;
+                continue;
+            }
+            if (type == ServerMessage::Pong) {
+                // Only the router pings nodes: the one the table left has bounced all it will
+                if (session.pings > 0) session.pings--;
+                finishMove(sessionId);
+                if (!sessions.count(sessionId)) return;
+                continue;
+            }
+            if (session.claimSent && node == session.tableNode) {
+                // The answer to the claim: the seat (or view) back, or an Error
+                session.claimSent = false;
+                if (type == ServerMessage::Error) {
+                    session.tableNode.clear();
+                    if (retryClaim(session)) {
+                        if (!sessions.count(sessionId)) return;
+                        continue;
+                    }
+                }
+                session.client->sendFrames(frame, frameSize);
+                io->flush(session.client);
+                session.claimOpen = false;
+                finishMove(sessionId);
+                if (!sessions.count(sessionId)) return;
+                continue;
+            }
+            session.client->sendFrames(frame, frameSize);
+            io->flush(session.client);
+        }
+    } catch (const Uno::InvalidInputException& e) {
+        report("Bad frame from node " + node + ": " + e.what());
+        closeUpstream(connection);
+        return;
+    }
+    compactInput(connection);
+}
+
+void Router::controlFrame(const std::string& node, ServerMessage type, ByteReader& frame) {
+    switch (type) {
+        case ServerMessage::TableExport: {
+            size_t size = frame.getVarint();
+            const uint8_t* state = frame.getBytes(size);
+            uint64_t hop = frame.getVarint();
+            ByteReader peek(state, size);
+            uint64_t tableId = peek.getVarint(); // saveState starts with the id
+            tableExported(tableId, hop);
+            std::string owner = nodeFor(tableId);
+            Connection* control = owner.empty() ? nullptr : nodes[owner].control;
+            if (!control) {
+                report("Table " + std::to_string(tableId) + " from node " + node + " has nowhere to go");
+                tableAdopted(owner, tableId, false, hop);
+                return;
+            }
+            size_t start = beginFrame(control->output, static_cast<uint8_t>(ClientMessage::AdoptTable));
+            ByteWriter writer(control->output);
+            writer.putVarint(size);
+            writer.putBytes(state, size);
+            writer.putVarint(hop);
+            finishFrame(control->output, start);
+            io->flush(control);
+            return;
+        }
+        case ServerMessage::TableAdopted: {
+            uint64_t tableId = frame.getVarint();
+            bool ok = frame.getU8() != 0;
+            uint64_t hop = frame.getVarint();
+            tableAdopted(node, tableId, ok, hop);
+            return;
+        }
+        case ServerMessage::Error:
+            report("Node " + node + ": " + frame.getString());
+            return;
+        default:
+            return;
+    }
+}
+
+// The session's table left the node it was on. Its frames wait until the seat
+// is claimed on the new node, which may already have the table, and until a
+// Ping to the old node comes back: a seat's notice follows the moves the node
+// bounced before it, and the Pong follows the ones it bounced after.
+void Router::tableMoved(uint64_t sessionId, Session& session, Connection* from, ByteReader& notice) {
+    uint64_t tableId = notice.getVarint();
+    Claim pending;
+    pending.sessionId = sessionId;
+    pending.seat = notice.getU8();
+    pending.token = notice.getU64();
+    pending.hop = notice.getVarint();
+    pending.giveUpAt = std::chrono::steady_clock::now() + CLAIM_PATIENCE;
+    session.moving = true;
+    session.claimOpen = true;
+    session.claimSent = false;
+    session.tableNode.clear();
+
+    if (pending.seat != NO_SEAT) {
+        size_t start = beginFrame(from->output, static_cast<uint8_t>(ClientMessage::Ping));
+        ByteWriter writer(from->output);
+        writer.putU64(tableId);
+        finishFrame(from->output, start);
+        io->flush(from);
+        session.pings++;
+    }
+    placeClaim(tableId, pending);
+}
+
+// A move the node could not play because the table had left it. Bounces come
+// just before the TableMoved or after it, and go to the new node first;
+// one from a node the session is done with is simply routed again.
+void Router::moveBounced(uint64_t sessionId, Session& session, const std::string& node, const uint8_t* move,
+                         size_t size) {
+    std::vector<uint8_t> frame;
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::PlayMove));
+    frame.insert(frame.end(), move, move + size);
+    finishFrame(frame, start);
+    if (!session.moving && node != session.tableNode) {
+        routeFrame(sessionId, session, frame.data(), frame.size());
+    } else if (session.bounced.size() + frame.size() > MAX_HELD_BYTES) {
+        sendText(session.client, ServerMessage::MoveRejected, "Not at a table");
+    } else {
+        session.bounced.insert(session.bounced.end(), frame.begin(), frame.end());
+    }
+}
+
+void Router::tableExported(uint64_t tableId, uint64_t hop) {
+    Whereabouts& where = moved[tableId];
+    if (hop <= where.adopted) where = Whereabouts(); // A new table under an old id, after a node started afresh
+    where.exported = hop;
+    where.at = std::chrono::steady_clock::now();
+}
+
+// The table arrived (or was lost): the claims that waited for this hop or an earlier one go ahead
+void Router::tableAdopted(const std::string& node, uint64_t tableId, bool ok, uint64_t hop) {
+    Whereabouts& where = moved[tableId];
+    where.node = ok ? node : std::string();
+    where.adopted = hop;
+    where.exported = std::max(where.exported, hop);
+    where.at = std::chrono::steady_clock::now();
+    if (where.exported > hop) return; // On its way again already
+
+    auto found = claims.find(tableId);
+    if (found == claims.end()) return;
+    std::vector<Claim> pending;
+    pending.swap(found->second);
+    claims.erase(found);
+    for (Claim& each : pending) {
+        if (each.hop > hop) {
+            claims[tableId].push_back(each);
+        } else if (ok) {
+            each.hop = hop;
+            claim(tableId, node, each);
+        } else {
+            giveUpClaim(each, "Table " + std::to_string(tableId) + " was lost while moving");
+        }
+    }
+}
+
+// Claims where the table is once the move the claim names is over, and
+// waits for the node that adopts it otherwise
+void Router::placeClaim(uint64_t tableId, const Claim& pending) {
+    auto found = moved.find(tableId);
+    if (found == moved.end() || found->second.adopted < pending.hop || found->second.exported > found->second.adopted) {
+        claims[tableId].push_back(pending);
+        return;
+    }
+    if (found->second.node.empty()) {
+        giveUpClaim(pending, "Table " + std::to_string(tableId) + " was lost while moving");
+        return;
+    }
+    Claim placed = pending;
+    placed.hop = found->second.adopted;
+    claim(tableId, found->second.node, placed);
+}
+
+// Takes the seat back on the node that adopted the table; spectators watch again
+void Router::claim(uint64_t tableId, const std::string& node, const Claim& pending) {
+    auto found = sessions.find(pending.sessionId);
+    if (found == sessions.end()) return;
+    Session& session = found->second;
+    std::vector<uint8_t> frame;
+    if (pending.seat == NO_SEAT) {
+        size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::Spectate));
+        ByteWriter writer(frame);
+        writer.putVarint(tableId);
+        finishFrame(frame, start);
+    } else {
+        size_t start = beginFrame(frame, static_cast<uint8_t>(ClientMessage::ClaimSeat));
+        ByteWriter writer(frame);
+        writer.putVarint(tableId);
+        writer.putU8(pending.seat);
+        writer.putU64(pending.token);
+        writer.putVarint(0); // The client's version is unknown here, so it gets a full view
+        finishFrame(frame, start);
+    }
+    if (forward(pending.sessionId, session, node, frame.data(), frame.size())) {
+        session.tableNode = node;
+        session.claimSent = true;
+        session.claimTable = tableId;
+        session.claim = pending;
+    } else {
+        session.claimOpen = false;
+        finishMove(pending.sessionId);
+    }
+}
+
+// A refused claim most likely met a table that had moved on meanwhile: it
+// waits for the next hop, unless it has waited long enough
+bool Router::retryClaim(Session& session) {
+    if (std::chrono::steady_clock::now() >= session.claim.giveUpAt) return false;
+    Claim retry = session.claim;
+    retry.hop++;
+    placeClaim(session.claimTable, retry);
+    return true;
+}
+
+void Router::giveUpClaim(const Claim& pending, const std::string& reason) {
+    auto found = sessions.find(pending.sessionId);
+    if (found == sessions.end()) return;
+    sendText(found->second.client, ServerMessage::Error, reason);
+    found->second.claimOpen = false;
+    finishMove(pending.sessionId);
+}
+
+void Router::expireClaims() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, Claim>> expired;
+    for (auto it = claims.begin(); it != claims.end();) {
+        std::vector<Claim>& waiting = it->second;
+        for (size_t i = 0; i < waiting.size();) {
+            if (waiting[i].giveUpAt <= now) {
+                expired.emplace_back(it->first, waiting[i]);
+                waiting[i] = waiting.back();
+                waiting.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        it = waiting.empty() ? claims.erase(it) : std::next(it);
+    }
+    for (const auto& each : expired) {
+        giveUpClaim(each.second, "Table " + std::to_string(each.first) + " was lost while moving");
+    }
+}
+
+// Ends the hold once the seat is back, or lost, and the nodes the table left have bounced all they will
+void Router::finishMove(uint64_t sessionId) {
+    auto found = sessions.find(sessionId);
+    if (found == sessions.end()) return;
+    const Session& session = found->second;
+    if (session.moving && !session.claimOpen && session.pings == 0) releaseHeld(sessionId);
+}
+
+// Ends a session's hold and routes the bounced moves, then what it sent meanwhile
+void Router::releaseHeld(uint64_t sessionId) {
+    auto found = sessions.find(sessionId);
+    if (found == sessions.end()) return;
+    Session& session = found->second;
+    session.moving = false;
+    std::vector<uint8_t> held;
+    held.swap(session.bounced);
+    held.insert(held.end(), session.held.begin(), session.held.end());
+    session.held.clear();
+    try {
+        size_t at = 0;
+        size_t frameSize;
+        while (completeFrame(held.data() + at, held.size() - at, frameSize)) {
+            routeFrame(sessionId, session, held.data() + at, frameSize);
+            at += frameSize;
+            if (!sessions.count(sessionId)) return;
+        }
+    } catch (const Uno::InvalidInputException& e) {
+        sendText(session.client, ServerMessage::Error, e.what());
+        closeSession(sessionId);
+    }
+}
+
+void Router::sendText(Connection* connection, ServerMessage type, const std::string& text) {
+    std::vector<uint8_t> frame;
+    appendText(frame, type, text);
+    connection->sendFrames(frame);
+    io->flush(connection);
+}
+
+// The client left: so does its every upstream, which frees its seats on the nodes
+void Router::closeSession(uint64_t sessionId) {
+    auto found = sessions.find(sessionId);
+    if (found == sessions.end()) return;
+    for (auto& entry : found->second.upstreams) {
+        upstreams.erase(entry.second);
+        connecting.erase(entry.second);
+        io->release(entry.second);
+    }
+    io->release(found->second.client);
+    sessions.erase(found);
+}
+
+void Router::closeUpstream(Connection* connection) {
+    if (connecting.count(connection)) {
+        connectFailed(connection); // Refused or reset before it was up
+        return;
+    }
+    auto found = upstreams.find(connection);
+    if (found == upstreams.end()) return;
+    if (found->second.sessionId != 0) {
+        closeSession(found->second.sessionId); // Its node went away mid-session
+        return;
+    }
+    Node& node = nodes[found->second.node];
+    if (node.control == connection) node.control = nullptr; // Opened again by the next reload
+    report("Lost the control link to node " + found->second.node);
+    upstreams.erase(found);
+    io->release(connection);
+}
@@ -0,0 +1,333 @@
+#include "../header/Server.h"
+#include "../header/EventLoop.h"
+#include "../header/Matchmaker.h"
+#include "../header/MoveJournal.h"
+#include "../header/Metrics.h"
+#include "../header/Handoff.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+static const uint32_t HANDOFF_MAGIC = 0x484F4E55; // "UNOH"
+
+Server::Server(const ServerConfig& serverConfig)
+    : config(serverConfig), boundPort(serverConfig.port), nextSessionId(1), handedOff(false) {
+    if (config.threads <= 0) {
+        config.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+Server::~Server() {
+    stop();
+}
+
+// Opens one SO_REUSEPORT listener; every loop gets its own on the same port
+int Server::openListener() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw Uno::ResourceException("Cannot create listening socket");
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(boundPort);
+    if (inet_pton(AF_INET, config.address.c_str(), &address.sin_addr) != 1) {
+        close(fd);
+        throw Uno::InvalidInputException("Invalid listen address: " + config.address);
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, config.backlog) != 0) {
+        close(fd);
+        throw Uno::ResourceException("Cannot listen on " + config.address + ":" + std::to_string(boundPort));
+    }
+
+    // With port 0 the first listener picks the port and the others share it
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+    return fd;
+}
+
+void Server::addLoop(int listenFd) {
+    int i = loopCount();
+    try {
+        loops.emplace_back(new EventLoop(*this, i, listenFd, config.backend));
+    } catch (const Uno::ResourceException&) {
+        if (i > 0 || config.backend == IoBackendKind::Epoll) {
+            close(listenFd);
+            throw;
+        }
+        // No usable io_uring on this kernel; every loop uses epoll instead
+        config.backend = IoBackendKind::Epoll;
+        loops.emplace_back(new EventLoop(*this, i, listenFd, config.backend));
+    }
+}
+
+void Server::start() {
+    if (!loops.empty()) {
+        throw Uno::GameStateException("Server is already running");
+    }
+    if (!config.takeoverPath.empty()) {
+        takeOver();
+        return;
+    }
+    if (!config.metricsAddress.empty()) {
+        metrics.reset(new MetricsEndpoint(config.metricsAddress));
+    }
+    for (int i = 0; i < config.threads; ++i) {
+        addLoop(openListener());
+    }
+    if (!config.journalDir.empty()) {
+        openJournals(true);
+    }
+    matchmaker.reset(new Matchmaker(*this));
+    if (!config.handoffPath.empty()) {
+        handoff.reset(new HandoffListener(config.handoffPath, [this](int channel) { return handOff(channel); }));
+    }
+    startServing();
+}
+
+void Server::startServing() {
+    lobby.start(); // Applies what importState listed meanwhile
+    for (auto& loop : loops) {
+        loop->start();
+    }
+    matchmaker->start();
+    if (metrics) metrics->start();
+    if (handoff) handoff->start();
+}
+
+// Adopts the running server's state. That server keeps its sockets until
+// confirm(), so anything that fails before it leaves the old one serving.
+void Server::takeOver() {
+    ReceivedHandoff received(config.takeoverPath);
+    ByteReader reader(received.getData(), received.getSize());
+    if (reader.getU32() != HANDOFF_MAGIC) {
+        throw Uno::InvalidInputException("The handoff did not come from a game server");
+    }
+    uint64_t count = reader.getVarint();
+    nextSessionId = reader.getVarint();
+    std::string name = reader.getString();
+    std::vector<std::string> nodes(reader.getVarint());
+    for (std::string& node : nodes) {
+        node = reader.getString();
+    }
+    setRing(name, nodes);
+    const std::vector<int>& fds = received.getFds();
+    if (count == 0 || count > fds.size()) {
+        throw Uno::InvalidInputException("The handoff is missing listening sockets");
+    }
+
+    // The listeners come first; table ids and seats assume the same loop count
+    config.threads = static_cast<int>(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        addLoop(fds[i]);
+    }
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    getsockname(fds[0], reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+
+    matchmaker.reset(new Matchmaker(*this));
+    for (auto& loop : loops) {
+        loop->importState(reader, fds);
+    }
+    if (!config.metricsAddress.empty()) {
+        metrics.reset(new MetricsEndpoint(config.metricsAddress)); // The old server gave the address up
+    }
+    received.confirm();
+    if (!config.journalDir.empty()) {
+        openJournals(false); // The games came with the handoff
+    }
+    if (!config.handoffPath.empty()) {
+        handoff.reset(new HandoffListener(config.handoffPath, [this](int channel) { return handOff(channel); }));
+    }
+    startServing();
+}
+
+// Before serving: puts back the games a crash interrupted, each on the loop
+// its id belongs to now (the loop count may have changed), then has every loop
+// rewrite its journal as the games it runs. Journals of loops this server does
+// not have go once their games are safe in the others.
+void Server::openJournals(bool recover) {
+    std::error_code error;
+    std::filesystem::create_directories(config.journalDir, error);
+    std::vector<std::string> stale;
+    std::filesystem::directory_iterator files(config.journalDir, error);
+    for (; recover && !error && files != std::filesystem::directory_iterator(); files.increment(error)) {
+        std::string file = files->path().string();
+        std::string name = files->path().filename().string();
+        if (name.compare(0, 5, "loop-") != 0 || files->path().extension() != ".journal") continue;
+        for (const auto& game : MoveJournal::recover(file)) {
+            try {
+                loopForTable(game.first).recoverTable(game.first, game.second);
+            } catch (const Uno::UnoException& e) {
+                throw Uno::InvalidInputException("Cannot recover table " + std::to_string(game.first) + " from " + file + ": " + e.what());
+            }
+        }
+        bool owned = false;
+        for (int i = 0; i < loopCount(); ++i) {
+            owned = owned || std::filesystem::path(EventLoop::journalPath(config.journalDir, i)).filename() == name;
+        }
+        if (!owned) stale.push_back(file);
+    }
+    for (auto& loop : loops) {
+        loop->openJournal();
+    }
+    for (const std::string& file : stale) {
+        std::filesystem::remove(file, error);
+    }
+}
+
+// Stops serving, writes everything out and passes it to the successor. If the
+// successor does not confirm, everything starts again and false is returned.
+bool Server::handOff(int channel) {
+    metrics.reset(); // Frees its address for the successor
+    matchmaker->stop(); // It posts to the loops, so it goes first
+    for (auto& loop : loops) {
+        loop->stop();
+    }
+    for (auto& loop : loops) {
+        loop->join();
+    }
+    for (auto& loop : loops) {
+        loop->quiesce();
+    }
+    // Queued work posts to other loops, so drain until every inbox stays empty
+    bool ran;
+    do {
+        ran = false;
+        for (auto& loop : loops) {
+            ran = loop->runQueued() || ran;
+        }
+    } while (ran);
+
+    std::vector<uint8_t> state;
+    std::vector<int> fds;
+    ByteWriter writer(state);
+    writer.putU32(HANDOFF_MAGIC);
+    writer.putVarint(loops.size());
+    writer.putVarint(nextSessionId.load());
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        writer.putString(nodeName);
+        writer.putVarint(ring.getNodes().size());
+        for (const std::string& node : ring.getNodes()) {
+            writer.putString(node);
+        }
+    }
+    for (auto& loop : loops) {
+        fds.push_back(loop->getListenFd());
+    }
+    for (auto& loop : loops) {
+        loop->exportState(writer, fds);
+    }
+    try {
+        sendHandoff(channel, state, fds);
+        if (receiveHandoffStep(channel, HANDOFF_ADOPTED) && sendHandoffStep(channel, HANDOFF_COMMIT)) {
+            handedOff = true;
+            return true;
+        }
+    } catch (const Uno::ResourceException&) {
+        // The successor is gone or never got everything; carry on serving
+    }
+
+    for (auto& loop : loops) {
+        loop->resume();
+        if (!config.journalDir.empty()) {
+            try {
+                loop->openJournal(); // The successor may have rewritten it already
+            } catch (const Uno::ResourceException&) {
+                // The loop serves without one
+            }
+        }
+        loop->start();
+    }
+    matchmaker->start();
+    if (!config.metricsAddress.empty()) {
+        try {
+            metrics.reset(new MetricsEndpoint(config.metricsAddress));
+            metrics->start();
+        } catch (const Uno::ResourceException&) {
+            // The successor may hold the address until it exits; serving matters more
+        }
+    }
+    return false;
+}
+
+void Server::stop() {
+    handoff.reset(); // Waits for a handoff under way
+    metrics.reset();
+    if (matchmaker) matchmaker->stop(); // It posts to the loops, so it goes first
+    for (auto& loop : loops) {
+        loop->stop();
+    }
+    for (auto& loop : loops) {
+        loop->join();
+    }
+    loops.clear();
+    matchmaker.reset();
+    lobby.stop(); // Nothing reports to it any more
+}
+
+bool Server::isHandedOff() const {
+    return handedOff;
+}
+
+int Server::getPort() const {
+    return boundPort;
+}
+
+IoBackendKind Server::getBackend() const {
+    return config.backend;
+}
+
+const ServerConfig& Server::getConfig() const {
+    return config;
+}
+
+int Server::loopCount() const {
+    return static_cast<int>(loops.size());
+}
+
+EventLoop& Server::getLoop(int index) {
+    return *loops[index];
+}
+
+EventLoop& Server::loopForTable(uint64_t tableId) {
+    return *loops[tableId % loops.size()];
+}
+
+Matchmaker& Server::getMatchmaker() {
+    return *matchmaker;
+}
+
+Lobby& Server::getLobby() {
+    return lobby;
+}
+
+uint64_t Server::newSessionId() {
+    return nextSessionId++;
+}
+
+void Server::setRing(const std::string& name, const std::vector<std::string>& nodes) {
+    HashRing updated(nodes);
+    std::lock_guard<std::mutex> lock(ringMutex);
+    ring = std::move(updated);
+    nodeName = name;
+}
+
+bool Server::ownsTable(uint64_t tableId) const {
+    std::lock_guard<std::mutex> lock(ringMutex);
+    if (ring.empty()) return true;
+    int owner = ring.owner(tableId);
+    return ring.getNodes()[owner] == nodeName;
+}
@@ -0,0 +1,441 @@
+#include "../header/ServerTable.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/Card.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+
+ServerTable::ServerTable() : game(nullptr) {
+    clear();
+}
+
+ServerTable::ServerTable(uint64_t tableId, int seats) : ServerTable() {
+    reset(tableId, seats);
+}
+
+ServerTable::~ServerTable() {
+}
+
+// The engine is made once and reset between games
+static UnoGame* freshGame(std::unique_ptr<UnoGame>& engine) {
+    if (engine) {
+        engine->reset();
+    } else {
+        engine.reset(new UnoGame());
+    }
+    return engine.get();
+}
+
+void ServerTable::clear() {
+    if (game) game->reset(); // The game owns the players
+    game = nullptr;
+    id = 0;
+    seatCount = 0;
+    status = TableStatus::Waiting;
+    winnerSeat = -1;
+    for (int s = 0; s < MAX_SEATS; ++s) {
+        seatPlayers[s] = nullptr;
+        names[s].clear();
+        occupied[s] = false;
+    }
+    // Cleared rather than freed: the next table in this object writes its frames into them
+    version = 1;
+    publicVersion = 0;
+    publicView.clear();
+    for (int s = 0; s <= MAX_SEATS; ++s) {
+        frameVersions[s] = 0;
+        viewFrames[s].clear();
+        deltaFrameVersions[s] = 0;
+        deltaFrames[s].clear();
+    }
+    for (DeltaRecord& record : history) {
+        record.version = 0;
+        record.changes.clear();
+        for (std::vector<CardCode>& drawn : record.drawn) drawn.clear();
+    }
+    deltaVersion = 0;
+    movesSinceSnapshot = 0;
+}
+
+void ServerTable::reset(uint64_t tableId, int seats) {
+    if (seats < 2 || seats > MAX_SEATS) {
+        throw Uno::InvalidInputException("Tables need between 2 and 4 seats");
+    }
+    clear();
+    id = tableId;
+    seatCount = seats;
+}
+
+int ServerTable::seatOf(const Player* player) const {
+    for (int s = 0; s < seatCount; ++s) {
+        if (seatPlayers[s] == player) return s;
+    }
+    return NO_SEAT;
+}
+
+int ServerTable::join(const std::string& name) {
+    if (status != TableStatus::Waiting) return -1;
+    for (int s = 0; s < seatCount; ++s) {
+        if (!occupied[s]) {
+            occupied[s] = true;
+            names[s] = name;
+            version++;
+            return s;
+        }
+    }
+    return -1;
+}
+
+void ServerTable::leave(int seat) {
+    if (seat < 0 || seat >= seatCount || !occupied[seat]) return;
+    occupied[seat] = false;
+    version++;
+    if (status == TableStatus::Playing) {
+        status = TableStatus::Finished; // Nobody can take over the seat mid-game
+        winnerSeat = -1;
+    }
+}
+
+void ServerTable::start(unsigned int seed) {
+    if (status != TableStatus::Waiting || occupiedSeats() != seatCount) {
+        throw Uno::GameStateException("Table can only start once every seat is taken");
+    }
+    game = freshGame(engine);
+    game->setSeed(seed);
+    for (int s = 0; s < seatCount; ++s) {
+        seatPlayers[s] = new Player(names[s]);
+        game->addPlayer(seatPlayers[s]);
+    }
+    game->startGame();
+    status = TableStatus::Playing;
+    version++;
+}
+
+void ServerTable::applyMove(int seat, const Move& move) {
+    if (status != TableStatus::Playing) {
+        throw Uno::GameStateException("Table is not running a game");
+    }
+    if (seat != getCurrentSeat()) {
+        throw Uno::GameStateException("It is not your turn");
+    }
+    int previousSeat = getCurrentSeat();
+    uint8_t previousFlags = viewFlags();
+    CardCode previousTop = encodeCard(game->getTopCard());
+    game->makeMove(move);
+    version++;
+
+    if (game->isGameOver()) {
+        std::vector<Player*> seats(seatPlayers, seatPlayers + seatCount);
+        winnerSeat = findWinnerSeat(*game, seats);
+        status = TableStatus::Finished;
+    }
+    recordDelta(previousSeat, previousFlags, previousTop);
+}
+
+uint8_t ServerTable::viewFlags() const {
+    uint8_t flags = 0;
+    if (!game) return flags;
+    flags |= VIEW_STARTED;
+    if (game->isDirectionReversed()) flags |= VIEW_REVERSED;
+    if (game->hasTakenTurnAction()) flags |= VIEW_TURN_ACTION;
+    if (status == TableStatus::Finished) flags |= VIEW_FINISHED;
+    return flags;
+}
+
+// Turns the engine's record of the move into the changes a client can see.
+// Pile operations are hidden; hand contents only go to their owner.
+void ServerTable::recordDelta(int previousSeat, uint8_t previousFlags, CardCode previousTop) {
+    // Recorded even when the move goes out as full views, so a resuming player can replay it
+    DeltaRecord& record = history[version % DELTA_HISTORY];
+    record.version = version;
+    record.changes.clear();
+    for (int s = 0; s < MAX_SEATS; ++s) {
+        record.drawn[s].clear();
+    }
+    std::vector<uint8_t> changes;
+    ByteWriter writer(changes);
+    int count = 0;
+    int drawSeat = NO_SEAT; // Consecutive draws by one seat become a single Drew
+    int drawCount = 0;
+    auto flushDraws = [&]() {
+        if (drawCount == 0) return;
+        writer.putU8(static_cast<uint8_t>(ViewChange::Drew));
+        writer.putU8(drawSeat);
+        writer.putVarint(drawCount);
+        count++;
+        drawCount = 0;
+    };
+
+    const StateDelta* delta = game->lastMoveDelta();
+    for (const DeltaOp& op : delta->ops) {
+        int seat = op.player ? seatOf(op.player) : NO_SEAT;
+        switch (op.type) {
+            case DeltaOpType::HandPush:
+                if (seat != drawSeat) flushDraws();
+                drawSeat = seat;
+                drawCount++;
+                record.drawn[seat].push_back(encodeCard(op.card));
+                break;
+            case DeltaOpType::HandErase:
+                flushDraws();
+                writer.putU8(static_cast<uint8_t>(ViewChange::Removed));
+                writer.putU8(seat);
+                writer.putVarint(op.index);
+                count++;
+                break;
+            case DeltaOpType::UnoFlag:
+                flushDraws();
+                writer.putU8(static_cast<uint8_t>(ViewChange::Uno));
+                writer.putU8(seat);
+                writer.putU8(op.after ? 1 : 0);
+                count++;
+                break;
+            case DeltaOpType::Eliminate:
+                flushDraws();
+                writer.putU8(static_cast<uint8_t>(ViewChange::Eliminated));
+                writer.putU8(seat);
+                count++;
+                break;
+            default:
+                break; // Piles, pending effects and the rest are not part of a view
+        }
+    }
+    flushDraws();
+
+    // Turn, flags and top card are compared rather than replayed, so each goes out once
+    if (getCurrentSeat() != previousSeat) {
+        writer.putU8(static_cast<uint8_t>(ViewChange::Turn));
+        writer.putU8(getCurrentSeat());
+        count++;
+    }
+    if (viewFlags() != previousFlags) {
+        writer.putU8(static_cast<uint8_t>(ViewChange::Flags));
+        writer.putU8(viewFlags());
+        count++;
+    }
+    CardCode top = encodeCard(game->getTopCard());
+    if (top != previousTop) {
+        writer.putU8(static_cast<uint8_t>(ViewChange::TopCard));
+        writer.putU16(top);
+        count++;
+    }
+
+    ByteWriter header(record.changes);
+    header.putVarint(count);
+    header.putBytes(changes.data(), changes.size());
+
+    if (++movesSinceSnapshot >= SNAPSHOT_INTERVAL) {
+        movesSinceSnapshot = 0;
+        return; // deltaFrame() returns nullptr, so this move goes out as full views
+    }
+    deltaVersion = version;
+}
+
+void ServerTable::buildView(int seat, TableView& view) const {
+    view.tableId = id;
+    view.seat = seat;
+    view.seats = seatCount;
+    view.currentSeat = getCurrentSeat();
+    view.version = version;
+    view.flags = 0;
+    view.topCard = NO_CARD;
+    view.hand.clear();
+    for (int s = 0; s < MAX_SEATS; ++s) {
+        view.names[s] = s < seatCount ? names[s] : std::string();
+        view.handSizes[s] = -1;
+        view.calledUno[s] = false;
+    }
+    if (!game) return;
+
+    view.flags = viewFlags();
+    view.topCard = encodeCard(game->getTopCard());
+
+    // Eliminated players are no longer in the engine's list and keep -1
+    for (int p = 0; p < game->getPlayerCount(); ++p) {
+        Player* player = game->getPlayer(p);
+        int s = seatOf(player);
+        if (s == NO_SEAT) continue;
+        view.handSizes[s] = player->getHandSize();
+        view.calledUno[s] = player->hasCalledUNOStatus();
+    }
+    seatHand(seat, view.hand);
+}
+
+void ServerTable::seatHand(int seat, std::vector<CardCode>& hand) const {
+    hand.clear();
+    if (!game || seat < 0 || seat >= seatCount) return;
+    for (int p = 0; p < game->getPlayerCount(); ++p) {
+        Player* player = game->getPlayer(p);
+        if (player != seatPlayers[seat]) continue; // Eliminated seats have no hand
+        for (int i = 0; i < player->getHandSize(); ++i) {
+            hand.push_back(encodeCard(player->getCardAtIndex(i)));
+        }
+    }
+}
+
+const std::vector<uint8_t>& ServerTable::viewFrame(int seat) {
+    int slot = (seat >= 0 && seat < seatCount) ? seat : MAX_SEATS;
+    if (frameVersions[slot] == version) return viewFrames[slot];
+
+    if (publicVersion != version) {
+        TableView view;
+        buildView(NO_SEAT, view);
+        publicView.clear();
+        ByteWriter writer(publicView);
+        writePublicView(writer, view);
+        publicVersion = version;
+    }
+
+    std::vector<CardCode> hand;
+    seatHand(slot == MAX_SEATS ? NO_SEAT : slot, hand);
+    std::vector<uint8_t>& frame = viewFrames[slot];
+    frame.clear();
+    size_t start = beginFrame(frame, static_cast<uint8_t>(ServerMessage::TableState));
+    ByteWriter writer(frame);
+    writer.putBytes(publicView.data(), publicView.size());
+    writePrivateView(writer, slot == MAX_SEATS ? NO_SEAT : slot, hand);
+    finishFrame(frame, start);
+    frameVersions[slot] = version;
+    return frame;
+}
+
+void ServerTable::writeDeltaFrame(std::vector<uint8_t>& out, int slot, const DeltaRecord& record) const {
+    size_t start = beginFrame(out, static_cast<uint8_t>(ServerMessage::TableDelta));
+    ByteWriter writer(out);
+    writer.putVarint(id);
+    writer.putVarint(record.version);
+    static const std::vector<CardCode> none;
+    const std::vector<CardCode>& drawn = slot == MAX_SEATS ? none : record.drawn[slot];
+    writer.putVarint(drawn.size());
+    for (CardCode code : drawn) {
+        writer.putU16(code);
+    }
+    writer.putBytes(record.changes.data(), record.changes.size());
+    finishFrame(out, start);
+}
+
+const std::vector<uint8_t>* ServerTable::deltaFrame(int seat) {
+    int slot = (seat >= 0 && seat < seatCount) ? seat : MAX_SEATS;
+    if (deltaVersion != version) return nullptr;
+    if (deltaFrameVersions[slot] == version) return &deltaFrames[slot];
+    std::vector<uint8_t>& frame = deltaFrames[slot];
+    frame.clear();
+    writeDeltaFrame(frame, slot, history[version % DELTA_HISTORY]);
+    deltaFrameVersions[slot] = version;
+    return &frame;
+}
+
+bool ServerTable::replayDeltas(int seat, uint64_t since, std::vector<uint8_t>& out) const {
+    if (since > version || version - since > DELTA_HISTORY) return false;
+    for (uint64_t v = since + 1; v <= version; ++v) {
+        if (history[v % DELTA_HISTORY].version != v) return false;
+    }
+    int slot = (seat >= 0 && seat < seatCount) ? seat : MAX_SEATS;
+    for (uint64_t v = since + 1; v <= version; ++v) {
+        writeDeltaFrame(out, slot, history[v % DELTA_HISTORY]);
+    }
+    return true;
+}
+
+void ServerTable::saveState(ByteWriter& writer) const {
+    writer.putVarint(id);
+    writer.putU8(seatCount);
+    writer.putU8(static_cast<uint8_t>(status));
+    writer.putSigned(winnerSeat);
+    writer.putVarint(version);
+    for (int s = 0; s < seatCount; ++s) {
+        writer.putU8(occupied[s] ? 1 : 0);
+        writer.putString(names[s]);
+    }
+    writer.putU8(game ? 1 : 0);
+    if (!game) return;
+
+    std::vector<uint8_t> snapshot;
+    game->saveSnapshot(snapshot);
+    writer.putVarint(snapshot.size());
+    writer.putBytes(snapshot.data(), snapshot.size());
+    // Seats by the engine's player index, which the snapshot keeps; -1 once eliminated
+    for (int s = 0; s < seatCount; ++s) {
+        int index = -1;
+        for (int p = 0; p < game->getPlayerCount(); ++p) {
+            if (game->getPlayer(p) == seatPlayers[s]) index = p;
+        }
+        writer.putSigned(index);
+    }
+}
+
+void ServerTable::loadState(ByteReader& reader) {
+    uint64_t tableId = reader.getVarint();
+    int seats = reader.getU8();
+    reset(tableId, seats);
+    uint8_t saved = reader.getU8();
+    if (saved > static_cast<uint8_t>(TableStatus::Finished)) {
+        throw Uno::InvalidInputException("Saved table has an unknown status");
+    }
+    status = static_cast<TableStatus>(saved);
+    winnerSeat = static_cast<int>(reader.getSigned());
+    version = reader.getVarint();
+    for (int s = 0; s < seats; ++s) {
+        occupied[s] = reader.getU8() != 0;
+        names[s] = reader.getString();
+    }
+    if (!reader.getU8()) return;
+
+    size_t size = reader.getVarint();
+    const uint8_t* snapshot = reader.getBytes(size);
+    game = freshGame(engine);
+    game->loadSnapshot(snapshot, size);
+    // Eliminated seats keep nullptr: their players only matter to the engine from here on
+    for (int s = 0; s < seats; ++s) {
+        int64_t index = reader.getSigned();
+        if (index >= game->getPlayerCount()) {
+            throw Uno::InvalidInputException("Saved seat refers to a missing player");
+        }
+        if (index >= 0) seatPlayers[s] = game->getPlayer(static_cast<int>(index));
+    }
+}
+
+uint64_t ServerTable::getId() const {
+    return id;
+}
+
+uint64_t ServerTable::getVersion() const {
+    return version;
+}
+
+int ServerTable::getSeatCount() const {
+    return seatCount;
+}
+
+int ServerTable::occupiedSeats() const {
+    int count = 0;
+    for (int s = 0; s < seatCount; ++s) {
+        if (occupied[s]) count++;
+    }
+    return count;
+}
+
+bool ServerTable::isSeatOccupied(int seat) const {
+    return seat >= 0 && seat < seatCount && occupied[seat];
+}
+
+TableStatus ServerTable::getStatus() const {
+    return status;
+}
+
+int ServerTable::getCurrentSeat() const {
+    if (!game || status != TableStatus::Playing) return NO_SEAT;
+    return seatOf(game->getCurrentPlayer());
+}
+
+bool ServerTable::hasTakenTurnAction() const {
+    return game && game->hasTakenTurnAction();
+}
+
+int ServerTable::getWinnerSeat() const {
+    return winnerSeat;
+}
+
+const UnoGame* ServerTable::getGame() const {
+    return game;
+}
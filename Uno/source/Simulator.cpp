@@ -0,0 +1,119 @@
+#include "../header/Simulator.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/Card.h"
+#include "../header/Bot.h"
+#include "../header/Exceptions.h"
+#include "../header/Metrics.h"
+#include <algorithm>
+#include <chrono>
+
+static const int LATENCY_SAMPLE = 16;
+
+void TurnObserver::onGameStart(const UnoGame&, unsigned int) {}
+
+void TurnObserver::onMove(const UnoGame&, const Move&) {}
+
+void TurnObserver::onGameEnd(const GameResult&) {}
+
+TurnObserver::~TurnObserver() {}
+
+Simulator::Simulator(int players, int turnLimit)
+    : numPlayers(players), maxTurns(turnLimit), gamesPlayed(0) {
+    if (players < 2 || players > MAX_SEATS) {
+        throw Uno::InvalidInputException("Simulations need between 2 and 4 players");
+    }
+}
+
+GameResult Simulator::playGame(unsigned int seed, const std::vector<Bot*>& bots, TurnObserver* observer) {
+    if ((int)bots.size() != numPlayers) {
+        throw Uno::InvalidInputException("Simulation needs one bot per seat");
+    }
+
+    UnoGame game;
+    game.setSeed(seed);
+    std::vector<Player*> seats;
+    for (int i = 0; i < numPlayers; ++i) {
+        Player* player = new Player("Bot " + std::to_string(i + 1));
+        seats.push_back(player);
+        game.addPlayer(player);
+    }
+    game.startGame();
+    if (observer) observer->onGameStart(game, seed);
+
+    GameResult result{seed, 0, 0, -1};
+    std::vector<Move> legal;
+    bool calledUno = false;
+
+    while (!game.isGameOver() && result.turns < maxTurns) {
+        Player* current = game.getCurrentPlayer();
+        int seat = std::find(seats.begin(), seats.end(), current) - seats.begin();
+
+        game.legalMoves(legal);
+        Move move = bots[seat]->chooseMove(game, legal);
+
+        if (observer && (move.type == MoveType::Play || move.type == MoveType::Draw)) {
+            TurnRecord record;
+            record.game = gamesPlayed;
+            record.turn = result.turns;
+            record.seat = seat;
+            for (int s = 0; s < MAX_SEATS; ++s) {
+                record.handSizes[s] = -1;
+            }
+            for (int p = 0; p < game.getPlayerCount(); ++p) {
+                Player* player = game.getPlayer(p);
+                int playerSeat = std::find(seats.begin(), seats.end(), player) - seats.begin();
+                record.handSizes[playerSeat] = player->getHandSize();
+            }
+            Card* top = game.getTopCard();
+            record.topCard = encodeCard(top);
+            record.topColor = top->getColor();
+            record.move = move;
+            record.moveCard = move.type == MoveType::Play ? encodeCard(current->getCardAtIndex(move.handIndex)) : NO_CARD;
+            record.calledUno = calledUno;
+            record.legalMoves = std::count_if(legal.begin(), legal.end(), [](const Move& m) {
+                return m.type == MoveType::Play || m.type == MoveType::Draw;
+            });
+            record.reversed = game.isDirectionReversed();
+            observer->onTurn(record);
+        }
+
+        // Only threads that report metrics time moves, and only one in LATENCY_SAMPLE:
+        // two clock reads cost a noticeable share of a move
+        bool timed = threadMetrics && result.moves % LATENCY_SAMPLE == 0;
+        std::chrono::steady_clock::time_point moveStart;
+        if (timed) moveStart = std::chrono::steady_clock::now();
+        game.makeMove(move);
+        if (timed) {
+            auto elapsed = std::chrono::steady_clock::now() - moveStart;
+            Metrics::observeMoveLatency(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        }
+        if (observer) observer->onMove(game, move);
+        result.moves++;
+        if (move.type == MoveType::CallUno) {
+            calledUno = true;
+        } else if (move.type == MoveType::EndTurn) {
+            result.turns++;
+            calledUno = false;
+        }
+    }
+
+    result.winnerSeat = findWinnerSeat(game, seats);
+    gamesPlayed++;
+    Metrics::count(Counter::GamesFinished);
+    if (observer) observer->onGameEnd(result);
+    return result;
+}
+
+int findWinnerSeat(UnoGame& game, const std::vector<Player*>& seats) {
+    if (!game.isGameOver()) return -1;
+
+    // The winner emptied their hand, or is the last player standing
+    for (int p = 0; p < game.getPlayerCount(); ++p) {
+        Player* player = game.getPlayer(p);
+        if (player->hasWon() || game.getPlayerCount() == 1) {
+            return std::find(seats.begin(), seats.end(), player) - seats.begin();
+        }
+    }
+    return -1;
+}
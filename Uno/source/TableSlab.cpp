@@ -0,0 +1,145 @@
+#include "../header/TableSlab.h"
+#include "../header/Exceptions.h"
+#include <algorithm>
+
+static const size_t FIRST_INDEX_SIZE = 2 * TABLES_PER_SLAB;
+
+TableSlab::TableSlab(size_t maxTables)
+    : freeSlots(NO_SLOT), count(0), limit(maxTables), index(FIRST_INDEX_SIZE) {
+}
+
+size_t TableSlab::home(uint64_t id) const {
+    // Fibonacci hashing spreads the ids of one loop, which go up in steps of the loop count
+    return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & (index.size() - 1);
+}
+
+uint32_t TableSlab::findSlot(uint64_t id) const {
+    if (id == 0) return NO_SLOT;
+    for (size_t i = home(id);; i = (i + 1) & (index.size() - 1)) {
+        if (index[i].id == id) return index[i].slot;
+        if (index[i].id == 0) return NO_SLOT;
+    }
+}
+
+TableEntry* TableSlab::find(uint64_t id) const {
+    uint32_t slot = findSlot(id);
+    return slot == NO_SLOT ? nullptr : &slotAt(slot).entry;
+}
+
+uint32_t TableSlab::takeSlot() {
+    if (freeSlots == NO_SLOT) {
+        uint32_t first = static_cast<uint32_t>(slabs.size() * TABLES_PER_SLAB);
+        slabs.emplace_back(new Slot[TABLES_PER_SLAB]);
+        for (uint32_t slot = first + TABLES_PER_SLAB; slot-- > first;) {
+            slotAt(slot).nextFree = freeSlots;
+            freeSlots = slot;
+        }
+    }
+    uint32_t slot = freeSlots;
+    Slot& taken = slotAt(slot);
+    freeSlots = taken.nextFree;
+    taken.nextFree = NO_SLOT;
+    taken.entry.table = &taken.table;
+    return slot;
+}
+
+void TableSlab::addToIndex(uint64_t id, uint32_t slot) {
+    if (2 * (count + 1) > index.size()) {
+        std::vector<IndexEntry> old(index.size() * 2);
+        old.swap(index);
+        for (const IndexEntry& entry : old) {
+            if (entry.id == 0) continue;
+            size_t i = home(entry.id);
+            while (index[i].id != 0) i = (i + 1) & (index.size() - 1);
+            index[i] = entry;
+        }
+    }
+    size_t i = home(id);
+    while (index[i].id != 0) i = (i + 1) & (index.size() - 1);
+    index[i].id = id;
+    index[i].slot = slot;
+    slotAt(slot).id = id;
+    count++;
+}
+
+// Backward-shift deletion: entries after the hole that may live there move up,
+// so lookups can keep stopping at the first empty position
+void TableSlab::removeFromIndex(uint64_t id) {
+    size_t mask = index.size() - 1;
+    size_t hole = home(id);
+    while (index[hole].id != id) hole = (hole + 1) & mask;
+    for (size_t i = (hole + 1) & mask; index[i].id != 0; i = (i + 1) & mask) {
+        size_t wanted = home(index[i].id);
+        // Movable unless its home lies cyclically in (hole, i]
+        if (((i - wanted) & mask) >= ((i - hole) & mask)) {
+            index[hole] = index[i];
+            hole = i;
+        }
+    }
+    index[hole] = IndexEntry();
+    count--;
+}
+
+void TableSlab::release(uint32_t slot) {
+    Slot& freed = slotAt(slot);
+    TableEntry& entry = freed.entry;
+    for (SeatRef& seat : entry.seats) seat = SeatRef();
+    entry.spectators.clear();
+    std::fill(entry.claimTokens, entry.claimTokens + MAX_SEATS, 0);
+    std::fill(entry.graceUntil, entry.graceUntil + MAX_SEATS, 0);
+    entry.spectatorBacklog.clear();
+    entry.rating = 0;
+    entry.hops = 0;
+    entry.listed = false;
+    freed.table.clear(); // Ends the game now rather than when the slot is taken again
+    freed.id = 0;
+    freed.nextFree = freeSlots;
+    freeSlots = slot;
+}
+
+TableEntry& TableSlab::create(uint64_t id, int seats) {
+    uint32_t slot = takeSlot();
+    try {
+        slotAt(slot).table.reset(id, seats);
+    } catch (...) {
+        release(slot);
+        throw;
+    }
+    addToIndex(id, slot);
+    return slotAt(slot).entry;
+}
+
+TableEntry& TableSlab::load(ByteReader& reader) {
+    uint32_t slot = takeSlot();
+    try {
+        ServerTable& table = slotAt(slot).table;
+        table.loadState(reader);
+        if (table.getId() == 0) {
+            throw Uno::InvalidInputException("Saved table has no id");
+        }
+        if (findSlot(table.getId()) != NO_SLOT) {
+            throw Uno::InvalidInputException("Table is already hosted here");
+        }
+    } catch (...) {
+        release(slot);
+        throw;
+    }
+    addToIndex(slotAt(slot).table.getId(), slot);
+    return slotAt(slot).entry;
+}
+
+void TableSlab::erase(TableEntry& entry) {
+    uint32_t slot = findSlot(entry.table->getId());
+    if (slot == NO_SLOT || &slotAt(slot).entry != &entry) return;
+    removeFromIndex(entry.table->getId());
+    release(slot);
+}
+
+size_t TableSlab::memoryUsage() const {
+    return slabs.size() * TABLES_PER_SLAB * sizeof(Slot) + index.capacity() * sizeof(IndexEntry);
+}
+
+void TableSlab::iterator::skipFree() {
+    uint32_t end = static_cast<uint32_t>(owner->slabs.size() * TABLES_PER_SLAB);
+    while (slot < end && owner->slotAt(slot).id == 0) ++slot;
+}
@@ -0,0 +1,92 @@
+#include "../header/TimingWheel.h"
+
+static const uint64_t MAX_DELAY = (1ull << (TimingWheel::WHEEL_BITS * TimingWheel::WHEEL_LEVELS)) - 1;
+
+TimingWheel::TimingWheel(uint64_t startTick) : now(startTick), count(0) {
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        for (int slot = 0; slot < WHEEL_SLOTS; ++slot) {
+            slots[level][slot].prev = slots[level][slot].next = &slots[level][slot];
+        }
+    }
+}
+
+void TimingWheel::unlink(TimerNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+}
+
+// Level l holds timers due within WHEEL_SLOTS^(l+1) ticks, in the slot their
+// tick falls in at that level's width
+void TimingWheel::place(TimerNode* node) {
+    uint64_t delay = node->expires - now;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delay >= (1ull << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    TimerNode* head = &slots[level][(node->expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+    node->next = head;
+    node->prev = head->prev;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+// Called as level 0 wraps: the level's slot for the coming stretch is spread over
+// the levels below, and when that slot is also the level's first, the same happens
+// one level up
+void TimingWheel::cascade(int level) {
+    int slot = static_cast<int>((now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+    TimerNode* head = &slots[level][slot];
+    if (head->next != head) {
+        // Detached first: a timer a full turn away goes straight back into this slot
+        TimerNode pending;
+        pending.next = head->next;
+        pending.prev = head->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head->prev = head->next = head;
+        while (pending.next != &pending) {
+            TimerNode* node = pending.next;
+            unlink(node);
+            place(node);
+        }
+    }
+    if (slot == 0 && level + 1 < WHEEL_LEVELS) cascade(level + 1);
+}
+
+void TimingWheel::schedule(TimerNode* node, uint64_t tick) {
+    if (node->isScheduled()) {
+        unlink(node);
+    } else {
+        count++;
+    }
+    if (tick <= now) tick = now + 1;
+    if (tick - now > MAX_DELAY) tick = now + MAX_DELAY;
+    node->expires = tick;
+    place(node);
+}
+
+void TimingWheel::cancel(TimerNode* node) {
+    if (!node->isScheduled()) return;
+    unlink(node);
+    count--;
+}
+
+int64_t TimingWheel::ticksUntilNext() const {
+    if (count == 0) return -1;
+    for (int ahead = 1; ahead <= WHEEL_SLOTS; ++ahead) {
+        uint64_t tick = now + ahead;
+        int slot = static_cast<int>(tick & (WHEEL_SLOTS - 1));
+        const TimerNode* head = &slots[0][slot];
+        if (head->next != head || slot == 0) return ahead;
+    }
+    return WHEEL_SLOTS;
+}
+
+uint64_t TimingWheel::currentTick() const {
+    return now;
+}
+
+size_t TimingWheel::size() const {
+    return count;
+}
@@ -0,0 +1,71 @@
+#include "../header/UndoHistory.h"
+#include "../header/Exceptions.h"
+
+UndoHistory::UndoHistory(int capacity)
+    : oldest(0), undoable(0), redoable(0) {
+    if (capacity <= 0) {
+        throw Uno::InvalidInputException("Undo history capacity must be positive");
+    }
+    ring.resize(capacity);
+}
+
+StateDelta& UndoHistory::slot(int offset) {
+    return ring[(oldest + offset) % ring.size()];
+}
+
+void UndoHistory::push(StateDelta& delta) {
+    // A new move invalidates anything that was undone before it
+    redoable = 0;
+
+    // Full ring: forget the oldest move to make room
+    if (undoable == (int)ring.size()) {
+        oldest = (oldest + 1) % ring.size();
+        undoable--;
+    }
+
+    StateDelta& target = slot(undoable);
+    target.ops.swap(delta.ops);
+    target.cards.swap(delta.cards);
+    target.rngStates.swap(delta.rngStates);
+    delta.clear(); // Hand back the slot's old buffers, emptied
+    undoable++;
+}
+
+StateDelta* UndoHistory::undo() {
+    if (undoable == 0) return nullptr;
+    undoable--;
+    redoable++;
+    return &slot(undoable);
+}
+
+StateDelta* UndoHistory::redo() {
+    if (redoable == 0) return nullptr;
+    redoable--;
+    return &slot(undoable++);
+}
+
+const StateDelta* UndoHistory::latest() const {
+    if (undoable == 0) return nullptr;
+    return &ring[(oldest + undoable - 1) % ring.size()];
+}
+
+bool UndoHistory::canUndo() const {
+    return undoable > 0;
+}
+
+bool UndoHistory::canRedo() const {
+    return redoable > 0;
+}
+
+int UndoHistory::capacity() const {
+    return ring.size();
+}
+
+void UndoHistory::clear() {
+    for (auto& delta : ring) {
+        delta.clear();
+    }
+    oldest = 0;
+    undoable = 0;
+    redoable = 0;
+}
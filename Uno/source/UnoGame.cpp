@@ -11,8 +11,13 @@
 #include "../header/ActionCard.h"
 #include "../header/WildCard.h"
 #include "../header/DrawFourCard.h"
+#include "../header/DropTwoCard.h"
 #include "../header/CardUtils.h"
 #include "../header/Exceptions.h"
+#include "../header/CardCode.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Notation.h"
+#include "../header/Metrics.h"
 
 UnoGame::UnoGame()
     : topCard(nullptr), currentPlayerIndex(0), isReverse(false), cardsDrawn(0), gameEnded(false), 
@@ -33,6 +38,11 @@ void UnoGame::startGame() {
         throw Uno::GameStateException("Cannot start game with no players");
     }
     
+    // A new game starts with an empty undo history
+    history.clear();
+    currentDelta.clear();
+    turnActionTaken = false;
+
     // Initialize and shuffle the deck
     try {
         deck.initializeDeck();
@@ -70,7 +80,7 @@ void UnoGame::startGame() {
     if (dynamic_cast<WildCard*>(topCard) || dynamic_cast<DrawFourCard*>(topCard)) {
         // If it's a wild card, set a random color
         try {
-            topCard->setColor(static_cast<CardColor>(rand() % 4));
+            topCard->setColor(static_cast<CardColor>(deck.randomInt(4)));
         } catch (const std::exception& e) {
             throw Uno::CardException(std::string("Failed to set color for initial wild card: ") + e.what());
         }
@@ -87,6 +97,8 @@ void UnoGame::nextTurn() {
         throw Uno::GameStateException("Cannot advance turns with no players");
     }
     
+    int previousIndex = currentPlayerIndex;
+
     // Calculate the next player index based on game direction
     if (isReverse) {
         currentPlayerIndex--;
@@ -99,6 +111,8 @@ void UnoGame::nextTurn() {
             currentPlayerIndex = 0;
         }
     }
+
+    if (recorder) recorder->record(DeltaOpType::CurrentPlayer, 0, previousIndex, currentPlayerIndex);
 }
 
 int UnoGame::nextPlayerIndex() const {
@@ -252,6 +266,7 @@ void UnoGame::skipTurn() {
 
 void UnoGame::reverseDirection() {
     isReverse = !isReverse; // Toggle the game direction
+    if (recorder) recorder->record(DeltaOpType::Direction);
     std::cout << "Game direction reversed!" << std::endl;
 }
 
@@ -325,12 +340,17 @@ void UnoGame::eliminatePlayer(Player* player) {
     auto it = std::find(players.begin(), players.end(), player);
     if (it != players.end()) {
         std::cout << player->getName() << " has been eliminated from the game." << std::endl;
+        int seat = it - players.begin();
+        int previousIndex = currentPlayerIndex;
         players.erase(it); // Remove player from the game
+        eliminatedPlayers.push_back(player); // Keep the player alive so the elimination can be undone
         
         // Adjust currentPlayerIndex if needed after elimination
         if (currentPlayerIndex >= players.size()) {
             currentPlayerIndex = 0;
         }
+
+        if (recorder) recorder->record(DeltaOpType::Eliminate, seat, previousIndex, currentPlayerIndex, player);
     } else {
         throw Uno::PlayerException("Player not found in game for elimination");
     }
@@ -400,6 +420,7 @@ void UnoGame::setTopCard(Card* card) {
     }
     
     // Set the new top card
+    if (recorder) recorder->record(DeltaOpType::TopCard, 0, 0, 0, nullptr, card, topCard);
     topCard = card;
 }
 
@@ -499,9 +520,10 @@ int UnoGame::getPlayerCount() const {
 bool UnoGame::getIntegerInput(int& output) {
     std::string line;
     std::getline(std::cin, line); // Read a line of input
-    std::stringstream ss(line);
-    // Attempt to parse integer and ensure no extra characters
-    return (ss >> output) && ss.eof();
+    // Skip leading blanks, then the rest of the line must be exactly one integer
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos) return false;
+    return parseInteger(std::string_view(line).substr(start), output);
 }
 
 void UnoGame::applyPendingEffects() {
@@ -509,7 +531,7 @@ void UnoGame::applyPendingEffects() {
     if (pendingReverseEffect) {
         try {
             reverseDirection();
-            pendingReverseEffect = false;
+            setPendingEffects(pendingSkipEffect, false);
         } catch (const std::exception& e) {
             throw Uno::GameStateException(std::string("Failed to apply reverse effect: ") + e.what());
         }
@@ -519,7 +541,7 @@ void UnoGame::applyPendingEffects() {
     if (pendingSkipEffect) {
         try {
             skipTurn(); // This will call nextTurn() internally
-            pendingSkipEffect = false;
+            setPendingEffects(false, pendingReverseEffect);
         } catch (const std::exception& e) {
             throw Uno::GameStateException(std::string("Failed to apply skip effect: ") + e.what());
         }
@@ -527,16 +549,443 @@ void UnoGame::applyPendingEffects() {
 }
 
 UnoGame::~UnoGame() {
-    // Clean up the top card if it exists to prevent memory leaks
-    if (topCard) {
-        delete topCard;
-        topCard = nullptr; // Set to nullptr after deletion
-    }
+    reset();
+}
+
+void UnoGame::reset() {
+    // The cards go back to the deck, which reuses them for the next game
+    deck.recycle(topCard);
+    topCard = nullptr;
     
     // Clean up all players to prevent memory leaks
     for (Player* p : players) {
+        p->returnHand(deck);
         delete p;
     }
     players.clear(); // Clear the player vector
+
+    // Eliminated players are owned by the game as well
+    for (Player* p : eliminatedPlayers) {
+        p->returnHand(deck);
+        delete p;
+    }
+    eliminatedPlayers.clear();
+
+    deck.setRecorder(nullptr);
+    deck.clear();
+    recorder = nullptr;
+    history.clear();
+    currentDelta.clear();
+    currentPlayerIndex = 0;
+    isReverse = false;
+    cardsDrawn = 0;
+    gameEnded = false;
+    pendingSkipEffect = false;
+    pendingReverseEffect = false;
+    turnActionTaken = false;
+}
+
+void UnoGame::setApplySkipEffect(bool value) {
+    setPendingEffects(value, pendingReverseEffect);
+}
+
+void UnoGame::setApplyReverseEffect(bool value) {
+    setPendingEffects(pendingSkipEffect, value);
+}
+
+void UnoGame::setPendingEffects(bool skip, bool reverse) {
+    // Pack both flags into one value so a single op covers them
+    int before = (pendingSkipEffect ? 1 : 0) | (pendingReverseEffect ? 2 : 0);
+    int after = (skip ? 1 : 0) | (reverse ? 2 : 0);
+    if (before == after) return;
+
+    if (recorder) recorder->record(DeltaOpType::PendingEffects, 0, before, after);
+    pendingSkipEffect = skip;
+    pendingReverseEffect = reverse;
+}
+
+void UnoGame::setTurnActionTaken(bool value) {
+    if (turnActionTaken == value) return;
+    if (recorder) recorder->record(DeltaOpType::TurnAction, 0, turnActionTaken, value);
+    turnActionTaken = value;
+}
+
+bool UnoGame::hasTakenTurnAction() const {
+    return turnActionTaken;
+}
+
+void UnoGame::setCardColor(Card* card, CardColor color) {
+    // Ensure the card to recolor is not null
+    if (!card) {
+        throw Uno::NullPointerException("card");
+    }
+
+    if (recorder) recorder->record(DeltaOpType::ColorChange, 0, (int)card->getColor(), (int)color, nullptr, card);
+    card->setColor(color);
 }
 
+void UnoGame::attachRecorder(StateDelta* delta) {
+    recorder = delta;
+    deck.setRecorder(delta);
+    for (Player* p : players) {
+        p->setRecorder(delta);
+    }
+    for (Player* p : eliminatedPlayers) {
+        p->setRecorder(delta);
+    }
+}
+
+void UnoGame::makeMove(const Move& move) {
+    if (isGameOver()) {
+        throw Uno::GameStateException("Cannot make a move after the game is over");
+    }
+    Player* player = getCurrentPlayer();
+
+    currentDelta.clear();
+    attachRecorder(&currentDelta);
+    try {
+        switch (move.type) {
+            case MoveType::CallUno:
+                player->callUNO();
+                break;
+            case MoveType::Draw:
+                if (turnActionTaken) {
+                    throw Uno::InvalidInputException("You have already played or drawn this turn");
+                }
+                drawCard(player);
+                setTurnActionTaken(true);
+                break;
+            case MoveType::Play:
+                playMove(player, move);
+                break;
+            case MoveType::EndTurn:
+                if (!turnActionTaken) {
+                    throw Uno::InvalidInputException("Play or draw a card before ending the turn");
+                }
+                nextTurn();
+                setTurnActionTaken(false);
+                applyPendingEffects(); // Skip and reverse take effect as the turn passes
+                break;
+        }
+    } catch (...) {
+        // Roll back whatever part of the move was applied before the failure
+        attachRecorder(nullptr);
+        revertDelta(currentDelta);
+        currentDelta.clear();
+        throw;
+    }
+    attachRecorder(nullptr);
+
+    history.push(currentDelta);
+    Metrics::count(Counter::Moves);
+}
+
+void UnoGame::playMove(Player* player, const Move& move) {
+    if (turnActionTaken) {
+        throw Uno::InvalidInputException("You have already played or drawn this turn");
+    }
+
+    Card* card = player->getCardAtIndex(move.handIndex);
+    if (!card) {
+        throw Uno::InvalidInputException("Card index out of bounds for playing card");
+    }
+    if (!isCardPlayable(card)) {
+        throw Uno::CardException("That card cannot be played on the current top card");
+    }
+
+    bool isWild = dynamic_cast<WildCard*>(card) || dynamic_cast<DrawFourCard*>(card);
+    if (isWild && (move.color == CardColor::NONE)) {
+        throw Uno::InvalidInputException("A color must be chosen for a wild card");
+    }
+
+    if (dynamic_cast<DropTwoCard*>(card)) {
+        // Validate the selection against the hand that remains once DropTwo is played
+        int remaining = player->getHandSize() - 1;
+        if (move.dropCount < 0 || move.dropCount > 2 || move.dropCount > remaining) {
+            throw Uno::InvalidInputException("DropTwo can drop at most two cards from the hand");
+        }
+        for (int i = 0; i < move.dropCount; ++i) {
+            if (move.dropIndices[i] < 0 || move.dropIndices[i] >= remaining) {
+                throw Uno::InvalidInputException("Card index out of bounds for dropping card");
+            }
+        }
+        if (move.dropCount == 2 && move.dropIndices[0] == move.dropIndices[1]) {
+            throw Uno::InvalidInputException("The same card cannot be dropped twice");
+        }
+
+        // DropTwo's own play() asks for input on the console, so apply it here instead
+        player->removeCardFromHand(move.handIndex);
+        setTopCard(card);
+        enforceUNOCall(player);
+
+        // Drop in descending order to avoid index shifts when removing from hand
+        int first = std::max(move.dropIndices[0], move.dropIndices[1]);
+        int second = std::min(move.dropIndices[0], move.dropIndices[1]);
+        if (move.dropCount == 2) {
+            dropCardFromPlayer(player, first);
+            dropCardFromPlayer(player, second);
+        } else if (move.dropCount == 1) {
+            dropCardFromPlayer(player, move.dropIndices[0]);
+        }
+    } else {
+        player->playCard(move.handIndex, *this);
+        if (isWild) {
+            setCardColor(card, move.color);
+        }
+        enforceUNOCall(player);
+    }
+
+    setTurnActionTaken(true);
+}
+
+void UnoGame::legalMoves(std::vector<Move>& out) const {
+    out.clear();
+    if (gameEnded || players.size() <= 1) return;
+
+    Player* player = getCurrentPlayer();
+    if (player->hasWon()) return;
+
+    if (player->getHandSize() == 2 && !player->hasCalledUNOStatus()) {
+        out.push_back(Move::callUno());
+    }
+
+    if (turnActionTaken) {
+        out.push_back(Move::endTurn());
+        return;
+    }
+
+    for (int i = 0; i < player->getHandSize(); ++i) {
+        Card* card = player->getCardAtIndex(i);
+        if (!card || !areCardsPlayable(card, topCard)) continue;
+
+        if (dynamic_cast<WildCard*>(card) || dynamic_cast<DrawFourCard*>(card)) {
+            // A wild card is a different move for each color it can be given
+            out.push_back(Move::play(i, CardColor::Red));
+            out.push_back(Move::play(i, CardColor::Blue));
+            out.push_back(Move::play(i, CardColor::Green));
+            out.push_back(Move::play(i, CardColor::Yellow));
+        } else {
+            out.push_back(Move::play(i));
+        }
+    }
+    out.push_back(Move::draw());
+}
+
+void UnoGame::setSeed(unsigned int seed) {
+    deck.seed(seed);
+}
+
+Player* UnoGame::getPlayer(int seat) const {
+    // Validate the seat index
+    if (seat < 0 || seat >= players.size()) {
+        throw Uno::GameStateException("Seat index out of bounds");
+    }
+    return players[seat];
+}
+
+bool UnoGame::isDirectionReversed() const {
+    return isReverse;
+}
+
+bool UnoGame::undoMove() {
+    StateDelta* delta = history.undo();
+    if (!delta) return false;
+    revertDelta(*delta);
+    return true;
+}
+
+bool UnoGame::redoMove() {
+    StateDelta* delta = history.redo();
+    if (!delta) return false;
+    replayDelta(*delta);
+    return true;
+}
+
+bool UnoGame::canUndo() const {
+    return history.canUndo();
+}
+
+bool UnoGame::canRedo() const {
+    return history.canRedo();
+}
+
+const StateDelta* UnoGame::lastMoveDelta() const {
+    return history.latest();
+}
+
+void UnoGame::revertDelta(const StateDelta& delta) {
+    // Walk the ops backwards so each one sees the state it produced
+    for (auto it = delta.ops.rbegin(); it != delta.ops.rend(); ++it) {
+        const DeltaOp& op = *it;
+        switch (op.type) {
+            case DeltaOpType::HandPush:
+            case DeltaOpType::HandErase:
+            case DeltaOpType::UnoFlag:
+                op.player->revertOp(op);
+                break;
+            case DeltaOpType::DrawPop:
+            case DeltaOpType::DrawPush:
+            case DeltaOpType::DiscardPush:
+            case DeltaOpType::Reshuffle:
+                deck.revertOp(op, delta);
+                break;
+            case DeltaOpType::TopCard:
+                topCard = op.previous;
+                break;
+            case DeltaOpType::ColorChange:
+                op.card->setColor(static_cast<CardColor>(op.before));
+                break;
+            case DeltaOpType::CurrentPlayer:
+                currentPlayerIndex = op.before;
+                break;
+            case DeltaOpType::Direction:
+                isReverse = !isReverse;
+                break;
+            case DeltaOpType::PendingEffects:
+                pendingSkipEffect = op.before & 1;
+                pendingReverseEffect = op.before & 2;
+                break;
+            case DeltaOpType::TurnAction:
+                turnActionTaken = op.before;
+                break;
+            case DeltaOpType::Eliminate:
+                eliminatedPlayers.pop_back();
+                players.insert(players.begin() + op.index, op.player);
+                currentPlayerIndex = op.before;
+                break;
+        }
+    }
+}
+
+void UnoGame::replayDelta(const StateDelta& delta) {
+    for (const DeltaOp& op : delta.ops) {
+        switch (op.type) {
+            case DeltaOpType::HandPush:
+            case DeltaOpType::HandErase:
+            case DeltaOpType::UnoFlag:
+                op.player->replayOp(op);
+                break;
+            case DeltaOpType::DrawPop:
+            case DeltaOpType::DrawPush:
+            case DeltaOpType::DiscardPush:
+            case DeltaOpType::Reshuffle:
+                deck.replayOp(op, delta);
+                break;
+            case DeltaOpType::TopCard:
+                topCard = op.card;
+                break;
+            case DeltaOpType::ColorChange:
+                op.card->setColor(static_cast<CardColor>(op.after));
+                break;
+            case DeltaOpType::CurrentPlayer:
+                currentPlayerIndex = op.after;
+                break;
+            case DeltaOpType::Direction:
+                isReverse = !isReverse;
+                break;
+            case DeltaOpType::PendingEffects:
+                pendingSkipEffect = op.after & 1;
+                pendingReverseEffect = op.after & 2;
+                break;
+            case DeltaOpType::TurnAction:
+                turnActionTaken = op.after;
+                break;
+            case DeltaOpType::Eliminate:
+                players.erase(players.begin() + op.index);
+                eliminatedPlayers.push_back(op.player);
+                currentPlayerIndex = op.after;
+                break;
+        }
+    }
+}
+
+
+// Bumped whenever the snapshot layout changes
+static const uint8_t SNAPSHOT_VERSION = 1;
+
+// Bits of the snapshot flags byte
+enum SnapshotFlag : uint8_t {
+    SNAPSHOT_REVERSED = 1,
+    SNAPSHOT_PENDING_SKIP = 2,
+    SNAPSHOT_PENDING_REVERSE = 4,
+    SNAPSHOT_TURN_ACTION = 8,
+    SNAPSHOT_ENDED = 16
+};
+
+void UnoGame::saveSnapshot(std::vector<uint8_t>& out) const {
+    ByteWriter writer(out);
+    writer.putU8(SNAPSHOT_VERSION);
+
+    writer.putVarint(players.size());
+    for (Player* player : players) {
+        player->saveState(writer);
+    }
+    writer.putVarint(eliminatedPlayers.size());
+    for (Player* player : eliminatedPlayers) {
+        player->saveState(writer);
+    }
+
+    uint8_t flags = 0;
+    if (isReverse) flags |= SNAPSHOT_REVERSED;
+    if (pendingSkipEffect) flags |= SNAPSHOT_PENDING_SKIP;
+    if (pendingReverseEffect) flags |= SNAPSHOT_PENDING_REVERSE;
+    if (turnActionTaken) flags |= SNAPSHOT_TURN_ACTION;
+    if (gameEnded) flags |= SNAPSHOT_ENDED;
+    writer.putVarint(currentPlayerIndex);
+    writer.putU8(flags);
+    writer.putU16(encodeCard(topCard));
+
+    deck.saveState(writer);
+}
+
+void UnoGame::loadSnapshot(const uint8_t* data, size_t size) {
+    if (!players.empty() || topCard) {
+        throw Uno::GameStateException("Snapshots can only be loaded into an empty game");
+    }
+
+    ByteReader reader(data, size);
+    if (reader.getU8() != SNAPSHOT_VERSION) {
+        throw Uno::InvalidInputException("Unsupported snapshot version");
+    }
+
+    try {
+        uint64_t count = reader.getVarint();
+        for (uint64_t i = 0; i < count; ++i) {
+            players.push_back(Player::loadState(reader, deck));
+        }
+        count = reader.getVarint();
+        for (uint64_t i = 0; i < count; ++i) {
+            eliminatedPlayers.push_back(Player::loadState(reader, deck));
+        }
+
+        uint64_t current = reader.getVarint();
+        if (players.empty() || current >= players.size()) {
+            throw Uno::InvalidInputException("Snapshot current player is out of range");
+        }
+        currentPlayerIndex = static_cast<int>(current);
+
+        uint8_t flags = reader.getU8();
+        isReverse = flags & SNAPSHOT_REVERSED;
+        pendingSkipEffect = flags & SNAPSHOT_PENDING_SKIP;
+        pendingReverseEffect = flags & SNAPSHOT_PENDING_REVERSE;
+        turnActionTaken = flags & SNAPSHOT_TURN_ACTION;
+        gameEnded = flags & SNAPSHOT_ENDED;
+
+        topCard = deck.makeCard(reader.getU16());
+        if (!topCard) {
+            throw Uno::InvalidInputException("Snapshot has no top card");
+        }
+        deck.loadState(reader);
+    } catch (...) {
+        // Leave the game empty again so the caller can retry with another snapshot
+        reset();
+        throw;
+    }
+
+    history.clear();
+    currentDelta.clear();
+}
+
+void silenceGameNarration() {
+    std::cout.setstate(std::ios::badbit);
+}
@@ -0,0 +1,427 @@
+#include "../header/UringBackend.h"
+#include "../header/EventLoop.h"
+#include "../header/Exceptions.h"
+#include "../header/Metrics.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const unsigned RING_ENTRIES = 1024;
+static const unsigned COMPLETION_ENTRIES = 4 * RING_ENTRIES;
+static const unsigned BUFFER_COUNT = 256;       // Power of two, as the kernel requires
+static const unsigned BUFFER_SIZE = 16 * 1024;
+static const uint16_t BUFFER_GROUP = 0;
+
+// What a completion belongs to, kept in the low bits of user_data next to the connection pointer
+enum CompletionTag : uint64_t {
+    TAG_ACCEPT = 1,
+    TAG_WAKE = 2,
+    TAG_RECEIVE = 3,
+    TAG_SEND = 4,
+    TAG_CANCEL = 5
+};
+static const uint64_t TAG_MASK = 7;
+
+static uint64_t makeTag(Connection* connection, CompletionTag tag) {
+    return reinterpret_cast<uint64_t>(connection) | tag;
+}
+
+static int ringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+// Waits for minComplete completions or timeoutMs, whichever comes first
+static int ringEnterTimed(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMs) {
+    __kernel_timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG,
+                                    &arg, sizeof(arg)));
+}
+
+static int ringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+UringBackend::UringBackend(IoHandler& eventHandler, int listenSocket)
+    : handler(eventHandler), listenFd(listenSocket), ringFd(-1), wakeFd(-1), wakeValue(0),
+      rings(MAP_FAILED), ringsSize(0), sqes(nullptr), sqesSize(0), sqHead(nullptr), sqTail(nullptr),
+      sqMask(0), sqEntries(0), sqLocalTail(0), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+      bufferRing(nullptr), bufferRingSize(0), buffers(nullptr), bufferTail(0), buffersReturned(false),
+      inFlight(0), quiescing(false) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = COMPLETION_ENTRIES;
+    ringFd = ringSetup(RING_ENTRIES, &params);
+    if (ringFd < 0) {
+        throw Uno::ResourceException(std::string("io_uring is not available: ") + strerror(errno));
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_EXT_ARG)) {
+        teardown();
+        throw Uno::ResourceException("io_uring on this kernel is too old");
+    }
+
+    // One mapping holds both rings; the submission entries are a second one
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringsSize = sqSize > cqSize ? sqSize : cqSize;
+    rings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* entries = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || entries == MAP_FAILED) {
+        teardown();
+        throw Uno::ResourceException("Cannot map io_uring rings");
+    }
+    sqes = static_cast<io_uring_sqe*>(entries);
+
+    uint8_t* base = static_cast<uint8_t*>(rings);
+    sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+    cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Slot i of the submission ring always names entry i
+    unsigned* array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) {
+        array[i] = i;
+    }
+
+    // Register the receive buffers the kernel picks from for every recv
+    bufferRingSize = BUFFER_COUNT * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        teardown();
+        throw Uno::ResourceException("Cannot allocate io_uring buffer ring");
+    }
+    bufferRing = static_cast<io_uring_buf_ring*>(ring);
+    buffers = new uint8_t[BUFFER_COUNT * BUFFER_SIZE];
+
+    io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    registration.ring_entries = BUFFER_COUNT;
+    registration.bgid = BUFFER_GROUP;
+    if (ringRegister(ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        teardown();
+        throw Uno::ResourceException("io_uring on this kernel has no provided buffer rings");
+    }
+    for (unsigned id = 0; id < BUFFER_COUNT; ++id) {
+        provideBuffer(static_cast<uint16_t>(id));
+    }
+    __atomic_store_n(&bufferRing->tail, bufferTail, __ATOMIC_RELEASE);
+
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        teardown();
+        throw Uno::ResourceException("Cannot create event loop");
+    }
+    armAccept();
+    armWake();
+}
+
+UringBackend::~UringBackend() {
+    teardown();
+}
+
+// Closing the ring cancels whatever is still queued, so only then is it safe to free what the kernel used
+void UringBackend::teardown() {
+    if (ringFd >= 0) close(ringFd);
+    ringFd = -1;
+    if (rings != MAP_FAILED) munmap(rings, ringsSize);
+    rings = MAP_FAILED;
+    if (sqes) munmap(sqes, sqesSize);
+    sqes = nullptr;
+    if (bufferRing) munmap(bufferRing, bufferRingSize);
+    bufferRing = nullptr;
+    delete[] buffers;
+    buffers = nullptr;
+    if (wakeFd >= 0) close(wakeFd);
+    wakeFd = -1;
+
+    for (Connection* connection : settling) {
+        delete connection;
+    }
+    settling.clear();
+}
+
+void UringBackend::provideBuffer(uint16_t id) {
+    // Only addr, len and bid are written: the ring's tail overlays the first entry's reserved field.
+    // The entries are indexed by hand because C++ compilers misplace the header's flexible bufs array.
+    io_uring_buf* slot = reinterpret_cast<io_uring_buf*>(bufferRing) + (bufferTail & (BUFFER_COUNT - 1));
+    slot->addr = reinterpret_cast<uint64_t>(buffers + static_cast<size_t>(id) * BUFFER_SIZE);
+    slot->len = BUFFER_SIZE;
+    slot->bid = id;
+    bufferTail++;
+}
+
+// Hands out the next free submission entry, submitting what is queued if the ring is full
+io_uring_sqe* UringBackend::nextSqe() {
+    if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        submit(0);
+        if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            throw Uno::ResourceException("io_uring submission queue is full");
+        }
+    }
+    io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqLocalTail++;
+    return sqe;
+}
+
+// Publishes the queued entries and enters the kernel once, optionally waiting for completions
+int UringBackend::submit(unsigned waitFor, int timeoutMs) {
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned pending = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (pending == 0 && waitFor == 0) return 0;
+    if (waitFor > 0 && timeoutMs >= 0) {
+        return ringEnterTimed(ringFd, pending, waitFor, IORING_ENTER_GETEVENTS, timeoutMs);
+    }
+    return ringEnter(ringFd, pending, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+}
+
+void UringBackend::armAccept() {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = TAG_ACCEPT;
+    inFlight++;
+}
+
+void UringBackend::armWake() {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    sqe->len = sizeof(wakeValue);
+    sqe->user_data = TAG_WAKE;
+    inFlight++;
+}
+
+void UringBackend::armReceive(Connection* connection) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = makeTag(connection, TAG_RECEIVE);
+    connection->receiving = true;
+    connection->pendingOps++;
+    inFlight++;
+}
+
+// Keeps one sendmsg in flight per connection, covering every queued segment
+// (shared frames included) up to MAX_SEND_VECTORS. Output queued meanwhile
+// goes out with the next one, once the current one completes.
+void UringBackend::sendQueued(Connection* connection) {
+    if (connection->sendInFlight || connection->fd < 0 || !connection->hasOutput() || quiescing) return;
+    connection->sealOutput(); // The kernel reads these buffers until the send completes
+
+    memset(&connection->sendHeader, 0, sizeof(connection->sendHeader));
+    connection->sendHeader.msg_iov = connection->sendVectors;
+    connection->sendHeader.msg_iovlen = connection->gatherOutput(connection->sendVectors, MAX_SEND_VECTORS);
+
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&connection->sendHeader);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeTag(connection, TAG_SEND);
+    connection->sendInFlight = true;
+    connection->pendingOps++;
+    inFlight++;
+    Metrics::count(Counter::SocketWrites);
+}
+
+void UringBackend::attach(Connection* connection) {
+    if (quiescing) return; // resume() attaches it
+    armReceive(connection);
+    sendQueued(connection);
+}
+
+void UringBackend::flush(Connection* connection) {
+    sendQueued(connection);
+}
+
+void UringBackend::release(Connection* connection) {
+    if (connection->fd < 0) return;
+    // Shutting down ends the multishot recv and any stuck send; the requests keep
+    // the socket alive until they complete, so the descriptor can go right away
+    shutdown(connection->fd, SHUT_RDWR);
+    close(connection->fd);
+    connection->fd = -1;
+    settling.push_back(connection);
+}
+
+void UringBackend::wake() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // The counter only fails when it is already full, which wakes the loop anyway
+    }
+}
+
+// One cancel takes back every request in the ring; the completions that follow
+// are dispatched until the kernel holds nothing, so no accept or recv can still
+// fire and no send can still be reading a connection's output
+void UringBackend::quiesce() {
+    quiescing = true;
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = TAG_CANCEL;
+    while (inFlight > 0) {
+        if (!poll(-1)) break;
+    }
+}
+
+void UringBackend::resume(const std::vector<Connection*>& connections) {
+    quiescing = false;
+    armAccept();
+    armWake();
+    for (Connection* connection : connections) {
+        attach(connection);
+    }
+}
+
+bool UringBackend::poll(int timeoutMs) {
+    // Everything queued since the last call goes in with the wait
+    if (submit(1, timeoutMs) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN && errno != ETIME) {
+        return false;
+    }
+
+    unsigned head = *cqHead;
+    for (;;) {
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail) break;
+        while (head != tail) {
+            io_uring_cqe cqe = cqes[head & cqMask];
+            head++;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            dispatch(cqe);
+        }
+    }
+
+    if (buffersReturned) {
+        __atomic_store_n(&bufferRing->tail, bufferTail, __ATOMIC_RELEASE);
+        buffersReturned = false;
+    }
+    settle();
+    return true;
+}
+
+void UringBackend::dispatch(const io_uring_cqe& cqe) {
+    Connection* connection = reinterpret_cast<Connection*>(cqe.user_data & ~TAG_MASK);
+    switch (cqe.user_data & TAG_MASK) {
+        case TAG_ACCEPT:
+            if (cqe.res >= 0) handler.onAccept(cqe.res);
+            // The kernel ends a multishot accept on errors such as EMFILE
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                inFlight--;
+                if (!quiescing) armAccept();
+            }
+            break;
+        case TAG_WAKE:
+            inFlight--;
+            if (!quiescing) armWake();
+            handler.onWake();
+            break;
+        case TAG_RECEIVE:
+            onReceive(connection, cqe.res, cqe.flags);
+            break;
+        case TAG_SEND:
+            onSend(connection, cqe.res);
+            break;
+        case TAG_CANCEL:
+            break;
+    }
+}
+
+void UringBackend::onReceive(Connection* connection, int result, unsigned flags) {
+    bool ended = false;
+    if (!(flags & IORING_CQE_F_MORE)) {
+        connection->receiving = false;
+        connection->pendingOps--;
+        inFlight--;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (result > 0 && connection->fd >= 0) {
+            const uint8_t* data = buffers + static_cast<size_t>(id) * BUFFER_SIZE;
+            connection->input.insert(connection->input.end(), data, data + result);
+        }
+        provideBuffer(id);
+        buffersReturned = true;
+    }
+
+    if (connection->fd < 0 || (result == -ECANCELED && quiescing)) return;
+    if (result > 0) {
+        handler.onInput(connection);
+    } else if (result != -ENOBUFS) {
+        ended = true; // End of stream or a socket error
+        handler.onHangup(connection);
+    }
+
+    // Out of buffers, or the kernel stopped the multishot: ask again
+    if (!ended && connection->fd >= 0 && !connection->receiving && !quiescing) {
+        if (result == -ENOBUFS) {
+            __atomic_store_n(&bufferRing->tail, bufferTail, __ATOMIC_RELEASE);
+            buffersReturned = false;
+        }
+        armReceive(connection);
+    }
+}
+
+void UringBackend::onSend(Connection* connection, int result) {
+    connection->sendInFlight = false;
+    connection->pendingOps--;
+    inFlight--;
+    if (connection->fd < 0) return;
+
+    if (result > 0) {
+        connection->consumeOutput(result);
+    } else if (result == -ECANCELED) {
+        return; // Withdrawn by quiesce() before anything went out
+    } else if (result != -EINTR && result != -EAGAIN) {
+        // The peer is gone; its read side will report the close
+        connection->clearOutput();
+        return;
+    }
+    sendQueued(connection);
+}
+
+// Frees released connections the kernel no longer refers to
+void UringBackend::settle() {
+    size_t kept = 0;
+    for (size_t i = 0; i < settling.size(); ++i) {
+        Connection* connection = settling[i];
+        if (connection->pendingOps > 0) {
+            settling[kept++] = connection;
+        } else {
+            delete connection;
+        }
+    }
+    settling.resize(kept);
+}
@@ -0,0 +1,162 @@
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/ColumnarFile.h"
+#include "../header/Exceptions.h"
+
+// Checks that columns read back from a columnar file as they were written.
+//
+//   columnarTest [ROWS]
+//
+// Writes files of up to ROWS rows at several row group sizes (down to one
+// row, and none at all), with columns shaped to hit both encodings and every
+// bit width: constants, long runs, small and full 64-bit ranges, values
+// either side of 32 bits, counters. Every column must read back whole and in
+// order; names, row counts and column lookups must match. A file whose
+// writer was destroyed without close() must still be complete, one cut short
+// must be refused, and so must appending after close(). Prints the first
+// differences and exits 1 if there were any.
+
+static const int COLUMNS = 8;
+static const char* NAMES[COLUMNS] = {"constant", "runs", "small", "full", "wide", "counter", "negative", "mixed"};
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    if (failures < 10)
+        printf("%s\n", what.c_str());
+    failures++;
+}
+
+static int64_t valueFor(int column, uint64_t row, std::mt19937_64& rng)
+{
+    switch (column)
+    {
+        case 0: return 42;
+        case 1: return static_cast<int64_t>(row / 500) % 3 - 1;
+        case 2: return static_cast<int64_t>(rng() % 7);
+        case 3: return rng() % 5 == 0 ? (rng() % 2 ? INT64_MIN : INT64_MAX) : static_cast<int64_t>(rng());
+        case 4: return static_cast<int64_t>((1ull << 32) - 2 + rng() % 4);
+        case 5: return static_cast<int64_t>(row);
+        case 6: return -static_cast<int64_t>(rng() % 100000) - 1;
+        default: return rng() % 3 == 0 ? static_cast<int64_t>(rng() % 1000) : 17;
+    }
+}
+
+// Writes rows rows in groups of groupSize and checks what a reader makes of them
+static void roundTrip(const std::string& path, uint64_t rows, int groupSize, bool closeFirst)
+{
+    std::string label = std::to_string(rows) + " rows in groups of " + std::to_string(groupSize);
+    std::vector<std::string> names(NAMES, NAMES + COLUMNS);
+    std::vector<std::vector<int64_t>> expected(COLUMNS);
+    std::mt19937_64 rng(rows * 31 + groupSize);
+    {
+        ColumnarWriter writer(path, names, groupSize);
+        int64_t row[COLUMNS];
+        for (uint64_t r = 0; r < rows; r++)
+        {
+            for (int c = 0; c < COLUMNS; c++)
+            {
+                row[c] = valueFor(c, r, rng);
+                expected[c].push_back(row[c]);
+            }
+            writer.appendRow(row);
+        }
+        if (writer.rowsWritten() != rows)
+            fail(label + ": writer counted " + std::to_string(writer.rowsWritten()) + " rows");
+        if (closeFirst)
+        {
+            writer.close();
+            try
+            {
+                writer.appendRow(row);
+                fail(label + ": appended a row after close()");
+            }
+            catch (const Uno::GameStateException&)
+            {
+            }
+            if (writer.bytesWritten() != std::filesystem::file_size(path))
+                fail(label + ": writer counted " + std::to_string(writer.bytesWritten()) + " bytes");
+        }
+        // Otherwise the destructor finishes the file
+    }
+
+    ColumnarReader reader(path);
+    if (reader.columns() != names)
+        fail(label + ": column names differ");
+    if (reader.rowCount() != rows)
+        fail(label + ": reader counted " + std::to_string(reader.rowCount()) + " rows");
+    if (reader.columnIndex("missing") != -1 || reader.columnIndex(NAMES[COLUMNS - 1]) != COLUMNS - 1)
+        fail(label + ": columnIndex found the wrong column");
+
+    // Backwards, so chunks are not read in file order
+    for (int c = COLUMNS - 1; c >= 0; c--)
+    {
+        std::vector<int64_t> values(1, -7); // readColumn appends
+        reader.readColumn(NAMES[c], values);
+        if (values.size() != rows + 1 || values[0] != -7)
+        {
+            fail(label + ": column " + NAMES[c] + " read back " + std::to_string(values.size() - 1) + " values");
+            continue;
+        }
+        for (uint64_t r = 0; r < rows; r++)
+        {
+            if (values[r + 1] != expected[c][r])
+            {
+                fail(label + ": column " + NAMES[c] + ", row " + std::to_string(r) + " read back " +
+                     std::to_string(values[r + 1]) + ", not " + std::to_string(expected[c][r]));
+                break;
+            }
+        }
+    }
+    try
+    {
+        std::vector<int64_t> values;
+        reader.readColumn("missing", values);
+        fail(label + ": read a column that does not exist");
+    }
+    catch (const Uno::InvalidInputException&)
+    {
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t rows = argc > 1 ? std::stoull(argv[1]) : 50000;
+    std::string name = "columnarTest-" + std::to_string(std::random_device{}()) + ".ucol";
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+
+    const int groupSizes[] = {1, 7, 1000, 16384};
+    const uint64_t rowCounts[] = {0, 1, 999, 1000, 1001, rows};
+    int files = 0;
+    for (int groupSize : groupSizes)
+    {
+        for (uint64_t count : rowCounts)
+        {
+            if (groupSize == 1 && count > 5000)
+                count = 5000; // A chunk per value takes long enough already
+            roundTrip(path, count, groupSize, files % 2 == 0);
+            files++;
+        }
+    }
+
+    // A file cut short lost its footer
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    try
+    {
+        ColumnarReader reader(path);
+        fail("a file cut short was read");
+    }
+    catch (const Uno::ResourceException&)
+    {
+    }
+    std::filesystem::remove(path);
+
+    printf("%d files written and read back, %d wrong\n", files, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/Compression.h"
+#include "../header/ServerTable.h"
+#include "../header/UnoGame.h"
+#include "../header/Protocol.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+
+// Checks that frames come out of a FrameUnpacker as they went into the
+// FramePacker at the other end of a connection.
+//
+//   framePackerTest [GAMES]
+//
+// Packs the TableState and TableDelta frames of random games, mixed with
+// frames of random bytes (some longer than the history window) and repeats
+// of earlier frames, in batches through packFrames. The packed bytes reach
+// the unpacker in pieces of random size, so it often holds only part of a
+// packed frame and must ask for more. Every so often both ends are written
+// with saveState and carried on by new objects read back with loadState, as
+// a hot restart does, and must keep in step. Damaged packed frames must be
+// refused with InvalidInputException or unpack to some frame, never worse.
+// Prints the first differences and exits 1 if there were any.
+
+static const int MAX_STEPS = 400;
+static const int BATCHES_PER_RESTART = 97;
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    if (failures < 10)
+        printf("%s\n", what.c_str());
+    failures++;
+}
+
+static void appendRandomFrame(std::mt19937& rng, std::vector<uint8_t>& out)
+{
+    size_t size = rng() % 4 == 0 ? rng() % 6000 : rng() % 200;
+    size_t start = beginFrame(out, static_cast<uint8_t>(1 + rng() % 16));
+    int alphabet = 1 + rng() % 255; // Small ones repeat enough to be matched
+    for (size_t i = 0; i < size; i++)
+        out.push_back(static_cast<uint8_t>(rng() % alphabet));
+    finishFrame(out, start);
+}
+
+// Carries both ends over to new objects through saveState and loadState
+static void restart(std::unique_ptr<FramePacker>& packer, std::unique_ptr<FrameUnpacker>& unpacker)
+{
+    std::vector<uint8_t> saved;
+    ByteWriter writer(saved);
+    packer->saveState(writer);
+    unpacker->saveState(writer);
+
+    ByteReader reader(saved);
+    packer.reset(new FramePacker());
+    packer->loadState(reader);
+    unpacker.reset(new FrameUnpacker());
+    unpacker->loadState(reader);
+    if (reader.remaining() != 0)
+        fail("loadState left " + std::to_string(reader.remaining()) + " saved bytes unread");
+
+    std::vector<uint8_t> again;
+    ByteWriter againWriter(again);
+    packer->saveState(againWriter);
+    unpacker->saveState(againWriter);
+    if (again != saved)
+        fail("state saved after loadState differs from what was loaded");
+}
+
+int main(int argc, char* argv[])
+{
+    int games = argc > 1 ? std::stoi(argv[1]) : 60;
+    silenceGameNarration();
+
+    std::mt19937 rng(3);
+    std::unique_ptr<FramePacker> packer(new FramePacker());
+    std::unique_ptr<FrameUnpacker> unpacker(new FrameUnpacker());
+    std::vector<std::vector<uint8_t>> sent;  // Frames of the batch in flight
+    std::vector<std::vector<uint8_t>> recent; // Frames to repeat
+    std::vector<uint8_t> batch, packed, received, frame;
+    uint64_t frames = 0, rawBytes = 0, packedBytes = 0;
+    int batches = 0;
+
+    // Sends the batch through the packer and checks what the unpacker makes of it
+    auto flush = [&]()
+    {
+        if (sent.empty())
+            return;
+        batch.clear();
+        for (const std::vector<uint8_t>& f : sent)
+            batch.insert(batch.end(), f.begin(), f.end());
+        packed.clear();
+        packer->packFrames(batch.data(), batch.size(), packed);
+        rawBytes += batch.size();
+        packedBytes += packed.size();
+
+        size_t delivered = 0, next = 0;
+        received.clear();
+        while (delivered < packed.size() || !received.empty())
+        {
+            size_t piece = std::min<size_t>(packed.size() - delivered, 1 + rng() % 300);
+            received.insert(received.end(), packed.begin() + delivered, packed.begin() + delivered + piece);
+            delivered += piece;
+            for (;;)
+            {
+                size_t used = unpacker->unpack(received.data(), received.size(), frame);
+                if (used == 0)
+                    break;
+                if (next >= sent.size() || frame != sent[next])
+                    fail("batch " + std::to_string(batches) + ", frame " + std::to_string(next) + " unpacked differently");
+                next++;
+                received.erase(received.begin(), received.begin() + used);
+            }
+            if (delivered == packed.size() && !received.empty())
+            {
+                fail("batch " + std::to_string(batches) + ": " + std::to_string(received.size()) + " packed bytes left over");
+                break;
+            }
+        }
+        if (next != sent.size())
+            fail("batch " + std::to_string(batches) + ": " + std::to_string(next) + " of " + std::to_string(sent.size()) + " frames unpacked");
+        frames += sent.size();
+        for (std::vector<uint8_t>& f : sent)
+        {
+            if (recent.size() == 32)
+                recent.erase(recent.begin());
+            recent.push_back(std::move(f));
+        }
+        sent.clear();
+        if (++batches % BATCHES_PER_RESTART == 0)
+            restart(packer, unpacker);
+    };
+    auto send = [&](const std::vector<uint8_t>& f)
+    {
+        sent.push_back(f);
+        if (rng() % 4 == 0)
+        {
+            sent.emplace_back();
+            appendRandomFrame(rng, sent.back());
+        }
+        if (rng() % 8 == 0 && !recent.empty())
+            sent.push_back(recent[rng() % recent.size()]);
+        if (sent.size() >= 1 + rng() % 8)
+            flush();
+    };
+
+    std::vector<Move> legal;
+    for (int g = 0; g < games; g++)
+    {
+        int seats = 2 + g % 3;
+        ServerTable table(g + 1, seats);
+        for (int s = 0; s < seats; s++)
+            table.join("Player " + std::to_string(s + 1));
+        table.start(g * 13 + 5);
+        int watching = g % seats;
+        send(table.viewFrame(watching));
+        for (int step = 0; step < MAX_STEPS && table.getStatus() == TableStatus::Playing; step++)
+        {
+            table.getGame()->legalMoves(legal);
+            try
+            {
+                table.applyMove(table.getCurrentSeat(), legal[rng() % legal.size()]);
+            }
+            catch (const Uno::UnoException&)
+            {
+                continue; // A DropTwo play without its drops; pick again
+            }
+            const std::vector<uint8_t>* delta = table.deltaFrame(watching);
+            send(delta ? *delta : table.viewFrame(watching));
+        }
+    }
+    flush();
+
+    // Whole frames only
+    std::vector<uint8_t> partial(recent.back().begin(), recent.back().end() - 1);
+    try
+    {
+        packed.clear();
+        packer->packFrames(partial.data(), partial.size(), packed);
+        fail("packFrames took part of a frame");
+    }
+    catch (const Uno::InvalidInputException&)
+    {
+    }
+
+    // Damaged packed frames, each tried on a copy of the unpacker
+    std::vector<uint8_t> saved;
+    ByteWriter writer(saved);
+    unpacker->saveState(writer);
+    int refused = 0, damaged = 2000;
+    for (int d = 0; d < damaged; d++)
+    {
+        const std::vector<uint8_t>& original = recent[rng() % recent.size()];
+        FramePacker sender;
+        ByteReader packerState(saved); // The unpacker's history is what the packer had
+        sender.loadState(packerState);
+        packed.clear();
+        sender.pack(original.data(), original.size(), packed);
+        int flips = 1 + rng() % 3;
+        for (int f = 0; f < flips; f++)
+            packed[rng() % packed.size()] ^= static_cast<uint8_t>(1 + rng() % 255);
+
+        FrameUnpacker copy;
+        ByteReader reader(saved);
+        copy.loadState(reader);
+        try
+        {
+            copy.unpack(packed.data(), packed.size(), frame);
+        }
+        catch (const Uno::InvalidInputException&)
+        {
+            refused++;
+        }
+    }
+
+    printf("%llu frames, %llu bytes packed to %llu (%.1f%%), %d of %d damaged frames refused, %d wrong\n",
+           (unsigned long long)frames, (unsigned long long)rawBytes, (unsigned long long)packedBytes,
+           rawBytes ? 100.0 * packedBytes / rawBytes : 0.0, refused, damaged, failures);
+    return failures == 0 ? 0 : 1;
+}
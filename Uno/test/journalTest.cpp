@@ -0,0 +1,373 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/MoveJournal.h"
+#include "../header/UnoGame.h"
+#include "../header/Player.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+
+// Checks that a move journal recovers what was logged up to the last whole
+// record, however the file was cut off or damaged.
+//
+//   journalTest [RECORDS]
+//
+// Plays random games side by side, logging a snapshot as each starts, then
+// every move, undo and redo, and an end for those that finish; one more game
+// is logged with snapshots in a caller's own format, as the server does. After
+// each record the test notes what the games looked like. The file is then cut
+// at every record boundary and at points inside records, and damaged by
+// flipped bytes: recovery must give back the games as of the last whole record
+// before the cut or the damage, and restoreGame must rebuild each one exactly.
+// A journal opened on a torn file must drop the tail and append after the
+// whole records, and compact and compactLater must leave one snapshot per
+// game with nothing logged before it. Prints the first differences and exits
+// 1 if there were any.
+
+static const size_t MAGIC_SIZE = 8;
+static const size_t RECORD_HEADER_SIZE = 8;
+static const int LIVE_GAMES = 3;
+static const uint64_t RAW_GAME = 1000; // Logged with snapshots recovery leaves alone
+
+// A game as recovery should find it: an engine snapshot of its state, or for
+// RAW_GAME the snapshot as logged and the number of moves after it
+struct Expected
+{
+    std::vector<uint8_t> state;
+    size_t ops = 0;
+};
+typedef std::map<uint64_t, Expected> Expectation;
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    if (failures < 10)
+        printf("%s\n", what.c_str());
+    failures++;
+}
+
+static std::vector<uint8_t> readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<uint8_t>& bytes, size_t size)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), size);
+}
+
+static void startGame(UnoGame& game, std::mt19937& rng)
+{
+    game.setSeed(rng());
+    int players = 2 + rng() % 3;
+    for (int p = 0; p < players; p++)
+        game.addPlayer(new Player("Player " + std::to_string(p + 1)));
+    game.startGame();
+}
+
+// Compares what recover found in path with expected
+static void checkRecovery(const std::string& path, const Expectation& expected, const std::string& label)
+{
+    std::map<uint64_t, RecoveredGame> games;
+    try
+    {
+        games = MoveJournal::recover(path);
+    }
+    catch (const Uno::UnoException& e)
+    {
+        fail(label + ": recover threw " + e.what());
+        return;
+    }
+    if (games.size() != expected.size())
+    {
+        fail(label + ": recovered " + std::to_string(games.size()) + " games, not " + std::to_string(expected.size()));
+        return;
+    }
+    for (const auto& entry : expected)
+    {
+        auto found = games.find(entry.first);
+        if (found == games.end())
+        {
+            fail(label + ": game " + std::to_string(entry.first) + " was not recovered");
+            continue;
+        }
+        const RecoveredGame& recovered = found->second;
+        if (entry.first == RAW_GAME)
+        {
+            if (recovered.snapshot != entry.second.state || recovered.ops.size() != entry.second.ops)
+                fail(label + ": the game with its own snapshot format came back different");
+            continue;
+        }
+        UnoGame game;
+        std::vector<uint8_t> state;
+        try
+        {
+            MoveJournal::restoreGame(recovered, game);
+            game.saveSnapshot(state);
+        }
+        catch (const Uno::UnoException& e)
+        {
+            fail(label + ": game " + std::to_string(entry.first) + " could not be restored: " + e.what());
+            continue;
+        }
+        if (state != entry.second.state)
+            fail(label + ": game " + std::to_string(entry.first) + " was restored differently");
+    }
+}
+
+// Offsets where each record ends, after the magic
+static std::vector<size_t> recordEnds(const std::vector<uint8_t>& bytes)
+{
+    std::vector<size_t> ends(1, MAGIC_SIZE);
+    size_t offset = MAGIC_SIZE;
+    while (bytes.size() - offset >= RECORD_HEADER_SIZE)
+    {
+        ByteReader header(bytes.data() + offset, RECORD_HEADER_SIZE);
+        offset += RECORD_HEADER_SIZE + header.getU32();
+        ends.push_back(offset);
+    }
+    return ends;
+}
+
+// The journal as of the cut at size: what the last whole record before it left
+static const Expectation& expectationAt(const std::vector<size_t>& ends, const std::vector<Expectation>& after, size_t size)
+{
+    size_t record = 0;
+    while (record + 1 < ends.size() && ends[record + 1] <= size)
+        record++;
+    return after[record];
+}
+
+int main(int argc, char* argv[])
+{
+    size_t records = argc > 1 ? std::stoul(argv[1]) : 1500;
+    silenceGameNarration();
+
+    std::string name = "journalTest-" + std::to_string(std::random_device{}());
+    std::string path = (std::filesystem::temp_directory_path() / (name + ".journal")).string();
+    std::string torn = path + ".torn";
+    std::mt19937 rng(7);
+
+    // Logs random play, noting the expected recovery after each record
+    std::vector<Expectation> after(1); // Before any record: nothing
+    {
+        MoveJournal journal(path, 100);
+        std::unique_ptr<UnoGame> games[LIVE_GAMES];
+        uint64_t ids[LIVE_GAMES];
+        int undoable[LIVE_GAMES] = {}; // Moves since the snapshot that may be undone
+        int redoable[LIVE_GAMES] = {};
+        uint64_t nextId = 1;
+        Expectation current;
+        uint64_t lsn = 0;
+
+        auto note = [&](int g)
+        {
+            if (g >= 0)
+            {
+                current[ids[g]].state.clear();
+                games[g]->saveSnapshot(current[ids[g]].state);
+            }
+            after.push_back(current);
+        };
+        auto begin = [&](int g)
+        {
+            games[g].reset(new UnoGame());
+            startGame(*games[g], rng);
+            ids[g] = nextId++;
+            undoable[g] = redoable[g] = 0;
+            lsn = journal.logSnapshot(ids[g], *games[g]);
+            note(g);
+        };
+        for (int g = 0; g < LIVE_GAMES; g++)
+            begin(g);
+
+        std::vector<Move> legal;
+        while (after.size() <= records)
+        {
+            int action = rng() % 20;
+            int g = rng() % LIVE_GAMES;
+            UnoGame& game = *games[g];
+            if (action == 0)
+            {
+                std::vector<uint8_t> state(1 + rng() % 300);
+                for (uint8_t& byte : state)
+                    byte = static_cast<uint8_t>(rng());
+                lsn = journal.logSnapshot(RAW_GAME, state);
+                current[RAW_GAME].state = state;
+                current[RAW_GAME].ops = 0;
+                note(-1);
+            }
+            else if (action == 1 && current.count(RAW_GAME))
+            {
+                lsn = journal.logMove(RAW_GAME, Move::draw());
+                current[RAW_GAME].ops++;
+                note(-1);
+            }
+            else if (action == 2)
+            {
+                lsn = journal.logSnapshot(ids[g], game); // Starts the game's log afresh
+                undoable[g] = redoable[g] = 0;
+                note(g);
+            }
+            else if (action == 3 && undoable[g] > 0 && game.undoMove())
+            {
+                lsn = journal.logUndo(ids[g]);
+                undoable[g]--;
+                redoable[g]++;
+                note(g);
+            }
+            else if (action == 4 && redoable[g] > 0 && game.redoMove())
+            {
+                lsn = journal.logRedo(ids[g]);
+                undoable[g]++;
+                redoable[g]--;
+                note(g);
+            }
+            else
+            {
+                game.legalMoves(legal);
+                Move move = legal[rng() % legal.size()];
+                try
+                {
+                    game.makeMove(move);
+                }
+                catch (const Uno::UnoException&)
+                {
+                    continue; // A DropTwo play without its drops; pick again
+                }
+                lsn = journal.logMove(ids[g], move);
+                undoable[g]++;
+                redoable[g] = 0;
+                note(g);
+                if (game.isGameOver())
+                {
+                    lsn = journal.logGameEnd(ids[g]);
+                    current.erase(ids[g]);
+                    note(-1);
+                    begin(g);
+                }
+            }
+        }
+        journal.waitDurable(lsn);
+        if (journal.durableLsn() < lsn)
+            fail("waitDurable returned before its record was durable");
+    }
+
+    std::vector<uint8_t> bytes = readFile(path);
+    std::vector<size_t> ends = recordEnds(bytes);
+    if (ends.size() != after.size() || ends.back() != bytes.size())
+    {
+        fail("the journal holds " + std::to_string(ends.size() - 1) + " records in " + std::to_string(bytes.size()) +
+             " bytes; " + std::to_string(after.size() - 1) + " were logged");
+        return 1;
+    }
+    checkRecovery(path, after.back(), "whole journal");
+
+    // Cut at every record boundary, and at some point inside most records
+    int cuts = 0;
+    for (size_t r = 0; r + 1 < ends.size(); r++)
+    {
+        std::vector<size_t> sizes = {ends[r], ends[r] + 1 + rng() % (ends[r + 1] - ends[r] - 1)};
+        if (r % 5 == 0)
+            sizes.push_back(ends[r + 1] - 1); // All but the last byte
+        for (size_t size : sizes)
+        {
+            writeFile(torn, bytes, size);
+            checkRecovery(torn, expectationAt(ends, after, size), "cut at " + std::to_string(size));
+            cuts++;
+        }
+    }
+
+    // A flipped byte ends the journal at the record it falls in
+    for (int d = 0; d < 200; d++)
+    {
+        std::vector<uint8_t> damaged(bytes);
+        size_t at = MAGIC_SIZE + rng() % (bytes.size() - MAGIC_SIZE);
+        damaged[at] ^= static_cast<uint8_t>(1 + rng() % 255);
+        writeFile(torn, damaged, damaged.size());
+        size_t record = 0;
+        while (ends[record + 1] <= at)
+            record++;
+        checkRecovery(torn, after[record], "byte " + std::to_string(at) + " flipped");
+    }
+
+    // A journal opened on a torn file appends after its last whole record
+    size_t record = ends.size() / 2;
+    writeFile(torn, bytes, ends[record] + RECORD_HEADER_SIZE / 2);
+    Expectation expected = after[record];
+    {
+        MoveJournal journal(torn);
+        if (std::filesystem::file_size(torn) != ends[record])
+            fail("opening a torn journal left " + std::to_string(std::filesystem::file_size(torn)) + " bytes, not " +
+                 std::to_string(ends[record]));
+        expected[RAW_GAME].state.assign(5, 9);
+        expected[RAW_GAME].ops = 1;
+        journal.logSnapshot(RAW_GAME, expected[RAW_GAME].state);
+        journal.waitDurable(journal.logMove(RAW_GAME, Move::endTurn()));
+    }
+    checkRecovery(torn, expected, "appended after a torn tail");
+    {
+        MoveJournal journal(torn); // Nothing torn this time
+    }
+    checkRecovery(torn, expected, "reopened after appending");
+
+    // Compacting leaves a snapshot of each live game and drops the rest
+    std::filesystem::remove(torn);
+    {
+        MoveJournal journal(torn, 100);
+        UnoGame first, second;
+        startGame(first, rng);
+        startGame(second, rng);
+        journal.logSnapshot(1, first);
+        journal.logSnapshot(2, second);
+        journal.logSnapshot(3, std::vector<uint8_t>(10, 3));
+        std::vector<Move> legal;
+        for (int m = 0; m < 60; m++)
+        {
+            UnoGame& game = m % 2 ? second : first;
+            if (game.isGameOver())
+                continue;
+            game.legalMoves(legal);
+            Move move = legal[rng() % legal.size()];
+            try
+            {
+                game.makeMove(move);
+            }
+            catch (const Uno::UnoException&)
+            {
+                continue;
+            }
+            journal.logMove(m % 2 ? 2 : 1, move);
+        }
+        journal.compact({{1, &first}, {2, &second}});
+        expected.clear();
+        first.saveSnapshot(expected[1].state);
+        second.saveSnapshot(expected[2].state);
+        checkRecovery(torn, expected, "compacted");
+        if (MoveJournal::recover(torn)[1].ops.size() != 0)
+            fail("compact left moves logged before its snapshot");
+
+        // compactLater swaps the file on the flusher; what is logged after it stays
+        std::vector<uint8_t> state(20, 4);
+        uint64_t lsn = journal.compactLater({{RAW_GAME, state}});
+        journal.logMove(RAW_GAME, Move::draw());
+        journal.waitDurable(lsn + 1);
+        expected.clear();
+        expected[RAW_GAME].state = state;
+        expected[RAW_GAME].ops = 1;
+        checkRecovery(torn, expected, "compacted later");
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(torn);
+    printf("%zu records, %d cuts, %d wrong\n", ends.size() - 1, cuts, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/ServerTable.h"
+#include "../header/UnoGame.h"
+#include "../header/Protocol.h"
+#include "../header/Exceptions.h"
+
+// Checks the client's move prediction against the server.
+//
+//   movePredictionTest [GAMES]
+//
+// Plays games at 2-4 seat tables with random moves, legal or not. Each move
+// goes through predictMove on the mover's view and through
+// ServerTable::applyMove, and both must agree: accepted by both or refused by
+// both with the same message, and when accepted the same top card, turn,
+// flags, UNO calls and hand counts. Cards the server deals are not predicted,
+// so after a draw or an UNO penalty the mover's own hand is not compared.
+// Prints the first differences and exits 1 if there were any.
+
+static const int MAX_STEPS = 2000;
+
+// A random move for a hand of handSize cards, often one the server refuses
+static Move randomMove(std::mt19937& rng, int handSize)
+{
+    int kind = rng() % 10;
+    if (kind < 5)
+    {
+        Move move = Move::play(rng() % (handSize + 1), static_cast<CardColor>(rng() % 5));
+        move.dropCount = rng() % 3;
+        move.dropIndices[0] = rng() % (handSize + 1);
+        move.dropIndices[1] = rng() % (handSize + 1);
+        return move;
+    }
+    if (kind < 7)
+        return Move::draw();
+    if (kind < 9)
+        return Move::endTurn();
+    return Move::callUno();
+}
+
+static bool samePrediction(const TableView& predicted, const TableView& actual, int seat, bool dealt)
+{
+    if (predicted.topCard != actual.topCard || predicted.currentSeat != actual.currentSeat ||
+        predicted.flags != actual.flags || predicted.calledUno[seat] != actual.calledUno[seat])
+    {
+        return false;
+    }
+    if (!dealt && predicted.hand != actual.hand)
+        return false;
+    for (int s = 0; s < actual.seats; s++)
+    {
+        if (s != seat && predicted.handSizes[s] != actual.handSizes[s])
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int games = argc > 1 ? std::stoi(argv[1]) : 1000;
+    silenceGameNarration();
+
+    std::mt19937 rng(7);
+    uint64_t moves = 0, accepted = 0, refused = 0;
+    int failures = 0;
+    for (int g = 0; g < games; g++)
+    {
+        int seats = 2 + g % 3;
+        ServerTable table(g + 1, seats);
+        for (int s = 0; s < seats; s++)
+            table.join("Player " + std::to_string(s + 1));
+        table.start(g * 31 + 5);
+
+        bool playedThisTurn = false;
+        int lastSeat = -1;
+        for (int step = 0; step < MAX_STEPS && table.getStatus() == TableStatus::Playing; step++)
+        {
+            int seat = table.getCurrentSeat();
+            TableView before;
+            table.buildView(seat, before);
+            if (seat != lastSeat || !(before.flags & VIEW_TURN_ACTION))
+                playedThisTurn = false;
+            lastSeat = seat;
+            Move move = randomMove(rng, static_cast<int>(before.hand.size()));
+            moves++;
+
+            TableView predicted = before;
+            bool played = playedThisTurn;
+            std::string predictedError, serverError;
+            try
+            {
+                predictMove(predicted, move, played);
+            }
+            catch (const Uno::UnoException& e)
+            {
+                predictedError = e.what();
+            }
+            try
+            {
+                table.applyMove(seat, move);
+            }
+            catch (const Uno::UnoException& e)
+            {
+                serverError = e.what();
+            }
+
+            if (predictedError != serverError)
+            {
+                if (failures < 10)
+                {
+                    printf("game %d, move %d: predicted \"%s\", server said \"%s\"\n", g, step,
+                           predictedError.empty() ? "accepted" : predictedError.c_str(),
+                           serverError.empty() ? "accepted" : serverError.c_str());
+                }
+                failures++;
+                continue;
+            }
+            if (!serverError.empty())
+            {
+                refused++;
+                continue;
+            }
+            accepted++;
+            playedThisTurn = played;
+            if (table.getStatus() != TableStatus::Playing)
+                break;
+
+            TableView after;
+            table.buildView(seat, after);
+            bool dealt = move.type == MoveType::Draw || after.hand.size() != predicted.hand.size();
+            if (!samePrediction(predicted, after, seat, dealt))
+            {
+                if (failures < 10)
+                    printf("game %d, move %d: predicted view differs from the server's\n", g, step);
+                failures++;
+            }
+        }
+    }
+
+    printf("%llu moves: %llu accepted, %llu refused, %d predicted wrong\n", (unsigned long long)moves,
+           (unsigned long long)accepted, (unsigned long long)refused, failures);
+    return failures == 0 ? 0 : 1;
+}
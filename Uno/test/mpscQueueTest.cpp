@@ -0,0 +1,103 @@
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../header/MpscQueue.h"
+
+// Checks the event loops' inbox queue with many threads pushing at once.
+//
+//   mpscQueueTest [PRODUCERS] [ITEMS]
+//
+// Each producer pushes ITEMS numbered items while one consumer pops them as
+// they come. Every item must come out exactly once and each producer's in
+// the order it pushed them. The items own heap memory, so a sanitizer build
+// also catches one freed twice or never. A last round leaves items in the
+// queue for its destructor. Prints the first differences and exits 1 if
+// there were any.
+
+struct Item
+{
+    int producer = -1;
+    std::unique_ptr<uint64_t> sequence; // On the heap, so a lost or doubled item shows
+};
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    if (failures < 10)
+        printf("%s\n", what.c_str());
+    failures++;
+}
+
+int main(int argc, char* argv[])
+{
+    int producers = argc > 1 ? std::stoi(argv[1]) : 8;
+    uint64_t items = argc > 2 ? std::stoull(argv[2]) : 200000;
+
+    MpscQueue<Item> queue;
+    std::atomic<int> ready(0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&, p]
+        {
+            ready++;
+            while (ready.load() < producers)
+                std::this_thread::yield(); // Start together, so the pushes interleave
+            for (uint64_t i = 0; i < items; i++)
+            {
+                Item item;
+                item.producer = p;
+                item.sequence.reset(new uint64_t(i));
+                queue.push(std::move(item));
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(producers, 0);
+    uint64_t received = 0, empty = 0;
+    Item item;
+    while (received < items * producers)
+    {
+        if (!queue.pop(item))
+        {
+            empty++;
+            std::this_thread::yield();
+            continue;
+        }
+        received++;
+        if (item.producer < 0 || item.producer >= producers || !item.sequence)
+        {
+            fail("item " + std::to_string(received) + " came out empty or from no producer");
+            continue;
+        }
+        uint64_t expected = next[item.producer];
+        if (*item.sequence != expected)
+            fail("producer " + std::to_string(item.producer) + ": item " + std::to_string(*item.sequence) +
+                 " came out where " + std::to_string(expected) + " was due");
+        next[item.producer] = *item.sequence + 1;
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    if (queue.pop(item))
+        fail("an item came out after every pushed one had");
+
+    // The destructor frees what nobody popped
+    {
+        MpscQueue<Item> leftover;
+        for (int i = 0; i < 100; i++)
+        {
+            Item extra;
+            extra.sequence.reset(new uint64_t(i));
+            leftover.push(std::move(extra));
+        }
+        leftover.pop(item);
+    }
+
+    printf("%llu items from %d producers, %llu pops found the queue empty, %d wrong\n",
+           (unsigned long long)received, producers, (unsigned long long)empty, failures);
+    return failures == 0 ? 0 : 1;
+}
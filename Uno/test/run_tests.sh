@@ -0,0 +1,50 @@
+#!/bin/sh
+# Builds the tests in this directory against the engine and server sources,
+# then runs each one; exits non-zero if any test fails to build or run.
+#
+#   test/run_tests.sh [TEST...]     (all of TESTS when none are named)
+#
+# The card classes draw themselves with raylib, so its headers and library
+# must be found: through pkg-config, or RAYLIB_CFLAGS and RAYLIB_LIBS. Objects
+# are kept in UNO_TEST_BUILD (default $TMPDIR/uno-test-build) and rebuilt
+# when their source or any header is newer; CXX and CXXFLAGS are honoured.
+
+TESTS="tableDeltaTest movePredictionTest timingWheelTest mpscQueueTest framePackerTest columnarTest journalTest"
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=${UNO_TEST_BUILD:-${TMPDIR:-/tmp}/uno-test-build}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2 -g}
+RAYLIB_CFLAGS=${RAYLIB_CFLAGS-$(pkg-config --cflags raylib 2>/dev/null)}
+RAYLIB_LIBS=${RAYLIB_LIBS-$(pkg-config --libs raylib 2>/dev/null || echo -lraylib)}
+
+[ $# -gt 0 ] && TESTS="$*"
+mkdir -p "$BUILD/source" || exit 1
+
+# Every source but the GUI, which has its own main program
+objects=""
+for source in "$ROOT"/source/*.cpp; do
+    name=$(basename "$source" .cpp)
+    [ "$name" = GameUI ] && continue
+    object="$BUILD/source/$name.o"
+    if [ ! -f "$object" ] || [ -n "$(find "$source" "$ROOT/header" -newer "$object" | head -n 1)" ]; then
+        $CXX $CXXFLAGS $RAYLIB_CFLAGS -pthread -c "$source" -o "$object" || exit 1
+    fi
+    objects="$objects $object"
+done
+
+failed=0
+for test in $TESTS; do
+    if ! $CXX $CXXFLAGS $RAYLIB_CFLAGS -pthread "$ROOT/test/$test.cpp" $objects $RAYLIB_LIBS -o "$BUILD/$test"; then
+        echo "$test: build failed"
+        failed=1
+        continue
+    fi
+    if "$BUILD/$test"; then
+        echo "$test: passed"
+    else
+        echo "$test: FAILED"
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/ServerTable.h"
+#include "../header/UnoGame.h"
+#include "../header/Protocol.h"
+#include "../header/ByteBuffer.h"
+#include "../header/Exceptions.h"
+
+// Checks that clients following a table through TableDelta messages see what
+// the server sees.
+//
+//   tableDeltaTest [GAMES]
+//
+// Plays random games at 2-4 seat tables. After every move each seat's view is
+// brought up to date the way GameClient does it, from the delta frame or,
+// when the server sends none, the full TableState, and compared with the view
+// ServerTable builds for that seat. Prints the first differences and exits 1
+// if any view went wrong.
+
+static const size_t FRAME_PREFIX = 5; // Size and message type
+static const int MAX_STEPS = 3000;
+
+static ByteReader frameBody(const std::vector<uint8_t>& frame)
+{
+    return ByteReader(frame.data() + FRAME_PREFIX, frame.size() - FRAME_PREFIX);
+}
+
+static bool sameView(const TableView& a, const TableView& b)
+{
+    if (a.version != b.version || a.currentSeat != b.currentSeat || a.flags != b.flags ||
+        a.topCard != b.topCard || a.hand != b.hand)
+    {
+        return false;
+    }
+    for (int s = 0; s < a.seats; s++)
+    {
+        if (a.handSizes[s] != b.handSizes[s] || a.calledUno[s] != b.calledUno[s])
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int games = argc > 1 ? std::stoi(argv[1]) : 300;
+    silenceGameNarration();
+
+    std::mt19937 rng(5);
+    uint64_t moves = 0, deltas = 0, deltaBytes = 0;
+    int failures = 0;
+    for (int g = 0; g < games; g++)
+    {
+        int seats = 2 + g % 3;
+        ServerTable table(g + 1, seats);
+        for (int s = 0; s < seats; s++)
+            table.join("Player " + std::to_string(s + 1));
+        table.start(g * 7 + 1);
+
+        TableView views[MAX_SEATS];
+        for (int s = 0; s < seats; s++)
+        {
+            ByteReader reader = frameBody(table.viewFrame(s));
+            readTableView(reader, views[s]);
+        }
+
+        std::vector<Move> legal;
+        for (int step = 0; step < MAX_STEPS && table.getStatus() == TableStatus::Playing; step++)
+        {
+            table.getGame()->legalMoves(legal);
+            try
+            {
+                table.applyMove(table.getCurrentSeat(), legal[rng() % legal.size()]);
+            }
+            catch (const Uno::UnoException&)
+            {
+                continue; // A DropTwo play without its drops; pick again
+            }
+            moves++;
+
+            for (int s = 0; s < seats; s++)
+            {
+                const std::vector<uint8_t>* delta = table.deltaFrame(s);
+                bool applied = false;
+                if (delta)
+                {
+                    ByteReader reader = frameBody(*delta);
+                    applied = applyTableDelta(reader, views[s]);
+                    deltas++;
+                    deltaBytes += delta->size();
+                }
+                else
+                {
+                    ByteReader reader = frameBody(table.viewFrame(s));
+                    readTableView(reader, views[s]);
+                    applied = true;
+                }
+
+                TableView expected;
+                table.buildView(s, expected);
+                if (!applied || !sameView(views[s], expected))
+                {
+                    if (failures < 10)
+                        printf("game %d, move %d, seat %d: view rebuilt from deltas differs\n", g, step, s);
+                    failures++;
+                    views[s] = expected; // Carry on from the right view
+                }
+            }
+        }
+    }
+
+    printf("%llu moves, %llu deltas (%.1f bytes each), %d views wrong\n", (unsigned long long)moves,
+           (unsigned long long)deltas, deltas ? (double)deltaBytes / deltas : 0.0, failures);
+    return failures == 0 ? 0 : 1;
+}
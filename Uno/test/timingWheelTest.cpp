@@ -0,0 +1,149 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../header/TimingWheel.h"
+
+// Checks the timing wheel against a plain list of due ticks.
+//
+//   timingWheelTest [STEPS]
+//
+// Schedules, reschedules and cancels timers at delays reaching every level of
+// the wheel and past its range, and turns it by steps from one tick to whole
+// cascades of the top levels. Each timer must fire exactly at its tick (the
+// next one for a tick already past, the last in range for one beyond it), in
+// tick order and only once; size() and ticksUntilNext() must agree with the
+// list. Some timers are scheduled again or others cancelled from inside the
+// callback, as the event loop does. Prints the first differences and exits 1
+// if there were any.
+
+static const int TIMERS = 2000;
+static const uint64_t MAX_DELAY = (1ull << (TimingWheel::WHEEL_BITS * TimingWheel::WHEEL_LEVELS)) - 1;
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    if (failures < 10)
+        printf("%s\n", what.c_str());
+    failures++;
+}
+
+// A delay reaching a random level of the wheel, or past the top one
+static uint64_t randomDelay(std::mt19937_64& rng)
+{
+    int level = rng() % (TimingWheel::WHEEL_LEVELS + 1);
+    uint64_t width = 1ull << (TimingWheel::WHEEL_BITS * (level + 1));
+    return rng() % width;
+}
+
+// Where the wheel puts a timer asked for tick
+static uint64_t expectedTick(uint64_t now, uint64_t tick)
+{
+    if (tick <= now)
+        tick = now + 1;
+    if (tick - now > MAX_DELAY)
+        tick = now + MAX_DELAY;
+    return tick;
+}
+
+int main(int argc, char* argv[])
+{
+    int steps = argc > 1 ? std::stoi(argv[1]) : 20000;
+
+    std::mt19937_64 rng(11);
+    uint64_t start = 1000003;
+    TimingWheel wheel(start);
+    std::vector<TimerNode> nodes(TIMERS);
+    std::vector<uint64_t> due(TIMERS, 0); // 0 while not scheduled
+    size_t scheduled = 0;
+    uint64_t fired = 0;
+
+    auto schedule = [&](int i, uint64_t tick)
+    {
+        if (due[i] == 0)
+            scheduled++;
+        due[i] = expectedTick(wheel.currentTick(), tick);
+        nodes[i].owner = i;
+        wheel.schedule(&nodes[i], tick);
+    };
+    auto cancel = [&](int i)
+    {
+        if (due[i] != 0)
+            scheduled--;
+        due[i] = 0;
+        wheel.cancel(&nodes[i]);
+    };
+
+    uint64_t lastFired = 0;
+    auto fire = [&](TimerNode* node)
+    {
+        int i = static_cast<int>(node->owner);
+        uint64_t now = wheel.currentTick();
+        if (due[i] != now)
+            fail("timer " + std::to_string(i) + " fired at " + std::to_string(now) + ", due at " + std::to_string(due[i]));
+        if (now < lastFired)
+            fail("timer " + std::to_string(i) + " fired out of order");
+        if (node->isScheduled())
+            fail("timer " + std::to_string(i) + " still scheduled in its callback");
+        lastFired = now;
+        due[i] = 0;
+        scheduled--;
+        fired++;
+
+        int action = rng() % 8;
+        if (action == 0)
+            schedule(i, now + randomDelay(rng)); // Again, as a turn timer restarts
+        else if (action == 1)
+            cancel(rng() % TIMERS);
+    };
+
+    for (int step = 0; step < steps; step++)
+    {
+        int action = rng() % 10;
+        int i = rng() % TIMERS;
+        if (action < 5)
+            schedule(i, wheel.currentTick() + randomDelay(rng));
+        else if (action < 6)
+            schedule(i, wheel.currentTick() - rng() % 3); // Already due
+        else if (action < 8)
+            cancel(i);
+        else
+        {
+            uint64_t ahead = rng() % 50 == 0 ? rng() % (1u << 18) : 1 + rng() % 100;
+            uint64_t target = wheel.currentTick() + ahead;
+            wheel.advance(target, fire);
+            if (wheel.currentTick() != target)
+                fail("wheel stopped at " + std::to_string(wheel.currentTick()) + ", not " + std::to_string(target));
+        }
+
+        uint64_t now = wheel.currentTick();
+        uint64_t next = 0;
+        for (int t = 0; t < TIMERS; t++)
+        {
+            if (due[t] != 0 && due[t] <= now)
+                fail("timer " + std::to_string(t) + " due at " + std::to_string(due[t]) + " did not fire by " + std::to_string(now));
+            if (due[t] != 0 && (next == 0 || due[t] < next))
+                next = due[t];
+            if ((due[t] != 0) != nodes[t].isScheduled())
+                fail("timer " + std::to_string(t) + " scheduled in the wheel but not in the list, or the other way");
+        }
+        if (wheel.size() != scheduled)
+            fail("wheel holds " + std::to_string(wheel.size()) + " timers, not " + std::to_string(scheduled));
+        int64_t until = wheel.ticksUntilNext();
+        if (scheduled == 0 ? until != -1 : (until < 1 || now + static_cast<uint64_t>(until) > next))
+            fail("ticksUntilNext is " + std::to_string(until) + " at " + std::to_string(now) + ", next timer due at " + std::to_string(next));
+    }
+
+    // Everything left comes due within the wheel's range
+    wheel.advance(wheel.currentTick() + MAX_DELAY, fire);
+    for (int t = 0; t < TIMERS; t++)
+    {
+        if (due[t] != 0 && due[t] <= wheel.currentTick())
+            fail("timer " + std::to_string(t) + " never fired");
+    }
+
+    printf("%llu timers fired over %llu ticks, %d wrong\n", (unsigned long long)fired,
+           (unsigned long long)(wheel.currentTick() - start), failures);
+    return failures == 0 ? 0 : 1;
+}